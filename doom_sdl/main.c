@@ -5,8 +5,11 @@
 #include "doomkeys.h"
 #include "m_argv.h"
 #include "doomgeneric.h"
+#include "i_video.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <stdbool.h>
@@ -19,6 +22,26 @@ SDL_Texture* texture;
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// How frames reach the window:
+//  scaled: the engine upscales to WIDTH x HEIGHT on the CPU and the
+//          result is copied into a texture of that size.
+//  stream: the 320x200 frame is palette-expanded straight into a
+//          streaming texture and the renderer scales it.
+typedef enum
+{
+  present_scaled,
+  present_stream,
+} present_t;
+
+static present_t present_mode = present_stream;
+static SDL_Texture* stream_texture;
+
+// -presenttiming alternates the two paths each frame and reports the
+// CPU time each one takes per presented frame.
+static bool present_timing = false;
+static uint64_t present_ns[2];
+static int present_frames[2];
+
 #define KEYQUEUE_SIZE 16
 
 static unsigned short s_KeyQueue[KEYQUEUE_SIZE];
@@ -159,28 +182,104 @@ void HandleMouse()
   }
 }
 
-void DG_DrawFrame()
+static uint64_t cpuTimeNs()
 {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void presentScaled()
+{
+  I_ScaleFrame(&doom);
   SDL_UpdateTexture(texture, NULL, doom.DG_ScreenBuffer, WIDTH*sizeof(uint32_t));
 
   SDL_RenderClear(renderer);
   SDL_RenderCopy(renderer, texture, NULL, NULL);
   SDL_RenderPresent(renderer);
+}
+
+static void presentStream()
+{
+  void* pixels;
+  int pitch;
+
+  if (SDL_LockTexture(stream_texture, NULL, &pixels, &pitch) == 0) {
+    I_ExpandFrame(pixels, pitch);
+    SDL_UnlockTexture(stream_texture);
+  }
+
+  SDL_RenderClear(renderer);
+  SDL_RenderCopy(renderer, stream_texture, NULL, NULL);
+  SDL_RenderPresent(renderer);
+}
+
+static void reportPresentTiming(uint64_t ns)
+{
+  present_ns[present_mode] += ns;
+  present_frames[present_mode]++;
+
+  if (present_frames[present_scaled] >= 5 * 35 && present_frames[present_stream] >= 5 * 35) {
+    printf("present: scaled %.3f ms CPU/frame, stream %.3f ms CPU/frame\n",
+           present_ns[present_scaled] / 1e6 / present_frames[present_scaled],
+           present_ns[present_stream] / 1e6 / present_frames[present_stream]);
+    memset(present_ns, 0, sizeof(present_ns));
+    memset(present_frames, 0, sizeof(present_frames));
+  }
+
+  present_mode = present_mode == present_scaled ? present_stream : present_scaled;
+}
+
+void DG_DrawFrame()
+{
+  uint64_t start = present_timing ? cpuTimeNs() : 0;
+
+  if (present_mode == present_stream)
+    presentStream();
+  else
+    presentScaled();
+
+  if (present_timing)
+    reportPresentTiming(cpuTimeNs() - start);
+
   HandleMouse();
   handleKeyInput();
 }
 
 int d_putchar(int c) { return putchar(c); }
 
+uint64_t DG_GetTicksUs()
+{
+  uint64_t counter = SDL_GetPerformanceCounter();
+  uint64_t freq = SDL_GetPerformanceFrequency();
+
+  return (counter / freq) * 1000000 + (counter % freq) * 1000000 / freq;
+}
+
 int main(int argc, char **argv)
 {
+  const char* filter = "nearest";
+
+  // Host options; the engine ignores what it does not know.
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-present") && i + 1 < argc) {
+      present_mode = !strcmp(argv[i + 1], "scaled") ? present_scaled : present_stream;
+    } else if (!strcmp(argv[i], "-scalefilter") && i + 1 < argc) {
+      filter = argv[i + 1];   // nearest, linear or best
+    } else if (!strcmp(argv[i], "-presenttiming")) {
+      present_timing = true;
+    }
+  }
+
   doomdata_init(&doom);
+  doom.DG_NativeFrame = true;
+
   window = SDL_CreateWindow("DOOM",
                             SDL_WINDOWPOS_UNDEFINED,
                             SDL_WINDOWPOS_UNDEFINED,
                             WIDTH,
                             HEIGHT,
-                            SDL_WINDOW_SHOWN
+                            SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
                             );
 
   // Setup renderer
@@ -190,7 +289,16 @@ int main(int argc, char **argv)
   // Render the rect to the screen
   SDL_RenderPresent(renderer);
 
+  // Keep 4:3 whatever the window size; both textures are stretched
+  // over the logical size.
+  SDL_RenderSetLogicalSize(renderer, WIDTH, HEIGHT);
+
+  // The filter applies to textures created after the hint is set.
+  SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, filter);
+
   texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+  stream_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING,
+                                     SCREENWIDTH, SCREENHEIGHT);
 
   doomgeneric_Create(&doom, argc, argv);
 
@@ -210,6 +318,7 @@ int main(int argc, char **argv)
   
   SDL_DestroyWindow(window);
   SDL_DestroyTexture(texture);
+  SDL_DestroyTexture(stream_texture);
 
   return 0;
 }
@@ -858,75 +858,71 @@ AM_clipMline(doom_data_t *doom,
 //
 // Classic Bresenham w/ whatever optimizations needed for speed
 //
+// Lines arrive clipped, so the only check is a cheap one against
+// rounding in the clipper.  The error term steps the minor axis with
+// a mask rather than a branch, and horizontal lines are a memset.
+//
 static void
 AM_drawFline(doom_data_t *doom,
              fline_t *fl,
              int color)
 {
-    register int x;
-    register int y;
-    register int dx;
-    register int dy;
-    register int sx;
-    register int sy;
-    register int ax;
-    register int ay;
-    register int d;
-
-    static int fuck = 0;
-
-    // For debugging only
-    if (fl->a.x < 0 || fl->a.x >= doom->f_w || fl->a.y < 0 || fl->a.y >= doom->f_h || fl->b.x < 0 || fl->b.x >= doom->f_w || fl->b.y < 0 || fl->b.y >= doom->f_h)
+    byte *dest;
+    int dx, dy;
+    int ax, ay;
+    int xstep, ystep;
+    int count;
+    int d, step;
+
+    if ((unsigned)fl->a.x >= (unsigned)doom->f_w || (unsigned)fl->b.x >= (unsigned)doom->f_w
+        || (unsigned)fl->a.y >= (unsigned)doom->f_h || (unsigned)fl->b.y >= (unsigned)doom->f_h)
     {
-        d_printf("fuck %d \r", fuck++);
         return;
     }
 
-#define PUTDOT(xx, yy, cc) doom->fb[(yy)*doom->f_w + (xx)] = (cc)
-
     dx = fl->b.x - fl->a.x;
-    ax = 2 * (dx < 0 ? -dx : dx);
-    sx = dx < 0 ? -1 : 1;
-
     dy = fl->b.y - fl->a.y;
+    dest = doom->fb + fl->a.y * doom->f_w + fl->a.x;
+
+    if (dy == 0)
+    {
+        if (dx < 0)
+            d_memset(dest + dx, color, 1 - dx);
+        else
+            d_memset(dest, color, dx + 1);
+        return;
+    }
+
+    ax = 2 * (dx < 0 ? -dx : dx);
+    xstep = dx < 0 ? -1 : 1;
     ay = 2 * (dy < 0 ? -dy : dy);
-    sy = dy < 0 ? -1 : 1;
+    ystep = dy < 0 ? -doom->f_w : doom->f_w;
 
-    x = fl->a.x;
-    y = fl->a.y;
+    *dest = color;
 
     if (ax > ay)
     {
         d = ay - ax / 2;
-        while (1)
+
+        for (count = ax / 2; count > 0; --count)
         {
-            PUTDOT(x, y, color);
-            if (x == fl->b.x)
-                return;
-            if (d >= 0)
-            {
-                y += sy;
-                d -= ax;
-            }
-            x += sx;
-            d += ay;
+            // All ones once d >= 0, when y moves on.
+            step = ~(d >> 31);
+            dest += (ystep & step) + xstep;
+            d += ay - (ax & step);
+            *dest = color;
         }
     }
     else
     {
         d = ax - ay / 2;
-        while (1)
+
+        for (count = ay / 2; count > 0; --count)
         {
-            PUTDOT(x, y, color);
-            if (y == fl->b.y)
-                return;
-            if (d >= 0)
-            {
-                x += sx;
-                d -= ay;
-            }
-            y += sy;
-            d += ax;
+            step = ~(d >> 31);
+            dest += (xstep & step) + ystep;
+            d += ax - (ay & step);
+            *dest = color;
         }
     }
 }
@@ -988,60 +984,134 @@ static void AM_drawGrid(doom_data_t *doom, int color)
 }
 
 //
-// Determines visible lines, draws them.
-// This is LineDef based, not LineSeg based.
+// Finds the lines in the window through the blockmap and clips them
+// to the frame buffer.  The list is only rebuilt when the window has
+// moved or zoomed since the last frame, or the level has changed and
+// taken the PU_LEVEL list with it.
 //
-static void AM_drawWalls(doom_data_t *doom)
+typedef struct amline_s
 {
-    int i;
-    mline_t l;
+    line_t *line;
+    fline_t fl;
+} amline_t;
+
+static void AM_findLines(doom_data_t *doom)
+{
+    int x1, x2, y1, y2;
+    int x, y;
+    short *list;
+    line_t *ld;
+    mline_t ml;
+    amline_t *al;
+
+    if (doom->amlines == NULL)
+    {
+        Z_Malloc(numlines * sizeof(amline_t), PU_LEVEL, &doom->amlines);
+    }
+    else if (doom->amlines_x == doom->m_x && doom->amlines_y == doom->m_y
+             && doom->amlines_w == doom->m_w && doom->amlines_h == doom->m_h)
+    {
+        return;
+    }
+
+    doom->amlines_x = doom->m_x;
+    doom->amlines_y = doom->m_y;
+    doom->amlines_w = doom->m_w;
+    doom->amlines_h = doom->m_h;
+    doom->numamlines = 0;
+
+    x1 = (doom->m_x - bmaporgx) >> MAPBLOCKSHIFT;
+    x2 = (doom->m_x2 - bmaporgx) >> MAPBLOCKSHIFT;
+    y1 = (doom->m_y - bmaporgy) >> MAPBLOCKSHIFT;
+    y2 = (doom->m_y2 - bmaporgy) >> MAPBLOCKSHIFT;
 
-    for (i = 0; i < numlines; i++)
+    x1 = x1 < 0 ? 0 : x1;
+    y1 = y1 < 0 ? 0 : y1;
+    x2 = x2 >= bmapwidth ? bmapwidth - 1 : x2;
+    y2 = y2 >= bmapheight ? bmapheight - 1 : y2;
+
+    // A line is listed in every block it crosses.
+
+    validcount++;
+
+    for (y = y1; y <= y2; y++)
     {
-        l.a.x = lines[i].v1->x;
-        l.a.y = lines[i].v1->y;
-        l.b.x = lines[i].v2->x;
-        l.b.y = lines[i].v2->y;
-        if (doom->cheating || (lines[i].flags & ML_MAPPED))
+        for (x = x1; x <= x2; x++)
         {
-            if ((lines[i].flags & LINE_NEVERSEE) && !doom->cheating)
-                continue;
-            if (!lines[i].backsector)
-            {
-                AM_drawMline(doom, &l, WALLCOLORS + doom->lightlev);
-            }
-            else
+            for (list = blockmaplump + blockmap[y * bmapwidth + x]; *list != -1; list++)
             {
-                if (lines[i].special == 39)
-                { // teleporters
-                    AM_drawMline(doom, &l, WALLCOLORS + WALLRANGE / 2);
-                }
-                else if (lines[i].flags & ML_SECRET) // secret door
-                {
-                    if (doom->cheating)
-                        AM_drawMline(doom, &l, SECRETWALLCOLORS + doom->lightlev);
-                    else
-                        AM_drawMline(doom, &l, WALLCOLORS + doom->lightlev);
-                }
-                else if (lines[i].backsector->floorheight != lines[i].frontsector->floorheight)
-                {
-                    AM_drawMline(doom, &l, FDWALLCOLORS + doom->lightlev); // floor level change
-                }
-                else if (lines[i].backsector->ceilingheight != lines[i].frontsector->ceilingheight)
-                {
-                    AM_drawMline(doom, &l, CDWALLCOLORS + doom->lightlev); // ceiling level change
-                }
-                else if (doom->cheating)
+                ld = &lines[*list];
+
+                if (ld->validcount == validcount)
+                    continue;
+
+                ld->validcount = validcount;
+
+                ml.a.x = ld->v1->x;
+                ml.a.y = ld->v1->y;
+                ml.b.x = ld->v2->x;
+                ml.b.y = ld->v2->y;
+
+                al = &doom->amlines[doom->numamlines];
+
+                if (AM_clipMline(doom, &ml, &al->fl))
                 {
-                    AM_drawMline(doom, &l, TSWALLCOLORS + doom->lightlev);
+                    al->line = ld;
+                    doom->numamlines++;
                 }
             }
         }
-        else if (doom->plr->powers[pw_allmap])
-        {
-            if (!(lines[i].flags & LINE_NEVERSEE))
-                AM_drawMline(doom, &l, GRAYS + 3);
-        }
+    }
+}
+
+//
+// The colour to draw a line in, or -1 if it is not drawn.
+// This is LineDef based, not LineSeg based.
+//
+static int AM_wallColor(doom_data_t *doom, line_t *line)
+{
+    if (doom->cheating || (line->flags & ML_MAPPED))
+    {
+        if ((line->flags & LINE_NEVERSEE) && !doom->cheating)
+            return -1;
+        if (!line->backsector)
+            return WALLCOLORS + doom->lightlev;
+        if (line->special == 39) // teleporters
+            return WALLCOLORS + WALLRANGE / 2;
+        if (line->flags & ML_SECRET) // secret door
+            return (doom->cheating ? SECRETWALLCOLORS : WALLCOLORS) + doom->lightlev;
+        if (line->backsector->floorheight != line->frontsector->floorheight)
+            return FDWALLCOLORS + doom->lightlev; // floor level change
+        if (line->backsector->ceilingheight != line->frontsector->ceilingheight)
+            return CDWALLCOLORS + doom->lightlev; // ceiling level change
+        if (doom->cheating)
+            return TSWALLCOLORS + doom->lightlev;
+    }
+    else if (doom->plr->powers[pw_allmap])
+    {
+        if (!(line->flags & LINE_NEVERSEE))
+            return GRAYS + 3;
+    }
+
+    return -1;
+}
+
+//
+// Determines visible lines, draws them.
+//
+static void AM_drawWalls(doom_data_t *doom)
+{
+    int i;
+    int color;
+
+    AM_findLines(doom);
+
+    for (i = 0; i < doom->numamlines; i++)
+    {
+        color = AM_wallColor(doom, doom->amlines[i].line);
+
+        if (color >= 0)
+            AM_drawFline(doom, &doom->amlines[i].fl, color);
     }
 }
 
@@ -35,12 +35,18 @@
 #include "net_client.h"
 #include "net_gui.h"
 #include "net_io.h"
-#include "net_query.h"
 #include "net_server.h"
-#include "net_sdl.h"
+#include "net_udp.h"
 #include "net_loop.h"
 
+#ifndef FEATURE_MULTIPLAYER
 const static boolean net_client_connected = false;
+#endif
+
+// Longest TryRunTics waits for the other players before returning
+// to let the frame be drawn.
+
+#define MAX_NET_WAIT 250
 
 static boolean BuildNewTic(struct doom_data_t_ *doom)
 {
@@ -90,7 +96,7 @@ static boolean BuildNewTic(struct doom_data_t_ *doom)
 
     if (net_client_connected)
     {
-        NET_CL_SendTiccmd(&cmd, maketic);
+        NET_CL_SendTiccmd(&cmd, doom->maketic);
     }
 
 #endif
@@ -110,6 +116,11 @@ static boolean BuildNewTic(struct doom_data_t_ *doom)
 
 void NetUpdate(struct doom_data_t_ *doom)
 {
+#ifdef FEATURE_MULTIPLAYER
+    NET_CL_Run(doom);
+    NET_SV_Run();
+#endif
+
     BuildNewTic(doom);
 }
 
@@ -173,6 +184,49 @@ void D_StartGameLoop(void)
 void D_StartNetGame(doom_data_t *doom, net_gamesettings_t *settings,
                     netgame_startup_callback_t callback)
 {
+#ifdef FEATURE_MULTIPLAYER
+    int i;
+
+    if (net_client_connected)
+    {
+        settings->consoleplayer = 0;
+        settings->num_players = 0;
+        settings->random = 0;
+        settings->new_sync = 0;
+        settings->extratics = 1;
+        settings->ticdup = 1;
+
+        // The controller's settings go to the server; everyone gets
+        // them back with their own player number.
+
+        NET_CL_StartGame(settings);
+
+        while (!NET_CL_GetSettings(settings))
+        {
+            if (!net_client_connected)
+            {
+                I_Error("D_StartNetGame: Lost connection to server");
+                return;
+            }
+
+            NET_CL_Run(doom);
+            NET_SV_Run();
+            I_Sleep(1);
+        }
+
+        doom->ticdup = settings->ticdup;
+        doom->new_sync = settings->new_sync;
+        doom->localplayer = settings->consoleplayer;
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            doom->local_playeringame[i] = i < settings->num_players;
+        }
+
+        return;
+    }
+#endif
+
     settings->consoleplayer = 0;
     settings->num_players = 1;
     settings->player_classes[0] = doom->player_class;
@@ -200,85 +254,90 @@ boolean D_InitNetGame(doom_data_t *doom, net_connect_data_t *connect_data)
 
 #ifdef FEATURE_MULTIPLAYER
 
+    //!
+    // @arg <n>
+    // @category net
+    //
+    // Use the specified UDP port for the server (default 2342).
+    //
+
+    i = M_CheckParmWithArgs(doom, "-port", 1);
+
+    if (i > 0)
+    {
+        net_udp_port = d_atoi(doom->myargv[i + 1]);
+    }
+
     //!
     // @category net
     //
-    // Start a multiplayer server, listening for connections.
+    // Start a multiplayer server, listening for connections from
+    // other copies of the game on this machine.
     //
 
-    if (M_CheckParm("-server") > 0 || M_CheckParm("-privateserver") > 0)
+    if (M_CheckParm(doom, "-server") > 0)
     {
-        NET_SV_Init();
+        NET_SV_Init(doom);
         NET_SV_AddModule(&net_loop_server_module);
-        NET_SV_AddModule(&net_sdl_module);
-        NET_SV_RegisterWithMaster();
+        NET_SV_AddModule(&net_udp_module);
 
         net_loop_client_module.InitClient();
         addr = net_loop_client_module.ResolveAddress(NULL);
     }
     else
     {
-        //!
-        // @category net
-        //
-        // Automatically search the local LAN for a multiplayer
-        // server and join it.
-        //
-
-        i = M_CheckParm("-autojoin");
-
-        if (i > 0)
-        {
-            addr = NET_FindLANServer();
-
-            if (addr == NULL)
-            {
-                I_Error("No server found on local LAN");
-            }
-        }
-
         //!
         // @arg <address>
         // @category net
         //
         // Connect to a multiplayer server running on the given
-        // address.
+        // address (localhost or 127.x.x.x, with an optional :port).
         //
 
-        i = M_CheckParmWithArgs("-connect", 1);
+        i = M_CheckParmWithArgs(doom, "-connect", 1);
 
         if (i > 0)
         {
-            net_sdl_module.InitClient();
-            addr = net_sdl_module.ResolveAddress(myargv[i + 1]);
+            net_udp_module.InitClient();
+            addr = net_udp_module.ResolveAddress(doom->myargv[i + 1]);
 
             if (addr == NULL)
             {
-                I_Error("Unable to resolve '%s'\n", myargv[i + 1]);
+                I_Error("Unable to resolve '%s'\n", doom->myargv[i + 1]);
+                return false;
             }
         }
     }
 
     if (addr != NULL)
     {
-        if (M_CheckParm("-drone") > 0)
+        //!
+        // @category net
+        //
+        // Join the game without a player, just watching.
+        //
+
+        if (M_CheckParm(doom, "-drone") > 0)
         {
             connect_data->drone = true;
         }
 
-        if (!NET_CL_Connect(addr, connect_data))
+        if (!NET_CL_Connect(doom, addr, connect_data))
         {
             I_Error("D_InitNetGame: Failed to connect to %s\n",
                     NET_AddrToString(addr));
+            return false;
         }
 
         d_printf("D_InitNetGame: Connected to %s\n", NET_AddrToString(addr));
 
+        doom->drone = connect_data->drone;
+
         // Wait for launch message received from server.
 
-        NET_WaitForLaunch();
+        NET_WaitForLaunch(doom);
 
-        result = true;
+        result = net_client_connected;
     }
 #endif
 
@@ -292,6 +351,10 @@ boolean D_InitNetGame(doom_data_t *doom, net_connect_data_t *connect_data)
 //
 void D_QuitNetGame(doom_data_t *doom)
 {
+#ifdef FEATURE_MULTIPLAYER
+    NET_CL_Disconnect();
+    NET_SV_Shutdown();
+#endif
 }
 
 static int GetLowTic(doom_data_t *doom)
@@ -300,6 +363,17 @@ static int GetLowTic(doom_data_t *doom)
 
     lowtic = doom->maketic;
 
+    // In a netgame, tics can only be run once the server has sent
+    // them.  A drone makes no tics of its own.
+
+    if (net_client_connected)
+    {
+        if (doom->drone || doom->recvtic < lowtic)
+        {
+            lowtic = doom->recvtic;
+        }
+    }
+
     return lowtic;
 }
 
@@ -373,10 +447,43 @@ void TryRunTics(struct doom_data_t_ *doom)
 {
     int i;
     int counts;
+#ifdef FEATURE_MULTIPLAYER
+    int start;
+#endif
 
     BuildNewTic(doom);
     ticcmd_set_t *set;
 
+#ifdef FEATURE_MULTIPLAYER
+    if (net_client_connected)
+    {
+        // Keep a whole batch of tics built ahead, so that a packet's
+        // worth is ready by the time the server needs it.
+
+        for (i = 1; i < net_ticbatch; ++i)
+        {
+            NetUpdate(doom);
+        }
+
+        // Wait for the other players' tics.  Give up after a while so
+        // the screen and menu keep running.
+
+        start = I_GetTimeMS();
+
+        while (GetLowTic(doom) <= doom->gametic / doom->ticdup)
+        {
+            if (!net_client_connected
+             || I_GetTimeMS() - start > MAX_NET_WAIT)
+            {
+                return;
+            }
+
+            I_Sleep(1);
+            NetUpdate(doom);
+        }
+    }
+#endif
+
     if (!PlayersInGame(doom))
     {
         return;
@@ -48,11 +48,13 @@
 #include "p_saveg.h"
 
 #include "i_endoom.h"
+#include "i_swap.h"
 #include "i_system.h"
 #include "i_timer.h"
 #include "i_video.h"
 
 #include "g_game.h"
+#include "g_prefetch.h"
 
 #include "hu_stuff.h"
 #include "wi_stuff.h"
@@ -60,7 +62,6 @@
 #include "am_map.h"
 #include "net_client.h"
 #include "net_dedicated.h"
-#include "net_query.h"
 
 #include "p_setup.h"
 #include "r_local.h"
@@ -125,6 +126,64 @@ static void Do_Wipe(doom_data_t *doom)
     }
 }
 
+// Heap usage in the top corner of the view, for -zonestats.
+
+#define ZONESTATS_SITES 3
+
+static void D_DrawZoneStats(doom_data_t *doom)
+{
+    zone_stats_t stats;
+    zone_site_t sites[ZONESTATS_SITES];
+    char buf[64];
+    const char *file, *p;
+    int numsites;
+    int x, y, dy;
+    int i;
+
+    Z_GetStats(&stats);
+
+    x = viewwindowx + 2;
+    y = viewwindowy + 10;
+    dy = SHORT(doom->hu_font[0]->height) + 1;
+
+    d_snprintf(buf, sizeof(buf), "ZONE %iK FREE %iK IN %i BIG %iK",
+               stats.size >> 10, stats.tagbytes[PU_FREE] >> 10,
+               stats.tagblocks[PU_FREE], stats.largestfree >> 10);
+    M_WriteText(doom, x, y, buf);
+    y += dy;
+
+    d_snprintf(buf, sizeof(buf), "STATIC %iK LEVEL %iK CACHE %iK",
+               stats.tagbytes[PU_STATIC] >> 10,
+               (stats.tagbytes[PU_LEVEL] + stats.tagbytes[PU_LEVSPEC]) >> 10,
+               (stats.tagbytes[PU_PURGELEVEL] + stats.tagbytes[PU_CACHE]) >> 10);
+    M_WriteText(doom, x, y, buf);
+    y += dy;
+
+    d_snprintf(buf, sizeof(buf), "PURGED %i %iK REREAD %i %iK",
+               stats.purges, stats.purgedbytes >> 10,
+               stats.rereads, stats.rereadbytes >> 10);
+    M_WriteText(doom, x, y, buf);
+    y += dy;
+
+    numsites = Z_GetSites(sites, ZONESTATS_SITES);
+
+    for (i = 0; i < numsites; ++i)
+    {
+        // Just the file name, without the directory.
+
+        for (file = p = sites[i].file; *p != '\0'; ++p)
+        {
+            if (*p == '/' || *p == '\\')
+                file = p + 1;
+        }
+
+        d_snprintf(buf, sizeof(buf), "%s:%i %iK", file, sites[i].line,
+                   sites[i].bytes >> 10);
+        M_WriteText(doom, x, y, buf);
+        y += dy;
+    }
+}
+
 void D_Display(struct doom_data_t_ *doom)
 {
     int y;
@@ -195,11 +254,17 @@ void D_Display(struct doom_data_t_ *doom)
 
     // draw the view directly
     if (doom->gamestate == GS_LEVEL && !doom->automapactive && doom->gametic)
+    {
         R_RenderPlayerView(doom, &doom->players[doom->displayplayer]);
+        G_MarkLevelFrame(doom);
+    }
 
     if (doom->gamestate == GS_LEVEL && doom->gametic)
         HU_Drawer(doom);
 
+    if (doom->zonestats && doom->gamestate == GS_LEVEL && doom->gametic)
+        D_DrawZoneStats(doom);
+
     // clean up border stuff
     if (doom->gamestate != doom->oldgamestate && doom->gamestate != GS_LEVEL)
         I_SetPalette(W_CacheLumpName(doom, DEH_String("PLAYPAL"), PU_CACHE));
@@ -284,10 +349,6 @@ void D_BindVariables(doom_data_t *doom)
     key_multi_msgplayer[2] = HUSTR_KEYBROWN;
     key_multi_msgplayer[3] = HUSTR_KEYRED;
 
-#ifdef FEATURE_MULTIPLAYER
-    NET_BindVariables();
-#endif
-
     M_BindVariable("mouse_sensitivity", &mouseSensitivity);
     M_BindVariable("sfx_volume", &sfxVolume);
     M_BindVariable("music_volume", &musicVolume);
@@ -333,20 +394,96 @@ boolean D_GrabMouseCallback(doom_data_t *doom)
     return (doom->gamestate == GS_LEVEL) && !doom->demoplayback && !doom->advancedemo;
 }
 
+void doomgeneric_SetBatch(struct doom_data_t_ *doom, int tics, int drawevery)
+{
+    doom->batchtics = tics > 0 ? tics : 1;
+    doom->batchdraw = drawevery > 0 ? drawevery : 0;
+    doom->batchcalls = 0;
+    doom->batchstartus = 0;
+}
+
+void doomgeneric_RequestFrame(struct doom_data_t_ *doom)
+{
+    doom->framerequested = true;
+}
+
+//
+// D_PrintBatchStats
+// How fast the game has been simulated since batching started.
+//
+static void D_PrintBatchStats(doom_data_t *doom)
+{
+    uint64_t us;
+    int tics;
+
+    if (doom->batchstartus == 0)
+        return;
+
+    us = I_GetTimeUS() - doom->batchstartus;
+    tics = doom->gametic - doom->batchstarttic;
+
+    d_printf("D_Batch: %i tics in %u ms, %u tics/s, %i frames drawn\n",
+             tics, (unsigned int) (us / 1000),
+             us > 0 ? (unsigned int) (tics * 1000000ull / us) : 0,
+             doom->batchframes);
+}
+
+//
+// D_FrameDue
+// Whether this call draws.  Skipped frames skip the sound update too;
+//  neither feeds back into the play simulation.
+//
+static boolean D_FrameDue(doom_data_t *doom)
+{
+    if (doom->framerequested)
+    {
+        doom->framerequested = false;
+        return true;
+    }
+
+    if (doom->batchdraw == 0)
+        return false;
+
+    return ++doom->batchcalls % doom->batchdraw == 0;
+}
+
 void doomgeneric_Tick(struct doom_data_t_ *doom)
 {
+    int i;
+
+    if (doom->observation)
+        D_StartObservation(doom);
+
+    if ((doom->batchtics > 1 || doom->batchdraw != 1) && doom->batchstartus == 0)
+    {
+        doom->batchstartus = I_GetTimeUS();
+        doom->batchstarttic = doom->gametic;
+        doom->batchframes = 0;
+    }
+
     // frame syncronous IO operations
     I_StartFrame();
 
-    TryRunTics(doom); // will run at least one tic
-
-    S_UpdateSounds(doom, doom->players[doom->consoleplayer].mo); // move positional sounds
+    for (i = 0; i < doom->batchtics && !doom->should_quit; i++)
+    {
+        TryRunTics(doom); // will run at least one tic
+    }
 
-    // Update display, next frame, with current state.
-    if (screenvisible)
+    if (D_FrameDue(doom))
     {
-        D_Display(doom);
+        S_UpdateSounds(doom, doom->players[doom->consoleplayer].mo); // move positional sounds
+
+        // Update display, next frame, with current state.
+        if (screenvisible)
+        {
+            D_Display(doom);
+        }
+
+        doom->batchframes++;
     }
+
+    if (doom->observation)
+        D_FinishObservation(doom);
 }
 
 //
@@ -1025,55 +1162,13 @@ void D_DoomMain(struct doom_data_t_ *doom)
     // in the game itself.
     //
 
-    if (M_CheckParm("-dedicated") > 0)
+    if (M_CheckParm(doom, "-dedicated") > 0)
     {
         d_printf("Dedicated server mode.\n");
-        NET_DedicatedServer();
+        NET_DedicatedServer(doom);
 
         // Never returns
     }
-
-    //!
-    // @category net
-    //
-    // Query the Internet master server for a global list of active
-    // servers.
-    //
-
-    if (M_CheckParm("-search"))
-    {
-        NET_MasterQuery();
-        exit(0);
-    }
-
-    //!
-    // @arg <address>
-    // @category net
-    //
-    // Query the status of the server running on the given IP
-    // address.
-    //
-
-    p = M_CheckParmWithArgs("-query", 1);
-
-    if (p)
-    {
-        NET_QueryAddress(myargv[p + 1]);
-        exit(0);
-    }
-
-    //!
-    // @category net
-    //
-    // Search the local LAN for running servers.
-    //
-
-    if (M_CheckParm("-localsearch"))
-    {
-        NET_LANQuery();
-        exit(0);
-    }
-
 #endif
 
     //!
@@ -1294,6 +1389,7 @@ void D_DoomMain(struct doom_data_t_ *doom)
     }
 
     I_AtExit((atexit_func_t)G_CheckDemoStatus, true);
+    I_AtExit(D_PrintBatchStats, true);
 
     // Generate the WAD hash table.  Speed things up a bit.
     W_GenerateHashTable(doom);
@@ -1470,6 +1566,41 @@ void D_DoomMain(struct doom_data_t_ *doom)
         doom->testcontrols = true;
     }
 
+    //!
+    // Show zone heap usage over the view; with -zonesites, also the
+    // places that have allocated the most.
+    //
+
+    doom->zonestats = M_CheckParm(doom, "-zonestats") > 0;
+
+    //!
+    // @arg <tics>
+    //
+    // Run this many tics for every frame, for simulating faster than
+    // real time.  The rate is printed on exit.
+    //
+
+    p = M_CheckParmWithArgs(doom, "-batchtics", 1);
+
+    if (p)
+    {
+        doomgeneric_SetBatch(doom, d_atoi(doom->myargv[p + 1]), doom->batchdraw);
+    }
+
+    //!
+    // @arg <n>
+    //
+    // Draw only every nth frame, or with 0 none at all unless the
+    // host asks for one.
+    //
+
+    p = M_CheckParmWithArgs(doom, "-batchdraw", 1);
+
+    if (p)
+    {
+        doomgeneric_SetBatch(doom, doom->batchtics, d_atoi(doom->myargv[p + 1]));
+    }
+
     // Check for load game parameter
     // We do this here and save the slot number, so that the network code
     // can override it or send the load slot to other players.
@@ -39,6 +39,10 @@ void D_AdvanceDemo (doom_data_t* doom);
 void D_DoAdvanceDemo (doom_data_t* doom);
 void D_StartTitle (doom_data_t* doom);
 
+// Around each doomgeneric_Tick while observing.
+void D_StartObservation (doom_data_t* doom);
+void D_FinishObservation (doom_data_t* doom);
+
 
 
 #endif
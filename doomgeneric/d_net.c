@@ -155,6 +155,7 @@ static void InitConnectData(doom_data_t* doom, net_connect_data_t *connect_data)
 {
     connect_data->max_players = MAXPLAYERS;
     connect_data->drone = false;
+    connect_data->player_class = 0;
 
     //!
     // @category net
@@ -194,9 +195,15 @@ static void InitConnectData(doom_data_t* doom, net_connect_data_t *connect_data)
     connect_data->lowres_turn = M_CheckParm(doom, "-record") > 0
                              && M_CheckParm(doom, "-longtics") == 0;
 
-    // Read checksums of our WAD directory and dehacked information
+    // Read checksums of our WADs and dehacked information.  The
+    // contents, not only the directory, so a modified WAD with the
+    // same lumps in the same places is still caught.
 
-    W_Checksum(doom, connect_data->wad_sha1sum);
+    W_ChecksumContents(doom, connect_data->wad_sha1sum);
+
+    // No dehacked support in this build, so nothing to checksum.
+
+    d_memset(connect_data->deh_sha1sum, 0, sizeof(sha1_digest_t));
 
     // Are we playing with the Freedoom IWAD?
 
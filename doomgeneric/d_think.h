@@ -60,6 +60,9 @@ typedef struct thinker_s
     struct thinker_s*	prev;
     struct thinker_s*	next;
     think_t		function;
+
+    // Slab pool the thinker was allocated from, see P_AllocateThinker.
+    struct thinkerpool_s* pool;
     
 } thinker_t;
 
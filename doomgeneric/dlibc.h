@@ -37,6 +37,7 @@ int d_file_exists(const char* path);
 int d_islower(int c);
 void* d_realloc(void* ptr, size_t newsize);
 void* d_memchr(const void *src, int c, size_t n);
+int d_memcmp(const void *vl, const void *vr, size_t n);
 
 struct _IO_FILE;
 typedef struct _IO_FILE FILE;
@@ -70,6 +70,8 @@ void doomdata_init(doom_data_t* doom) {
     doom->scale_mtof = (fixed_t)INITSCALEMTOF;
     doom->new_sync = true;
     doom->ticdup = 1;
+    doom->batchtics = 1;
+    doom->batchdraw = 1;
     doom->show_endoom = 1;
     doom->wipegamestate = GS_DEMOSCREEN;
     doom->oldgamestate = -1;
@@ -564,6 +564,12 @@ struct doom_data_t_
     mpoint_t f_oldloc;
     boolean automapactive;
 
+    // Lines inside the automap window, clipped to the frame buffer,
+    // and the window they were found for.
+    struct amline_s *amlines;
+    int numamlines;
+    fixed_t amlines_x, amlines_y, amlines_w, amlines_h;
+
     event_t events[MAXEVENTS];
     int eventhead;
     int eventtail;
@@ -699,12 +705,35 @@ struct doom_data_t_
     struct lumpinfo_s *lumpinfo;
     unsigned int numlumps;
 
-    // Hash table for fast lookups
+    // Open-addressed hash table of lump numbers keyed on lumpinfo
+    // key, lumphashmask + 1 slots, -1 for an empty slot.
 
-    struct lumpinfo_s **lumphash;
+    int *lumphash;
+    unsigned int lumphashmask;
 
     uint32_t *DG_ScreenBuffer;
 
+    // Set by hosts that scale the frame themselves.  I_FinishUpdate
+    // then leaves DG_ScreenBuffer alone and DG_DrawFrame is expected
+    // to call I_ExpandFrame or I_ScaleFrame.
+    boolean DG_NativeFrame;
+
+    // Set by doomgeneric_Observe.
+    struct dg_observation_s *observation;
+
+    // Tics run by each doomgeneric_Tick, and how many calls apart
+    // frames are drawn, 0 for only when requested.  See
+    // doomgeneric_SetBatch.
+    int batchtics;
+    int batchdraw;
+    int batchcalls;
+    boolean framerequested;
+
+    // For the tics per second report, from the first batched call.
+    uint64_t batchstartus;
+    int batchstarttic;
+    int batchframes;
+
     int myargc;
     char **myargv;
 
@@ -1024,6 +1053,7 @@ struct doom_data_t_
     boolean usergame;  // ok to save / end game
 
     boolean timingdemo; // if true, exit with report on completion
+    int demostarttime;  // I_GetTimeMS() when the timed demo started
     boolean nodrawers;  // for comparative timing purposes
 
     boolean viewactive;
@@ -1048,7 +1078,6 @@ struct doom_data_t_
     boolean netdemo;
     byte *demobuffer;
     byte *demo_p;
-    byte *demoend;
     boolean singledemo; // quit after playing a demo from cmdline
 
     boolean precache; // if true, load all graphics at start
@@ -1056,6 +1085,8 @@ struct doom_data_t_
     boolean testcontrols; // Invoked by setup to test controls
     int testcontrols_mousespeed;
 
+    boolean zonestats; // -zonestats: zone heap overlay
+
     wbstartstruct_t wminfo; // parms for world map / intermission
 
     byte consistancy[MAXPLAYERS][BACKUPTICS];
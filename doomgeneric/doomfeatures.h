@@ -27,9 +27,8 @@
 
 #undef FEATURE_DEHACKED
 
-// Enables multiplayer support (network games)
-
-#undef FEATURE_MULTIPLAYER
+// Multiplayer support (network games) is enabled by the build with
+// FEATURE_MULTIPLAYER where there are sockets to play over.
 
 // Enables sound output
 
@@ -4,10 +4,23 @@
 #include "i_video.h"
 #include "doomgeneric.h"
 #include "dlibc.h"
+#include "d_main.h"
 #include "doomdef.h"
+#include "doomstat.h"
+#include "r_observe.h"
+#include "z_zone.h"
 
 void D_DoomMain (struct doom_data_t_* doom);
 
+extern boolean setsizeneeded;
+
+// R_ObservedViews when the tick started.
+static int startviews;
+
+// The host's writer for doomgeneric_StartCapture.
+static dg_capturewrite_t hostcapturewrite;
+static void *hostcapturedata;
+
 
 void doomgeneric_Create(struct doom_data_t_* doom, int argc, char **argv)
 {
@@ -18,3 +31,173 @@ void doomgeneric_Create(struct doom_data_t_* doom, int argc, char **argv)
     D_DoomMain (doom);
 }
 
+static boolean HostCaptureWrite(void *data, uint64_t offset,
+                                const byte *buf, int length)
+{
+    return hostcapturewrite(hostcapturedata, offset, buf, length) != 0;
+}
+
+int doomgeneric_StartCapture(struct doom_data_t_ *doom,
+                             dg_capturewrite_t write, void *userdata)
+{
+    // Finish any capture still writing through the old writer first.
+
+    I_StopCapture();
+
+    hostcapturewrite = write;
+    hostcapturedata = userdata;
+
+    return I_StartCapture(HostCaptureWrite, NULL);
+}
+
+void doomgeneric_StopCapture(struct doom_data_t_ *doom)
+{
+    I_StopCapture();
+}
+
+size_t doomgeneric_ObservationSize(int flags)
+{
+    size_t size = sizeof(dg_observation_t) + SCREENWIDTH * SCREENHEIGHT;
+
+    if (flags & DG_OBS_DEPTH)
+        size += SCREENWIDTH * SCREENHEIGHT * sizeof(uint16_t);
+
+    if (flags & DG_OBS_LABELS)
+        size += SCREENWIDTH * SCREENHEIGHT;
+
+    return size;
+}
+
+dg_observation_t *doomgeneric_Observe(struct doom_data_t_ *doom, int flags,
+                                      void *memory)
+{
+    dg_observation_t *obs;
+    byte *oldscreen;
+    size_t size;
+
+    if (doom->observation != NULL)
+        return doom->observation;
+
+    size = doomgeneric_ObservationSize(flags);
+
+    if (memory == NULL)
+        memory = Z_Malloc(size, PU_STATIC, NULL);
+
+    d_memset(memory, 0, size);
+
+    obs = memory;
+    obs->size = size;
+    obs->flags = flags;
+    obs->width = SCREENWIDTH;
+    obs->height = SCREENHEIGHT;
+
+    // Draw straight into the region.  Anything holding on to the old
+    // screen follows it, and the view is set up again on the next
+    // frame for the renderer's row pointers.
+
+    oldscreen = I_VideoBuffer;
+    I_SetVideoBuffer(DG_OBS_SCREEN(obs));
+
+    if (doom->dest_screen == oldscreen)
+        doom->dest_screen = I_VideoBuffer;
+    if (doom->fb == oldscreen)
+        doom->fb = I_VideoBuffer;
+    if (doom->wipe_scr == oldscreen)
+        doom->wipe_scr = I_VideoBuffer;
+
+    setsizeneeded = true;
+
+    R_SetObservation(flags & DG_OBS_DEPTH ? DG_OBS_DEPTHBUFFER(obs) : NULL,
+                     flags & DG_OBS_LABELS ? DG_OBS_LABELBUFFER(obs) : NULL,
+                     obs->objects);
+
+    doom->observation = obs;
+
+    return obs;
+}
+
+//
+// D_StartObservation
+// Marks the region as being written, for readers in other processes.
+//
+void D_StartObservation(struct doom_data_t_ *doom)
+{
+    dg_observation_t *obs = doom->observation;
+
+    // The fence keeps this tick's writes to the region after the odd
+    // sequence, as the store alone would only keep earlier ones before.
+    __atomic_store_n(&obs->sequence, obs->sequence | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    startviews = R_ObservedViews();
+}
+
+static void ObserveGameVars(struct doom_data_t_ *doom, dg_gamevars_t *vars)
+{
+    player_t *player = &doom->players[doom->consoleplayer];
+    mobj_t *mo = player->mo;
+    int i;
+
+    vars->gametic = doom->gametic;
+    vars->gamestate = doom->gamestate;
+    vars->episode = doom->gameepisode;
+    vars->map = doom->gamemap;
+    vars->leveltime = leveltime;
+
+    vars->health = player->health;
+    vars->armor = player->armorpoints;
+    vars->dead = player->playerstate == PST_DEAD;
+    vars->readyweapon = player->readyweapon;
+
+    for (i = 0; i < NUMWEAPONS; i++)
+        vars->weaponowned[i] = player->weaponowned[i];
+
+    for (i = 0; i < NUMAMMO; i++)
+    {
+        vars->ammo[i] = player->ammo[i];
+        vars->maxammo[i] = player->maxammo[i];
+    }
+
+    for (i = 0; i < NUMCARDS; i++)
+        vars->cards[i] = player->cards[i];
+
+    vars->damagecount = player->damagecount;
+    vars->bonuscount = player->bonuscount;
+
+    vars->kills = player->killcount;
+    vars->items = player->itemcount;
+    vars->secrets = player->secretcount;
+    vars->totalkills = doom->totalkills;
+    vars->totalitems = doom->totalitems;
+    vars->totalsecrets = doom->totalsecret;
+
+    // No body outside a level.
+
+    if (mo != NULL)
+    {
+        vars->x = mo->x;
+        vars->y = mo->y;
+        vars->z = mo->z;
+        vars->angle = mo->angle;
+        vars->momx = mo->momx;
+        vars->momy = mo->momy;
+        vars->momz = mo->momz;
+    }
+}
+
+//
+// D_FinishObservation
+// Fills in everything but the buffers, which were drawn in place.
+//
+void D_FinishObservation(struct doom_data_t_ *doom)
+{
+    dg_observation_t *obs = doom->observation;
+    boolean viewdrawn = R_ObservedViews() != startviews;
+
+    ObserveGameVars(doom, &obs->vars);
+    I_GetPalette(obs->palette);
+
+    obs->viewdrawn = viewdrawn;
+    obs->numobjects = viewdrawn ? R_ObservedObjects() : 0;
+
+    __atomic_store_n(&obs->sequence, obs->sequence + 1, __ATOMIC_RELEASE);
+}
@@ -1,6 +1,7 @@
 #ifndef DOOM_GENERIC
 #define DOOM_GENERIC
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct doom_data_t_;
@@ -9,10 +10,154 @@ void doomgeneric_Res(uint32_t* width, uint32_t* height);
 void doomgeneric_Create(struct doom_data_t_* doom, int argc, char **argv);
 void doomgeneric_Tick(struct doom_data_t_* doom);
 
+// Batch simulation.  Each doomgeneric_Tick runs tics tics, and draws,
+// presents and updates sound only every drawevery calls, or with 0
+// only after doomgeneric_RequestFrame.  The game plays out the same
+// whether or not frames are drawn.  -batchtics and -batchdraw set
+// the same from the command line.
+void doomgeneric_SetBatch(struct doom_data_t_* doom, int tics, int drawevery);
+void doomgeneric_RequestFrame(struct doom_data_t_* doom);
+
+// Frame capture.  Every frame drawn from here on is queued, with its
+// palette, and coded and written on a background thread through
+// write, which stores length bytes of buf at offset in a file or
+// anything else seekable and returns 0 if it could not.  The format
+// is that of doomgeneric/m_capture.h; tools/capconv turns it into
+// PNGs or raw RGB.  The capture is finished by
+// doomgeneric_StopCapture or at exit.  -capture <file> does the same
+// from the command line.
+typedef int (*dg_capturewrite_t)(void* userdata, uint64_t offset,
+                                 const unsigned char* buf, int length);
+
+int doomgeneric_StartCapture(struct doom_data_t_* doom,
+                             dg_capturewrite_t write, void* userdata);
+void doomgeneric_StopCapture(struct doom_data_t_* doom);
+
+// Observations, for programs that drive the engine and learn from
+// what it shows.  The engine draws the frame, and optionally the
+// depth and label buffers, straight into one region that the host
+// may supply, shared memory say, and fills in the rest at the end of
+// each doomgeneric_Tick.  Nothing is copied out.
+
+#define DG_OBS_DEPTH    1   // distance to what each view pixel shows
+#define DG_OBS_LABELS   2   // which object each view pixel shows
+
+#define DG_OBS_MAXOBJECTS 255
+
+// The console player and level, as of the last tic run.
+typedef struct
+{
+    int32_t gametic;
+    int32_t gamestate;      // gamestate_t
+    int32_t episode, map;
+    int32_t leveltime;
+
+    int32_t health;
+    int32_t armor;
+    int32_t dead;
+    int32_t readyweapon;
+    int32_t weaponowned[9];
+    int32_t ammo[4];
+    int32_t maxammo[4];
+    int32_t cards[6];
+    int32_t damagecount;    // screen flash on taking damage
+    int32_t bonuscount;     // and on picking things up
+
+    int32_t kills, items, secrets;
+    int32_t totalkills, totalitems, totalsecrets;
+
+    // fixed_t and angle_t, as in the engine.
+    int32_t x, y, z;
+    int32_t angle;
+    int32_t momx, momy, momz;
+} dg_gamevars_t;
+
+// An object drawn in the last frame.  Its pixels have label
+// objects index + 1 in the label buffer.
+typedef struct
+{
+    int32_t type;           // mobjtype_t
+    int32_t x, y, z;
+    int32_t angle;
+    int32_t health;
+    int32_t flags;
+} dg_object_t;
+
+typedef struct dg_observation_s
+{
+    uint32_t size;          // of the whole region
+    uint32_t flags;         // DG_OBS_*
+    uint32_t width, height;
+
+    // Odd while a tick is writing, bumped to the next even number
+    // when it is done.  Readers in another process should copy what
+    // they need between doomgeneric_ObservationReadBegin and
+    // doomgeneric_ObservationReadRetry, and copy again if it says so.
+    uint32_t sequence;
+
+    // Whether the depth, labels and objects are from this frame.
+    // They are not written while the 3D view is hidden.
+    uint32_t viewdrawn;
+
+    dg_gamevars_t vars;
+
+    uint8_t palette[256 * 3];
+
+    uint32_t numobjects;
+    dg_object_t objects[DG_OBS_MAXOBJECTS];
+
+    // Followed by the screen, width * height palette indices; then
+    // with DG_OBS_DEPTH width * height uint16_t distances in map units,
+    // 0xffff for the sky; then with DG_OBS_LABELS width * height
+    // labels, 0 for anything that is not an object.
+} dg_observation_t;
+
+#define DG_OBS_SCREEN(obs) ((uint8_t *) ((obs) + 1))
+#define DG_OBS_DEPTHBUFFER(obs) \
+    ((uint16_t *) (DG_OBS_SCREEN(obs) + (obs)->width * (obs)->height))
+#define DG_OBS_LABELBUFFER(obs) \
+    ((uint8_t *) (DG_OBS_DEPTHBUFFER(obs) \
+        + ((obs)->flags & DG_OBS_DEPTH ? (obs)->width * (obs)->height : 0)))
+
+// Bytes of memory doomgeneric_Observe needs for flags.
+size_t doomgeneric_ObservationSize(int flags);
+
+// Start observing, after doomgeneric_Create.  memory, of at least
+// doomgeneric_ObservationSize(flags) bytes and 8-byte aligned, becomes
+// the region; if NULL the engine allocates it.  The engine draws its
+// screen in the region from then on.  Call once.
+dg_observation_t* doomgeneric_Observe(struct doom_data_t_* doom, int flags,
+                                      void* memory);
+
+// Waits for any tick writing the region to finish, and returns the
+// sequence to pass to doomgeneric_ObservationReadRetry.
+static inline uint32_t doomgeneric_ObservationReadBegin(const dg_observation_t* obs)
+{
+    uint32_t sequence;
+
+    while ((sequence = __atomic_load_n(&obs->sequence, __ATOMIC_ACQUIRE)) & 1)
+    {
+    }
+
+    return sequence;
+}
+
+// Nonzero if a tick wrote the region while it was being copied, so
+// the copy may be torn.  The fence keeps the copy's reads before the
+// sequence is checked again.
+static inline int doomgeneric_ObservationReadRetry(const dg_observation_t* obs,
+                                                   uint32_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&obs->sequence, __ATOMIC_RELAXED) != sequence;
+}
 
 //Implement below functions for your platform
 void DG_Init();
 void DG_DrawFrame();
 int DG_GetKey(int* pressed, unsigned char* key);
+// Monotonic time in microseconds, used by i_timer.c
+uint64_t DG_GetTicksUs();
 
 #endif //DOOM_GENERIC
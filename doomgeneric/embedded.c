@@ -1,6 +1,12 @@
 #include "dlibc.h"
 #include <stdbool.h>
+
+#ifdef EMBED_PACKED_WAD
+// doom1.wad is compressed; see w_file_packed.c.
+extern unsigned int doom1_wad_len;
+#else
 #include "doom1wad.h"
+#endif
 
 struct _IO_FILE {
     long offset;
@@ -47,6 +53,11 @@ FILE* d_fopen(const char* filepath, const char* modes) {
 }
 
 int d_fread(void* dest, size_t size, size_t count, FILE* file) {
+#ifdef EMBED_PACKED_WAD
+    // It can still be opened, so the IWAD is found, but the data is
+    // read through w_file_packed.c.
+    return 0;
+#else
     size_t bytesLeft = doom1_wad_len - doom1.offset;
     size_t bytesReq = size * count;
     size_t bytesRead = bytesLeft < bytesReq ? bytesLeft : bytesReq;
@@ -56,6 +67,7 @@ int d_fread(void* dest, size_t size, size_t count, FILE* file) {
     d_memcpy(dest, doom1_wad + doom1.offset, bytesRead);
     doom1.offset += bytesRead;
     return elems;
+#endif
 }
 
 int d_fwrite(const void* src, size_t size, size_t count, FILE* file) { return -1; }
@@ -81,6 +81,10 @@ void	F_CastTicker (struct doom_data_t_* doom);
 boolean F_CastResponder (struct doom_data_t_* doom, event_t *ev);
 void	F_CastDrawer (struct doom_data_t_* doom);
 
+// F_TextWrite keeps its screen in a layer, since it only changes
+// when another letter comes out.
+static vlayer_t textlayer;
+
 //
 // F_StartFinale
 //
@@ -90,6 +94,7 @@ void F_StartFinale (doom_data_t* doom)
 
     doom->gameaction = ga_nothing;
     doom->gamestate = GS_FINALE;
+    V_FreeLayer(&textlayer);
     doom->viewactive = false;
     doom->automapactive = false;
 
@@ -199,7 +204,6 @@ void F_Ticker (doom_data_t* doom)
 
 #include "hu_stuff.h"
 
-
 void F_TextWrite (struct doom_data_t_* doom)
 {
     byte*	src;
@@ -207,14 +211,28 @@ void F_TextWrite (struct doom_data_t_* doom)
     
     int		x,y,w;
     signed int	count;
+    unsigned int	key;
     const char*	ch;
     int		c;
     int		cx;
     int		cy;
     
+    count = ((signed int) doom->finalecount - 10) / TEXTSPEED;
+    if (count < 0)
+	count = 0;
+
+    key = ((unsigned int) (size_t) doom->finaletext * 31
+         + (unsigned int) (size_t) doom->finaleflat) * 31 + count;
+
+    if (!V_BeginLayer(doom, &textlayer, key))
+    {
+	V_EndLayer(doom, &textlayer);
+	return;
+    }
+
     // erase the entire screen to a tiled background
     src = W_CacheLumpName (doom, doom->finaleflat , PU_CACHE);
-    dest = I_VideoBuffer;
+    dest = doom->dest_screen;
 	
     for (y=0 ; y<SCREENHEIGHT ; y++)
     {
@@ -237,9 +255,6 @@ void F_TextWrite (struct doom_data_t_* doom)
     cy = 10;
     ch = doom->finaletext;
 	
-    count = ((signed int) doom->finalecount - 10) / TEXTSPEED;
-    if (count < 0)
-	count = 0;
     for ( ; count ; count-- )
     {
 	c = *ch++;
@@ -265,7 +280,8 @@ void F_TextWrite (struct doom_data_t_* doom)
 	V_DrawPatch(doom, cx, cy, doom->hu_font[c]);
 	cx+=w;
     }
-	
+
+    V_EndLayer(doom, &textlayer);
 }
 
 //
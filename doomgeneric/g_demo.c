@@ -0,0 +1,674 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Demo recording to a file stream, and the compact demo format.
+//
+//   A compact demo is DEMO_COMPACT_VERSION followed by the usual
+//   .lmp header, then one record per tic:
+//
+//     0x00-0x0f   a tic: for each player in the game, a mask of the
+//                 ticcmd fields that differ from that player's last
+//                 command, then the new values of those fields in
+//                 .lmp order and size (the first mask is this byte)
+//     0x80-0xff   the last tic again, (byte & 0x7f) + 1 times
+//     0x40        end of tics
+//
+//   Whatever follows the end byte is .lmp data copied as is: the
+//   end marker, a tic the recording stopped part way through, and
+//   anything a tool left after the marker.  Converting an .lmp to
+//   compact and back gives the same bytes.
+//
+
+#include "dlibc.h"
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "p_sync.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "g_demo.h"
+
+#define FIELD_FORWARD 0x01
+#define FIELD_SIDE    0x02
+#define FIELD_ANGLE   0x04
+#define FIELD_BUTTONS 0x08
+
+#define COMPACT_RUN   0x80
+#define COMPACT_END   0x40
+#define MAXRUN        128
+
+// Data is written to the demo file this many bytes at a time.
+
+#define DEMOCHUNK 16384
+
+// The part of a ticcmd a demo keeps.
+
+typedef struct
+{
+    signed char forwardmove;
+    signed char sidemove;
+    short angleturn;
+    byte buttons;
+} democmd_t;
+
+typedef struct
+{
+    byte *data;
+    int size;
+    int pos;
+} demowriter_t;
+
+typedef struct
+{
+    democmd_t last[MAXPLAYERS];
+    democmd_t tic[MAXPLAYERS];
+    int numplayers;
+    int slot;           // players of tic[] filled in so far
+    int run;            // repeats of last[] not yet written
+    boolean longtics;
+} democoder_t;
+
+static FILE *demofile;
+static byte demochunk[DEMOCHUNK];
+static int chunklength;
+static int streamlength;
+static boolean streamfailed;
+static boolean streamcompact;
+static democoder_t recorder;
+
+// Compact demo being played, expanded to .lmp form.
+
+static byte *expandeddemo;
+
+// Sync block after the end marker of the demo being played.
+
+static const byte *syncblock;
+static int synclength;
+
+static void PutByte(demowriter_t *writer, byte value)
+{
+    if (writer->data != NULL && writer->pos < writer->size)
+    {
+        writer->data[writer->pos] = value;
+    }
+
+    ++writer->pos;
+}
+
+static void PutBytes(demowriter_t *writer, const byte *data, int length)
+{
+    int i;
+
+    for (i = 0; i < length; ++i)
+    {
+        PutByte(writer, data[i]);
+    }
+}
+
+static void InitCoder(democoder_t *coder, const byte *header)
+{
+    int i;
+
+    d_memset(coder, 0, sizeof(*coder));
+    coder->longtics = header[0] == DOOM_191_VERSION;
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        if (header[9 + i])
+        {
+            ++coder->numplayers;
+        }
+    }
+}
+
+static int VanillaCmdLength(democoder_t *coder)
+{
+    return coder->longtics ? 5 : 4;
+}
+
+static void ReadVanillaCmd(democoder_t *coder, const byte *in, democmd_t *cmd)
+{
+    cmd->forwardmove = (signed char)*in++;
+    cmd->sidemove = (signed char)*in++;
+
+    if (coder->longtics)
+    {
+        cmd->angleturn = in[0] | (in[1] << 8);
+        in += 2;
+    }
+    else
+    {
+        cmd->angleturn = *in++ << 8;
+    }
+
+    cmd->buttons = *in;
+}
+
+static void WriteVanillaCmd(democoder_t *coder, demowriter_t *writer, democmd_t *cmd)
+{
+    PutByte(writer, cmd->forwardmove);
+    PutByte(writer, cmd->sidemove);
+
+    if (coder->longtics)
+    {
+        PutByte(writer, cmd->angleturn & 0xff);
+        PutByte(writer, (cmd->angleturn >> 8) & 0xff);
+    }
+    else
+    {
+        PutByte(writer, (cmd->angleturn >> 8) & 0xff);
+    }
+
+    PutByte(writer, cmd->buttons);
+}
+
+static int ChangedFields(democmd_t *cmd, democmd_t *last)
+{
+    int mask = 0;
+
+    if (cmd->forwardmove != last->forwardmove)
+        mask |= FIELD_FORWARD;
+    if (cmd->sidemove != last->sidemove)
+        mask |= FIELD_SIDE;
+    if (cmd->angleturn != last->angleturn)
+        mask |= FIELD_ANGLE;
+    if (cmd->buttons != last->buttons)
+        mask |= FIELD_BUTTONS;
+
+    return mask;
+}
+
+static void FlushRun(democoder_t *coder, demowriter_t *writer)
+{
+    if (coder->run > 0)
+    {
+        PutByte(writer, COMPACT_RUN | (coder->run - 1));
+        coder->run = 0;
+    }
+}
+
+//
+// Writes the tic in coder->tic[] as a compact record, or counts it
+// towards a run if no player's command changed.
+//
+static void EncodeTic(democoder_t *coder, demowriter_t *writer)
+{
+    democmd_t *cmd, *last;
+    int masks[MAXPLAYERS];
+    boolean changed = false;
+    int i;
+
+    for (i = 0; i < coder->numplayers; ++i)
+    {
+        masks[i] = ChangedFields(&coder->tic[i], &coder->last[i]);
+        changed |= masks[i] != 0;
+    }
+
+    if (!changed)
+    {
+        if (++coder->run == MAXRUN)
+        {
+            FlushRun(coder, writer);
+        }
+
+        return;
+    }
+
+    FlushRun(coder, writer);
+
+    for (i = 0; i < coder->numplayers; ++i)
+    {
+        cmd = &coder->tic[i];
+        last = &coder->last[i];
+
+        PutByte(writer, masks[i]);
+
+        if (masks[i] & FIELD_FORWARD)
+            PutByte(writer, cmd->forwardmove);
+        if (masks[i] & FIELD_SIDE)
+            PutByte(writer, cmd->sidemove);
+        if (masks[i] & FIELD_ANGLE)
+        {
+            if (coder->longtics)
+                PutByte(writer, cmd->angleturn & 0xff);
+            PutByte(writer, (cmd->angleturn >> 8) & 0xff);
+        }
+        if (masks[i] & FIELD_BUTTONS)
+            PutByte(writer, cmd->buttons);
+
+        *last = *cmd;
+    }
+}
+
+//
+// Reads the fields in mask into cmd.  Returns the bytes used, or -1
+// if the data runs out.
+//
+static int DecodeFields(democoder_t *coder, const byte *in, int length, int mask, democmd_t *cmd)
+{
+    int needed = 0;
+    int pos = 0;
+
+    if (mask & FIELD_FORWARD)
+        ++needed;
+    if (mask & FIELD_SIDE)
+        ++needed;
+    if (mask & FIELD_ANGLE)
+        needed += coder->longtics ? 2 : 1;
+    if (mask & FIELD_BUTTONS)
+        ++needed;
+
+    if (needed > length)
+    {
+        return -1;
+    }
+
+    if (mask & FIELD_FORWARD)
+        cmd->forwardmove = (signed char)in[pos++];
+    if (mask & FIELD_SIDE)
+        cmd->sidemove = (signed char)in[pos++];
+    if (mask & FIELD_ANGLE)
+    {
+        if (coder->longtics)
+        {
+            cmd->angleturn = in[pos] | (in[pos + 1] << 8);
+            pos += 2;
+        }
+        else
+        {
+            cmd->angleturn = in[pos++] << 8;
+        }
+    }
+    if (mask & FIELD_BUTTONS)
+        cmd->buttons = in[pos++];
+
+    return pos;
+}
+
+int G_EncodeCompactDemo(const byte *in, int length, byte *out, int outsize)
+{
+    demowriter_t writer = {out, outsize, 0};
+    democoder_t coder;
+    int cmdlength;
+    int pos, tic, i;
+
+    if (length < DEMO_HEADER_LENGTH || in[0] == DEMO_COMPACT_VERSION)
+    {
+        return -1;
+    }
+
+    InitCoder(&coder, in);
+    cmdlength = VanillaCmdLength(&coder);
+
+    PutByte(&writer, DEMO_COMPACT_VERSION);
+    PutBytes(&writer, in, DEMO_HEADER_LENGTH);
+
+    // Stop at the first tic that is not all there; it goes in the
+    // tail with the marker.
+
+    pos = DEMO_HEADER_LENGTH;
+
+    while (coder.numplayers > 0)
+    {
+        tic = pos;
+
+        for (i = 0; i < coder.numplayers; ++i)
+        {
+            if (tic + cmdlength > length || in[tic] == DEMOMARKER)
+            {
+                break;
+            }
+
+            ReadVanillaCmd(&coder, in + tic, &coder.tic[i]);
+            tic += cmdlength;
+        }
+
+        if (i < coder.numplayers)
+        {
+            break;
+        }
+
+        EncodeTic(&coder, &writer);
+        pos = tic;
+    }
+
+    FlushRun(&coder, &writer);
+    PutByte(&writer, COMPACT_END);
+    PutBytes(&writer, in + pos, length - pos);
+
+    return writer.pos;
+}
+
+int G_DecodeCompactDemo(const byte *in, int length, byte *out, int outsize)
+{
+    demowriter_t writer = {out, outsize, 0};
+    democoder_t coder;
+    int pos, count, used, mask, i;
+    byte value;
+
+    if (length < 1 + DEMO_HEADER_LENGTH || in[0] != DEMO_COMPACT_VERSION)
+    {
+        return -1;
+    }
+
+    InitCoder(&coder, in + 1);
+    PutBytes(&writer, in + 1, DEMO_HEADER_LENGTH);
+
+    pos = 1 + DEMO_HEADER_LENGTH;
+
+    for (;;)
+    {
+        if (pos >= length)
+        {
+            return -1;
+        }
+
+        value = in[pos++];
+
+        if (value == COMPACT_END)
+        {
+            break;
+        }
+
+        if (value & COMPACT_RUN)
+        {
+            count = (value & ~COMPACT_RUN) + 1;
+        }
+        else
+        {
+            if (coder.numplayers == 0)
+            {
+                return -1;
+            }
+
+            for (i = 0; i < coder.numplayers; ++i)
+            {
+                mask = i == 0 ? value : (pos < length ? in[pos++] : 0xff);
+
+                if (mask & ~(FIELD_FORWARD | FIELD_SIDE | FIELD_ANGLE | FIELD_BUTTONS))
+                {
+                    return -1;
+                }
+
+                used = DecodeFields(&coder, in + pos, length - pos, mask, &coder.last[i]);
+
+                if (used < 0)
+                {
+                    return -1;
+                }
+
+                pos += used;
+            }
+
+            count = 1;
+        }
+
+        while (count-- > 0)
+        {
+            for (i = 0; i < coder.numplayers; ++i)
+            {
+                WriteVanillaCmd(&coder, &writer, &coder.last[i]);
+            }
+        }
+    }
+
+    PutBytes(&writer, in + pos, length - pos);
+
+    return writer.pos;
+}
+
+//
+// Recording
+//
+
+static void FlushChunk(void)
+{
+    if (chunklength > 0 && d_fwrite(demochunk, 1, chunklength, demofile) < chunklength)
+    {
+        streamfailed = true;
+    }
+
+    chunklength = 0;
+}
+
+static void StreamBytes(const byte *data, int length)
+{
+    if (chunklength + length > DEMOCHUNK)
+    {
+        FlushChunk();
+    }
+
+    d_memcpy(demochunk + chunklength, data, length);
+    chunklength += length;
+    streamlength += length;
+}
+
+boolean G_OpenDemoStream(doom_data_t *doom, char *name, byte *header, boolean compact)
+{
+    byte version = DEMO_COMPACT_VERSION;
+
+    demofile = d_fopen(name, "wb");
+
+    if (demofile == NULL)
+    {
+        return false;
+    }
+
+    chunklength = 0;
+    streamlength = 0;
+    streamfailed = false;
+    streamcompact = compact;
+    InitCoder(&recorder, header);
+
+    if (compact)
+    {
+        StreamBytes(&version, 1);
+    }
+
+    StreamBytes(header, DEMO_HEADER_LENGTH);
+
+    return true;
+}
+
+void G_StreamDemoTiccmd(doom_data_t *doom, ticcmd_t *cmd)
+{
+    // Room for a run and a tic with every field changed.
+    byte buffer[1 + MAXPLAYERS * 6];
+    demowriter_t writer = {buffer, sizeof(buffer), 0};
+    democmd_t democmd;
+
+    democmd.forwardmove = cmd->forwardmove;
+    democmd.sidemove = cmd->sidemove;
+    democmd.angleturn = cmd->angleturn;
+    democmd.buttons = cmd->buttons;
+
+    if (!streamcompact)
+    {
+        WriteVanillaCmd(&recorder, &writer, &democmd);
+    }
+    else
+    {
+        recorder.tic[recorder.slot++] = democmd;
+
+        if (recorder.slot >= recorder.numplayers)
+        {
+            recorder.slot = 0;
+            EncodeTic(&recorder, &writer);
+        }
+    }
+
+    if (writer.pos > 0)
+    {
+        StreamBytes(buffer, writer.pos);
+    }
+}
+
+int G_DemoStreamLength(void)
+{
+    return streamlength;
+}
+
+boolean G_CloseDemoStream(doom_data_t *doom)
+{
+    byte buffer[2 + MAXPLAYERS * 5];
+    demowriter_t writer = {buffer, sizeof(buffer), 0};
+    int i, length;
+
+    if (streamcompact)
+    {
+        FlushRun(&recorder, &writer);
+        PutByte(&writer, COMPACT_END);
+
+        // A tic cut short by the quit key stays in .lmp form.
+
+        for (i = 0; i < recorder.slot; ++i)
+        {
+            WriteVanillaCmd(&recorder, &writer, &recorder.tic[i]);
+        }
+    }
+
+    PutByte(&writer, DEMOMARKER);
+    StreamBytes(buffer, writer.pos);
+
+    // Per-tic hashes go after the marker, where players ignore them.
+    // They are read back a chunk at a time from the sync side file.
+
+    FlushChunk();
+
+    while ((length = P_ReadSyncBlock(demochunk, DEMOCHUNK)) > 0)
+    {
+        chunklength = length;
+        streamlength += length;
+        FlushChunk();
+    }
+
+    if (length < 0)
+    {
+        d_printf("G_CloseDemoStream: couldn't read back the sync block, the demo has none\n");
+    }
+
+    d_fclose(demofile);
+    demofile = NULL;
+
+    return !streamfailed;
+}
+
+void G_QuantizeDemoTiccmd(doom_data_t *doom, ticcmd_t *cmd)
+{
+    byte turn;
+
+    // Same rounding as writing the command out and reading it back.
+
+    if (!doom->longtics)
+    {
+        turn = cmd->angleturn >> 8;
+        cmd->angleturn = turn << 8;
+    }
+}
+
+//
+// Playback
+//
+
+// Finds the sync block past the end marker of a .lmp demo, if it
+// has one.
+
+static void FindSyncBlock(const byte *demo, int length)
+{
+    democoder_t coder;
+    int pos;
+
+    syncblock = NULL;
+    synclength = 0;
+
+    if (length < DEMO_HEADER_LENGTH)
+    {
+        return;
+    }
+
+    InitCoder(&coder, demo);
+    pos = DEMO_HEADER_LENGTH;
+
+    while (pos < length && demo[pos] != DEMOMARKER)
+    {
+        pos += VanillaCmdLength(&coder);
+    }
+
+    ++pos;
+
+    if (pos + 4 <= length && d_strncmp((const char *) demo + pos, "DSYN", 4) == 0)
+    {
+        syncblock = demo + pos;
+        synclength = length - pos;
+    }
+}
+
+byte *G_LoadDemo(doom_data_t *doom, char *name)
+{
+    byte *data;
+    int lump, length, expanded;
+
+    lump = W_GetNumForName(doom, name);
+    data = W_CacheLumpNum(doom, lump, PU_STATIC);
+    length = W_LumpLength(doom, lump);
+
+    expandeddemo = NULL;
+
+    if (length == 0 || data[0] != DEMO_COMPACT_VERSION)
+    {
+        FindSyncBlock(data, length);
+        return data;
+    }
+
+    expanded = G_DecodeCompactDemo(data, length, NULL, 0);
+
+    if (expanded < 0)
+    {
+        W_ReleaseLumpName(doom, name);
+        I_Error("G_LoadDemo: %s is not a valid compact demo", name);
+        return NULL;
+    }
+
+    expandeddemo = Z_Malloc(expanded, PU_STATIC, NULL);
+    G_DecodeCompactDemo(data, length, expandeddemo, expanded);
+    W_ReleaseLumpName(doom, name);
+    FindSyncBlock(expandeddemo, expanded);
+
+    return expandeddemo;
+}
+
+const byte *G_DemoSyncBlock(int *length)
+{
+    *length = synclength;
+
+    return syncblock;
+}
+
+void G_ReleaseDemo(doom_data_t *doom, char *name)
+{
+    syncblock = NULL;
+    synclength = 0;
+
+    if (expandeddemo != NULL)
+    {
+        Z_Free(expandeddemo);
+        expandeddemo = NULL;
+    }
+    else
+    {
+        W_ReleaseLumpName(doom, name);
+    }
+}
@@ -0,0 +1,69 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Demo recording to a file stream, and the compact demo format.
+//
+
+
+#ifndef __G_DEMO__
+#define __G_DEMO__
+
+#include "doomdef.h"
+#include "d_ticcmd.h"
+
+#define DEMOMARKER 0x80
+
+// First byte of a compact demo, ahead of the usual .lmp header.
+#define DEMO_COMPACT_VERSION 0xd0
+
+// Version byte, game settings and playeringame[].
+#define DEMO_HEADER_LENGTH (9 + MAXPLAYERS)
+
+// Opens name for writing and writes the .lmp header, prefixed with
+// DEMO_COMPACT_VERSION if compact is set.  Returns false if the file
+// cannot be opened.
+boolean G_OpenDemoStream (doom_data_t* doom, char* name, byte* header, boolean compact);
+
+// Appends one player's ticcmd.  Data goes out to the file a chunk at
+// a time, so the cost stays flat however long the recording runs.
+void G_StreamDemoTiccmd (doom_data_t* doom, ticcmd_t* cmd);
+
+// Bytes the demo takes so far, for -maxdemo.
+int G_DemoStreamLength (void);
+
+// Ends the demo and closes the file.  Returns false if any write
+// failed.
+boolean G_CloseDemoStream (doom_data_t* doom);
+
+// Rounds cmd to what the demo stores, so recording plays the same
+// game as playback will.
+void G_QuantizeDemoTiccmd (doom_data_t* doom, ticcmd_t* cmd);
+
+// Convert between .lmp and compact demos.  Both return the length of
+// the output, or -1 if the input is not a demo of the expected kind.
+// Nothing past outsize is written; pass a NULL out to size a buffer.
+int G_EncodeCompactDemo (const byte* in, int length, byte* out, int outsize);
+int G_DecodeCompactDemo (const byte* in, int length, byte* out, int outsize);
+
+// Caches the demo lump, expanding it if compact, and releases it.
+// A compact demo that does not decode is an I_Error.
+byte* G_LoadDemo (doom_data_t* doom, char* name);
+void G_ReleaseDemo (doom_data_t* doom, char* name);
+
+// The sync block (see p_sync.h) of the demo G_LoadDemo last loaded,
+// or NULL if it has none.  Valid until G_ReleaseDemo.
+const byte* G_DemoSyncBlock (int* length);
+
+#endif
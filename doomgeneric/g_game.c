@@ -38,6 +38,7 @@
 
 #include "p_setup.h"
 #include "p_saveg.h"
+#include "p_sync.h"
 #include "p_tick.h"
 
 #include "d_main.h"
@@ -63,6 +64,9 @@
 // SKY handling - still the wrong place.
 #include "r_data.h"
 #include "r_sky.h"
+#include "g_demo.h"
+#include "g_prefetch.h"
+#include "r_texcache.h"
 
 #include "g_game.h"
 
@@ -464,6 +468,8 @@ void G_DoLoadLevel(doom_data_t *doom)
 {
     int i;
 
+    G_FinishPrefetch(doom);
+
     // Set the sky map.
     // First thing, we have a dummy sky texture name,
     //  a flat. The data is in the WAD only because
@@ -514,7 +520,9 @@ void G_DoLoadLevel(doom_data_t *doom)
     P_SetupLevel(doom, doom->gameepisode, doom->gamemap, 0, doom->gameskill);
     doom->displayplayer = doom->consoleplayer; // view the guy you are playing
     doom->gameaction = ga_nothing;
+#ifndef NDEBUG
     Z_CheckHeap();
+#endif
 
     // clear cmd building stuff
 
@@ -865,6 +873,7 @@ void G_Ticker(doom_data_t *doom)
 
     case GS_INTERMISSION:
         WI_Ticker(doom);
+        G_PrefetchTicker(doom);
         break;
 
     case GS_FINALE:
@@ -875,6 +884,8 @@ void G_Ticker(doom_data_t *doom)
         D_PageTicker(doom);
         break;
     }
+
+    P_SyncTic(doom);
 }
 
 //
@@ -1324,6 +1335,7 @@ void G_DoCompleted(doom_data_t *doom)
     doom->automapactive = false;
 
     WI_Start(doom, &doom->wminfo);
+    G_StartPrefetch(doom, doom->gameepisode, doom->wminfo.next + 1);
 }
 
 //
@@ -1332,6 +1344,7 @@ void G_DoCompleted(doom_data_t *doom)
 void G_WorldDone(doom_data_t *doom)
 {
     doom->gameaction = ga_worlddone;
+    G_MarkWorldDone();
 
     if (secretexit)
         doom->players[doom->consoleplayer].didsecret = true;
@@ -1641,7 +1654,10 @@ void G_InitNew(doom_data_t *doom,
 //
 // DEMO RECORDING
 //
-#define DEMOMARKER 0x80
+
+// -maxdemo, in bytes.
+
+static int demomaxsize;
 
 void G_ReadDemoTiccmd(doom_data_t *doom, ticcmd_t *cmd)
 {
@@ -1669,85 +1685,26 @@ void G_ReadDemoTiccmd(doom_data_t *doom, ticcmd_t *cmd)
     cmd->buttons = (unsigned char)*doom->demo_p++;
 }
 
-// Increase the size of the demo buffer to allow unlimited demos
-
-static void IncreaseDemoBuffer(doom_data_t* doom)
-{
-    int current_length;
-    byte *new_demobuffer;
-    byte *new_demop;
-    int new_length;
-
-    // Find the current size
-
-    current_length = doom->demoend - doom->demobuffer;
-
-    // Generate a new buffer twice the size
-    new_length = current_length * 2;
-
-    new_demobuffer = Z_Malloc(new_length, PU_STATIC, 0);
-    new_demop = new_demobuffer + (doom->demo_p - doom->demobuffer);
-
-    // Copy over the old data
-
-    d_memcpy(new_demobuffer, doom->demobuffer, current_length);
-
-    // Free the old buffer and point the demo pointers at the new buffer.
-
-    Z_Free(doom->demobuffer);
-
-    doom->demobuffer = new_demobuffer;
-    doom->demo_p = new_demop;
-    doom->demoend = doom->demobuffer + new_length;
-}
-
 void G_WriteDemoTiccmd(doom_data_t *doom, ticcmd_t *cmd)
 {
-    byte *demo_start;
-
     if (doom->gamekeydown[key_demo_quit]) // press q to end demo recording
         G_CheckDemoStatus(doom);
 
-    demo_start = doom->demo_p;
-
-    *doom->demo_p++ = cmd->forwardmove;
-    *doom->demo_p++ = cmd->sidemove;
-
-    // If this is a longtics demo, record in higher resolution
-
-    if (doom->longtics)
-    {
-        *doom->demo_p++ = (cmd->angleturn & 0xff);
-        *doom->demo_p++ = (cmd->angleturn >> 8) & 0xff;
-    }
-    else
-    {
-        *doom->demo_p++ = cmd->angleturn >> 8;
-    }
-
-    *doom->demo_p++ = cmd->buttons;
+    if (!doom->demorecording)
+        return;
 
-    // reset demo pointer back
-    doom->demo_p = demo_start;
+    // The demo goes out to its file as it is recorded, so there is
+    // no buffer to grow; -maxdemo only matters with the vanilla limit.
 
-    if (doom->demo_p > doom->demoend - 16)
+    if (doom->vanilla_demo_limit && G_DemoStreamLength() > demomaxsize - 16)
     {
-        if (doom->vanilla_demo_limit)
-        {
-            // no more space
-            G_CheckDemoStatus(doom);
-            return;
-        }
-        else
-        {
-            // Vanilla demo limit disabled: unlimited
-            // demo lengths!
-
-            IncreaseDemoBuffer(doom);
-        }
+        // no more space
+        G_CheckDemoStatus(doom);
+        return;
     }
 
-    G_ReadDemoTiccmd(doom, cmd); // make SURE it is exactly the same
+    G_QuantizeDemoTiccmd(doom, cmd); // make SURE it is exactly the same
+    G_StreamDemoTiccmd(doom, cmd);
 }
 
 //
@@ -1757,13 +1714,12 @@ void G_RecordDemo(struct doom_data_t_* doom, char *name)
 {
     size_t demoname_size;
     int i;
-    int maxsize;
 
     doom->usergame = false;
     demoname_size = d_strlen(name) + 5;
     doom->demoname = Z_Malloc(demoname_size, PU_STATIC, NULL);
     d_snprintf(doom->demoname, demoname_size, "%s.lmp", name);
-    maxsize = 0x20000;
+    demomaxsize = 0x20000;
 
     //!
     // @arg <size>
@@ -1775,9 +1731,7 @@ void G_RecordDemo(struct doom_data_t_* doom, char *name)
 
     i = M_CheckParmWithArgs(doom, "-maxdemo", 1);
     if (i)
-        maxsize = d_atoi(doom->myargv[i + 1]) * 1024;
-    doom->demobuffer = Z_Malloc(maxsize, PU_STATIC, NULL);
-    doom->demoend = doom->demobuffer + maxsize;
+        demomaxsize = d_atoi(doom->myargv[i + 1]) * 1024;
 
     doom->demorecording = true;
 }
@@ -1803,6 +1757,9 @@ int G_VanillaVersionCode(doom_data_t *doom)
 
 void G_BeginRecording(doom_data_t *doom)
 {
+    byte header[DEMO_HEADER_LENGTH];
+    byte *demo_p;
+    boolean compact;
     int i;
 
     //!
@@ -1817,30 +1774,48 @@ void G_BeginRecording(doom_data_t *doom)
 
     doom->lowres_turn = !doom->longtics;
 
-    doom->demo_p = doom->demobuffer;
+    demo_p = header;
 
     // Save the right version code for this demo
 
     if (doom->longtics)
     {
-        *doom->demo_p++ = DOOM_191_VERSION;
+        *demo_p++ = DOOM_191_VERSION;
     }
     else
     {
-        *doom->demo_p++ = G_VanillaVersionCode(doom);
+        *demo_p++ = G_VanillaVersionCode(doom);
     }
 
-    *doom->demo_p++ = doom->gameskill;
-    *doom->demo_p++ = doom->gameepisode;
-    *doom->demo_p++ = doom->gamemap;
-    *doom->demo_p++ = doom->deathmatch;
-    *doom->demo_p++ = doom->respawnparm;
-    *doom->demo_p++ = doom->fastparm;
-    *doom->demo_p++ = doom->nomonsters;
-    *doom->demo_p++ = doom->consoleplayer;
+    *demo_p++ = doom->gameskill;
+    *demo_p++ = doom->gameepisode;
+    *demo_p++ = doom->gamemap;
+    *demo_p++ = doom->deathmatch;
+    *demo_p++ = doom->respawnparm;
+    *demo_p++ = doom->fastparm;
+    *demo_p++ = doom->nomonsters;
+    *demo_p++ = doom->consoleplayer;
 
     for (i = 0; i < MAXPLAYERS; i++)
-        *doom->demo_p++ = doom->playeringame[i];
+        *demo_p++ = doom->playeringame[i];
+
+    //!
+    // @category demo
+    //
+    // Record in the compact format, which codes only what changes
+    // from one tic to the next.  Played back like any other demo.
+    //
+
+    compact = M_CheckParm(doom, "-compactdemo") != 0;
+
+    if (!G_OpenDemoStream(doom, doom->demoname, header, compact))
+    {
+        d_printf("G_BeginRecording: couldn't open %s, not recording\n", doom->demoname);
+        doom->demorecording = false;
+        return;
+    }
+
+    P_StartSyncRecord(doom);
 }
 
 //
@@ -1860,9 +1835,11 @@ void G_DoPlayDemo(doom_data_t *doom)
     skill_t skill;
     int i, episode, map;
     int demoversion;
+    const byte *sync;
+    int synclength;
 
     doom->gameaction = ga_nothing;
-    doom->demobuffer = doom->demo_p = W_CacheLumpName(doom, defdemoname, PU_STATIC);
+    doom->demobuffer = doom->demo_p = G_LoadDemo(doom, defdemoname);
 
     demoversion = *doom->demo_p++;
 
@@ -1901,6 +1878,14 @@ void G_DoPlayDemo(doom_data_t *doom)
 
     doom->usergame = false;
     doom->demoplayback = true;
+
+    sync = G_DemoSyncBlock(&synclength);
+
+    if (sync != NULL)
+        P_StartSyncCheck(doom, sync, synclength);
+
+    if (doom->timingdemo)
+        doom->demostarttime = I_GetTimeMS();
 }
 
 //
@@ -1935,11 +1920,30 @@ void G_TimeDemo(doom_data_t *doom, char *name)
 
 boolean G_CheckDemoStatus(doom_data_t *doom)
 {
-    int endtime;
+    int realtime;
+
+    if (doom->timingdemo)
+    {
+        realtime = I_GetTimeMS() - doom->demostarttime;
+        if (realtime <= 0)
+            realtime = 1;
+
+        // Prevent recursive calls, and quit once the
+        // playback below has been cleaned up
+        doom->timingdemo = false;
+        doom->singledemo = true;
+
+        d_printf("timed %i gametics in %i ms (%i fps)\n",
+                 doom->gametic, realtime, doom->gametic * 1000 / realtime);
+        P_PrintThinkerStats();
+        P_PrintSightStats();
+        R_PrintTextureCacheStats();
+    }
 
     if (doom->demoplayback)
     {
-        W_ReleaseLumpName(doom, defdemoname);
+        P_StopSync();
+        G_ReleaseDemo(doom, defdemoname);
         doom->demoplayback = false;
         doom->netdemo = false;
         doom->netgame = false;
@@ -1960,10 +1964,16 @@ boolean G_CheckDemoStatus(doom_data_t *doom)
 
     if (doom->demorecording)
     {
-        *doom->demo_p++ = DEMOMARKER;
-        M_WriteFile(doom->demoname, doom->demobuffer, doom->demo_p - doom->demobuffer);
-        Z_Free(doom->demobuffer);
         doom->demorecording = false;
+
+        if (!G_CloseDemoStream(doom))
+        {
+            P_StopSync();
+            I_Error("Couldn't write demo %s", doom->demoname);
+            return false;
+        }
+
+        P_StopSync();
         I_Error("Demo %s recorded", doom->demoname);
     }
 
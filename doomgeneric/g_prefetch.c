@@ -0,0 +1,500 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Preloading of the next level during the intermission.
+//   The map lumps, flats, wall patches and sprites of the next
+//   level are pulled into the zone cache a slice at a time, and
+//   its composite textures are built into the texture cache, so
+//   G_DoLoadLevel mostly finds everything already in memory.
+//   The zone is only touched from the main thread; composites are
+//   drawn on a background thread where one is available.
+//
+
+#include "dlibc.h"
+
+#include "doomdef.h"
+#include "doomdata.h"
+#include "doomstat.h"
+#include "i_swap.h"
+#include "i_thread.h"
+#include "i_timer.h"
+#include "info.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "p_setup.h"
+#include "r_data.h"
+#include "r_sky.h"
+#include "r_state.h"
+#include "r_texcache.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "g_prefetch.h"
+
+// Time allowed per intermission tic (1/35 s = 28571 us).
+
+#define PREFETCH_BUDGET_US 6000
+
+// Composite patches held locked in the zone at one time.
+
+#define PREFETCH_LOCKED_BYTES (1024 * 1024)
+
+typedef enum
+{
+    pf_idle,
+    pf_maplumps,
+    pf_scan,
+    pf_flats,
+    pf_textures,
+    pf_startdraw,
+    pf_sprites,
+    pf_draw,
+    pf_done
+} prefetchstate_t;
+
+static prefetchstate_t state = pf_idle;
+
+static int maplump;
+static int position;
+
+static int *flatlumps;
+static int numflatlumps;
+static char *texturepresent;
+static char *spritepresent;
+
+// Composites reserved in the texture cache, waiting to be drawn.
+
+static int *jobtexnums;
+static patch_t ***jobpatches;
+static patch_t **patchbuffer;
+static patch_t **nextpatch;
+static int numjobs;
+static int numdrawn;
+static int lockedbytes;
+static boolean texcachefull;
+
+static ithread_t *drawthread;
+
+static int loadedbytes;
+static uint64_t prefetchtime;
+static boolean prefetched;
+
+static uint64_t worlddonetime;
+
+static void DrawCompositesThread(void *data)
+{
+    int i;
+
+    for (i = 0; i < numjobs; ++i)
+    {
+        R_DrawComposite(jobtexnums[i], jobpatches[i]);
+    }
+}
+
+static void CacheLump(doom_data_t *doom, int lump)
+{
+    W_CacheLumpNum(doom, lump, PU_CACHE);
+    loadedbytes += doom->lumpinfo[lump].size;
+}
+
+static void AddFlat(doom_data_t *doom, char *name)
+{
+    char buf[9];
+    int lump;
+
+    M_StringCopy(buf, name, sizeof(buf));
+    lump = W_CheckNumForName(doom, buf);
+
+    if (lump >= 0)
+    {
+        flatlumps[numflatlumps++] = lump;
+    }
+}
+
+static void AddTexture(char *name)
+{
+    char buf[9];
+    int texnum;
+
+    M_StringCopy(buf, name, sizeof(buf));
+    texnum = R_CheckTextureNumForName(buf);
+
+    if (texnum >= 0)
+    {
+        texturepresent[texnum] = 1;
+    }
+}
+
+static void AddThing(int type)
+{
+    int i;
+
+    for (i = 0; i < NUMMOBJTYPES; ++i)
+    {
+        if (mobjinfo[i].doomednum == type)
+        {
+            spritepresent[states[mobjinfo[i].spawnstate].sprite] = 1;
+            break;
+        }
+    }
+}
+
+// Work out what the level needs from its SECTORS, SIDEDEFS
+// and THINGS lumps.
+
+static void ScanMap(doom_data_t *doom)
+{
+    mapsector_t *ms;
+    mapsidedef_t *msd;
+    mapthing_t *mt;
+    int count;
+    int i;
+
+    ms = W_CacheLumpNum(doom, maplump + ML_SECTORS, PU_STATIC);
+    count = W_LumpLength(doom, maplump + ML_SECTORS) / sizeof(mapsector_t);
+
+    flatlumps = Z_Malloc((count * 2 + 1) * sizeof(*flatlumps), PU_STATIC, NULL);
+    numflatlumps = 0;
+
+    for (i = 0; i < count; ++i)
+    {
+        AddFlat(doom, ms[i].floorpic);
+        AddFlat(doom, ms[i].ceilingpic);
+    }
+
+    W_ReleaseLumpNum(doom, maplump + ML_SECTORS);
+
+    texturepresent = Z_Malloc(numtextures, PU_STATIC, NULL);
+    d_memset(texturepresent, 0, numtextures);
+
+    msd = W_CacheLumpNum(doom, maplump + ML_SIDEDEFS, PU_STATIC);
+    count = W_LumpLength(doom, maplump + ML_SIDEDEFS) / sizeof(mapsidedef_t);
+
+    for (i = 0; i < count; ++i)
+    {
+        AddTexture(msd[i].toptexture);
+        AddTexture(msd[i].midtexture);
+        AddTexture(msd[i].bottomtexture);
+    }
+
+    W_ReleaseLumpNum(doom, maplump + ML_SIDEDEFS);
+
+    texturepresent[skytexture] = 1;
+
+    spritepresent = Z_Malloc(numsprites, PU_STATIC, NULL);
+    d_memset(spritepresent, 0, numsprites);
+
+    mt = W_CacheLumpNum(doom, maplump + ML_THINGS, PU_STATIC);
+    count = W_LumpLength(doom, maplump + ML_THINGS) / sizeof(mapthing_t);
+
+    for (i = 0; i < count; ++i)
+    {
+        AddThing(SHORT(mt[i].type));
+    }
+
+    W_ReleaseLumpNum(doom, maplump + ML_THINGS);
+
+    // Room to lock the patches of every composite.
+
+    count = 0;
+
+    for (i = 0; i < numtextures; ++i)
+    {
+        if (texturepresent[i])
+        {
+            count += R_TexturePatchCount(i);
+        }
+    }
+
+    jobtexnums = Z_Malloc(numtextures * sizeof(*jobtexnums), PU_STATIC, NULL);
+    jobpatches = Z_Malloc(numtextures * sizeof(*jobpatches), PU_STATIC, NULL);
+    patchbuffer = Z_Malloc((count + 1) * sizeof(*patchbuffer), PU_STATIC, NULL);
+    nextpatch = patchbuffer;
+}
+
+static void PrefetchTexture(doom_data_t *doom, int texnum)
+{
+    int locked;
+
+    loadedbytes += R_CacheTexturePatches(doom, texnum);
+
+    if (texcachefull)
+    {
+        return;
+    }
+
+    locked = R_ReserveComposite(doom, texnum, nextpatch, &lockedbytes);
+
+    if (locked > 0)
+    {
+        jobtexnums[numjobs] = texnum;
+        jobpatches[numjobs] = nextpatch;
+        ++numjobs;
+        nextpatch += locked;
+    }
+
+    // Leave the rest to R_PrecacheLevel.
+    if (locked < 0 || lockedbytes >= PREFETCH_LOCKED_BYTES)
+    {
+        texcachefull = true;
+    }
+}
+
+static void PrefetchSprite(doom_data_t *doom, int sprite)
+{
+    spriteframe_t *sf;
+    int i;
+    int j;
+
+    for (i = 0; i < sprites[sprite].numframes; ++i)
+    {
+        sf = &sprites[sprite].spriteframes[i];
+
+        for (j = 0; j < 8; ++j)
+        {
+            CacheLump(doom, firstspritelump + sf->lump[j]);
+        }
+    }
+}
+
+// Do one unit of work.
+
+static void PrefetchStep(doom_data_t *doom)
+{
+    switch (state)
+    {
+    case pf_maplumps:
+        CacheLump(doom, maplump + position);
+        if (++position > ML_BLOCKMAP)
+        {
+            state = pf_scan;
+        }
+        break;
+
+    case pf_scan:
+        ScanMap(doom);
+        position = 0;
+        state = pf_flats;
+        break;
+
+    case pf_flats:
+        if (position < numflatlumps)
+        {
+            CacheLump(doom, flatlumps[position++]);
+            break;
+        }
+        position = 0;
+        state = pf_textures;
+        break;
+
+    case pf_textures:
+        while (position < numtextures && !texturepresent[position])
+        {
+            ++position;
+        }
+        if (position < numtextures)
+        {
+            PrefetchTexture(doom, position++);
+            break;
+        }
+        state = pf_startdraw;
+        break;
+
+    case pf_startdraw:
+        // Everything the draw needs is locked, so it can go on in
+        // the background while the sprites are loaded.
+        if (numjobs > 0)
+        {
+            drawthread = I_StartThread(DrawCompositesThread, NULL);
+            if (drawthread != NULL)
+            {
+                numdrawn = numjobs;
+            }
+        }
+        position = 0;
+        state = pf_sprites;
+        break;
+
+    case pf_sprites:
+        while (position < numsprites && !spritepresent[position])
+        {
+            ++position;
+        }
+        if (position < numsprites)
+        {
+            PrefetchSprite(doom, position++);
+            break;
+        }
+        state = pf_draw;
+        break;
+
+    case pf_draw:
+        // No background thread: draw one composite per step.
+        if (numdrawn < numjobs)
+        {
+            R_DrawComposite(jobtexnums[numdrawn], jobpatches[numdrawn]);
+            ++numdrawn;
+            break;
+        }
+        state = pf_done;
+        break;
+
+    default:
+        break;
+    }
+}
+
+//
+// G_StartPrefetch
+//
+void G_StartPrefetch(doom_data_t *doom, int episode, int map)
+{
+    char lumpname[9];
+
+    G_FinishPrefetch(doom);
+
+    //!
+    // @category obscure
+    //
+    // Do not preload the next level during the intermission.
+    //
+
+    if (M_CheckParm(doom, "-noprefetch"))
+    {
+        return;
+    }
+
+    P_MapLumpName(doom, episode, map, lumpname);
+    maplump = W_CheckNumForName(doom, lumpname);
+
+    if (maplump < 0 || maplump + ML_BLOCKMAP >= doom->numlumps)
+    {
+        return;
+    }
+
+    // Composites left over from this level may now be evicted.
+    R_TextureCacheFrame();
+
+    state = pf_maplumps;
+    position = ML_THINGS;
+    numjobs = 0;
+    numdrawn = 0;
+    lockedbytes = 0;
+    loadedbytes = 0;
+    prefetchtime = 0;
+    texcachefull = false;
+    drawthread = NULL;
+}
+
+//
+// G_PrefetchTicker
+//
+void G_PrefetchTicker(doom_data_t *doom)
+{
+    uint64_t start;
+    uint64_t now;
+
+    if (state == pf_idle || state == pf_done)
+    {
+        return;
+    }
+
+    start = I_GetTimeUS();
+
+    do
+    {
+        PrefetchStep(doom);
+        now = I_GetTimeUS();
+    } while (state != pf_done && now - start < PREFETCH_BUDGET_US);
+
+    prefetchtime += now - start;
+}
+
+//
+// G_FinishPrefetch
+//
+void G_FinishPrefetch(doom_data_t *doom)
+{
+    int i;
+
+    prefetched = state == pf_done;
+
+    if (state == pf_idle)
+    {
+        return;
+    }
+
+    if (drawthread != NULL)
+    {
+        I_WaitThread(drawthread);
+        drawthread = NULL;
+    }
+
+    if (state >= pf_textures)
+    {
+        // Composites that were reserved must be complete before
+        // anything can draw them.
+        for (; numdrawn < numjobs; ++numdrawn)
+        {
+            R_DrawComposite(jobtexnums[numdrawn], jobpatches[numdrawn]);
+        }
+
+        for (i = 0; i < numjobs; ++i)
+        {
+            R_ReleaseComposite(doom, jobtexnums[i]);
+        }
+    }
+
+    if (state > pf_scan)
+    {
+        Z_Free(flatlumps);
+        Z_Free(texturepresent);
+        Z_Free(spritepresent);
+        Z_Free(jobtexnums);
+        Z_Free(jobpatches);
+        Z_Free(patchbuffer);
+    }
+
+    if (doom->devparm)
+    {
+        d_printf("G_FinishPrefetch: %s, %i KiB and %i composites "
+                 "in %i us\n", prefetched ? "complete" : "partial",
+                 loadedbytes / 1024, numjobs, (int) prefetchtime);
+    }
+
+    state = pf_idle;
+}
+
+void G_MarkWorldDone(void)
+{
+    worlddonetime = I_GetTimeUS();
+}
+
+void G_MarkLevelFrame(doom_data_t *doom)
+{
+    if (worlddonetime == 0)
+    {
+        return;
+    }
+
+    if (doom->devparm)
+    {
+        d_printf("G_MarkLevelFrame: %i us from exit to first frame, "
+                 "prefetch %s\n", (int) (I_GetTimeUS() - worlddonetime),
+                 prefetched ? "complete" : "not complete");
+    }
+
+    worlddonetime = 0;
+}
@@ -0,0 +1,39 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Preloading of the next level during the intermission.
+//
+
+
+#ifndef __G_PREFETCH__
+#define __G_PREFETCH__
+
+#include "doomdef.h"
+
+// Called by G_DoCompleted once the next map is known.
+void G_StartPrefetch (doom_data_t* doom, int episode, int map);
+
+// Does a slice of the preload, called every intermission tic.
+void G_PrefetchTicker (doom_data_t* doom);
+
+// Waits for the preload and releases everything it holds.
+// Must be called before the next level is set up.
+void G_FinishPrefetch (doom_data_t* doom);
+
+// Exit to first frame latency, reported with -devparm.
+void G_MarkWorldDone (void);
+void G_MarkLevelFrame (doom_data_t* doom);
+
+#endif
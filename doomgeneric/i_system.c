@@ -54,14 +54,14 @@ static atexit_listentry_t *exit_funcs = NULL;
 
 void I_AtExit(atexit_func_t func, boolean run_on_error)
 {
-#define EXIT_FUNC_COUNT 6
+#define EXIT_FUNC_COUNT 7
     static atexit_listentry_t funcs[EXIT_FUNC_COUNT];
     static size_t index = 0;
 
     if (index >= EXIT_FUNC_COUNT)
     {
         I_Error("Number of exit functions has increased\n");
-        return; // There should be only 6 functions
+        return; // There should be only 7 functions
     }
 
     atexit_listentry_t *entry = funcs + index;
@@ -187,15 +187,54 @@ void I_Quit(doom_data_t *doom)
     }
 }
 
+#define ERROR_FUNC_COUNT 2
+
+static void (*error_funcs[ERROR_FUNC_COUNT])(void);
+
+void I_AtError(void (*func)(void))
+{
+    int i;
+
+    for (i = 0; i < ERROR_FUNC_COUNT; ++i)
+    {
+        if (error_funcs[i] == NULL)
+        {
+            error_funcs[i] = func;
+            return;
+        }
+    }
+
+    I_Error("Number of error functions has increased\n");
+}
+
 //
 // I_Error
 //
 void I_Error(char *error, ...)
 {
+    static boolean in_error = false;
     va_list va;
+    int i;
+
     va_start(va, error);
     d_vprintf(error, va);
     va_end(va);
+
+    // An error in an error function is only printed.
+
+    if (in_error)
+    {
+        return;
+    }
+
+    in_error = true;
+
+    for (i = 0; i < ERROR_FUNC_COUNT && error_funcs[i] != NULL; ++i)
+    {
+        error_funcs[i]();
+    }
+
+    in_error = false;
 }
 
 #define DOS_MEM_DUMP_SIZE 10
@@ -65,6 +65,11 @@ boolean I_GetMemoryValue(struct doom_data_t_* doom, unsigned int offset, void *v
 
 void I_AtExit(atexit_func_t func, boolean run_if_error);
 
+// Schedule a function to be called by I_Error once the message has
+// been printed, to save a log say.  I_Error still returns after.
+
+void I_AtError(void (*func)(void));
+
 // Add all system-specific config file variable bindings.
 
 void I_BindVariables(void);
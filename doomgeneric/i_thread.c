@@ -0,0 +1,343 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Thread functions.
+//
+
+#include "doomtype.h"
+#include "i_thread.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAXWORKERS 8
+#define MAXTHREADS 4
+#define MAXSIGNALS 4
+
+struct ithread_s
+{
+    pthread_t thread;
+    threadfunc_t func;
+    void *data;
+    boolean inuse;
+};
+
+static ithread_t threads[MAXTHREADS];
+
+struct isignal_s
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int count;
+};
+
+static isignal_t signals[MAXSIGNALS];
+static int numsignals;
+
+typedef struct
+{
+    parallelfunc_t func;
+    void *data;
+    int count;
+    int next;
+} paralleljob_t;
+
+static void RunJobs(paralleljob_t *job)
+{
+    int i;
+
+    for (;;)
+    {
+        i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+
+        if (i >= job->count)
+        {
+            break;
+        }
+
+        job->func(job->data, i);
+    }
+}
+
+// I_ParallelFor's workers are started on its first call and kept,
+// waiting for the next job.  Every worker takes part in every job,
+// even if only to find nothing left, so the job (on the caller's
+// stack) is finished with once they have all checked back in.
+
+static pthread_t workers[MAXWORKERS];
+static int numworkers;
+static boolean workersstarted;
+
+static pthread_mutex_t poolmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolwork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pooldone = PTHREAD_COND_INITIALIZER;
+static paralleljob_t *pooljob;
+static unsigned int poolgeneration;
+static int poolbusy;
+
+static void *WorkerThread(void *arg)
+{
+    unsigned int generation = 0;
+    paralleljob_t *job;
+
+    pthread_mutex_lock(&poolmutex);
+
+    for (;;)
+    {
+        while (poolgeneration == generation)
+        {
+            pthread_cond_wait(&poolwork, &poolmutex);
+        }
+
+        generation = poolgeneration;
+        job = pooljob;
+        pthread_mutex_unlock(&poolmutex);
+
+        RunJobs(job);
+
+        pthread_mutex_lock(&poolmutex);
+
+        if (--poolbusy == 0)
+        {
+            pthread_cond_signal(&pooldone);
+        }
+    }
+
+    return NULL;
+}
+
+// Only the thread that forked is left in the child, so it starts
+// again with no workers.
+
+static void ForgetWorkers(void)
+{
+    pthread_mutex_init(&poolmutex, NULL);
+    pthread_cond_init(&poolwork, NULL);
+    pthread_cond_init(&pooldone, NULL);
+    numworkers = 0;
+    workersstarted = false;
+}
+
+static void StartWorkers(void)
+{
+    int i;
+
+    workersstarted = true;
+    pthread_atfork(NULL, NULL, ForgetWorkers);
+
+    // The calling thread takes a share of the work too.
+
+    for (i = 0; i < I_NumWorkerThreads() - 1; ++i)
+    {
+        if (pthread_create(&workers[i], NULL, WorkerThread, NULL) != 0)
+        {
+            break;
+        }
+
+        pthread_detach(workers[i]);
+    }
+
+    numworkers = i;
+}
+
+int I_NumWorkerThreads(void)
+{
+    static int numthreads = 0;
+    long cpus;
+
+    if (numthreads == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numthreads = cpus < 1 ? 1 : cpus > MAXWORKERS ? MAXWORKERS : cpus;
+    }
+
+    return numthreads;
+}
+
+void I_ParallelFor(int count, parallelfunc_t func, void *data)
+{
+    paralleljob_t job;
+
+    job.func = func;
+    job.data = data;
+    job.count = count;
+    job.next = 0;
+
+    if (!workersstarted && count > 1)
+    {
+        StartWorkers();
+    }
+
+    if (numworkers == 0 || count <= 1)
+    {
+        RunJobs(&job);
+        return;
+    }
+
+    pthread_mutex_lock(&poolmutex);
+    pooljob = &job;
+    poolbusy = numworkers;
+    ++poolgeneration;
+    pthread_cond_broadcast(&poolwork);
+    pthread_mutex_unlock(&poolmutex);
+
+    RunJobs(&job);
+
+    pthread_mutex_lock(&poolmutex);
+
+    while (poolbusy > 0)
+    {
+        pthread_cond_wait(&pooldone, &poolmutex);
+    }
+
+    pthread_mutex_unlock(&poolmutex);
+}
+
+static void *BackgroundThread(void *arg)
+{
+    ithread_t *thread = arg;
+
+    thread->func(thread->data);
+
+    return NULL;
+}
+
+ithread_t *I_StartThread(threadfunc_t func, void *data)
+{
+    ithread_t *thread;
+    int i;
+
+    for (i = 0; i < MAXTHREADS; ++i)
+    {
+        thread = &threads[i];
+
+        if (thread->inuse)
+        {
+            continue;
+        }
+
+        thread->func = func;
+        thread->data = data;
+
+        if (pthread_create(&thread->thread, NULL, BackgroundThread, thread) != 0)
+        {
+            return NULL;
+        }
+
+        thread->inuse = true;
+
+        return thread;
+    }
+
+    return NULL;
+}
+
+void I_WaitThread(ithread_t *thread)
+{
+    pthread_join(thread->thread, NULL);
+    thread->inuse = false;
+}
+
+isignal_t *I_NewSignal(void)
+{
+    isignal_t *signal;
+
+    if (numsignals == MAXSIGNALS)
+    {
+        return NULL;
+    }
+
+    signal = &signals[numsignals];
+
+    if (pthread_mutex_init(&signal->mutex, NULL) != 0)
+    {
+        return NULL;
+    }
+
+    if (pthread_cond_init(&signal->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&signal->mutex);
+        return NULL;
+    }
+
+    signal->count = 0;
+    ++numsignals;
+
+    return signal;
+}
+
+void I_PostSignal(isignal_t *signal)
+{
+    pthread_mutex_lock(&signal->mutex);
+    ++signal->count;
+    pthread_cond_signal(&signal->cond);
+    pthread_mutex_unlock(&signal->mutex);
+}
+
+void I_WaitSignal(isignal_t *signal)
+{
+    pthread_mutex_lock(&signal->mutex);
+
+    while (signal->count == 0)
+    {
+        pthread_cond_wait(&signal->cond, &signal->mutex);
+    }
+
+    --signal->count;
+    pthread_mutex_unlock(&signal->mutex);
+}
+
+#else
+
+ithread_t *I_StartThread(threadfunc_t func, void *data)
+{
+    return NULL;
+}
+
+void I_WaitThread(ithread_t *thread)
+{
+}
+
+isignal_t *I_NewSignal(void)
+{
+    return NULL;
+}
+
+void I_PostSignal(isignal_t *signal)
+{
+}
+
+void I_WaitSignal(isignal_t *signal)
+{
+}
+
+int I_NumWorkerThreads(void)
+{
+    return 1;
+}
+
+void I_ParallelFor(int count, parallelfunc_t func, void *data)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        func(data, i);
+    }
+}
+
+#endif
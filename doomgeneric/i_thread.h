@@ -0,0 +1,59 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      System specific thread interface.
+//      Without HAVE_PTHREAD (the UEFI build) everything runs
+//      on the calling thread.
+//
+
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+typedef void (*parallelfunc_t)(void *data, int index);
+typedef void (*threadfunc_t)(void *data);
+
+typedef struct ithread_s ithread_t;
+typedef struct isignal_s isignal_t;
+
+// Number of threads I_ParallelFor will use, including the caller.
+int I_NumWorkerThreads(void);
+
+// Call func(data, i) for every i in [0, count), spread over the
+// worker threads.  Returns when all calls have finished.  func must
+// not touch the zone or any other shared engine state.  The workers
+// are started on the first call and kept, so only one thread may
+// call this at a time, and not from inside func.
+void I_ParallelFor(int count, parallelfunc_t func, void *data);
+
+// Run func(data) on a background thread.  Returns NULL if threads
+// are not available, in which case the caller must do the work
+// itself.
+ithread_t *I_StartThread(threadfunc_t func, void *data);
+
+// Wait for a thread from I_StartThread to finish.
+void I_WaitThread(ithread_t *thread);
+
+// A counting signal for handing work between two threads.  Returns
+// NULL if threads are not available.
+isignal_t *I_NewSignal(void);
+
+// Raise the signal once, waking a thread in I_WaitSignal.
+void I_PostSignal(isignal_t *signal);
+
+// Block until the signal has been raised, then consume one raise.
+void I_WaitSignal(isignal_t *signal);
+
+#endif
@@ -0,0 +1,74 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Timer functions.
+//
+
+#include "i_timer.h"
+#include "doomgeneric.h"
+
+#ifdef HAVE_PTHREAD
+#include <unistd.h>
+#endif
+
+//
+// I_GetTime
+// returns time in 1/35th second tics
+//
+int I_GetTime(void)
+{
+    return (int)((DG_GetTicksUs() * TICRATE) / 1000000);
+}
+
+//
+// Same as I_GetTime, but returns time in milliseconds
+//
+int I_GetTimeMS(void)
+{
+    return (int)(DG_GetTicksUs() / 1000);
+}
+
+//
+// Same as I_GetTime, but returns time in microseconds.
+// Used for profiling, where milliseconds are too coarse.
+//
+uint64_t I_GetTimeUS(void)
+{
+    return DG_GetTicksUs();
+}
+
+//
+// I_Sleep
+// Gives up the CPU where the host has a scheduler; otherwise spins
+// on the clock.
+//
+void I_Sleep(int ms)
+{
+#ifdef HAVE_PTHREAD
+    usleep(ms * 1000);
+#else
+    uint64_t end;
+
+    end = DG_GetTicksUs() + (uint64_t) ms * 1000;
+
+    while (DG_GetTicksUs() < end)
+    {
+    }
+#endif
+}
+
+void I_InitTimer(void)
+{
+}
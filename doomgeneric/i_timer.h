@@ -20,6 +20,8 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include <stdint.h>
+
 #define TICRATE 35
 
 // Called by D_DoomLoop,
@@ -29,6 +31,9 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns current time in us, for profiling
+uint64_t I_GetTimeUS (void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
@@ -31,7 +31,11 @@ static const char
 #include "m_argv.h"
 #include "d_event.h"
 #include "d_main.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "i_timer.h"
 #include "i_video.h"
+#include "m_capture.h"
 #include "z_zone.h"
 
 #include "tables.h"
@@ -83,6 +87,52 @@ static struct color colors[256];
 
 byte *I_VideoBuffer = NULL;
 
+// Cleared when the host has supplied I_VideoBuffer.
+static boolean videobufferzone;
+
+// The frame and palette being presented.  Normally I_VideoBuffer and
+// colors; with -pipeline, a copy taken at I_FinishUpdate so the
+// convert thread can work on it while the next frame is drawn.
+
+static byte *presentframe;
+static struct color *presentcolors = colors;
+
+// -pipeline hands each finished frame to a convert thread, which
+// does the palette expansion and scaling while the main thread runs
+// the next tics and renders the next frame.  DG_DrawFrame stays on
+// the main thread, since hosts may only touch their window there,
+// and shows the converted frame at the next I_FinishUpdate.  The
+// renderer draws on top of the previous frame (status bar, view
+// border), so the frame is copied rather than swapped.
+
+static boolean pipeline;
+static boolean pipelinetiming;
+static boolean pipelinebusy;
+static boolean pipelineready;
+static isignal_t *framesignal;
+static isignal_t *donesignal;
+static byte *pipeframe;
+static struct color pipecolors[256];
+
+// The converted frame for hosts with DG_NativeFrame, which
+// I_ExpandFrame copies out.
+
+static uint32_t *pipeexpanded;
+
+// Convert thread time and main thread stall, in us, since the
+// last -pipelinetiming report.
+
+static uint64_t pipelinepresent;
+static uint64_t pipelinestall;
+static int pipelineframes;
+
+// The file -capture is writing to, and where the last write left
+// it.  Hosts that start a capture themselves supply their own writer.
+
+static FILE *capturefile;
+static uint64_t capturefilepos;
+static boolean captureatexit;
+
 // If true, game is running as a screensaver
 
 boolean screensaver_mode = false;
@@ -140,6 +190,57 @@ void cmap_to_rgb565(uint16_t *out, uint8_t *in, int in_pixels)
     }
 }
 
+static void ExpandFrame(uint32_t *out, int pitch)
+{
+    uint32_t palette[256];
+    uint32_t *row;
+    byte *in;
+    int x, y;
+
+    for (x = 0; x < 256; ++x)
+    {
+        palette[x] = presentcolors[x].b | ((uint32_t)presentcolors[x].g << 8) | ((uint32_t)presentcolors[x].r << 16);
+    }
+
+    in = presentframe;
+
+    for (y = 0; y < SCREENHEIGHT; ++y)
+    {
+        row = (uint32_t *)((byte *)out + y * pitch);
+
+        for (x = 0; x < SCREENWIDTH; ++x)
+        {
+            row[x] = palette[in[x]];
+        }
+
+        in += SCREENWIDTH;
+    }
+}
+
+//
+// I_ExpandFrame
+// Palette-expands the frame being presented at its own 320x200 into out, pitch
+//  bytes apart per row, in the same XRGB8888 layout as map_to_fb.  With
+//  -pipeline the convert thread has already expanded it and the rows are
+//  only copied.
+//
+void I_ExpandFrame(uint32_t *out, int pitch)
+{
+    int y;
+
+    if (!pipeline)
+    {
+        ExpandFrame(out, pitch);
+        return;
+    }
+
+    for (y = 0; y < SCREENHEIGHT; ++y)
+    {
+        d_memcpy((byte *)out + y * pitch, pipeexpanded + y * SCREENWIDTH,
+                 SCREENWIDTH * sizeof(uint32_t));
+    }
+}
+
 void map_to_fb(uint32_t *out, uint8_t *in)
 {
     uint32_t transformed_xres = s_Fb.xres - s_Fb.skip_x * 2;
@@ -168,7 +269,7 @@ void map_to_fb(uint32_t *out, uint8_t *in)
             uint32_t transformed_x = (x - s_Fb.skip_x) * SCREENWIDTH / transformed_xres;
             uint32_t transformed_y = (y - s_Fb.skip_y) * SCREENHEIGHT / transformed_yres;
             uint8_t value = in[transformed_y * SCREENWIDTH + transformed_x];
-            struct color c = colors[value];
+            struct color c = presentcolors[value];
 
             out[y * s_Fb.xres + x] = c.b | ((uint32_t)c.g << 8) | ((uint32_t)c.r << 16);
         }
@@ -210,6 +311,214 @@ void cmap_to_fb(uint8_t *out, uint8_t *in, int in_pixels)
     }
 }
 
+static void PresentFrame(doom_data_t *doom)
+{
+    if (!doom->DG_NativeFrame)
+    {
+        map_to_fb(doom->DG_ScreenBuffer, presentframe);
+    }
+
+    DG_DrawFrame();
+}
+
+//
+// The convert thread only writes DG_ScreenBuffer or pipeexpanded.
+// It never calls into the host, and the main thread does not read
+// either buffer until WaitPipeline has returned.
+//
+static void ConvertThread(void *data)
+{
+    doom_data_t *doom = data;
+    uint64_t start;
+
+    for (;;)
+    {
+        I_WaitSignal(framesignal);
+
+        start = I_GetTimeUS();
+
+        if (doom->DG_NativeFrame)
+        {
+            ExpandFrame(pipeexpanded, SCREENWIDTH * sizeof(uint32_t));
+        }
+        else
+        {
+            map_to_fb(doom->DG_ScreenBuffer, presentframe);
+        }
+
+        pipelinepresent += I_GetTimeUS() - start;
+
+        I_PostSignal(donesignal);
+    }
+}
+
+static void I_InitPipeline(doom_data_t *doom)
+{
+    if (!M_CheckParm(doom, "-pipeline"))
+    {
+        return;
+    }
+
+    framesignal = I_NewSignal();
+    donesignal = I_NewSignal();
+
+    if (framesignal == NULL || donesignal == NULL)
+    {
+        d_printf("I_InitGraphics: -pipeline needs threads, presenting serially\n");
+        return;
+    }
+
+    pipeframe = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+
+    if (doom->DG_NativeFrame)
+    {
+        pipeexpanded = Z_Malloc(SCREENWIDTH * SCREENHEIGHT * sizeof(uint32_t),
+                                PU_STATIC, NULL);
+    }
+
+    if (I_StartThread(ConvertThread, doom) == NULL)
+    {
+        d_printf("I_InitGraphics: no convert thread, presenting serially\n");
+        Z_Free(pipeframe);
+
+        if (pipeexpanded != NULL)
+        {
+            Z_Free(pipeexpanded);
+            pipeexpanded = NULL;
+        }
+
+        return;
+    }
+
+    presentframe = pipeframe;
+    presentcolors = pipecolors;
+    pipeline = true;
+    pipelinetiming = M_CheckParm(doom, "-pipelinetiming") > 0;
+}
+
+//
+// Wait for the convert thread to finish the previous frame.  The
+// time spent here is the part of the conversion that did not overlap
+// the next frame.
+//
+static void WaitPipeline(void)
+{
+    uint64_t start;
+    int present, stall, overlap;
+
+    if (!pipelinebusy)
+    {
+        return;
+    }
+
+    start = I_GetTimeUS();
+    I_WaitSignal(donesignal);
+    pipelinestall += I_GetTimeUS() - start;
+    pipelinebusy = false;
+
+    if (pipelinetiming && ++pipelineframes == 5 * TICRATE)
+    {
+        present = pipelinepresent / pipelineframes;
+        stall = pipelinestall / pipelineframes;
+        overlap = present > stall ? present - stall : 0;
+
+        d_printf("pipeline: convert %d us/frame, %d us overlapped (%d%%), main thread waited %d us/frame\n",
+                 present, overlap, present ? overlap * 100 / present : 0, stall);
+
+        pipelinepresent = 0;
+        pipelinestall = 0;
+        pipelineframes = 0;
+    }
+}
+
+static boolean WriteCaptureFile(void *data, uint64_t offset,
+                                const byte *buf, int length)
+{
+    FILE *file = data;
+
+    if (offset != capturefilepos && d_fseek(file, offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+
+    capturefilepos = offset + length;
+
+    return d_fwrite(buf, 1, length, file) == length;
+}
+
+static void StopCaptureAtExit(doom_data_t *doom)
+{
+    I_StopCapture();
+}
+
+//
+// I_StartCapture
+// Records every frame from here on through write; see m_capture.h.
+//
+boolean I_StartCapture(capturewrite_t write, void *data)
+{
+    I_StopCapture();
+
+    if (!captureatexit)
+    {
+        I_AtExit(StopCaptureAtExit, true);
+        captureatexit = true;
+    }
+
+    return M_StartCapture(write, data, SCREENWIDTH, SCREENHEIGHT);
+}
+
+void I_StopCapture(void)
+{
+    M_StopCapture();
+
+    if (capturefile != NULL)
+    {
+        d_fclose(capturefile);
+        capturefile = NULL;
+    }
+}
+
+static void I_InitCapture(doom_data_t *doom)
+{
+    FILE *file;
+    int i;
+
+    //!
+    // @arg <file>
+    //
+    // Record every frame drawn, with its palette, to <file>.
+    // tools/capconv turns the recording into PNGs or raw RGB.
+    //
+
+    i = M_CheckParmWithArgs(doom, "-capture", 1);
+
+    if (i <= 0)
+    {
+        return;
+    }
+
+    file = d_fopen(doom->myargv[i + 1], "wb");
+
+    if (file == NULL)
+    {
+        d_printf("I_InitGraphics: could not open %s for -capture\n",
+                 doom->myargv[i + 1]);
+        return;
+    }
+
+    capturefilepos = 0;
+
+    if (I_StartCapture(WriteCaptureFile, file))
+    {
+        capturefile = file;
+    }
+    else
+    {
+        d_fclose(file);
+    }
+}
+
 void I_InitGraphics(struct doom_data_t_* doom)
 {
     int i;
@@ -256,13 +565,48 @@ void I_InitGraphics(struct doom_data_t_* doom)
 
     /* Allocate screen to draw to */
     I_VideoBuffer = (byte *)Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL); // For DOOM to draw on
+    videobufferzone = true;
+    presentframe = I_VideoBuffer;
 
     screenvisible = true;
+
+    I_InitPipeline(doom);
+    I_InitCapture(doom);
 }
 
 void I_ShutdownGraphics(void)
 {
-    Z_Free(I_VideoBuffer);
+    WaitPipeline();
+
+    if (videobufferzone)
+    {
+        Z_Free(I_VideoBuffer);
+    }
+}
+
+//
+// I_SetVideoBuffer
+// Moves the screen to buffer, which the host owns.  Whatever else
+//  points at the old screen is the caller's to fix up.
+//
+void I_SetVideoBuffer(byte *buffer)
+{
+    WaitPipeline();
+
+    d_memcpy(buffer, I_VideoBuffer, SCREENWIDTH * SCREENHEIGHT);
+
+    if (presentframe == I_VideoBuffer)
+    {
+        presentframe = buffer;
+    }
+
+    if (videobufferzone)
+    {
+        Z_Free(I_VideoBuffer);
+        videobufferzone = false;
+    }
+
+    I_VideoBuffer = buffer;
 }
 
 void I_StartFrame(void)
@@ -300,8 +644,47 @@ void I_FinishUpdate(doom_data_t* doom)
     line_in = (unsigned char *)I_VideoBuffer;
     line_out = (unsigned char *)doom->DG_ScreenBuffer;
 
-    map_to_fb(doom->DG_ScreenBuffer, I_VideoBuffer);
-    DG_DrawFrame();
+    if (M_Capturing())
+    {
+        byte palette[768];
+
+        I_GetPalette(palette);
+        M_CaptureFrame(doom->gametic, I_VideoBuffer, palette);
+    }
+
+    if (pipeline)
+    {
+        WaitPipeline();
+
+        // Show the frame converted while this one was drawn; the
+        // convert thread is idle until the next signal.
+
+        if (pipelineready)
+        {
+            DG_DrawFrame();
+        }
+
+        d_memcpy(pipeframe, I_VideoBuffer, SCREENWIDTH * SCREENHEIGHT);
+        d_memcpy(pipecolors, colors, sizeof(colors));
+
+        pipelinebusy = true;
+        pipelineready = true;
+        I_PostSignal(framesignal);
+        return;
+    }
+
+    PresentFrame(doom);
+}
+
+//
+// I_ScaleFrame
+// The CPU upscale into DG_ScreenBuffer that I_FinishUpdate does for
+//  hosts without DG_NativeFrame.  This runs on the caller's thread, even
+//  with -pipeline.
+//
+void I_ScaleFrame(doom_data_t *doom)
+{
+    map_to_fb(doom->DG_ScreenBuffer, presentframe);
 }
 
 //
@@ -348,6 +731,22 @@ void I_SetPalette(byte *palette)
     }
 }
 
+//
+// I_GetPalette
+// The palette as last set, gamma corrected, as RGB triples.
+//
+void I_GetPalette(byte *rgb)
+{
+    int i;
+
+    for (i = 0; i < 256; ++i)
+    {
+        *rgb++ = colors[i].r;
+        *rgb++ = colors[i].g;
+        *rgb++ = colors[i].b;
+    }
+}
+
 // Given an RGB value, find the closest matching palette index.
 
 int I_GetPaletteIndex(int r, int g, int b)
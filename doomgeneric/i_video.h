@@ -21,6 +21,7 @@
 #define __I_VIDEO__
 
 #include "doomtype.h"
+#include "m_capture.h"
 
 // Screen width and height.
 
@@ -104,13 +105,29 @@ void I_ShutdownGraphics(void);
 
 // Takes full 8 bit values.
 void I_SetPalette (byte* palette);
+void I_GetPalette (byte* rgb);
 int I_GetPaletteIndex(int r, int g, int b);
 
 void I_UpdateNoBlit (void);
 void I_FinishUpdate (struct doom_data_t_* doom);
 
+// For hosts that set DG_NativeFrame and scale on their own: expand
+// the 320x200 frame to XRGB8888 rows pitch bytes apart, or do the
+// usual CPU upscale into DG_ScreenBuffer.
+void I_ExpandFrame (uint32_t* out, int pitch);
+void I_ScaleFrame (struct doom_data_t_* doom);
+
 void I_ReadScreen (byte* scr);
 
+// Draw the screen in buffer, SCREENWIDTH * SCREENHEIGHT bytes the
+// caller owns, from now on.
+void I_SetVideoBuffer (byte* buffer);
+
+// Record every finished frame through write, in the format of
+// m_capture.h, until I_StopCapture or exit.
+boolean I_StartCapture (capturewrite_t write, void *data);
+void I_StopCapture (void);
+
 void I_BeginRead (void);
 
 void I_CheckIsScreensaver(void);
@@ -0,0 +1,621 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Recording every frame to a capture file.
+//
+//   The main thread copies each frame and palette into a ring of
+//   slots and moves on; a writer thread codes the frames and appends
+//   them to the file.  The ring is single producer, single consumer:
+//   the main thread only advances the head and the writer only the
+//   tail, so a slot changes hands without a lock.  The signals are
+//   only there so neither side has to spin.
+//
+//   A payload is a series of tokens, each a variable length number
+//   (seven bits a byte, low first) holding a count and an op in its
+//   low two bits:
+//
+//     CAPTURE_SKIP     count pixels are as in the previous frame
+//     CAPTURE_LITERAL  count pixels follow
+//     CAPTURE_FILL     count pixels are all the one byte that follows
+//
+//   Most of a game frame is unchanged or flat, so a frame is
+//   typically a few kilobytes.
+//
+
+#include "dlibc.h"
+
+#include "i_thread.h"
+#include "i_timer.h"
+#include "m_capture.h"
+#include "z_zone.h"
+
+#define CAPTURE_SKIP    0
+#define CAPTURE_LITERAL 1
+#define CAPTURE_FILL    2
+
+// Shortest unchanged or flat stretch worth its own token.
+#define CAPTURE_MINRUN  4
+
+// Frames the main thread can get ahead of the writer.
+#define CAPTURE_SLOTS   8
+
+// The index is kept in blocks of this many entries, enough for
+// about eight hours at 35 frames a second.
+#define INDEXBLOCK      1024
+#define INDEXBLOCKS     1024
+
+typedef struct
+{
+    int tic;
+    byte palette[768];
+    byte *pixels;
+} captureslot_t;
+
+static capturewrite_t capturewrite;
+static void *capturedata;
+static int capturewidth, captureheight;
+static unsigned int captureframes;
+
+static captureslot_t slots[CAPTURE_SLOTS];
+static unsigned int queuehead;
+static unsigned int queuetail;
+static boolean queuestop;
+
+static isignal_t *queuedsignal;
+static isignal_t *freesignal;
+static ithread_t *writerthread;
+
+// The writer's state: the last frame and palette written, the
+// payload buffer and the offset of every record so far.  The main
+// thread allocates the index blocks, ahead of the frames that fill
+// them, so the writer never touches the zone.
+
+static byte *lastframe;
+static byte lastpalette[768];
+static byte *payload;
+static uint64_t *frameindex[INDEXBLOCKS];
+static uint64_t fileoffset;
+static boolean writefailed;
+
+// What the capture has cost: time the main thread spent queuing
+// (including waits for a free slot), time the writer spent coding
+// and writing, and bytes written.
+
+static uint64_t queuetime;
+static uint64_t writetime;
+static int queuewaits;
+
+//
+// Frame coding
+//
+
+static byte *PutNumber(byte *dest, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        *dest++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+
+    *dest++ = value;
+
+    return dest;
+}
+
+static byte *PutToken(byte *dest, int op, int count)
+{
+    return PutNumber(dest, ((unsigned int) count << 2) | op);
+}
+
+static byte *PutLiteral(byte *dest, const byte *src, int count)
+{
+    if (count > 0)
+    {
+        dest = PutToken(dest, CAPTURE_LITERAL, count);
+        d_memcpy(dest, src, count);
+        dest += count;
+    }
+
+    return dest;
+}
+
+// Number of pixels from the start that match prev, eight at a time
+// once frame is aligned.  The frames all come from the zone, so prev
+// is aligned with it.
+
+static int SameLength(const byte *frame, const byte *prev, int length)
+{
+    int i;
+
+    for (i = 0; i < length && ((uintptr_t) (frame + i) & 7) != 0; ++i)
+    {
+        if (frame[i] != prev[i])
+        {
+            return i;
+        }
+    }
+
+    while (i + 8 <= length
+        && *(const uint64_t *) (frame + i) == *(const uint64_t *) (prev + i))
+    {
+        i += 8;
+    }
+
+    while (i < length && frame[i] == prev[i])
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+// Number of pixels from the start that are the same as the first.
+
+static int RunLength(const byte *frame, int length)
+{
+    int i;
+
+    for (i = 1; i < length && frame[i] == frame[0]; ++i)
+    {
+    }
+
+    return i;
+}
+
+int M_EncodeCaptureFrame(const byte *prev, const byte *frame, int length,
+                         byte *dest)
+{
+    byte *out;
+    int literal;
+    int i, count, run;
+
+    out = dest;
+    literal = 0;
+    i = 0;
+
+    while (i < length)
+    {
+        if (prev != NULL)
+        {
+            count = SameLength(frame + i, prev + i, length - i);
+            run = 0;
+
+            // A flat stretch that runs on past the unchanged pixels
+            // is cheaper as a fill.
+
+            if (count >= CAPTURE_MINRUN)
+            {
+                run = RunLength(frame + i, length - i);
+            }
+
+            if (run <= count
+             && (count >= CAPTURE_MINRUN || (count > 0 && i + count == length)))
+            {
+                out = PutLiteral(out, frame + literal, i - literal);
+                out = PutToken(out, CAPTURE_SKIP, count);
+                i += count;
+                literal = i;
+                continue;
+            }
+        }
+
+        count = RunLength(frame + i, length - i);
+
+        if (count >= CAPTURE_MINRUN)
+        {
+            out = PutLiteral(out, frame + literal, i - literal);
+            out = PutToken(out, CAPTURE_FILL, count);
+            *out++ = frame[i];
+            i += count;
+            literal = i;
+            continue;
+        }
+
+        ++i;
+    }
+
+    out = PutLiteral(out, frame + literal, i - literal);
+
+    return out - dest;
+}
+
+boolean M_DecodeCaptureFrame(const byte *src, int srclength, byte *frame,
+                             int length)
+{
+    const byte *end;
+    unsigned int token;
+    int shift, count, pos;
+
+    end = src + srclength;
+    pos = 0;
+
+    while (src < end)
+    {
+        token = 0;
+        shift = 0;
+
+        do
+        {
+            if (src == end || shift > 28)
+            {
+                return false;
+            }
+
+            token |= (unsigned int) (*src & 0x7f) << shift;
+            shift += 7;
+        } while (*src++ & 0x80);
+
+        count = token >> 2;
+
+        if (count > length - pos)
+        {
+            return false;
+        }
+
+        switch (token & 3)
+        {
+            case CAPTURE_SKIP:
+                break;
+
+            case CAPTURE_LITERAL:
+                if (count > end - src)
+                {
+                    return false;
+                }
+                d_memcpy(frame + pos, src, count);
+                src += count;
+                break;
+
+            case CAPTURE_FILL:
+                if (src == end)
+                {
+                    return false;
+                }
+                d_memset(frame + pos, *src++, count);
+                break;
+
+            default:
+                return false;
+        }
+
+        pos += count;
+    }
+
+    return pos == length;
+}
+
+//
+// The file
+//
+
+static void PutLong(byte *dest, unsigned int value)
+{
+    dest[0] = value;
+    dest[1] = value >> 8;
+    dest[2] = value >> 16;
+    dest[3] = value >> 24;
+}
+
+static void PutLongLong(byte *dest, uint64_t value)
+{
+    PutLong(dest, (unsigned int) value);
+    PutLong(dest + 4, (unsigned int) (value >> 32));
+}
+
+static void WriteBytes(const byte *data, int length)
+{
+    if (writefailed)
+    {
+        return;
+    }
+
+    if (!capturewrite(capturedata, fileoffset, data, length))
+    {
+        writefailed = true;
+        return;
+    }
+
+    fileoffset += length;
+}
+
+static void WriteHeader(uint64_t indexoffset)
+{
+    byte header[CAPTURE_HEADERSIZE];
+
+    d_memset(header, 0, sizeof(header));
+    d_memcpy(header, "DCAP", 4);
+    PutLong(header + 4, CAPTURE_VERSION);
+    header[8] = capturewidth;
+    header[9] = capturewidth >> 8;
+    header[10] = captureheight;
+    header[11] = captureheight >> 8;
+    PutLong(header + 12, captureframes);
+    PutLongLong(header + 16, indexoffset);
+    PutLong(header + 24, CAPTURE_KEYINTERVAL);
+
+    WriteBytes(header, sizeof(header));
+}
+
+// Codes one frame against the last and appends it.  Runs on the
+// writer thread, so it keeps off the zone.
+
+static void WriteFrame(captureslot_t *slot)
+{
+    byte record[CAPTURE_RECORDSIZE];
+    uint64_t start;
+    boolean key, newpalette;
+    int length, i;
+
+    if (writefailed)
+    {
+        return;
+    }
+
+    start = I_GetTimeUS();
+    key = captureframes % CAPTURE_KEYINTERVAL == 0;
+    newpalette = key;
+
+    for (i = 0; i < 768 && !newpalette; ++i)
+    {
+        newpalette = slot->palette[i] != lastpalette[i];
+    }
+
+    length = M_EncodeCaptureFrame(key ? NULL : lastframe, slot->pixels,
+                                  capturewidth * captureheight, payload);
+
+    PutLong(record, slot->tic);
+    PutLong(record + 4, (key ? CAPTURE_KEY : 0)
+                      | (newpalette ? CAPTURE_PALETTE : 0));
+    PutLong(record + 8, length);
+
+    frameindex[captureframes / INDEXBLOCK][captureframes % INDEXBLOCK] = fileoffset;
+    ++captureframes;
+
+    WriteBytes(record, sizeof(record));
+
+    if (newpalette)
+    {
+        WriteBytes(slot->palette, 768);
+        d_memcpy(lastpalette, slot->palette, 768);
+    }
+
+    WriteBytes(payload, length);
+
+    d_memcpy(lastframe, slot->pixels, capturewidth * captureheight);
+
+    writetime += I_GetTimeUS() - start;
+}
+
+static void WriterThread(void *data)
+{
+    unsigned int tail;
+
+    for (;;)
+    {
+        I_WaitSignal(queuedsignal);
+
+        tail = queuetail;
+
+        if (tail == __atomic_load_n(&queuehead, __ATOMIC_ACQUIRE))
+        {
+            if (__atomic_load_n(&queuestop, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        WriteFrame(&slots[tail % CAPTURE_SLOTS]);
+
+        __atomic_store_n(&queuetail, tail + 1, __ATOMIC_RELEASE);
+        I_PostSignal(freesignal);
+    }
+}
+
+boolean M_StartCapture(capturewrite_t write, void *data, int width,
+                       int height)
+{
+    int i;
+
+    M_StopCapture();
+
+    capturewrite = write;
+    capturedata = data;
+    capturewidth = width;
+    captureheight = height;
+    captureframes = 0;
+    fileoffset = 0;
+    writefailed = false;
+    queuehead = queuetail = 0;
+    queuestop = false;
+    queuetime = writetime = 0;
+    queuewaits = 0;
+
+    for (i = 0; i < CAPTURE_SLOTS; ++i)
+    {
+        slots[i].pixels = Z_Malloc(width * height, PU_STATIC, NULL);
+    }
+
+    lastframe = Z_Malloc(width * height, PU_STATIC, NULL);
+    payload = Z_Malloc(M_CAPTURE_BOUND(width * height), PU_STATIC, NULL);
+    d_memset(lastpalette, 0, sizeof(lastpalette));
+
+    // Written again with the frame count and index at the end.
+
+    WriteHeader(0);
+
+    if (writefailed)
+    {
+        M_StopCapture();
+        return false;
+    }
+
+    // The signals outlive the capture, there being only a few.
+
+    if (queuedsignal == NULL)
+    {
+        queuedsignal = I_NewSignal();
+        freesignal = I_NewSignal();
+    }
+
+    writerthread = NULL;
+
+    if (queuedsignal != NULL && freesignal != NULL)
+    {
+        writerthread = I_StartThread(WriterThread, NULL);
+    }
+
+    if (writerthread == NULL)
+    {
+        d_printf("M_StartCapture: no writer thread, writing inline\n");
+    }
+
+    return true;
+}
+
+boolean M_Capturing(void)
+{
+    return capturewrite != NULL;
+}
+
+void M_CaptureFrame(int tic, const byte *frame, const byte *palette)
+{
+    captureslot_t *slot;
+    unsigned int head;
+    uint64_t start;
+
+    if (capturewrite == NULL)
+    {
+        return;
+    }
+
+    start = I_GetTimeUS();
+    head = queuehead;
+
+    if (head % INDEXBLOCK == 0)
+    {
+        if (head / INDEXBLOCK == INDEXBLOCKS)
+        {
+            d_printf("M_CaptureFrame: capture is full, stopping\n");
+            M_StopCapture();
+            return;
+        }
+
+        frameindex[head / INDEXBLOCK] =
+            Z_Malloc(INDEXBLOCK * sizeof(uint64_t), PU_STATIC, NULL);
+    }
+
+    if (writerthread != NULL)
+    {
+        // A full ring means the writer is behind; wait for a slot
+        // rather than drop the frame.
+
+        if (head - __atomic_load_n(&queuetail, __ATOMIC_ACQUIRE) == CAPTURE_SLOTS)
+        {
+            ++queuewaits;
+
+            do
+            {
+                I_WaitSignal(freesignal);
+            } while (head - __atomic_load_n(&queuetail, __ATOMIC_ACQUIRE) == CAPTURE_SLOTS);
+        }
+    }
+
+    slot = &slots[head % CAPTURE_SLOTS];
+    slot->tic = tic;
+    d_memcpy(slot->palette, palette, 768);
+    d_memcpy(slot->pixels, frame, capturewidth * captureheight);
+
+    if (writerthread != NULL)
+    {
+        __atomic_store_n(&queuehead, head + 1, __ATOMIC_RELEASE);
+        I_PostSignal(queuedsignal);
+        queuetime += I_GetTimeUS() - start;
+    }
+    else
+    {
+        // Without a writer the coding is part of the main thread's
+        // cost, so it counts in both.
+
+        WriteFrame(slot);
+        queuetime += I_GetTimeUS() - start;
+    }
+}
+
+void M_StopCapture(void)
+{
+    byte entry[8];
+    uint64_t indexoffset, length, raw;
+    unsigned int i;
+
+    if (capturewrite == NULL)
+    {
+        return;
+    }
+
+    if (writerthread != NULL)
+    {
+        __atomic_store_n(&queuestop, true, __ATOMIC_RELEASE);
+        I_PostSignal(queuedsignal);
+        I_WaitThread(writerthread);
+        writerthread = NULL;
+    }
+
+    indexoffset = fileoffset;
+
+    for (i = 0; i < captureframes; ++i)
+    {
+        PutLongLong(entry, frameindex[i / INDEXBLOCK][i % INDEXBLOCK]);
+        WriteBytes(entry, sizeof(entry));
+    }
+
+    length = fileoffset;
+    fileoffset = 0;
+
+    WriteHeader(indexoffset);
+    capturewrite = NULL;
+
+    raw = (uint64_t) captureframes * (capturewidth * captureheight + 768);
+
+    if (writefailed)
+    {
+        d_printf("M_StopCapture: a write failed, the capture is incomplete\n");
+    }
+    else if (captureframes > 0)
+    {
+        d_printf("M_StopCapture: %u frames, %u KB (%u%% of raw); main thread %u us/frame, %d waits for the writer; writer %u us/frame\n",
+                 captureframes,
+                 (unsigned int) (length / 1024),
+                 (unsigned int) (length * 100 / raw),
+                 (unsigned int) (queuetime / captureframes),
+                 queuewaits,
+                 (unsigned int) (writetime / captureframes));
+    }
+
+    for (i = 0; i < CAPTURE_SLOTS; ++i)
+    {
+        Z_Free(slots[i].pixels);
+    }
+
+    for (i = 0; i < INDEXBLOCKS && frameindex[i] != NULL; ++i)
+    {
+        Z_Free(frameindex[i]);
+        frameindex[i] = NULL;
+    }
+
+    Z_Free(lastframe);
+    Z_Free(payload);
+}
@@ -0,0 +1,89 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Recording every frame to a capture file.
+//
+//   All numbers in the file are little endian.  It starts with a
+//   header:
+//
+//     "DCAP", version, width and height (16 bit each), frame count,
+//     index offset (64 bit), key frame interval, reserved
+//
+//   then one record per frame:
+//
+//     tic, flags, payload length, the 768 byte palette if
+//     CAPTURE_PALETTE is set, the payload
+//
+//   and last the index, the 64 bit offset of every record.  The
+//   frame count and index offset are filled in when the capture is
+//   stopped; a file left at zero can still be read front to back.
+//   Every key frame interval'th frame is a key frame, coded against
+//   a black screen rather than the previous frame, so a reader can
+//   seek to any frame through the index.  tools/capconv turns a
+//   capture into PNGs or raw RGB.
+//
+
+#ifndef __M_CAPTURE__
+#define __M_CAPTURE__
+
+#include "doomtype.h"
+
+#define CAPTURE_VERSION        1
+#define CAPTURE_HEADERSIZE     32
+#define CAPTURE_RECORDSIZE     12
+#define CAPTURE_KEYINTERVAL    64
+
+// Record flags.
+#define CAPTURE_KEY            1
+#define CAPTURE_PALETTE        2
+
+// Largest payload for a frame of length pixels.
+#define M_CAPTURE_BOUND(length) ((length) * 2 + 16)
+
+// Codes length pixels of frame as changes from prev, or from a black
+// screen if prev is NULL, into dest.  Returns the payload length.
+int M_EncodeCaptureFrame(const byte *prev, const byte *frame, int length,
+                         byte *dest);
+
+// Applies a payload from M_EncodeCaptureFrame to frame, which holds
+// the previous frame (or zeroes, for a key frame).  Returns false if
+// the payload is malformed or does not cover exactly length pixels.
+boolean M_DecodeCaptureFrame(const byte *src, int srclength, byte *frame,
+                             int length);
+
+// Where a capture goes: writes length bytes of buf at offset, and
+// returns false if it could not.  Called on the writer thread.
+// Writes are in order except for the header, which is written again
+// at offset 0 when the capture stops.
+typedef boolean (*capturewrite_t)(void *data, uint64_t offset,
+                                  const byte *buf, int length);
+
+// Starts capturing width x height frames through write.  Frames are
+// coded and written on a background thread where there is one.
+boolean M_StartCapture(capturewrite_t write, void *data, int width,
+                       int height);
+
+// True between M_StartCapture and M_StopCapture.
+boolean M_Capturing(void);
+
+// Queues a frame and its 768 byte RGB palette for writing.  Only
+// waits if the writer has fallen a whole queue behind.
+void M_CaptureFrame(int tic, const byte *frame, const byte *palette);
+
+// Writes out the queued frames, the index and the final header, and
+// prints how much the capture cost.
+void M_StopCapture(void);
+
+#endif
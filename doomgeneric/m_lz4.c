@@ -0,0 +1,277 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Compression in the LZ4 block format.
+//
+//   Each sequence is a token byte, whose high nibble is the number of
+//   literals and low nibble the match length less 4 (15 meaning more
+//   length bytes follow, each added on until one is not 255), the
+//   literals, then a two byte little endian offset back into the
+//   output.  The last sequence has literals only.  Decoding is a
+//   couple of copies per sequence, which is why it is used for the
+//   embedded IWAD.
+//
+
+#include "dlibc.h"
+
+#include "m_lz4.h"
+
+#define MINMATCH 4
+
+// The last match must start this far from the end, and the last
+// this many bytes are always literals.
+#define MFLIMIT 12
+#define LASTLITERALS 5
+
+#define MAXOFFSET 65535
+
+#define HASHLOG 13
+
+static unsigned int Read32(const byte *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static int Hash(unsigned int sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASHLOG);
+}
+
+// Writes the extra bytes of a length that did not fit in its nibble.
+
+static byte *WriteLength(byte *op, int length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        *op++ = 255;
+    }
+
+    *op++ = length;
+
+    return op;
+}
+
+static byte *WriteSequence(byte *op, const byte *literals, int numliterals,
+                           int offset, int matchlength)
+{
+    byte *token = op++;
+
+    *token = (numliterals >= 15 ? 15 : numliterals) << 4;
+
+    if (numliterals >= 15)
+    {
+        op = WriteLength(op, numliterals - 15);
+    }
+
+    d_memcpy(op, literals, numliterals);
+    op += numliterals;
+
+    if (matchlength == 0)
+    {
+        return op;
+    }
+
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+
+    matchlength -= MINMATCH;
+    *token |= matchlength >= 15 ? 15 : matchlength;
+
+    if (matchlength >= 15)
+    {
+        op = WriteLength(op, matchlength - 15);
+    }
+
+    return op;
+}
+
+int M_LZ4Compress(const byte *src, int length, byte *dest, int destlength)
+{
+    int table[1 << HASHLOG];
+    byte *op;
+    int ip, anchor, ref, matchlength;
+    int limit, matchlimit;
+    unsigned int sequence;
+    int h;
+
+    // Every sequence fits within the bound, so check once up front
+    // rather than per byte written.
+
+    if (destlength < M_LZ4_BOUND(length))
+    {
+        return 0;
+    }
+
+    for (h = 0; h < (1 << HASHLOG); ++h)
+    {
+        table[h] = -1;
+    }
+
+    op = dest;
+    ip = anchor = 0;
+    limit = length - MFLIMIT;
+    matchlimit = length - LASTLITERALS;
+
+    while (ip < limit)
+    {
+        sequence = Read32(src + ip);
+        h = Hash(sequence);
+        ref = table[h];
+        table[h] = ip;
+
+        if (ref < 0 || ip - ref > MAXOFFSET || Read32(src + ref) != sequence)
+        {
+            ++ip;
+            continue;
+        }
+
+        // Take in any matching bytes before the hashed ones.
+
+        while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+        {
+            --ip;
+            --ref;
+        }
+
+        matchlength = MINMATCH;
+
+        while (ip + matchlength < matchlimit
+            && src[ip + matchlength] == src[ref + matchlength])
+        {
+            ++matchlength;
+        }
+
+        op = WriteSequence(op, src + anchor, ip - anchor, ip - ref, matchlength);
+
+        ip += matchlength;
+        anchor = ip;
+
+        // Hash a position inside the match too, so that runs are
+        // picked up again straight away.
+
+        if (ip - 2 < limit)
+        {
+            table[Hash(Read32(src + ip - 2))] = ip - 2;
+        }
+    }
+
+    op = WriteSequence(op, src + anchor, length - anchor, 0, 0);
+
+    return op - dest;
+}
+
+// Reads the extra bytes of a length, or returns -1 past the end.
+
+static int ReadLength(const byte *src, int length, int *sp, int value)
+{
+    byte b;
+
+    do
+    {
+        if (*sp >= length)
+        {
+            return -1;
+        }
+
+        b = src[(*sp)++];
+        value += b;
+    } while (b == 255);
+
+    return value;
+}
+
+int M_LZ4Decompress(const byte *src, int length, byte *dest, int destlength)
+{
+    int sp, dp;
+    int token, numliterals, offset, matchlength;
+    int i;
+    byte *match;
+    byte *op;
+
+    sp = dp = 0;
+
+    while (sp < length)
+    {
+        token = src[sp++];
+        numliterals = token >> 4;
+
+        if (numliterals == 15)
+        {
+            numliterals = ReadLength(src, length, &sp, numliterals);
+        }
+
+        if (numliterals < 0 || numliterals > length - sp
+         || numliterals > destlength - dp)
+        {
+            return -1;
+        }
+
+        d_memcpy(dest + dp, src + sp, numliterals);
+        sp += numliterals;
+        dp += numliterals;
+
+        // The last sequence stops after its literals.
+
+        if (sp == length)
+        {
+            break;
+        }
+
+        if (length - sp < 2)
+        {
+            return -1;
+        }
+
+        offset = src[sp] | (src[sp + 1] << 8);
+        sp += 2;
+
+        matchlength = token & 15;
+
+        if (matchlength == 15)
+        {
+            matchlength = ReadLength(src, length, &sp, matchlength);
+        }
+
+        matchlength += MINMATCH;
+
+        if (offset == 0 || offset > dp || matchlength < MINMATCH
+         || matchlength > destlength - dp)
+        {
+            return -1;
+        }
+
+        // An offset shorter than the match repeats what it has just
+        // written, so that has to go a byte at a time.
+
+        op = dest + dp;
+        match = op - offset;
+
+        if (offset >= matchlength)
+        {
+            d_memcpy(op, match, matchlength);
+        }
+        else
+        {
+            for (i = 0; i < matchlength; ++i)
+            {
+                op[i] = match[i];
+            }
+        }
+
+        dp += matchlength;
+    }
+
+    return dp;
+}
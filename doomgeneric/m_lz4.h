@@ -0,0 +1,37 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Compression in the LZ4 block format.
+//
+
+
+#ifndef __M_LZ4__
+#define __M_LZ4__
+
+#include "doomtype.h"
+
+// Largest compressed size of length bytes of input.
+#define M_LZ4_BOUND(length) ((length) + (length) / 255 + 16)
+
+// Compresses length bytes of src into dest.  Returns the compressed
+// length, or 0 if it does not fit in destlength bytes.
+int M_LZ4Compress(const byte *src, int length, byte *dest, int destlength);
+
+// Decompresses length bytes of src into dest.  Returns the number of
+// bytes written, or -1 if the data is malformed or would not fit in
+// destlength bytes; nothing is ever read or written out of bounds.
+int M_LZ4Decompress(const byte *src, int length, byte *dest, int destlength);
+
+#endif
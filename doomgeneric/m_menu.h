@@ -51,6 +51,9 @@ void M_Init (doom_data_t* doom);
 // does nothing if menu is already up.
 void M_StartControlPanel (void);
 
+// Draws a string in the HUD font straight to the screen.
+void M_WriteText(struct doom_data_t_* doom, int x, int y, char *string);
+
 
 
 extern int detailLevel;
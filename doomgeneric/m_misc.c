@@ -404,3 +404,29 @@ char *M_StringJoin(const char *s, ...)
 
     return result;
 }
+
+unsigned int M_HashBytes(unsigned int hash, const void *data, size_t len)
+{
+    const byte *p = data;
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+unsigned int M_HashWords(unsigned int hash, const int *words, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+    {
+        hash = (hash ^ (unsigned int) words[i]) * 0x9e3779b1u;
+        hash ^= hash >> 15;
+    }
+
+    return hash;
+}
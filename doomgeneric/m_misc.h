@@ -45,5 +45,13 @@ boolean M_StringEndsWith(const char *s, const char *suffix);
 int M_vsnprintf(char *buf, size_t buf_len, const char *s, va_list args);
 char *M_OEMToUTF8(const char *ansi);
 
+// 32-bit FNV-1a, continuing from hash (start with M_HASH_INIT).
+#define M_HASH_INIT 2166136261u
+unsigned int M_HashBytes(unsigned int hash, const void *data, size_t len);
+
+// The same idea a 32-bit word at a time, for hashing many ints
+// quickly.  Not the same result as M_HashBytes on the same data.
+unsigned int M_HashWords(unsigned int hash, const int *words, size_t count);
+
 #endif
 
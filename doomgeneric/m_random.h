@@ -35,5 +35,9 @@ int P_Random (void);
 // Fix randoms for demos.
 void M_ClearRandom (void);
 
+// Table positions, for state hashing.
+extern int rndindex;
+extern int prndindex;
+
 
 #endif
@@ -0,0 +1,700 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Network client code.  The packet formats are described in
+//     net_server.c.
+//
+
+#include "dlibc.h"
+#include "doomfeatures.h"
+
+#ifdef FEATURE_MULTIPLAYER
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "net_client.h"
+#include "net_defs.h"
+#include "net_gui.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+// Bytes a ticcmd takes on the wire with every field present, to
+// compare the diffs against.
+
+#define FULL_TICCMD_BYTES 7
+
+// Milliseconds between -netstats reports.
+
+#define STATS_PERIOD 5000
+
+typedef enum
+{
+    // Sending SYN until the server answers.
+
+    CLIENT_CONNECTING,
+
+    // Connected; waiting for the other players to join.
+
+    CLIENT_WAITING_LAUNCH,
+
+    // Everyone is here; waiting for the game settings.
+
+    CLIENT_WAITING_START,
+
+    // In a game.
+
+    CLIENT_IN_GAME,
+
+    // Rejected, timed out or told to leave.
+
+    CLIENT_DISCONNECTED,
+} net_client_state_t;
+
+typedef struct
+{
+    int start_time;
+    int rtt_total;
+    int rtt_count;
+    int rtt_max;
+    int bytes_out;
+    int bytes_in;
+    int packets_out;
+    int packets_in;
+    int tics_sent;
+    int tic_bytes;
+} net_stats_t;
+
+boolean net_client_connected = false;
+int net_ticbatch = 1;
+
+extern void D_ReceiveTic(doom_data_t *doom, ticcmd_t *ticcmds,
+                         boolean *players_mask);
+
+static net_client_state_t client_state;
+static net_context_t *client_context;
+static net_addr_t *server_addr;
+static net_connect_data_t client_connect_data;
+static boolean client_controller;
+static int last_send_time;
+static int last_recv_time;
+
+// Settings to send if we are the controller, and those the server
+// sent back.
+
+static net_gamesettings_t start_settings;
+static boolean start_requested;
+static net_gamesettings_t client_settings;
+
+// Our ticcmds: send_start is the first the server has not
+// acknowledged, sent_end the end of those sent at least once and
+// send_end the end of those built.
+
+static ticcmd_t send_cmds[BACKUPTICS];
+static int send_time[BACKUPTICS];
+static int send_start;
+static int sent_end;
+static int send_end;
+
+// Full tics from the server, and the next one wanted.  sent_ack is
+// the recv_seq the server was last told.
+
+static ticcmd_t recv_cmds[BACKUPTICS][NET_MAXPLAYERS];
+static int recv_seq;
+static int sent_ack;
+
+static boolean show_stats;
+static net_stats_t stats;
+
+static void SendPacket(net_packet_t *packet)
+{
+    NET_SendPacket(server_addr, packet);
+
+    stats.bytes_out += packet->len;
+    ++stats.packets_out;
+
+    last_send_time = I_GetTimeMS();
+}
+
+static void SendSimplePacket(net_packet_type_t type)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(4);
+    NET_WriteInt16(packet, type);
+    SendPacket(packet);
+    NET_FreePacket(packet);
+}
+
+static void SendSYN(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteConnectData(packet, &client_connect_data);
+    SendPacket(packet);
+    NET_FreePacket(packet);
+}
+
+static void SendGameStart(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(packet, &start_settings);
+    SendPacket(packet);
+    NET_FreePacket(packet);
+}
+
+//
+// Sends every tic the server has not acknowledged, up to a packet's
+// worth, along with how far we have got with its tics.
+//
+static void SendTics(void)
+{
+    static const ticcmd_t zerocmd;
+    net_packet_t *packet;
+    net_ticdiff_t diff;
+    const ticcmd_t *base;
+    int count, len;
+    int i, seq, now;
+
+    now = I_GetTimeMS();
+    count = send_end - send_start;
+
+    if (count > NET_MAXTICSPERPACKET)
+    {
+        count = NET_MAXTICSPERPACKET;
+    }
+
+    packet = NET_NewPacket(16 + count * 8);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt32(packet, recv_seq);
+    NET_WriteInt32(packet, send_start);
+    NET_WriteInt8(packet, count);
+
+    base = send_start == 0 ? &zerocmd
+                           : &send_cmds[(send_start - 1) % BACKUPTICS];
+
+    for (i = 0; i < count; ++i)
+    {
+        seq = send_start + i;
+
+        len = packet->len;
+        NET_TiccmdDiff((ticcmd_t *) base, &send_cmds[seq % BACKUPTICS], &diff);
+        NET_WriteTiccmdDiff(packet, &diff, client_settings.lowres_turn);
+        base = &send_cmds[seq % BACKUPTICS];
+
+        if (seq >= sent_end)
+        {
+            send_time[seq % BACKUPTICS] = now;
+            stats.tic_bytes += packet->len - len;
+            ++stats.tics_sent;
+        }
+    }
+
+    if (send_start + count > sent_end)
+    {
+        sent_end = send_start + count;
+    }
+
+    sent_ack = recv_seq;
+
+    SendPacket(packet);
+    NET_FreePacket(packet);
+}
+
+static void Disconnected(doom_data_t *doom)
+{
+    boolean was_in_game;
+
+    was_in_game = client_state == CLIENT_IN_GAME;
+
+    client_state = CLIENT_DISCONNECTED;
+    net_client_connected = false;
+
+    if (was_in_game)
+    {
+        D_ReceiveTic(doom, NULL, NULL);
+    }
+}
+
+static void ParseAck(net_packet_t *packet)
+{
+    unsigned int controller;
+
+    if (client_state != CLIENT_CONNECTING
+     || !NET_ReadInt8(packet, &controller))
+    {
+        return;
+    }
+
+    client_controller = controller != 0;
+    client_state = CLIENT_WAITING_LAUNCH;
+    net_client_connected = true;
+}
+
+static void ParseRejected(net_packet_t *packet)
+{
+    char *reason;
+
+    if (client_state != CLIENT_CONNECTING)
+    {
+        return;
+    }
+
+    reason = NET_ReadString(packet);
+
+    d_printf("NET_CL: Rejected by server: %s\n",
+             reason != NULL ? reason : "(no reason given)");
+
+    client_state = CLIENT_DISCONNECTED;
+}
+
+static void ParseGameStart(net_packet_t *packet)
+{
+    net_gamesettings_t settings;
+
+    if (client_state != CLIENT_WAITING_START
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    client_settings = settings;
+    client_state = CLIENT_IN_GAME;
+
+    send_start = sent_end = send_end = 0;
+    recv_seq = 0;
+    sent_ack = -1;
+
+    d_memset(&stats, 0, sizeof(stats));
+    stats.start_time = I_GetTimeMS();
+}
+
+static void ParseGameData(doom_data_t *doom, net_packet_t *packet)
+{
+    ticcmd_t cmds[NET_MAXPLAYERS];
+    boolean ingame[NET_MAXPLAYERS];
+    net_ticdiff_t diff;
+    unsigned int ackseq, start, count, mask;
+    unsigned int i, p;
+    int seq, rtt;
+
+    if (client_state != CLIENT_IN_GAME
+     || !NET_ReadInt32(packet, &ackseq)
+     || !NET_ReadInt32(packet, &start)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    if ((int) ackseq > send_start && (int) ackseq <= sent_end)
+    {
+        rtt = I_GetTimeMS() - send_time[(ackseq - 1) % BACKUPTICS];
+        stats.rtt_total += rtt;
+        ++stats.rtt_count;
+
+        if (rtt > stats.rtt_max)
+        {
+            stats.rtt_max = rtt;
+        }
+
+        send_start = ackseq;
+    }
+
+    // Tics after a gap cannot be decoded; the server sends them again.
+
+    if ((int) start > recv_seq)
+    {
+        return;
+    }
+
+    if (start == 0)
+    {
+        d_memset(cmds, 0, sizeof(cmds));
+    }
+    else
+    {
+        d_memcpy(cmds, recv_cmds[(start - 1) % BACKUPTICS], sizeof(cmds));
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        seq = start + i;
+
+        if (!NET_ReadInt8(packet, &mask))
+        {
+            return;
+        }
+
+        for (p = 0; p < NET_MAXPLAYERS; ++p)
+        {
+            ingame[p] = (mask & (1 << p)) != 0;
+
+            if (!ingame[p])
+            {
+                d_memset(&cmds[p], 0, sizeof(ticcmd_t));
+            }
+            else if (NET_ReadTiccmdDiff(packet, &diff,
+                                        client_settings.lowres_turn))
+            {
+                NET_TiccmdPatch(&cmds[p], &diff, &cmds[p]);
+            }
+            else
+            {
+                return;
+            }
+        }
+
+        // Leave room in the game's own tic buffer; a drone can fall
+        // behind the server.
+
+        if (seq == recv_seq
+         && seq - doom->gametic / doom->ticdup < BACKUPTICS - 1)
+        {
+            d_memcpy(recv_cmds[seq % BACKUPTICS], cmds, sizeof(cmds));
+            D_ReceiveTic(doom, cmds, ingame);
+            ++recv_seq;
+        }
+    }
+}
+
+static void ParsePacket(doom_data_t *doom, net_packet_t *packet)
+{
+    unsigned int type;
+
+    if (!NET_ReadInt16(packet, &type))
+    {
+        return;
+    }
+
+    switch (type)
+    {
+        case NET_PACKET_TYPE_ACK:
+            ParseAck(packet);
+            break;
+
+        case NET_PACKET_TYPE_REJECTED:
+            ParseRejected(packet);
+            break;
+
+        case NET_PACKET_TYPE_LAUNCH:
+            if (client_state == CLIENT_WAITING_LAUNCH)
+            {
+                client_state = CLIENT_WAITING_START;
+            }
+            break;
+
+        case NET_PACKET_TYPE_GAMESTART:
+            ParseGameStart(packet);
+            break;
+
+        case NET_PACKET_TYPE_GAMEDATA:
+            ParseGameData(doom, packet);
+            break;
+
+        case NET_PACKET_TYPE_DISCONNECT:
+            d_printf("NET_CL: Server closed the connection\n");
+            Disconnected(doom);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void PrintStats(void)
+{
+    int now, period, rtt, tics_per_packet, bytes_per_tic;
+
+    now = I_GetTimeMS();
+    period = now - stats.start_time;
+
+    if (period < STATS_PERIOD)
+    {
+        return;
+    }
+
+    rtt = stats.rtt_count > 0 ? stats.rtt_total / stats.rtt_count : 0;
+    tics_per_packet = stats.packets_out > 0
+                    ? stats.tics_sent * 100 / stats.packets_out : 0;
+    bytes_per_tic = stats.tics_sent > 0
+                  ? stats.tic_bytes * 100 / stats.tics_sent : 0;
+
+    d_printf("netstats: rtt %i ms (max %i), up %i B/s %i pkt/s, "
+             "down %i B/s %i pkt/s, %i.%02i tics/pkt, "
+             "%i.%02i B/ticcmd (%i raw)\n",
+             rtt, stats.rtt_max,
+             stats.bytes_out * 1000 / period,
+             stats.packets_out * 1000 / period,
+             stats.bytes_in * 1000 / period,
+             stats.packets_in * 1000 / period,
+             tics_per_packet / 100, tics_per_packet % 100,
+             bytes_per_tic / 100, bytes_per_tic % 100,
+             FULL_TICCMD_BYTES);
+
+    d_memset(&stats, 0, sizeof(stats));
+    stats.start_time = now;
+}
+
+//
+// Receive packets and send whatever is due.  Tics normally go out
+// from NET_CL_SendTiccmd; this covers resends and acknowledgements.
+//
+void NET_CL_Run(struct doom_data_t_ *doom)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int now;
+
+    if (client_context == NULL || client_state == CLIENT_DISCONNECTED)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(client_context, &addr, &packet))
+    {
+        if (addr == server_addr)
+        {
+            stats.bytes_in += packet->len;
+            ++stats.packets_in;
+            last_recv_time = I_GetTimeMS();
+
+            ParsePacket(doom, packet);
+        }
+
+        NET_FreePacket(packet);
+    }
+
+    now = I_GetTimeMS();
+
+    if (client_state != CLIENT_CONNECTING
+     && client_state != CLIENT_DISCONNECTED
+     && now - last_recv_time > NET_TIMEOUT)
+    {
+        d_printf("NET_CL: Lost connection to server\n");
+        SendSimplePacket(NET_PACKET_TYPE_DISCONNECT);
+        Disconnected(doom);
+        return;
+    }
+
+    switch (client_state)
+    {
+        case CLIENT_WAITING_LAUNCH:
+        case CLIENT_WAITING_START:
+
+            // Let the server know we are still here, and repeat the
+            // settings in case they were lost.
+
+            if (now - last_send_time >= 500)
+            {
+                if (client_state == CLIENT_WAITING_START && start_requested)
+                {
+                    SendGameStart();
+                }
+                else
+                {
+                    SendSimplePacket(NET_PACKET_TYPE_KEEPALIVE);
+                }
+            }
+            break;
+
+        case CLIENT_IN_GAME:
+
+            // Resend anything unacknowledged, and acknowledge tics
+            // when there is nothing of our own to carry it.
+
+            if ((send_start < send_end && now - last_send_time >= NET_RESEND_TIME)
+             || (recv_seq != sent_ack && now - last_send_time >= NET_RESEND_TIME / 2)
+             || now - last_send_time >= 1000)
+            {
+                SendTics();
+            }
+
+            if (show_stats)
+            {
+                PrintStats();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+boolean NET_CL_Connect(struct doom_data_t_ *doom, net_addr_t *addr,
+                       net_connect_data_t *data)
+{
+    int start_time;
+    int i;
+
+    //!
+    // @arg <n>
+    // @category net
+    //
+    // Send our ticcmds to the server n tics at a time (1 to 4).  The
+    // game is built that many tics ahead, so larger batches mean
+    // fewer packets but more input latency.
+    //
+
+    i = M_CheckParmWithArgs(doom, "-netbatch", 1);
+
+    if (i > 0)
+    {
+        net_ticbatch = d_atoi(doom->myargv[i + 1]);
+
+        if (net_ticbatch < 1)
+        {
+            net_ticbatch = 1;
+        }
+        else if (net_ticbatch > 4)
+        {
+            net_ticbatch = 4;
+        }
+    }
+
+    //!
+    // @category net
+    //
+    // Print round trip time, bandwidth and ticcmd compression every
+    // five seconds during a network game.
+    //
+
+    show_stats = M_CheckParm(doom, "-netstats") > 0;
+
+    server_addr = addr;
+    client_connect_data = *data;
+    client_context = NET_NewContext();
+    NET_AddModule(client_context, addr->module);
+
+    client_state = CLIENT_CONNECTING;
+    start_requested = false;
+
+    // Keep sending SYN until the server answers.  If we are the
+    // server as well, it has to be run from here.
+
+    start_time = I_GetTimeMS();
+    last_send_time = start_time - 1000;
+
+    while (client_state == CLIENT_CONNECTING)
+    {
+        if (I_GetTimeMS() - start_time > NET_TIMEOUT)
+        {
+            client_state = CLIENT_DISCONNECTED;
+            break;
+        }
+
+        if (I_GetTimeMS() - last_send_time >= 1000)
+        {
+            SendSYN();
+        }
+
+        NET_CL_Run(doom);
+        NET_SV_Run();
+        I_Sleep(1);
+    }
+
+    last_recv_time = I_GetTimeMS();
+
+    return client_state != CLIENT_DISCONNECTED;
+}
+
+void NET_CL_Disconnect(void)
+{
+    if (!net_client_connected)
+    {
+        return;
+    }
+
+    SendSimplePacket(NET_PACKET_TYPE_DISCONNECT);
+
+    client_state = CLIENT_DISCONNECTED;
+    net_client_connected = false;
+}
+
+//
+// Waits for everyone to join.  There is no waiting screen; the wait
+// is reported on the console.
+//
+void NET_WaitForLaunch(struct doom_data_t_ *doom)
+{
+    d_printf("NET_CL: Waiting for the other players%s\n",
+             client_controller ? " (we pick the settings)" : "");
+
+    while (client_state == CLIENT_WAITING_LAUNCH)
+    {
+        NET_CL_Run(doom);
+        NET_SV_Run();
+        I_Sleep(1);
+    }
+
+    if (client_state == CLIENT_DISCONNECTED)
+    {
+        I_Error("NET_WaitForLaunch: Lost connection to server");
+    }
+}
+
+//
+// Only the controller's settings are used; everyone else waits to
+// be told them.
+//
+void NET_CL_StartGame(net_gamesettings_t *settings)
+{
+    if (!client_controller)
+    {
+        return;
+    }
+
+    start_settings = *settings;
+    start_requested = true;
+
+    SendGameStart();
+}
+
+void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
+{
+    if (client_state != CLIENT_IN_GAME || maketic != send_end)
+    {
+        return;
+    }
+
+    send_cmds[maketic % BACKUPTICS] = *ticcmd;
+    ++send_end;
+
+    if (send_end - sent_end >= net_ticbatch)
+    {
+        SendTics();
+    }
+}
+
+boolean NET_CL_GetSettings(net_gamesettings_t *_settings)
+{
+    if (client_state != CLIENT_IN_GAME)
+    {
+        return false;
+    }
+
+    *_settings = client_settings;
+
+    return true;
+}
+
+#endif
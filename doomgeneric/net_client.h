@@ -19,19 +19,28 @@
 
 #include "doomtype.h"
 #include "d_ticcmd.h"
+#include "doomfeatures.h"
 #include "sha1.h"
 #include "net_defs.h"
 
-boolean NET_CL_Connect(net_addr_t *addr, net_connect_data_t *data);
+struct doom_data_t_;
+
+boolean NET_CL_Connect(struct doom_data_t_ *doom, net_addr_t *addr, net_connect_data_t *data);
 void NET_CL_Disconnect(void);
-void NET_CL_Run(void);
-void NET_CL_Init(void);
-void NET_CL_LaunchGame(void);
+void NET_CL_Run(struct doom_data_t_ *doom);
 void NET_CL_StartGame(net_gamesettings_t *settings);
 void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic);
 boolean NET_CL_GetSettings(net_gamesettings_t *_settings);
-void NET_Init(void);
 
-void NET_BindVariables(void);
+#ifdef FEATURE_MULTIPLAYER
+
+// True from the server accepting us until the connection is lost.
+extern boolean net_client_connected;
+
+// Tics queued before a packet goes out (-netbatch).  The main loop
+// builds this many tics ahead so the server is never kept waiting.
+extern int net_ticbatch;
+
+#endif
 
 #endif /* #ifndef NET_CLIENT_H */
@@ -0,0 +1,40 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Dedicated server code.
+//
+
+#include "dlibc.h"
+#include "doomfeatures.h"
+
+#ifdef FEATURE_MULTIPLAYER
+
+#include "i_timer.h"
+#include "net_dedicated.h"
+#include "net_server.h"
+#include "net_udp.h"
+
+void NET_DedicatedServer(struct doom_data_t_ *doom)
+{
+    NET_SV_Init(doom);
+    NET_SV_AddModule(&net_udp_module);
+
+    for (;;)
+    {
+        NET_SV_Run();
+        I_Sleep(1);
+    }
+}
+
+#endif
@@ -18,7 +18,9 @@
 #ifndef NET_DEDICATED_H
 #define NET_DEDICATED_H
 
-void NET_DedicatedServer(void);
+struct doom_data_t_;
+
+void NET_DedicatedServer(struct doom_data_t_ *doom);
 
 #endif /* #ifndef NET_DEDICATED_H */
 
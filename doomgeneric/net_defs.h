@@ -43,6 +43,19 @@
 
 #define BACKUPTICS 128
 
+// Most tics carried by one gameplay packet.
+
+#define NET_MAXTICSPERPACKET 32
+
+// Milliseconds without hearing from a peer before giving up on it.
+
+#define NET_TIMEOUT 10000
+
+// Milliseconds before tics that have not been acknowledged are sent
+// again.
+
+#define NET_RESEND_TIME 100
+
 typedef struct _net_module_s net_module_t;
 typedef struct _net_packet_s net_packet_t;
 typedef struct _net_addr_s net_addr_t;
@@ -14,7 +14,8 @@
 // Graphical stuff related to the networking code:
 //
 //  * The client waiting screen when we are waiting for the server to
-//    start the game.
+//    start the game.  There is no screen here yet; the wait is
+//    reported on the console.
 //
 
 
@@ -23,7 +24,9 @@
 
 #include "doomtype.h"
 
-extern void NET_WaitForLaunch(void);
+struct doom_data_t_;
+
+extern void NET_WaitForLaunch(struct doom_data_t_ *doom);
 
 #endif /* #ifndef NET_GUI_H */
 
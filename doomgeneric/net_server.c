@@ -0,0 +1,710 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Network server code.
+//
+//     The server collects every player's ticcmds, puts each tic
+//     together once all of them are in, and sends the full tics out
+//     to every client.  Every packet starts with an int16 type:
+//
+//     SYN         c->s  NET_MAGIC_NUMBER, connect data
+//     ACK         s->c  int8 nonzero if this client is the controller
+//     REJECTED    s->c  reason string
+//     LAUNCH      s->c  -nodes clients have connected
+//     GAMESTART   c->s  the controller's settings
+//                 s->c  the settings, with this client's consoleplayer
+//     KEEPALIVE   c->s  still waiting for LAUNCH or GAMESTART
+//     GAMEDATA    c->s  int32 next server tic wanted, int32 first tic,
+//                       int8 count, then a ticcmd diff per tic
+//                 s->c  int32 next client tic wanted, int32 first tic,
+//                       int8 count, then per tic an int8 mask of the
+//                       players in game and a ticcmd diff for each
+//     DISCONNECT  either way
+//
+//     Each side sends everything the other has not acknowledged yet,
+//     so several tics usually share a packet and a lost packet is
+//     covered by the next one.  The first ticcmd in a packet is
+//     diffed against the tic before it, which the receiver must
+//     already have, and each later one against the one before.
+//
+
+#include "dlibc.h"
+#include "doomfeatures.h"
+
+#ifdef FEATURE_MULTIPLAYER
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+typedef enum
+{
+    // Waiting for -nodes clients to connect.
+
+    SERVER_WAITING_LAUNCH,
+
+    // Waiting for the controller to send the game settings.
+
+    SERVER_WAITING_START,
+
+    // In a game.
+
+    SERVER_IN_GAME,
+} net_server_state_t;
+
+typedef struct
+{
+    boolean active;
+    net_addr_t *addr;
+    net_connect_data_t connect_data;
+    int last_recv_time;
+    int last_send_time;
+
+    // Player slot, or -1 for a drone.
+
+    int player;
+
+    // Sent game data since the start, so has the settings.
+
+    boolean started;
+
+    // Ticcmds from this client, and the next tic wanted from it.
+
+    ticcmd_t cmds[BACKUPTICS];
+    int recvseq;
+
+    // The next full tic the client wants, the end of what it has been
+    // sent at least once, and the recvseq it was last told.
+
+    int ackseq;
+    int sendseq;
+    int sentack;
+} net_client_t;
+
+static boolean server_initialized = false;
+static net_server_state_t server_state;
+static net_context_t *server_context;
+static net_client_t clients[MAXNETNODES];
+static net_gamesettings_t sv_settings;
+static int expected_nodes;
+
+// Full tics, and the next one to put together.
+
+static ticcmd_t sv_cmds[BACKUPTICS][NET_MAXPLAYERS];
+static unsigned int sv_ingame[BACKUPTICS];
+static int sv_tic;
+
+static net_client_t *FindClient(net_addr_t *addr)
+{
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && clients[i].addr == addr)
+        {
+            return &clients[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int NumClients(void)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+// The controller is the longest connected client; it picks the
+// game settings.
+
+static net_client_t *Controller(void)
+{
+    int i;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            return &clients[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void SendSimplePacket(net_client_t *client, net_packet_type_t type)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(4);
+    NET_WriteInt16(packet, type);
+    NET_SendPacket(client->addr, packet);
+    NET_FreePacket(packet);
+}
+
+static void SendReject(net_addr_t *addr, char *reason)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_REJECTED);
+    NET_WriteString(packet, reason);
+    NET_SendPacket(addr, packet);
+    NET_FreePacket(packet);
+}
+
+static void SendAck(net_client_t *client)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(4);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_ACK);
+    NET_WriteInt8(packet, client == Controller());
+    NET_SendPacket(client->addr, packet);
+    NET_FreePacket(packet);
+}
+
+static void SendGameStart(net_client_t *client)
+{
+    net_gamesettings_t settings;
+    net_packet_t *packet;
+
+    settings = sv_settings;
+    settings.consoleplayer = client->player < 0 ? 0 : client->player;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(packet, &settings);
+    NET_SendPacket(client->addr, packet);
+    NET_FreePacket(packet);
+}
+
+static void DropClient(net_client_t *client, boolean tell)
+{
+    d_printf("NET_SV: %s left\n", NET_AddrToString(client->addr));
+
+    if (tell)
+    {
+        SendSimplePacket(client, NET_PACKET_TYPE_DISCONNECT);
+    }
+
+    client->active = false;
+}
+
+static void ParseSYN(net_packet_t *packet, net_addr_t *addr)
+{
+    net_connect_data_t data;
+    net_client_t *client;
+    net_client_t *controller;
+    unsigned int magic;
+    int i;
+
+    if (!NET_ReadInt32(packet, &magic) || magic != NET_MAGIC_NUMBER
+     || !NET_ReadConnectData(packet, &data))
+    {
+        return;
+    }
+
+    // A repeated SYN: the ACK was lost.
+
+    client = FindClient(addr);
+
+    if (client != NULL)
+    {
+        SendAck(client);
+        return;
+    }
+
+    if (server_state != SERVER_WAITING_LAUNCH)
+    {
+        SendReject(addr, "Game has already started.");
+        return;
+    }
+
+    controller = Controller();
+
+    if (controller != NULL
+     && (d_memcmp(data.wad_sha1sum, controller->connect_data.wad_sha1sum,
+                  sizeof(sha1_digest_t)) != 0
+      || data.gamemode != controller->connect_data.gamemode
+      || data.gamemission != controller->connect_data.gamemission))
+    {
+        SendReject(addr, "Your WADs do not match the server's.");
+        return;
+    }
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!clients[i].active)
+        {
+            break;
+        }
+    }
+
+    if (i == MAXNETNODES)
+    {
+        SendReject(addr, "Server is full.");
+        return;
+    }
+
+    client = &clients[i];
+    d_memset(client, 0, sizeof(*client));
+    client->active = true;
+    client->addr = addr;
+    client->connect_data = data;
+    client->player = -1;
+    client->last_recv_time = I_GetTimeMS();
+
+    d_printf("NET_SV: %s joined (%i of %i)\n", NET_AddrToString(addr),
+             NumClients(), expected_nodes);
+
+    SendAck(client);
+
+    if (NumClients() >= expected_nodes)
+    {
+        server_state = SERVER_WAITING_START;
+
+        for (i = 0; i < MAXNETNODES; ++i)
+        {
+            if (clients[i].active)
+            {
+                SendSimplePacket(&clients[i], NET_PACKET_TYPE_LAUNCH);
+            }
+        }
+    }
+}
+
+static void ParseGameStart(net_packet_t *packet, net_client_t *client)
+{
+    net_gamesettings_t settings;
+    int num_players;
+    int i;
+
+    if (server_state == SERVER_IN_GAME)
+    {
+        // Lost GAMESTART; send it again.
+
+        SendGameStart(client);
+        return;
+    }
+
+    if (server_state != SERVER_WAITING_START || client != Controller()
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    // Hand out player slots in the order the clients joined.
+
+    num_players = 0;
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (!clients[i].active)
+        {
+            continue;
+        }
+
+        if (clients[i].connect_data.drone || num_players >= NET_MAXPLAYERS
+         || num_players >= clients[i].connect_data.max_players)
+        {
+            clients[i].player = -1;
+        }
+        else
+        {
+            settings.player_classes[num_players] = clients[i].connect_data.player_class;
+            clients[i].player = num_players++;
+        }
+    }
+
+    settings.num_players = num_players;
+    sv_settings = settings;
+    sv_tic = 0;
+    server_state = SERVER_IN_GAME;
+
+    d_printf("NET_SV: starting game with %i players\n", num_players);
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            SendGameStart(&clients[i]);
+        }
+    }
+}
+
+static void ParseKeepAlive(net_client_t *client)
+{
+    // The client is still waiting for something it may have missed.
+
+    if (server_state == SERVER_WAITING_START)
+    {
+        SendSimplePacket(client, NET_PACKET_TYPE_LAUNCH);
+    }
+    else if (server_state == SERVER_IN_GAME && !client->started)
+    {
+        SendGameStart(client);
+    }
+}
+
+static void ParseGameData(net_packet_t *packet, net_client_t *client)
+{
+    static const ticcmd_t zerocmd;
+    net_ticdiff_t diff;
+    ticcmd_t base;
+    unsigned int ackseq, start, count;
+    unsigned int i, seq;
+
+    if (server_state != SERVER_IN_GAME
+     || !NET_ReadInt32(packet, &ackseq)
+     || !NET_ReadInt32(packet, &start)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    client->started = true;
+
+    if ((int) ackseq > client->ackseq && (int) ackseq <= sv_tic)
+    {
+        client->ackseq = ackseq;
+    }
+
+    // Drones only acknowledge.  Tics after a gap cannot be decoded
+    // without the one before; the client will send them again.
+
+    if (client->player < 0 || (int) start > client->recvseq)
+    {
+        return;
+    }
+
+    base = start == 0 ? zerocmd : client->cmds[(start - 1) % BACKUPTICS];
+
+    for (i = 0; i < count; ++i)
+    {
+        seq = start + i;
+
+        if (!NET_ReadTiccmdDiff(packet, &diff, sv_settings.lowres_turn)
+         || (int) seq >= sv_tic + BACKUPTICS - 1)
+        {
+            break;
+        }
+
+        NET_TiccmdPatch(&base, &diff, &base);
+
+        if ((int) seq == client->recvseq)
+        {
+            client->cmds[seq % BACKUPTICS] = base;
+            ++client->recvseq;
+        }
+    }
+}
+
+static void ParsePacket(net_packet_t *packet, net_addr_t *addr)
+{
+    net_client_t *client;
+    unsigned int type;
+
+    if (!NET_ReadInt16(packet, &type))
+    {
+        return;
+    }
+
+    if (type == NET_PACKET_TYPE_SYN)
+    {
+        ParseSYN(packet, addr);
+        return;
+    }
+
+    client = FindClient(addr);
+
+    if (client == NULL)
+    {
+        return;
+    }
+
+    client->last_recv_time = I_GetTimeMS();
+
+    switch (type)
+    {
+        case NET_PACKET_TYPE_GAMESTART:
+            ParseGameStart(packet, client);
+            break;
+
+        case NET_PACKET_TYPE_KEEPALIVE:
+            ParseKeepAlive(client);
+            break;
+
+        case NET_PACKET_TYPE_GAMEDATA:
+            ParseGameData(packet, client);
+            break;
+
+        case NET_PACKET_TYPE_DISCONNECT:
+            DropClient(client, false);
+            break;
+
+        default:
+            break;
+    }
+}
+
+//
+// Puts together every tic that all players have sent their ticcmd
+// for.  Players who have left are simply not in game from then on.
+//
+static void AssembleTics(void)
+{
+    net_client_t *client;
+    boolean anyplayers;
+    int i, slot;
+
+    for (;;)
+    {
+        anyplayers = false;
+
+        for (i = 0; i < MAXNETNODES; ++i)
+        {
+            client = &clients[i];
+
+            if (!client->active)
+            {
+                continue;
+            }
+
+            // Nothing may be overwritten that a client still needs.
+
+            if (sv_tic - client->ackseq >= BACKUPTICS - 1)
+            {
+                return;
+            }
+
+            if (client->player >= 0)
+            {
+                if (client->recvseq <= sv_tic)
+                {
+                    return;
+                }
+
+                anyplayers = true;
+            }
+        }
+
+        if (!anyplayers)
+        {
+            return;
+        }
+
+        slot = sv_tic % BACKUPTICS;
+        d_memset(sv_cmds[slot], 0, sizeof(sv_cmds[slot]));
+        sv_ingame[slot] = 0;
+
+        for (i = 0; i < MAXNETNODES; ++i)
+        {
+            client = &clients[i];
+
+            if (client->active && client->player >= 0)
+            {
+                sv_cmds[slot][client->player] = client->cmds[sv_tic % BACKUPTICS];
+                sv_ingame[slot] |= 1 << client->player;
+            }
+        }
+
+        ++sv_tic;
+    }
+}
+
+static void SendTics(net_client_t *client, int now)
+{
+    static const ticcmd_t zerocmd;
+    net_packet_t *packet;
+    net_ticdiff_t diff;
+    ticcmd_t *base[NET_MAXPLAYERS];
+    int start, count, slot;
+    int i, p;
+
+    start = client->ackseq;
+    count = sv_tic - start;
+
+    // New tics go out at once, as does news that the client's tics
+    // arrived.  Anything else is a resend or a keepalive.
+
+    if (sv_tic <= client->sendseq && client->recvseq == client->sentack
+     && (count == 0 || now - client->last_send_time < NET_RESEND_TIME)
+     && now - client->last_send_time < 1000)
+    {
+        return;
+    }
+
+    if (count > NET_MAXTICSPERPACKET)
+    {
+        count = NET_MAXTICSPERPACKET;
+    }
+
+    packet = NET_NewPacket(16 + count * 8);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt32(packet, client->recvseq);
+    NET_WriteInt32(packet, start);
+    NET_WriteInt8(packet, count);
+
+    for (p = 0; p < NET_MAXPLAYERS; ++p)
+    {
+        base[p] = start == 0 ? (ticcmd_t *) &zerocmd
+                             : &sv_cmds[(start - 1) % BACKUPTICS][p];
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        slot = (start + i) % BACKUPTICS;
+
+        NET_WriteInt8(packet, sv_ingame[slot]);
+
+        for (p = 0; p < NET_MAXPLAYERS; ++p)
+        {
+            if (sv_ingame[slot] & (1 << p))
+            {
+                NET_TiccmdDiff(base[p], &sv_cmds[slot][p], &diff);
+                NET_WriteTiccmdDiff(packet, &diff, sv_settings.lowres_turn);
+            }
+
+            base[p] = &sv_cmds[slot][p];
+        }
+    }
+
+    NET_SendPacket(client->addr, packet);
+    NET_FreePacket(packet);
+
+    if (start + count > client->sendseq)
+    {
+        client->sendseq = start + count;
+    }
+
+    client->sentack = client->recvseq;
+    client->last_send_time = now;
+}
+
+void NET_SV_Init(struct doom_data_t_ *doom)
+{
+    int i;
+
+    //!
+    // @arg <n>
+    // @category net
+    //
+    // Start the game once n players (including the one running the
+    // server, if any) have joined.  The default is 2.
+    //
+
+    i = M_CheckParmWithArgs(doom, "-nodes", 1);
+    expected_nodes = i > 0 ? d_atoi(doom->myargv[i + 1]) : 2;
+
+    if (expected_nodes < 1)
+    {
+        expected_nodes = 1;
+    }
+
+    server_context = NET_NewContext();
+    d_memset(clients, 0, sizeof(clients));
+    server_state = SERVER_WAITING_LAUNCH;
+    server_initialized = true;
+}
+
+void NET_SV_AddModule(net_module_t *module)
+{
+    module->InitServer();
+    NET_AddModule(server_context, module);
+}
+
+void NET_SV_Run(void)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int now;
+    int i;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(server_context, &addr, &packet))
+    {
+        ParsePacket(packet, addr);
+        NET_FreePacket(packet);
+    }
+
+    now = I_GetTimeMS();
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && now - clients[i].last_recv_time > NET_TIMEOUT)
+        {
+            DropClient(&clients[i], true);
+        }
+    }
+
+    if (server_state != SERVER_IN_GAME)
+    {
+        return;
+    }
+
+    AssembleTics();
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active && clients[i].started)
+        {
+            SendTics(&clients[i], now);
+        }
+    }
+}
+
+void NET_SV_Shutdown(void)
+{
+    int i;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    for (i = 0; i < MAXNETNODES; ++i)
+    {
+        if (clients[i].active)
+        {
+            SendSimplePacket(&clients[i], NET_PACKET_TYPE_DISCONNECT);
+            clients[i].active = false;
+        }
+    }
+
+    server_initialized = false;
+}
+
+#endif
@@ -17,16 +17,19 @@
 #ifndef NET_SERVER_H
 #define NET_SERVER_H
 
+#include "net_defs.h"
+
+struct doom_data_t_;
+
 // initialize server and wait for connections
 
-void NET_SV_Init(void);
+void NET_SV_Init(struct doom_data_t_ *doom);
 
 // run server: check for new packets received etc.
 
 void NET_SV_Run(void);
 
-// Shut down the server
-// Blocks until all clients disconnect, or until a 5 second timeout
+// Shut down the server, telling the clients
 
 void NET_SV_Shutdown(void);
 
@@ -34,9 +37,5 @@ void NET_SV_Shutdown(void);
 
 void NET_SV_AddModule(net_module_t *module);
 
-// Register server with master server.
-
-void NET_SV_RegisterWithMaster(void);
-
 #endif /* #ifndef NET_SERVER_H */
 
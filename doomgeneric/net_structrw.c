@@ -0,0 +1,292 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Reading and writing various structures into packets
+//
+
+#include "dlibc.h"
+#include "doomfeatures.h"
+
+#ifdef FEATURE_MULTIPLAYER
+
+#include "doomtype.h"
+#include "net_packet.h"
+#include "net_structrw.h"
+
+void NET_WriteConnectData(net_packet_t *packet, net_connect_data_t *data)
+{
+    NET_WriteInt8(packet, data->gamemode);
+    NET_WriteInt8(packet, data->gamemission);
+    NET_WriteInt8(packet, data->lowres_turn);
+    NET_WriteInt8(packet, data->drone);
+    NET_WriteInt8(packet, data->max_players);
+    NET_WriteInt8(packet, data->is_freedoom);
+    NET_WriteSHA1Sum(packet, data->wad_sha1sum);
+    NET_WriteSHA1Sum(packet, data->deh_sha1sum);
+    NET_WriteInt8(packet, data->player_class);
+}
+
+boolean NET_ReadConnectData(net_packet_t *packet, net_connect_data_t *data)
+{
+    return NET_ReadInt8(packet, (unsigned int *) &data->gamemode)
+        && NET_ReadInt8(packet, (unsigned int *) &data->gamemission)
+        && NET_ReadInt8(packet, (unsigned int *) &data->lowres_turn)
+        && NET_ReadInt8(packet, (unsigned int *) &data->drone)
+        && NET_ReadInt8(packet, (unsigned int *) &data->max_players)
+        && NET_ReadInt8(packet, (unsigned int *) &data->is_freedoom)
+        && NET_ReadSHA1Sum(packet, data->wad_sha1sum)
+        && NET_ReadSHA1Sum(packet, data->deh_sha1sum)
+        && NET_ReadInt8(packet, (unsigned int *) &data->player_class);
+}
+
+void NET_WriteSettings(net_packet_t *packet, net_gamesettings_t *settings)
+{
+    int i;
+
+    NET_WriteInt8(packet, settings->ticdup);
+    NET_WriteInt8(packet, settings->extratics);
+    NET_WriteInt8(packet, settings->deathmatch);
+    NET_WriteInt8(packet, settings->nomonsters);
+    NET_WriteInt8(packet, settings->fast_monsters);
+    NET_WriteInt8(packet, settings->respawn_monsters);
+    NET_WriteInt8(packet, settings->episode);
+    NET_WriteInt8(packet, settings->map);
+    NET_WriteInt8(packet, settings->skill);
+    NET_WriteInt8(packet, settings->gameversion);
+    NET_WriteInt8(packet, settings->lowres_turn);
+    NET_WriteInt8(packet, settings->new_sync);
+    NET_WriteInt32(packet, settings->timelimit);
+    NET_WriteInt8(packet, settings->loadgame);
+    NET_WriteInt8(packet, settings->random);
+    NET_WriteInt8(packet, settings->num_players);
+    NET_WriteInt8(packet, settings->consoleplayer);
+
+    for (i = 0; i < settings->num_players; ++i)
+    {
+        NET_WriteInt8(packet, settings->player_classes[i]);
+    }
+}
+
+boolean NET_ReadSettings(net_packet_t *packet, net_gamesettings_t *settings)
+{
+    boolean success;
+    int i;
+
+    success = NET_ReadInt8(packet, (unsigned int *) &settings->ticdup)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->extratics)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->deathmatch)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->nomonsters)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->fast_monsters)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->respawn_monsters)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->episode)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->map)
+           && NET_ReadSInt8(packet, &settings->skill)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->gameversion)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->lowres_turn)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->new_sync)
+           && NET_ReadInt32(packet, (unsigned int *) &settings->timelimit)
+           && NET_ReadSInt8(packet, (signed int *) &settings->loadgame)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->random)
+           && NET_ReadInt8(packet, (unsigned int *) &settings->num_players)
+           && NET_ReadSInt8(packet, (signed int *) &settings->consoleplayer);
+
+    if (!success || settings->num_players > NET_MAXPLAYERS)
+    {
+        return false;
+    }
+
+    for (i = 0; i < settings->num_players; ++i)
+    {
+        if (!NET_ReadInt8(packet,
+                          (unsigned int *) &settings->player_classes[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void NET_TiccmdDiff(ticcmd_t *tic1, ticcmd_t *tic2, net_ticdiff_t *diff)
+{
+    diff->diff = 0;
+    diff->cmd = *tic2;
+
+    if (tic1->forwardmove != tic2->forwardmove)
+        diff->diff |= NET_TICDIFF_FORWARD;
+    if (tic1->sidemove != tic2->sidemove)
+        diff->diff |= NET_TICDIFF_SIDE;
+    if (tic1->angleturn != tic2->angleturn)
+        diff->diff |= NET_TICDIFF_TURN;
+    if (tic1->buttons != tic2->buttons)
+        diff->diff |= NET_TICDIFF_BUTTONS;
+    if (tic1->consistancy != tic2->consistancy)
+        diff->diff |= NET_TICDIFF_CONSISTANCY;
+    if (tic2->chatchar != 0)
+        diff->diff |= NET_TICDIFF_CHATCHAR;
+}
+
+void NET_TiccmdPatch(ticcmd_t *src, net_ticdiff_t *diff, ticcmd_t *dest)
+{
+    d_memmove(dest, src, sizeof(ticcmd_t));
+
+    // Apply the diff
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+        dest->forwardmove = diff->cmd.forwardmove;
+    if (diff->diff & NET_TICDIFF_SIDE)
+        dest->sidemove = diff->cmd.sidemove;
+    if (diff->diff & NET_TICDIFF_TURN)
+        dest->angleturn = diff->cmd.angleturn;
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+        dest->buttons = diff->cmd.buttons;
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+        dest->consistancy = diff->cmd.consistancy;
+
+    // Chat characters are only sent once, not repeated.
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+        dest->chatchar = diff->cmd.chatchar;
+    else
+        dest->chatchar = 0;
+}
+
+void NET_WriteTiccmdDiff(net_packet_t *packet, net_ticdiff_t *diff,
+                         boolean lowres_turn)
+{
+    // Header
+
+    NET_WriteInt8(packet, diff->diff);
+
+    // Write the fields which are enabled:
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+        NET_WriteInt8(packet, diff->cmd.forwardmove);
+    if (diff->diff & NET_TICDIFF_SIDE)
+        NET_WriteInt8(packet, diff->cmd.sidemove);
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            NET_WriteInt8(packet, diff->cmd.angleturn / 256);
+        }
+        else
+        {
+            NET_WriteInt16(packet, diff->cmd.angleturn);
+        }
+    }
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+        NET_WriteInt8(packet, diff->cmd.buttons);
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+        NET_WriteInt8(packet, diff->cmd.consistancy);
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+        NET_WriteInt8(packet, diff->cmd.chatchar);
+}
+
+boolean NET_ReadTiccmdDiff(net_packet_t *packet, net_ticdiff_t *diff,
+                           boolean lowres_turn)
+{
+    unsigned int val;
+    signed int sval;
+
+    // Read header
+
+    if (!NET_ReadInt8(packet, &diff->diff))
+        return false;
+
+    // Read fields
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+    {
+        if (!NET_ReadSInt8(packet, &sval))
+            return false;
+        diff->cmd.forwardmove = sval;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE)
+    {
+        if (!NET_ReadSInt8(packet, &sval))
+            return false;
+        diff->cmd.sidemove = sval;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            if (!NET_ReadSInt8(packet, &sval))
+                return false;
+            diff->cmd.angleturn = sval * 256;
+        }
+        else
+        {
+            if (!NET_ReadSInt16(packet, &sval))
+                return false;
+            diff->cmd.angleturn = sval;
+        }
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+    {
+        if (!NET_ReadInt8(packet, &val))
+            return false;
+        diff->cmd.buttons = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+    {
+        if (!NET_ReadInt8(packet, &val))
+            return false;
+        diff->cmd.consistancy = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+    {
+        if (!NET_ReadInt8(packet, &val))
+            return false;
+        diff->cmd.chatchar = val;
+    }
+
+    return true;
+}
+
+boolean NET_ReadSHA1Sum(net_packet_t *packet, sha1_digest_t digest)
+{
+    unsigned int b;
+    int i;
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        if (!NET_ReadInt8(packet, &b))
+        {
+            return false;
+        }
+
+        digest[i] = b;
+    }
+
+    return true;
+}
+
+void NET_WriteSHA1Sum(net_packet_t *packet, sha1_digest_t digest)
+{
+    int i;
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        NET_WriteInt8(packet, digest[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,259 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module using UDP sockets bound to localhost.
+//     Only loopback addresses are accepted: this is for running
+//     several copies of the game on one machine (tests, bots), not
+//     for play across a network.
+//
+
+#include "dlibc.h"
+#include "doomfeatures.h"
+
+#ifdef FEATURE_MULTIPLAYER
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "i_system.h"
+#include "m_misc.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_udp.h"
+
+#define MAX_ADDRESSES 32
+#define MAX_DATAGRAM 1500
+
+typedef struct
+{
+    net_addr_t net_addr;
+    struct sockaddr_in sin;
+} addrpair_t;
+
+int net_udp_port = DEFAULT_UDP_PORT;
+
+static int udpsocket = -1;
+static addrpair_t addr_table[MAX_ADDRESSES];
+static int addr_table_size;
+
+// Finds the net_addr_t for a sockaddr, adding it if it is new, so
+// that the same peer always maps to the same net_addr_t.
+
+static net_addr_t *FindAddress(struct sockaddr_in *sin)
+{
+    addrpair_t *pair;
+    int i;
+
+    for (i = 0; i < addr_table_size; ++i)
+    {
+        pair = &addr_table[i];
+
+        if (pair->sin.sin_addr.s_addr == sin->sin_addr.s_addr
+         && pair->sin.sin_port == sin->sin_port)
+        {
+            return &pair->net_addr;
+        }
+    }
+
+    if (addr_table_size == MAX_ADDRESSES)
+    {
+        return NULL;
+    }
+
+    pair = &addr_table[addr_table_size++];
+    pair->net_addr.module = &net_udp_module;
+    pair->net_addr.handle = pair;
+    pair->sin = *sin;
+
+    return &pair->net_addr;
+}
+
+static boolean OpenSocket(int port)
+{
+    struct sockaddr_in sin;
+
+    udpsocket = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (udpsocket < 0)
+    {
+        return false;
+    }
+
+    d_memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = htons(port);
+
+    if (bind(udpsocket, (struct sockaddr *) &sin, sizeof(sin)) < 0
+     || fcntl(udpsocket, F_SETFL, O_NONBLOCK) < 0)
+    {
+        close(udpsocket);
+        udpsocket = -1;
+        return false;
+    }
+
+    return true;
+}
+
+static boolean NET_UDP_InitClient(void)
+{
+    if (udpsocket >= 0)
+    {
+        return true;
+    }
+
+    return OpenSocket(0);
+}
+
+static boolean NET_UDP_InitServer(void)
+{
+    if (udpsocket >= 0)
+    {
+        return true;
+    }
+
+    if (!OpenSocket(net_udp_port))
+    {
+        I_Error("NET_UDP_InitServer: Unable to bind to port %i", net_udp_port);
+        return false;
+    }
+
+    return true;
+}
+
+static void NET_UDP_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    addrpair_t *pair;
+
+    // No LAN broadcasts: everything is on this machine.
+
+    if (addr == &net_broadcast_addr || udpsocket < 0)
+    {
+        return;
+    }
+
+    pair = addr->handle;
+
+    sendto(udpsocket, packet->data, packet->len, 0,
+           (struct sockaddr *) &pair->sin, sizeof(pair->sin));
+}
+
+static boolean NET_UDP_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    byte buffer[MAX_DATAGRAM];
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    ssize_t result;
+
+    if (udpsocket < 0)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        fromlen = sizeof(from);
+        result = recvfrom(udpsocket, buffer, sizeof(buffer), 0,
+                          (struct sockaddr *) &from, &fromlen);
+
+        if (result < 0)
+        {
+            return false;
+        }
+
+        *addr = FindAddress(&from);
+
+        if (*addr != NULL)
+        {
+            break;
+        }
+    }
+
+    *packet = NET_NewPacket(result);
+    d_memcpy((*packet)->data, buffer, result);
+    (*packet)->len = result;
+
+    return true;
+}
+
+static void NET_UDP_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
+{
+    addrpair_t *pair = addr->handle;
+    char host[INET_ADDRSTRLEN];
+
+    inet_ntop(AF_INET, &pair->sin.sin_addr, host, sizeof(host));
+    d_snprintf(buffer, buffer_len, "%s:%i", host, ntohs(pair->sin.sin_port));
+}
+
+static void NET_UDP_FreeAddress(net_addr_t *addr)
+{
+    // Addresses live in addr_table for the whole session.
+}
+
+static net_addr_t *NET_UDP_ResolveAddress(char *address)
+{
+    struct sockaddr_in sin;
+    char host[64];
+    char *colon;
+    int port;
+
+    if (address == NULL)
+    {
+        return NULL;
+    }
+
+    M_StringCopy(host, address, sizeof(host));
+    port = net_udp_port;
+
+    colon = d_strchr(host, ':');
+
+    if (colon != NULL)
+    {
+        *colon = '\0';
+        port = d_atoi(colon + 1);
+    }
+
+    d_memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+
+    if (!d_stricmp(host, "localhost"))
+    {
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    else if (inet_pton(AF_INET, host, &sin.sin_addr) != 1
+          || (ntohl(sin.sin_addr.s_addr) >> 24) != 127)
+    {
+        return NULL;
+    }
+
+    return FindAddress(&sin);
+}
+
+net_module_t net_udp_module =
+{
+    NET_UDP_InitClient,
+    NET_UDP_InitServer,
+    NET_UDP_SendPacket,
+    NET_UDP_RecvPacket,
+    NET_UDP_AddrToString,
+    NET_UDP_FreeAddress,
+    NET_UDP_ResolveAddress,
+};
+
+#endif
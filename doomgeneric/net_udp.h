@@ -0,0 +1,31 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module using UDP sockets bound to localhost, for
+//     games between processes on the same machine.
+//
+
+#ifndef NET_UDP_H
+#define NET_UDP_H
+
+#include "net_defs.h"
+
+#define DEFAULT_UDP_PORT 2342
+
+// Port the server listens on; -port.
+extern int net_udp_port;
+
+extern net_module_t net_udp_module;
+
+#endif /* #ifndef NET_UDP_H */
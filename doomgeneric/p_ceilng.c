@@ -184,7 +184,7 @@ int EV_DoCeiling(doom_data_t *doom,
 
 		// new door thinker
 		rtn = 1;
-		ceiling = Z_Malloc(sizeof(*ceiling), PU_LEVSPEC, 0);
+		ceiling = P_AllocateThinker(tp_ceiling);
 		P_AddThinker(&ceiling->thinker);
 		sec->specialdata = ceiling;
 		ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
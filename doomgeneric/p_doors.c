@@ -262,7 +262,7 @@ int EV_DoDoor(doom_data_t *doom,
 
 		// new door thinker
 		rtn = 1;
-		door = Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+		door = P_AllocateThinker(tp_door);
 		P_AddThinker(&door->thinker);
 		sec->specialdata = door;
 
@@ -459,7 +459,7 @@ void EV_VerticalDoor(doom_data_t *doom,
 	}
 
 	// new door thinker
-	door = Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocateThinker(tp_door);
 	P_AddThinker(&door->thinker);
 	sec->specialdata = door;
 	door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
@@ -508,7 +508,7 @@ void P_SpawnDoorCloseIn30(sector_t *sec)
 {
 	vldoor_t *door;
 
-	door = Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocateThinker(tp_door);
 
 	P_AddThinker(&door->thinker);
 
@@ -532,7 +532,7 @@ void P_SpawnDoorRaiseIn5Mins(doom_data_t *doom,
 {
 	vldoor_t *door;
 
-	door = Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocateThinker(tp_door);
 
 	P_AddThinker(&door->thinker);
 
@@ -741,7 +741,7 @@ EV_SlidingDoor
     // Init sliding door vars
     if (!door)
     {
-	door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocateThinker(tp_door);
 	P_AddThinker (&door->thinker);
 	sec->specialdata = door;
 		
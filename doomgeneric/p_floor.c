@@ -263,7 +263,7 @@ int EV_DoFloor(doom_data_t *doom,
 
 		// new floor thinker
 		rtn = 1;
-		floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+		floor = P_AllocateThinker(tp_floor);
 		P_AddThinker(&floor->thinker);
 		sec->specialdata = floor;
 		floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -462,7 +462,7 @@ int EV_BuildStairs(doom_data_t *doom,
 
 		// new floor thinker
 		rtn = 1;
-		floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+		floor = P_AllocateThinker(tp_floor);
 		P_AddThinker(&floor->thinker);
 		sec->specialdata = floor;
 		floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -515,7 +515,7 @@ int EV_BuildStairs(doom_data_t *doom,
 
 				sec = tsec;
 				secnum = newsecnum;
-				floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+				floor = P_AllocateThinker(tp_floor);
 
 				P_AddThinker(&floor->thinker);
 
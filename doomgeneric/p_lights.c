@@ -61,7 +61,7 @@ void P_SpawnFireFlicker(doom_data_t *doom, sector_t *sector)
     // Nothing special about it during gameplay.
     sector->special = 0;
 
-    flick = Z_Malloc(sizeof(*flick), PU_LEVSPEC, 0);
+    flick = P_AllocateThinker(tp_fireflicker);
 
     P_AddThinker(&flick->thinker);
 
@@ -109,7 +109,7 @@ void P_SpawnLightFlash(doom_data_t *doom, sector_t *sector)
     // nothing special about it during gameplay
     sector->special = 0;
 
-    flash = Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+    flash = P_AllocateThinker(tp_lightflash);
 
     P_AddThinker(&flash->thinker);
 
@@ -159,7 +159,7 @@ void P_SpawnStrobeFlash(doom_data_t *doom,
 {
     strobe_t *flash;
 
-    flash = Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+    flash = P_AllocateThinker(tp_strobe);
 
     P_AddThinker(&flash->thinker);
 
@@ -309,7 +309,7 @@ void P_SpawnGlowingLight(doom_data_t *doom, sector_t *sector)
 {
     glow_t *g;
 
-    g = Z_Malloc(sizeof(*g), PU_LEVSPEC, 0);
+    g = P_AllocateThinker(tp_glow);
 
     P_AddThinker(&g->thinker);
 
@@ -61,9 +61,44 @@
 // both the head and tail of the thinker list
 extern thinker_t thinkercap;
 
+// Each thinker class is allocated from its own pool of
+// fixed-size slabs instead of individual zone blocks.
+typedef enum
+{
+    tp_mobj,
+    tp_ceiling,
+    tp_door,
+    tp_floor,
+    tp_plat,
+    tp_fireflicker,
+    tp_lightflash,
+    tp_strobe,
+    tp_glow,
+    NUMTHINKERPOOLS
+} thinkerpool_e;
+
 void P_InitThinkers(void);
+void P_InitThinkerPools(doom_data_t *doom);
+void *P_AllocateThinker(thinkerpool_e type);
+void P_FreeThinker(thinker_t *thinker);
 void P_AddThinker(thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
+void P_RunThinkers(doom_data_t *doom);
+void P_PrintThinkerStats(void);
+
+typedef struct
+{
+    unsigned int misc;          // game state, P_Random index, players
+    unsigned int sectors;
+    unsigned int mobjs;
+    int nummobjs;
+} gamestatehash_t;
+
+// If mobjhashes is not NULL it gets each map object's own hash, in
+// thinker order, up to maxmobjs of them.
+void P_HashGameState(doom_data_t *doom, gamestatehash_t *hash,
+                     unsigned int *mobjhashes, int maxmobjs);
+unsigned int P_GameStateHash(doom_data_t *doom);
 
 //
 // P_PSPR
@@ -212,7 +247,6 @@ boolean P_CheckPosition(doom_data_t *doom, mobj_t *thing, fixed_t x, fixed_t y);
 boolean P_TryMove(doom_data_t *doom, mobj_t *thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove(doom_data_t *doom, mobj_t *thing, fixed_t x, fixed_t y);
 void P_SlideMove(doom_data_t *doom, mobj_t *mo);
-boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
 void P_UseLines(doom_data_t *doom, player_t *player);
 
 boolean P_ChangeSector(doom_data_t *doom, sector_t *sector, boolean crunch);
@@ -237,6 +271,25 @@ void P_RadiusAttack(doom_data_t *doom,
                     mobj_t *source,
                     int damage);
 
+//
+// P_SIGHT
+//
+enum
+{
+    SIGHT_REJECT,
+    SIGHT_TRAVERSE,
+    SIGHT_CACHED,
+    NUMSIGHTCOUNTS
+};
+
+extern int sightcounts[NUMSIGHTCOUNTS];
+
+boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void P_InvalidateSightCache(void);
+void P_InvalidateSightSector(sector_t *sector);
+void P_InitSightCache(doom_data_t *doom);
+void P_PrintSightStats(void);
+
 //
 // P_SETUP
 //
@@ -248,6 +301,16 @@ extern int bmapheight; // in mapblocks
 extern fixed_t bmaporgx;
 extern fixed_t bmaporgy;    // origin of block map
 extern mobj_t **blocklinks; // for thing chains
+extern int totallines;      // entries in the sector line buffer
+
+sector_t *GetSectorAtNullAddress(doom_data_t *doom);
+void P_SetupBlockMap(void);
+
+//
+// P_MAPCACHE
+//
+boolean P_LoadMapCache(doom_data_t *doom, char *mapname, int lumpnum);
+void P_SaveMapCache(doom_data_t *doom, char *mapname, int lumpnum);
 
 //
 // P_INTER
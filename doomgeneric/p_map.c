@@ -1321,6 +1321,10 @@ P_ChangeSector(doom_data_t *doom,
     nofit = false;
     crushchange = crunch;
 
+    // sector heights changed, so cached sight checks through it
+    // are stale
+    P_InvalidateSightSector(sector);
+
     // re-check heights for all things near the moving sector
     for (x = sector->blockbox[BOXLEFT]; x <= sector->blockbox[BOXRIGHT]; x++)
         for (y = sector->blockbox[BOXBOTTOM]; y <= sector->blockbox[BOXTOP]; y++)
@@ -0,0 +1,755 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Level geometry cache.
+//	Stores the fully processed level structures (after P_GroupLines
+//	and REJECT padding) as one binary image, kept in the zone and
+//	written to a file, so that later loads of the same map can
+//	bulk-copy them instead of converting every lump.
+//	Pointers are stored as array indices and relocated on load.
+//
+
+#include "dlibc.h"
+
+#include "z_zone.h"
+#include "m_misc.h"
+#include "sha1.h"
+#include "w_checksum.h"
+#include "w_wad.h"
+
+#include "doomdef.h"
+#include "doomdata.h"
+#include "p_local.h"
+#include "r_state.h"
+
+#define MAPCACHE_MAGIC   "DGMAPCH"
+#define MAPCACHE_VERSION 2
+
+// Sizes of the in-memory structures.  The cache is a raw image of
+// these, so a build with a different layout must not accept it.
+
+enum
+{
+    mcs_pointer,
+    mcs_vertex,
+    mcs_sector,
+    mcs_side,
+    mcs_line,
+    mcs_subsector,
+    mcs_node,
+    mcs_seg,
+    NUMMAPCACHESIZES
+};
+
+typedef struct
+{
+    char magic[8];
+    int version;
+    int structsizes[NUMMAPCACHESIZES];
+    sha1_digest_t wadsum;
+    char mapname[8];
+
+    int numvertexes;
+    int numsectors;
+    int numsides;
+    int numlines;
+    int numsubsectors;
+    int numnodes;
+    int numsegs;
+    int totallines;
+    int blockmaplen;    // in bytes
+    int rejectlen;      // in bytes, including padding
+
+    unsigned int payloadsum;
+} mapcacheheader_t;
+
+// Swizzled pointer value for the "glass hack" backsector,
+// see GetSectorAtNullAddress.
+
+#define NULLSECTOR_INDEX ((intptr_t) -1)
+
+static boolean wadsum_valid = false;
+static sha1_digest_t wadsum;
+
+static void MapCacheStructSizes(int *sizes)
+{
+    sizes[mcs_pointer] = sizeof(void *);
+    sizes[mcs_vertex] = sizeof(vertex_t);
+    sizes[mcs_sector] = sizeof(sector_t);
+    sizes[mcs_side] = sizeof(side_t);
+    sizes[mcs_line] = sizeof(line_t);
+    sizes[mcs_subsector] = sizeof(subsector_t);
+    sizes[mcs_node] = sizeof(node_t);
+    sizes[mcs_seg] = sizeof(seg_t);
+}
+
+// The WADs do not change once the game has started, so the
+// checksum of their contents only needs to be calculated once.
+
+static byte *MapCacheWadSum(doom_data_t *doom)
+{
+    if (!wadsum_valid)
+    {
+        W_ChecksumContents(doom, wadsum);
+        wadsum_valid = true;
+    }
+
+    return wadsum;
+}
+
+static boolean MemEqual(const void *a, const void *b, size_t len)
+{
+    const byte *pa = a;
+    const byte *pb = b;
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+    {
+        if (pa[i] != pb[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static char *MapCacheFileName(doom_data_t *doom, char *mapname)
+{
+    return M_StringJoin(doom->savegamedir, "mapcache_", mapname, ".dat", NULL);
+}
+
+// Images of the maps cached this session.  They are kept in the
+// zone as well as written out, so that going back to a map (a
+// restart or a loaded game) skips the lumps even where files cannot
+// be written, as with the embedded WAD.  They are PU_CACHE, so the
+// zone can take them back when it runs short.
+
+#define MAXCACHEDMAPS 64
+
+typedef struct
+{
+    char mapname[8];
+    byte *image;
+    int length;
+} cachedmap_t;
+
+static cachedmap_t cachedmaps[MAXCACHEDMAPS];
+static int nextcachedmap;
+
+static cachedmap_t *FindCachedMap(char *mapname)
+{
+    int i;
+
+    for (i = 0; i < MAXCACHEDMAPS; ++i)
+    {
+        if (cachedmaps[i].image != NULL
+         && d_strnicmp(cachedmaps[i].mapname, mapname,
+                       sizeof(cachedmaps[i].mapname)) == 0)
+        {
+            return &cachedmaps[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void KeepImage(char *mapname, byte *image, int length)
+{
+    cachedmap_t *cached;
+
+    cached = FindCachedMap(mapname);
+
+    if (cached == NULL)
+    {
+        // Past MAXCACHEDMAPS, the oldest one goes.
+
+        cached = &cachedmaps[nextcachedmap];
+        nextcachedmap = (nextcachedmap + 1) % MAXCACHEDMAPS;
+    }
+
+    if (cached->image != NULL && cached->image != image)
+    {
+        Z_Free(cached->image);
+    }
+
+    d_strncpy(cached->mapname, mapname, sizeof(cached->mapname));
+    cached->length = length;
+    cached->image = image;
+    Z_ChangeUser(image, (void **) &cached->image);
+    Z_ChangeTag(image, PU_CACHE);
+}
+
+// Everything after the header.
+
+static int PayloadLength(mapcacheheader_t *header)
+{
+    return header->numvertexes * sizeof(vertex_t)
+         + header->numsectors * sizeof(sector_t)
+         + header->numsides * sizeof(side_t)
+         + header->numlines * sizeof(line_t)
+         + header->numsubsectors * sizeof(subsector_t)
+         + header->numnodes * sizeof(node_t)
+         + header->numsegs * sizeof(seg_t)
+         + header->totallines * sizeof(line_t *)
+         + header->blockmaplen
+         + header->rejectlen;
+}
+
+//
+// Saving
+//
+
+static boolean swizzle_ok;
+
+// Convert a pointer into base[0..count-1] to index + 1; NULL becomes 0.
+
+static void *Swizzle(void *ptr, void *base, size_t size, int count)
+{
+    ptrdiff_t offset;
+
+    if (ptr == NULL)
+    {
+        return NULL;
+    }
+
+    offset = (byte *) ptr - (byte *) base;
+
+    if (offset < 0 || offset % size != 0 || offset / size >= count)
+    {
+        swizzle_ok = false;
+        return NULL;
+    }
+
+    return (void *) (offset / size + 1);
+}
+
+static void *SwizzleSector(doom_data_t *doom, sector_t *sector)
+{
+    if (sector != NULL && sector == GetSectorAtNullAddress(doom))
+    {
+        return (void *) NULLSECTOR_INDEX;
+    }
+
+    return Swizzle(sector, sectors, sizeof(sector_t), numsectors);
+}
+
+#define SWIZZLE(ptr, array, count) Swizzle(ptr, array, sizeof(*(array)), count)
+static void SwizzleSectorElem(doom_data_t *doom, void *elem)
+{
+    sector_t *sector = elem;
+    line_t **linebuffer = numsectors > 0 ? sectors[0].lines : NULL;
+
+    // Nothing has been spawned yet, so the runtime links
+    // must all be empty.
+
+    if (sector->soundtarget != NULL || sector->thinglist != NULL
+     || sector->specialdata != NULL)
+    {
+        swizzle_ok = false;
+    }
+
+    sector->lines = SWIZZLE(sector->lines, linebuffer, totallines + 1);
+    d_memset(&sector->soundorg.thinker, 0, sizeof(thinker_t));
+}
+
+static void SwizzleSideElem(doom_data_t *doom, void *elem)
+{
+    side_t *side = elem;
+
+    side->sector = SwizzleSector(doom, side->sector);
+}
+
+static void SwizzleLineElem(doom_data_t *doom, void *elem)
+{
+    line_t *line = elem;
+
+    if (line->specialdata != NULL)
+    {
+        swizzle_ok = false;
+    }
+
+    line->v1 = SWIZZLE(line->v1, vertexes, numvertexes);
+    line->v2 = SWIZZLE(line->v2, vertexes, numvertexes);
+    line->frontsector = SwizzleSector(doom, line->frontsector);
+    line->backsector = SwizzleSector(doom, line->backsector);
+}
+
+static void SwizzleSubsectorElem(doom_data_t *doom, void *elem)
+{
+    subsector_t *ss = elem;
+
+    ss->sector = SwizzleSector(doom, ss->sector);
+}
+
+static void SwizzleSegElem(doom_data_t *doom, void *elem)
+{
+    seg_t *seg = elem;
+
+    seg->v1 = SWIZZLE(seg->v1, vertexes, numvertexes);
+    seg->v2 = SWIZZLE(seg->v2, vertexes, numvertexes);
+    seg->sidedef = SWIZZLE(seg->sidedef, sides, numsides);
+    seg->linedef = SWIZZLE(seg->linedef, lines, numlines);
+    seg->frontsector = SwizzleSector(doom, seg->frontsector);
+    seg->backsector = SwizzleSector(doom, seg->backsector);
+}
+
+static void SwizzleLineBufferElem(doom_data_t *doom, void *elem)
+{
+    line_t **li = elem;
+
+    *li = SWIZZLE(*li, lines, numlines);
+}
+
+static int RejectLength(doom_data_t *doom, int lumpnum)
+{
+    int minlength;
+    int lumplen;
+
+    minlength = (numsectors * numsectors + 7) / 8;
+    lumplen = W_LumpLength(doom, lumpnum + ML_REJECT);
+
+    return lumplen > minlength ? lumplen : minlength;
+}
+
+// Copy one array into the image, and swizzle the pointers in the
+// copy, so the live level data is not touched.
+
+static byte *PutArray(doom_data_t *doom, byte *dest,
+                      void *array, size_t size, int count,
+                      void (*swizzle)(doom_data_t *doom, void *elem))
+{
+    int i;
+
+    d_memcpy(dest, array, size * count);
+
+    if (swizzle != NULL)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            swizzle(doom, dest + i * size);
+        }
+    }
+
+    return dest + size * count;
+}
+
+// Write the image out too, through a temporary file so that a
+// half-written cache is never left behind.  The embedded backend
+// cannot open files for writing, so there only the zone copy is kept.
+
+static void WriteCacheFile(doom_data_t *doom, char *mapname,
+                           byte *image, int length)
+{
+    char *filename;
+    char *tempname;
+    FILE *file;
+    boolean ok;
+
+    filename = MapCacheFileName(doom, mapname);
+    tempname = M_StringJoin(filename, ".tmp", NULL);
+
+    file = d_fopen(tempname, "wb");
+
+    if (file != NULL)
+    {
+        ok = d_fwrite(image, length, 1, file) == 1;
+        d_fclose(file);
+
+        if (ok)
+        {
+            d_remove(filename);
+            ok = d_rename(tempname, filename) == 0;
+        }
+
+        if (!ok)
+        {
+            d_remove(tempname);
+        }
+    }
+
+    Z_Free(tempname);
+    Z_Free(filename);
+}
+
+//
+// P_SaveMapCache
+// Cache the level that was just loaded from lumps.
+// Must be called before any things are spawned.
+//
+void P_SaveMapCache(doom_data_t *doom, char *mapname, int lumpnum)
+{
+    mapcacheheader_t header;
+    line_t **linebuffer;
+    byte *image;
+    byte *p;
+    int length;
+
+    d_memset(&header, 0, sizeof(header));
+    d_memcpy(header.magic, MAPCACHE_MAGIC, sizeof(header.magic));
+    header.version = MAPCACHE_VERSION;
+    MapCacheStructSizes(header.structsizes);
+    d_memcpy(header.wadsum, MapCacheWadSum(doom), sizeof(sha1_digest_t));
+    d_strncpy(header.mapname, mapname, sizeof(header.mapname));
+
+    header.numvertexes = numvertexes;
+    header.numsectors = numsectors;
+    header.numsides = numsides;
+    header.numlines = numlines;
+    header.numsubsectors = numsubsectors;
+    header.numnodes = numnodes;
+    header.numsegs = numsegs;
+    header.totallines = totallines;
+    header.blockmaplen = W_LumpLength(doom, lumpnum + ML_BLOCKMAP);
+    header.rejectlen = RejectLength(doom, lumpnum);
+
+    length = sizeof(header) + PayloadLength(&header);
+    image = Z_Malloc(length, PU_STATIC, NULL);
+
+    linebuffer = numsectors > 0 ? sectors[0].lines : NULL;
+    swizzle_ok = true;
+
+    p = image + sizeof(header);
+    p = PutArray(doom, p, vertexes, sizeof(vertex_t), numvertexes, NULL);
+    p = PutArray(doom, p, sectors, sizeof(sector_t), numsectors,
+                 SwizzleSectorElem);
+    p = PutArray(doom, p, sides, sizeof(side_t), numsides, SwizzleSideElem);
+    p = PutArray(doom, p, lines, sizeof(line_t), numlines, SwizzleLineElem);
+    p = PutArray(doom, p, subsectors, sizeof(subsector_t), numsubsectors,
+                 SwizzleSubsectorElem);
+    p = PutArray(doom, p, nodes, sizeof(node_t), numnodes, NULL);
+    p = PutArray(doom, p, segs, sizeof(seg_t), numsegs, SwizzleSegElem);
+    p = PutArray(doom, p, linebuffer, sizeof(line_t *), totallines,
+                 SwizzleLineBufferElem);
+    p = PutArray(doom, p, blockmaplump, 1, header.blockmaplen, NULL);
+    PutArray(doom, p, rejectmatrix, 1, header.rejectlen, NULL);
+
+    if (!swizzle_ok)
+    {
+        d_printf("P_SaveMapCache: %s has unrelocatable data, "
+                 "not cached\n", mapname);
+        Z_Free(image);
+        return;
+    }
+
+    header.payloadsum = M_HashBytes(M_HASH_INIT, image + sizeof(header),
+                                    length - sizeof(header));
+    d_memcpy(image, &header, sizeof(header));
+
+    WriteCacheFile(doom, mapname, image, length);
+    KeepImage(mapname, image, length);
+}
+
+//
+// Loading
+//
+
+#define NUMMAPCACHEARRAYS 10
+
+static boolean relocate_ok;
+static void *loadedarrays[NUMMAPCACHEARRAYS];
+static int numloadedarrays;
+
+static void *GetArray(const byte **src, size_t size, int count)
+{
+    void *array;
+
+    array = Z_Malloc(size * count + 1, PU_LEVEL, NULL);
+    loadedarrays[numloadedarrays++] = array;
+
+    d_memcpy(array, *src, size * count);
+    *src += size * count;
+
+    return array;
+}
+
+// Inverse of Swizzle.  The image has passed its checksum, but the
+// indices are still range checked so that a cache produced by a
+// different build cannot send pointers outside the level arrays.
+
+static void *Relocate(void *index, void *base, size_t size, int count)
+{
+    intptr_t i = (intptr_t) index;
+
+    if (i == 0)
+    {
+        return NULL;
+    }
+
+    if (i < 1 || i > count)
+    {
+        relocate_ok = false;
+        return NULL;
+    }
+
+    return (byte *) base + (i - 1) * size;
+}
+
+// Throw away a partially loaded cache.
+
+static void FreeLoadedArrays(void)
+{
+    int i;
+
+    for (i = 0; i < numloadedarrays; ++i)
+    {
+        Z_Free(loadedarrays[i]);
+    }
+
+    numloadedarrays = 0;
+}
+
+static sector_t *RelocateSector(doom_data_t *doom, void *index)
+{
+    if ((intptr_t) index == NULLSECTOR_INDEX)
+    {
+        return GetSectorAtNullAddress(doom);
+    }
+
+    return Relocate(index, sectors, sizeof(sector_t), numsectors);
+}
+
+#define RELOCATE(ptr, array, count) Relocate(ptr, array, sizeof(*(array)), count)
+
+static boolean ValidHeader(doom_data_t *doom, mapcacheheader_t *header,
+                           char *mapname, int lumpnum)
+{
+    int sizes[NUMMAPCACHESIZES];
+
+    MapCacheStructSizes(sizes);
+
+    return MemEqual(header->magic, MAPCACHE_MAGIC, sizeof(header->magic))
+        && header->version == MAPCACHE_VERSION
+        && MemEqual(header->structsizes, sizes, sizeof(sizes))
+        && MemEqual(header->wadsum, MapCacheWadSum(doom),
+                    sizeof(sha1_digest_t))
+        && d_strnicmp(header->mapname, mapname,
+                      sizeof(header->mapname)) == 0
+        && header->numvertexes >= 0 && header->numsectors >= 0
+        && header->numsides >= 0 && header->numlines >= 0
+        && header->numsubsectors >= 0 && header->numnodes >= 0
+        && header->numsegs >= 0 && header->totallines >= 0
+        && header->blockmaplen == W_LumpLength(doom, lumpnum + ML_BLOCKMAP)
+        && header->blockmaplen >= 8;
+}
+
+// Restore the level from an image, saved this session or read from
+// a file.  Returns false, with nothing changed that the lump path
+// would not replace, if the image does not fit this map or build.
+
+static boolean LoadImage(doom_data_t *doom, const byte *image, int length,
+                         char *mapname, int lumpnum)
+{
+    mapcacheheader_t header;
+    line_t **linebuffer;
+    const byte *p;
+    int i;
+
+    if (length < (int) sizeof(header))
+    {
+        return false;
+    }
+
+    d_memcpy(&header, image, sizeof(header));
+
+    if (!ValidHeader(doom, &header, mapname, lumpnum)
+     || length != (int) sizeof(header) + PayloadLength(&header)
+     || M_HashBytes(M_HASH_INIT, image + sizeof(header),
+                    length - sizeof(header)) != header.payloadsum)
+    {
+        d_printf("P_LoadMapCache: cache for %s is corrupt, ignoring\n",
+                 mapname);
+        return false;
+    }
+
+    relocate_ok = true;
+    numloadedarrays = 0;
+
+    numvertexes = header.numvertexes;
+    numsectors = header.numsectors;
+    numsides = header.numsides;
+    numlines = header.numlines;
+    numsubsectors = header.numsubsectors;
+    numnodes = header.numnodes;
+    numsegs = header.numsegs;
+    totallines = header.totallines;
+
+    p = image + sizeof(header);
+    vertexes = GetArray(&p, sizeof(vertex_t), numvertexes);
+    sectors = GetArray(&p, sizeof(sector_t), numsectors);
+    sides = GetArray(&p, sizeof(side_t), numsides);
+    lines = GetArray(&p, sizeof(line_t), numlines);
+    subsectors = GetArray(&p, sizeof(subsector_t), numsubsectors);
+    nodes = GetArray(&p, sizeof(node_t), numnodes);
+    segs = GetArray(&p, sizeof(seg_t), numsegs);
+    linebuffer = GetArray(&p, sizeof(line_t *), totallines);
+    blockmaplump = GetArray(&p, 1, header.blockmaplen);
+    rejectmatrix = GetArray(&p, 1, header.rejectlen);
+
+    // Turn indices back into pointers.
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        sectors[i].lines = RELOCATE(sectors[i].lines, linebuffer,
+                                    totallines + 1);
+    }
+
+    for (i = 0; i < numsides; ++i)
+    {
+        sides[i].sector = RelocateSector(doom, sides[i].sector);
+    }
+
+    for (i = 0; i < numlines; ++i)
+    {
+        line_t *li = &lines[i];
+
+        li->v1 = RELOCATE(li->v1, vertexes, numvertexes);
+        li->v2 = RELOCATE(li->v2, vertexes, numvertexes);
+        li->frontsector = RelocateSector(doom, li->frontsector);
+        li->backsector = RelocateSector(doom, li->backsector);
+    }
+
+    for (i = 0; i < numsubsectors; ++i)
+    {
+        subsectors[i].sector = RelocateSector(doom, subsectors[i].sector);
+    }
+
+    for (i = 0; i < numsegs; ++i)
+    {
+        seg_t *seg = &segs[i];
+
+        seg->v1 = RELOCATE(seg->v1, vertexes, numvertexes);
+        seg->v2 = RELOCATE(seg->v2, vertexes, numvertexes);
+        seg->sidedef = RELOCATE(seg->sidedef, sides, numsides);
+        seg->linedef = RELOCATE(seg->linedef, lines, numlines);
+        seg->frontsector = RelocateSector(doom, seg->frontsector);
+        seg->backsector = RelocateSector(doom, seg->backsector);
+    }
+
+    for (i = 0; i < totallines; ++i)
+    {
+        linebuffer[i] = RELOCATE(linebuffer[i], lines, numlines);
+    }
+
+
+    if (!relocate_ok)
+    {
+        d_printf("P_LoadMapCache: cache for %s is invalid, ignoring\n",
+                 mapname);
+        FreeLoadedArrays();
+        return false;
+    }
+
+    numloadedarrays = 0;
+    P_SetupBlockMap();
+
+    return true;
+}
+
+// Read a cache file whole.  Returns NULL if there is none, or it
+// is not a cache of this map from these WADs.
+
+static byte *ReadCacheFile(doom_data_t *doom, char *mapname, int lumpnum,
+                           int *length)
+{
+    mapcacheheader_t header;
+    char *filename;
+    FILE *file;
+    byte *image;
+
+    filename = MapCacheFileName(doom, mapname);
+    file = d_fopen(filename, "rb");
+    Z_Free(filename);
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    if (d_fread(&header, sizeof(header), 1, file) != 1
+     || !ValidHeader(doom, &header, mapname, lumpnum))
+    {
+        d_fclose(file);
+        return NULL;
+    }
+
+    *length = sizeof(header) + PayloadLength(&header);
+    image = Z_Malloc(*length, PU_STATIC, NULL);
+    d_memcpy(image, &header, sizeof(header));
+
+    if (d_fread(image + sizeof(header), *length - sizeof(header), 1, file) != 1)
+    {
+        Z_Free(image);
+        image = NULL;
+    }
+
+    d_fclose(file);
+
+    return image;
+}
+
+//
+// P_LoadMapCache
+// Restore the geometry of the given map from the cache.  Returns
+// false if there is no valid cache, in which case the level must
+// be loaded from its lumps as usual.
+//
+boolean P_LoadMapCache(doom_data_t *doom, char *mapname, int lumpnum)
+{
+    cachedmap_t *cached;
+    byte *image;
+    int length;
+    boolean result;
+
+    cached = FindCachedMap(mapname);
+
+    if (cached != NULL)
+    {
+        // Allocating the level arrays could purge the image while
+        // it is being read, so hold it until they are done.
+
+        image = cached->image;
+        Z_ChangeTag(image, PU_STATIC);
+        result = LoadImage(doom, image, cached->length, mapname, lumpnum);
+
+        if (result)
+        {
+            Z_ChangeTag(image, PU_CACHE);
+            return true;
+        }
+
+        Z_Free(image);
+    }
+
+    image = ReadCacheFile(doom, mapname, lumpnum, &length);
+
+    if (image == NULL)
+    {
+        return false;
+    }
+
+    result = LoadImage(doom, image, length, mapname, lumpnum);
+
+    if (result)
+    {
+        KeepImage(mapname, image, length);
+    }
+    else
+    {
+        Z_Free(image);
+    }
+
+    return result;
+}
@@ -482,8 +482,7 @@ P_SpawnMobj(struct doom_data_t_ *doom,
     state_t *st;
     mobjinfo_t *info;
 
-    mobj = Z_Malloc(sizeof(*mobj), PU_LEVEL, NULL);
-    d_memset(mobj, 0, sizeof(*mobj));
+    mobj = P_AllocateThinker(tp_mobj);
     info = &mobjinfo[type];
 
     mobj->type = type;
@@ -152,7 +152,7 @@ int EV_DoPlat(doom_data_t *doom,
 
 		// Find lowest & highest floors around sector
 		rtn = 1;
-		plat = Z_Malloc(sizeof(*plat), PU_LEVSPEC, 0);
+		plat = P_AllocateThinker(tp_plat);
 		P_AddThinker(&plat->thinker);
 
 		plat->type = type;
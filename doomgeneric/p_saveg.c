@@ -1615,7 +1615,7 @@ void P_UnArchiveThinkers(struct doom_data_t_* doom)
         if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
             P_RemoveMobj((mobj_t *)currentthinker);
         else
-            Z_Free(currentthinker);
+            P_FreeThinker(currentthinker);
 
         currentthinker = next;
     }
@@ -1632,7 +1632,7 @@ void P_UnArchiveThinkers(struct doom_data_t_* doom)
 
         case tc_mobj:
             saveg_read_pad();
-            mobj = Z_Malloc(sizeof(*mobj), PU_LEVEL, NULL);
+            mobj = P_AllocateThinker(tp_mobj);
             saveg_read_mobj_t(doom, mobj);
 
             mobj->target = NULL;
@@ -1788,7 +1788,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_ceiling:
             saveg_read_pad();
-            ceiling = Z_Malloc(sizeof(*ceiling), PU_LEVEL, NULL);
+            ceiling = P_AllocateThinker(tp_ceiling);
             saveg_read_ceiling_t(ceiling);
             ceiling->sector->specialdata = ceiling;
 
@@ -1801,7 +1801,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_door:
             saveg_read_pad();
-            door = Z_Malloc(sizeof(*door), PU_LEVEL, NULL);
+            door = P_AllocateThinker(tp_door);
             saveg_read_vldoor_t(door);
             door->sector->specialdata = door;
             door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
@@ -1810,7 +1810,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_floor:
             saveg_read_pad();
-            floor = Z_Malloc(sizeof(*floor), PU_LEVEL, NULL);
+            floor = P_AllocateThinker(tp_floor);
             saveg_read_floormove_t(floor);
             floor->sector->specialdata = floor;
             floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1819,7 +1819,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_plat:
             saveg_read_pad();
-            plat = Z_Malloc(sizeof(*plat), PU_LEVEL, NULL);
+            plat = P_AllocateThinker(tp_plat);
             saveg_read_plat_t(plat);
             plat->sector->specialdata = plat;
 
@@ -1832,7 +1832,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_flash:
             saveg_read_pad();
-            flash = Z_Malloc(sizeof(*flash), PU_LEVEL, NULL);
+            flash = P_AllocateThinker(tp_lightflash);
             saveg_read_lightflash_t(flash);
             flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
             P_AddThinker(&flash->thinker);
@@ -1840,7 +1840,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_strobe:
             saveg_read_pad();
-            strobe = Z_Malloc(sizeof(*strobe), PU_LEVEL, NULL);
+            strobe = P_AllocateThinker(tp_strobe);
             saveg_read_strobe_t(strobe);
             strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
             P_AddThinker(&strobe->thinker);
@@ -1848,7 +1848,7 @@ void P_UnArchiveSpecials(void)
 
         case tc_glow:
             saveg_read_pad();
-            glow = Z_Malloc(sizeof(*glow), PU_LEVEL, NULL);
+            glow = P_AllocateThinker(tp_glow);
             saveg_read_glow_t(glow);
             glow->thinker.function.acp1 = (actionf_p1)T_Glow;
             P_AddThinker(&glow->thinker);
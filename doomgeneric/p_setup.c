@@ -29,6 +29,7 @@
 #include "g_game.h"
 
 #include "i_system.h"
+#include "i_timer.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -65,7 +66,7 @@ line_t *lines;
 int numsides;
 side_t *sides;
 
-static int totallines;
+int totallines;
 
 // BLOCKMAP
 // Created from axis aligned bounding box
@@ -494,7 +495,6 @@ void P_LoadBlockMap(struct doom_data_t_* doom, int lump)
 
     blockmaplump = Z_Malloc(lumplen, PU_LEVEL, NULL);
     W_ReadLump(doom, lump, blockmaplump);
-    blockmap = blockmaplump + 4;
 
     // Swap all short integers to native byte ordering.
 
@@ -503,6 +503,20 @@ void P_LoadBlockMap(struct doom_data_t_* doom, int lump)
         blockmaplump[i] = SHORT(blockmaplump[i]);
     }
 
+    P_SetupBlockMap();
+}
+
+//
+// P_SetupBlockMap
+// Reads the header of the byte swapped blockmap lump
+// and allocates the mobj chains.
+//
+void P_SetupBlockMap(void)
+{
+    int count;
+
+    blockmap = blockmaplump + 4;
+
     // Read the header
 
     bmaporgx = blockmaplump[0] << FRACBITS;
@@ -716,6 +730,29 @@ static void P_LoadReject(struct doom_data_t_* doom, int lumpnum)
     }
 }
 
+//
+// P_MapLumpName
+// Fills in the (at most 8 character) lump name of a map.
+//
+void P_MapLumpName(doom_data_t *doom, int episode, int map, char *lumpname)
+{
+    if (doom->gamemode == commercial)
+    {
+        if (map < 10)
+            d_snprintf(lumpname, 9, "map0%i", map);
+        else
+            d_snprintf(lumpname, 9, "map%i", map);
+    }
+    else
+    {
+        lumpname[0] = 'E';
+        lumpname[1] = '0' + episode;
+        lumpname[2] = 'M';
+        lumpname[3] = '0' + map;
+        lumpname[4] = 0;
+    }
+}
+
 //
 // P_SetupLevel
 //
@@ -728,6 +765,8 @@ void P_SetupLevel(doom_data_t *doom,
     int i;
     char lumpname[9];
     int lumpnum;
+    boolean mapcache;
+    uint64_t loadstart;
 
     doom->totalkills = doom->totalitems = doom->totalsecret = doom->wminfo.maxfrags = 0;
     doom->wminfo.partime = 180;
@@ -746,42 +785,49 @@ void P_SetupLevel(doom_data_t *doom,
     Z_FreeTags(PU_LEVEL, PU_PURGELEVEL - 1);
 
     // UNUSED W_Profile ();
+    P_InitThinkerPools(doom);
     P_InitThinkers();
 
     // find map name
-    if (doom->gamemode == commercial)
+    P_MapLumpName(doom, episode, map, lumpname);
+
+    lumpnum = W_GetNumForName(doom, lumpname);
+
+    leveltime = 0;
+
+    mapcache = M_CheckParm(doom, "-mapcache") > 0;
+    loadstart = I_GetTimeUS();
+
+    if (mapcache && P_LoadMapCache(doom, lumpname, lumpnum))
     {
-        if (map < 10)
-            d_snprintf(lumpname, 9, "map0%i", map);
-        else
-            d_snprintf(lumpname, 9, "map%i", map);
+        d_printf("P_SetupLevel: %s geometry from cache in %i us\n",
+                 lumpname, (int) (I_GetTimeUS() - loadstart));
     }
     else
     {
-        lumpname[0] = 'E';
-        lumpname[1] = '0' + episode;
-        lumpname[2] = 'M';
-        lumpname[3] = '0' + map;
-        lumpname[4] = 0;
-    }
+        // note: most of this ordering is important
+        P_LoadBlockMap(doom, lumpnum + ML_BLOCKMAP);
+        P_LoadVertexes(doom, lumpnum + ML_VERTEXES);
+        P_LoadSectors(doom, lumpnum + ML_SECTORS);
+        P_LoadSideDefs(doom, lumpnum + ML_SIDEDEFS);
 
-    lumpnum = W_GetNumForName(doom, lumpname);
-
-    leveltime = 0;
+        P_LoadLineDefs(doom, lumpnum + ML_LINEDEFS);
+        P_LoadSubsectors(doom, lumpnum + ML_SSECTORS);
+        P_LoadNodes(doom, lumpnum + ML_NODES);
+        P_LoadSegs(doom, lumpnum + ML_SEGS);
 
-    // note: most of this ordering is important
-    P_LoadBlockMap(doom, lumpnum + ML_BLOCKMAP);
-    P_LoadVertexes(doom, lumpnum + ML_VERTEXES);
-    P_LoadSectors(doom, lumpnum + ML_SECTORS);
-    P_LoadSideDefs(doom, lumpnum + ML_SIDEDEFS);
+        P_GroupLines();
+        P_LoadReject(doom, lumpnum + ML_REJECT);
 
-    P_LoadLineDefs(doom, lumpnum + ML_LINEDEFS);
-    P_LoadSubsectors(doom, lumpnum + ML_SSECTORS);
-    P_LoadNodes(doom, lumpnum + ML_NODES);
-    P_LoadSegs(doom, lumpnum + ML_SEGS);
+        if (mapcache)
+        {
+            d_printf("P_SetupLevel: %s geometry from lumps in %i us\n",
+                     lumpname, (int) (I_GetTimeUS() - loadstart));
+            P_SaveMapCache(doom, lumpname, lumpnum);
+        }
+    }
 
-    P_GroupLines();
-    P_LoadReject(doom, lumpnum + ML_REJECT);
+    P_InvalidateSightCache();
 
     doom->bodyqueslot = 0;
     deathmatch_p = deathmatchstarts;
@@ -821,5 +867,6 @@ void P_Init(doom_data_t *doom)
 {
     P_InitSwitchList(doom);
     P_InitPicAnims(doom);
+    P_InitSightCache(doom);
     R_InitSprites(doom, sprnames);
 }
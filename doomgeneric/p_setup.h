@@ -34,6 +34,9 @@ P_SetupLevel
 
 struct doom_data_t_;
 
+// Lump name of the given map, lumpname must hold 9 characters.
+void P_MapLumpName(struct doom_data_t_* doom, int episode, int map, char *lumpname);
+
 // Called by startup code.
 void P_Init (struct doom_data_t_* doom);
 
@@ -17,9 +17,11 @@
 //
 
 #include <stddef.h>
+#include "dlibc.h"
 #include "doomdef.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "p_local.h"
 
 // State.
@@ -36,7 +38,46 @@ divline_t strace; // from t1 to t2
 fixed_t t2x;
 fixed_t t2y;
 
-int sightcounts[2];
+// [SIGHT_REJECT]     rejected by the REJECT lump
+// [SIGHT_TRAVERSE]   full BSP traversal
+// [SIGHT_CACHED]     answered from the per-tic cache
+int sightcounts[NUMSIGHTCOUNTS];
+
+//
+// Per-tic sight cache.
+// The result of P_CheckSight only depends on the two positions
+// and on sector heights, so repeated checks between the same
+// pair are answered from a small direct-mapped table.  Entries
+// are tagged with sightepoch, which is bumped at the start of
+// every tic.  Each entry also keeps a bit per sector whose
+// heights the traversal looked at (sector number modulo 64), so
+// a moving sector only drops the entries that may depend on it.
+// -nosightcache traverses every time.
+//
+#define SIGHTCACHESIZE 1024
+
+typedef struct
+{
+    unsigned int epoch;
+    mobj_t *t1, *t2;
+    subsector_t *ss1, *ss2;
+    fixed_t x1, y1, z1, h1;
+    fixed_t x2, y2, z2, h2;
+    uint64_t sectors;
+    boolean result;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHESIZE];
+static unsigned int sightepoch = 1;
+static boolean nosightcache;
+
+// Sectors looked at by the traversal in progress.
+static uint64_t sightsectors;
+
+static uint64_t SightSectorBit(sector_t *sector)
+{
+    return (uint64_t)1 << ((sector - sectors) & 63);
+}
 
 //
 // P_DivlineSide
@@ -196,6 +237,7 @@ boolean P_CrossSubsector(int num)
         // crosses a two sided line
         front = seg->frontsector;
         back = seg->backsector;
+        sightsectors |= SightSectorBit(front) | SightSectorBit(back);
 
         // no wall to block sight with?
         if (front->floorheight == back->floorheight && front->ceilingheight == back->ceilingheight)
@@ -282,14 +324,72 @@ boolean P_CrossBSPNode(int bspnum)
 }
 
 //
-// P_CheckSight
-// Returns true
-//  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_InvalidateSightCache
+// Called at the start of each tic and when a
+// level is loaded.
 //
-boolean
-P_CheckSight(mobj_t *t1,
-             mobj_t *t2)
+void P_InvalidateSightCache(void)
+{
+    ++sightepoch;
+
+    // On wraparound, make sure no stale entry
+    // can match the new epoch.
+    if (sightepoch == 0)
+    {
+        d_memset(sightcache, 0, sizeof(sightcache));
+        sightepoch = 1;
+    }
+}
+
+//
+// P_InvalidateSightSector
+// Called whenever a sector's floor or ceiling moves.  Drops the
+// entries whose traversal looked at the sector, or at another
+// one sharing its bit.
+//
+void P_InvalidateSightSector(sector_t *sector)
+{
+    uint64_t bit;
+    int i;
+
+    bit = SightSectorBit(sector);
+
+    for (i = 0; i < SIGHTCACHESIZE; i++)
+    {
+        if (sightcache[i].epoch == sightepoch && (sightcache[i].sectors & bit))
+            sightcache[i].epoch = 0;
+    }
+}
+
+//
+// P_InitSightCache
+//
+void P_InitSightCache(doom_data_t *doom)
+{
+    //!
+    // @category obscure
+    //
+    // Answer every sight check with a full traversal, without the
+    // per-tic sight cache.
+    //
+
+    nosightcache = M_CheckParm(doom, "-nosightcache") > 0;
+}
+
+//
+// P_PrintSightStats
+//
+void P_PrintSightStats(void)
+{
+    d_printf("sight checks: %i reject, %i traversed, %i cached\n",
+             sightcounts[SIGHT_REJECT], sightcounts[SIGHT_TRAVERSE],
+             sightcounts[SIGHT_CACHED]);
+}
+
+//
+// P_CheckSightUncached
+//
+static boolean P_CheckSightUncached(mobj_t *t1, mobj_t *t2)
 {
     int s1;
     int s2;
@@ -297,6 +397,8 @@ P_CheckSight(mobj_t *t1,
     int bytenum;
     int bitnum;
 
+    sightsectors = 0;
+
     // First check for trivial rejection.
 
     // Determine subsector entries in REJECT table.
@@ -309,7 +411,7 @@ P_CheckSight(mobj_t *t1,
     // Check in REJECT table.
     if (rejectmatrix[bytenum] & bitnum)
     {
-        sightcounts[0]++;
+        sightcounts[SIGHT_REJECT]++;
 
         // can't possibly be connected
         return false;
@@ -317,7 +419,7 @@ P_CheckSight(mobj_t *t1,
 
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    sightcounts[SIGHT_TRAVERSE]++;
 
     validcount++;
 
@@ -335,3 +437,55 @@ P_CheckSight(mobj_t *t1,
     // the head node is the last node output
     return P_CrossBSPNode(numnodes - 1);
 }
+
+//
+// P_CheckSight
+// Returns true
+//  if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+boolean
+P_CheckSight(mobj_t *t1,
+             mobj_t *t2)
+{
+    sightcache_t *entry;
+    uintptr_t hash;
+
+    if (nosightcache)
+        return P_CheckSightUncached(t1, t2);
+
+    hash = (uintptr_t)t1 ^ ((uintptr_t)t2 * 31)
+         ^ (unsigned int)(t1->x ^ t1->y ^ t2->x ^ t2->y);
+    hash ^= hash >> 16;
+    entry = &sightcache[(hash ^ (hash >> 8)) & (SIGHTCACHESIZE - 1)];
+
+    if (entry->epoch == sightepoch
+     && entry->t1 == t1 && entry->t2 == t2
+     && entry->ss1 == t1->subsector && entry->ss2 == t2->subsector
+     && entry->x1 == t1->x && entry->y1 == t1->y
+     && entry->z1 == t1->z && entry->h1 == t1->height
+     && entry->x2 == t2->x && entry->y2 == t2->y
+     && entry->z2 == t2->z && entry->h2 == t2->height)
+    {
+        sightcounts[SIGHT_CACHED]++;
+        return entry->result;
+    }
+
+    entry->epoch = sightepoch;
+    entry->t1 = t1;
+    entry->t2 = t2;
+    entry->ss1 = t1->subsector;
+    entry->ss2 = t2->subsector;
+    entry->x1 = t1->x;
+    entry->y1 = t1->y;
+    entry->z1 = t1->z;
+    entry->h1 = t1->height;
+    entry->x2 = t2->x;
+    entry->y2 = t2->y;
+    entry->z2 = t2->z;
+    entry->h2 = t2->height;
+    entry->result = P_CheckSightUncached(t1, t2);
+    entry->sectors = sightsectors;
+
+    return entry->result;
+}
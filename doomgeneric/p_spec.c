@@ -1275,7 +1275,7 @@ int EV_DoDonut(doom_data_t *doom, line_t *line)
 			}
 
 			//	Spawn rising slime
-			floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+			floor = P_AllocateThinker(tp_floor);
 			P_AddThinker(&floor->thinker);
 			s2->specialdata = floor;
 			floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -1289,7 +1289,7 @@ int EV_DoDonut(doom_data_t *doom, line_t *line)
 			floor->floordestheight = s3_floorheight;
 
 			//	Spawn lowering donut-hole
-			floor = Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+			floor = P_AllocateThinker(tp_floor);
 			P_AddThinker(&floor->thinker);
 			s1->specialdata = floor;
 			floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -0,0 +1,437 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-tic game state hashes, kept with demos to find where
+//	playback went out of sync.
+//
+
+#include "dlibc.h"
+
+#include "doomstat.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "p_local.h"
+#include "sha1.h"
+#include "w_checksum.h"
+#include "z_zone.h"
+
+#include "p_sync.h"
+
+#define SYNC_HEADERSIZE 12
+#define SYNC_RECORDSIZE 12
+
+// With SYNC_OBJECTS, the most object hashes kept for one tic.  The
+// rest are still in the tic's objects hash.
+#define SYNC_MAXOBJECTS 2048
+
+// Records are gathered here and written to the side file a chunk at
+// a time; one tic's record always fits.
+#define SYNC_CHUNK 32768
+
+// Recording: the header, and the tics so far in a side file next to
+// the demo, which G_CloseDemoStream copies in after the end marker.
+// Nothing is kept in the zone, however long the recording.
+
+static boolean syncrecording;
+static byte syncheader[SYNC_HEADERSIZE + sizeof(sha1_digest_t)];
+static char *syncfilename;
+static FILE *syncfile;
+static boolean syncfailed;
+static byte syncchunk[SYNC_CHUNK];
+static int chunklength;
+static int readpos;
+
+// Checking: the block from the demo, and where the next tic is.
+
+static boolean syncchecking;
+static const byte *checkblock;
+static int checklength;
+static int checkpos;
+static boolean desynced;
+
+static unsigned int syncflags;
+static int synctics;
+static uint64_t synctime;
+
+// The first SYNC_MAXOBJECTS objects' hashes for this tic, with
+// SYNC_OBJECTS.
+
+static unsigned int mobjhashes[SYNC_MAXOBJECTS];
+
+static void PutLong(byte *dest, unsigned int value)
+{
+    dest[0] = value;
+    dest[1] = value >> 8;
+    dest[2] = value >> 16;
+    dest[3] = value >> 24;
+}
+
+static unsigned int GetLong(const byte *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((unsigned int) src[3] << 24);
+}
+
+// The nth map object in thinker order.
+
+static mobj_t *NthMobj(int n)
+{
+    thinker_t *th;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        if (th->function.acp1 == (actionf_p1)P_MobjThinker && n-- == 0)
+            return (mobj_t *)th;
+    }
+
+    return NULL;
+}
+
+// Hashes the tic, with the objects' own hashes if the block keeps
+// them.
+
+static void HashTic(doom_data_t *doom, gamestatehash_t *hash)
+{
+    if (!(syncflags & SYNC_OBJECTS))
+    {
+        P_HashGameState(doom, hash, NULL, 0);
+        return;
+    }
+
+    P_HashGameState(doom, hash, mobjhashes, SYNC_MAXOBJECTS);
+}
+
+// How many object hashes a tic with count objects keeps.
+
+static int KeptObjects(unsigned int count)
+{
+    return count < SYNC_MAXOBJECTS ? count : SYNC_MAXOBJECTS;
+}
+
+static void Reset(void)
+{
+    P_StopSync();
+
+    syncflags = 0;
+    synctics = 0;
+    synctime = 0;
+    desynced = false;
+}
+
+//
+// P_StartSyncRecord
+//
+void P_StartSyncRecord(doom_data_t *doom)
+{
+    Reset();
+
+    syncfilename = M_StringJoin(doom->demoname, ".sync", NULL);
+    syncfile = d_fopen(syncfilename, "w+b");
+
+    if (syncfile == NULL)
+    {
+        d_printf("P_StartSyncRecord: couldn't open %s, no sync block\n", syncfilename);
+        Z_Free(syncfilename);
+        syncfilename = NULL;
+        return;
+    }
+
+    //!
+    // @category demo
+    //
+    // Keep the map objects' own hashes (up to 2048 per tic) in the
+    // recorded demo's sync block, so playback can say which object
+    // went out of sync first.  Makes the block a lot bigger.
+    //
+
+    if (M_CheckParm(doom, "-syncobjects"))
+        syncflags |= SYNC_OBJECTS;
+
+    syncflags |= SYNC_WADSUM;
+    W_ChecksumContents(doom, syncheader + SYNC_HEADERSIZE);
+    syncfailed = false;
+    chunklength = 0;
+    readpos = 0;
+    syncrecording = true;
+}
+
+//
+// P_StartSyncCheck
+//
+void P_StartSyncCheck(doom_data_t *doom, const byte *block, int length)
+{
+    sha1_digest_t wadsum;
+
+    Reset();
+
+    if (length < SYNC_HEADERSIZE || d_strncmp((const char *)block, "DSYN", 4) != 0)
+        return;
+
+    syncflags = GetLong(block + 4);
+    checkpos = SYNC_HEADERSIZE;
+
+    if (syncflags & SYNC_WADSUM)
+    {
+        checkpos += sizeof(sha1_digest_t);
+
+        if (length < checkpos)
+            return;
+
+        W_ChecksumContents(doom, wadsum);
+
+        // Likely to go out of sync, but the report will say why.
+        if (d_memcmp(wadsum, block + SYNC_HEADERSIZE, sizeof(wadsum)) != 0)
+            d_printf("P_StartSyncCheck: demo was recorded with different WADs\n");
+    }
+
+    checkblock = block;
+    checklength = length;
+    syncchecking = true;
+}
+
+static void FlushRecords(void)
+{
+    if (chunklength > 0 && d_fwrite(syncchunk, 1, chunklength, syncfile) < chunklength)
+        syncfailed = true;
+
+    chunklength = 0;
+}
+
+static void RecordTic(doom_data_t *doom)
+{
+    gamestatehash_t hash;
+    int need, kept, i;
+
+    HashTic(doom, &hash);
+
+    need = SYNC_RECORDSIZE;
+    kept = 0;
+
+    if (syncflags & SYNC_OBJECTS)
+    {
+        kept = KeptObjects(hash.nummobjs);
+        need += 4 + kept * 4;
+    }
+
+    if (chunklength + need > SYNC_CHUNK)
+        FlushRecords();
+
+    PutLong(syncchunk + chunklength, hash.misc);
+    PutLong(syncchunk + chunklength + 4, hash.sectors);
+    PutLong(syncchunk + chunklength + 8, hash.mobjs);
+    chunklength += SYNC_RECORDSIZE;
+
+    if (syncflags & SYNC_OBJECTS)
+    {
+        PutLong(syncchunk + chunklength, hash.nummobjs);
+        chunklength += 4;
+
+        for (i = 0; i < kept; i++)
+        {
+            PutLong(syncchunk + chunklength, mobjhashes[i]);
+            chunklength += 4;
+        }
+    }
+
+    synctics++;
+}
+
+static void ReportDesync(doom_data_t *doom, gamestatehash_t *hash,
+                         const byte *record)
+{
+    const byte *objects;
+    mobj_t *mo;
+    int recorded, kept, i;
+
+    d_printf("P_SyncTic: out of sync at demo tic %d (gametic %d, leveltime %d):%s%s%s\n",
+             synctics, doom->gametic, leveltime,
+             hash->misc != GetLong(record) ? " players/game state" : "",
+             hash->sectors != GetLong(record + 4) ? " sectors" : "",
+             hash->mobjs != GetLong(record + 8) ? " objects" : "");
+
+    if (hash->mobjs == GetLong(record + 8))
+        return;
+
+    if (!(syncflags & SYNC_OBJECTS))
+    {
+        d_printf("P_SyncTic: record the demo with -syncobjects to find the object\n");
+        return;
+    }
+
+    // The first object whose hash differs, or the first one past
+    // the end of the shorter list.
+
+    objects = record + SYNC_RECORDSIZE;
+    recorded = GetLong(objects);
+    kept = KeptObjects(recorded);
+
+    for (i = 0; i < hash->nummobjs && i < kept; i++)
+    {
+        if (mobjhashes[i] != GetLong(objects + 4 + i * 4))
+            break;
+    }
+
+    if (recorded != hash->nummobjs)
+    {
+        d_printf("P_SyncTic: %d objects, the recording had %d\n",
+                 hash->nummobjs, recorded);
+    }
+
+    if (i == SYNC_MAXOBJECTS)
+    {
+        d_printf("P_SyncTic: the first %d objects match, and no more are kept\n", i);
+        return;
+    }
+
+    mo = NthMobj(i);
+
+    if (mo != NULL)
+    {
+        d_printf("P_SyncTic: first differing object is #%d: type %d at (%d, %d, %d), state %d, health %d\n",
+                 i, mo->type, mo->x >> FRACBITS, mo->y >> FRACBITS,
+                 mo->z >> FRACBITS, (int)(mo->state - states), mo->health);
+    }
+}
+
+static void CheckTic(doom_data_t *doom)
+{
+    gamestatehash_t hash;
+    const byte *record;
+    int length;
+
+    if (checkpos + SYNC_RECORDSIZE > checklength)
+    {
+        // Playing on past the end of the block.
+        syncchecking = false;
+        return;
+    }
+
+    record = checkblock + checkpos;
+    length = SYNC_RECORDSIZE;
+
+    if (syncflags & SYNC_OBJECTS)
+    {
+        if (checkpos + length + 4 > checklength
+         || KeptObjects(GetLong(record + length)) > (checklength - checkpos - length - 4) / 4)
+        {
+            syncchecking = false;
+            return;
+        }
+
+        length += 4 + KeptObjects(GetLong(record + length)) * 4;
+    }
+
+    HashTic(doom, &hash);
+
+    if (hash.misc != GetLong(record)
+     || hash.sectors != GetLong(record + 4)
+     || hash.mobjs != GetLong(record + 8))
+    {
+        ReportDesync(doom, &hash, record);
+
+        // Everything after follows from this, so one report will do.
+        desynced = true;
+        syncchecking = false;
+    }
+
+    checkpos += length;
+    synctics++;
+}
+
+//
+// P_SyncTic
+//
+void P_SyncTic(doom_data_t *doom)
+{
+    uint64_t start;
+
+    if (!syncrecording && !syncchecking)
+        return;
+
+    start = I_GetTimeUS();
+
+    if (syncrecording)
+        RecordTic(doom);
+    else
+        CheckTic(doom);
+
+    synctime += I_GetTimeUS() - start;
+}
+
+//
+// P_ReadSyncBlock
+//
+int P_ReadSyncBlock(byte *buffer, int size)
+{
+    int length;
+
+    if (!syncrecording)
+        return 0;
+
+    if (readpos == 0)
+    {
+        FlushRecords();
+
+        if (syncfailed || d_fseek(syncfile, 0, SEEK_SET) != 0)
+            return -1;
+
+        d_memcpy(syncheader, "DSYN", 4);
+        PutLong(syncheader + 4, syncflags);
+        PutLong(syncheader + 8, synctics);
+    }
+
+    if (readpos < (int)sizeof(syncheader))
+    {
+        length = sizeof(syncheader) - readpos;
+
+        if (length > size)
+            length = size;
+
+        d_memcpy(buffer, syncheader + readpos, length);
+        readpos += length;
+
+        return length;
+    }
+
+    return d_fread(buffer, 1, size, syncfile);
+}
+
+//
+// P_StopSync
+//
+void P_StopSync(void)
+{
+    if (synctics > 0 && (syncrecording || checkblock != NULL))
+    {
+        d_printf("P_StopSync: %d tics %s%s, %d us/tic\n", synctics,
+                 syncrecording ? "hashed" : "checked",
+                 syncrecording || desynced ? "" : ", all in sync",
+                 (int)(synctime / synctics));
+    }
+
+    if (syncfile != NULL)
+    {
+        d_fclose(syncfile);
+        d_remove(syncfilename);
+        Z_Free(syncfilename);
+        syncfile = NULL;
+        syncfilename = NULL;
+    }
+
+    syncrecording = false;
+    syncchecking = false;
+    checkblock = NULL;
+    synctics = 0;
+}
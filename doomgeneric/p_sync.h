@@ -0,0 +1,67 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-tic game state hashes, kept with demos to find where
+//	playback went out of sync.
+//
+//	A recorded demo gets a sync block after its end marker, where
+//	vanilla and the compact format both ignore it:
+//
+//	  "DSYN", flags, tic count, with SYNC_WADSUM the 20 byte
+//	  W_ChecksumContents of the WADs, then per tic the hashes of
+//	  everything else (game state, random index, players), the
+//	  sectors and the map objects; with SYNC_OBJECTS, also the
+//	  number of objects and the hashes of the first 2048 of them in
+//	  thinker order
+//
+//	All little endian 32 bit.  Playing the demo back checks each
+//	tic against the block and reports the first that differs.
+//
+
+
+#ifndef __P_SYNC__
+#define __P_SYNC__
+
+#include "doomtype.h"
+
+struct doom_data_t_;
+
+// Block flags.
+#define SYNC_OBJECTS 1
+#define SYNC_WADSUM  2
+
+// Start keeping a hash of every tic for the demo being recorded, in
+// a side file next to it; -syncobjects keeps the objects' hashes as
+// well.
+void P_StartSyncRecord(struct doom_data_t_ *doom);
+
+// Check each tic against block, length bytes of a demo's sync
+// block.  The block must stay put until P_StopSync.
+void P_StartSyncCheck(struct doom_data_t_ *doom, const byte *block,
+                      int length);
+
+// Record or check the tic just run.  Called at the end of G_Ticker.
+void P_SyncTic(struct doom_data_t_ *doom);
+
+// Read back the sync block for the tics recorded so far, up to size
+// bytes a call.  Returns how many bytes were copied to buffer, 0 at
+// the end of the block (or if nothing was recorded) and -1 if the
+// side file could not be written or read.
+int P_ReadSyncBlock(byte *buffer, int size);
+
+// Stop recording or checking, and say how it went.
+void P_StopSync(void);
+
+#endif
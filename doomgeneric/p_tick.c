@@ -18,6 +18,11 @@
 //
 
 #include "z_zone.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_random.h"
 #include "p_local.h"
 
 #include "doomstat.h"
@@ -26,7 +31,7 @@ int leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
+// All thinkers should be allocated by P_AllocateThinker
 // so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
@@ -35,6 +40,194 @@ int leveltime;
 // Both the head and tail of the thinker list.
 thinker_t thinkercap;
 
+//
+// THINKER POOLS
+// Every thinker class gets its own pool of fixed-size slabs,
+// carved out of the zone with PU_LEVEL and released along with
+// the rest of the level.  Objects are handed out from the slab
+// in creation order, and freed objects go on a per-pool free
+// list to be recycled without touching the zone again.
+// The thinker list still defines the execution order.
+// -nothinkerpools gives every thinker its own zone block, as
+// vanilla does.
+//
+
+#define THINKERSLABSIZE 64
+
+typedef struct thinkerpool_s
+{
+    int size;
+
+    // Slab currently being carved, and objects left in it.
+    byte *slab;
+    int slabfree;
+
+    // Recycled objects, linked through thinker.next.
+    thinker_t *freelist;
+
+    // Statistics for P_PrintThinkerStats.
+    int numslabs;
+    int allocs;
+    int recycled;
+    int live;
+    int peak;
+} thinkerpool_t;
+
+static thinkerpool_t thinkerpools[NUMTHINKERPOOLS];
+static boolean nothinkerpools;
+
+static const int thinkerpoolsizes[NUMTHINKERPOOLS] =
+{
+    sizeof(mobj_t),
+    sizeof(ceiling_t),
+    sizeof(vldoor_t),
+    sizeof(floormove_t),
+    sizeof(plat_t),
+    sizeof(fireflicker_t),
+    sizeof(lightflash_t),
+    sizeof(strobe_t),
+    sizeof(glow_t),
+};
+
+static const char *thinkerpoolnames[NUMTHINKERPOOLS] =
+{
+    "mobj", "ceiling", "door", "floor", "plat",
+    "fireflicker", "lightflash", "strobe", "glow",
+};
+
+// Time spent in P_Ticker and P_RunThinkers, for -timedemo reports.
+static uint64_t tickertime;
+static uint64_t thinkertime;
+static int thinkertics;
+
+//
+// P_InitThinkerPools
+// Forget all slabs; called after the level zone
+// blocks they lived in have been freed.
+//
+void P_InitThinkerPools(doom_data_t *doom)
+{
+    int i;
+
+    //!
+    // @category obscure
+    //
+    // Allocate every thinker from the zone on its own instead of
+    // from the per-class pools.
+    //
+
+    nothinkerpools = M_CheckParm(doom, "-nothinkerpools") > 0;
+
+    for (i = 0; i < NUMTHINKERPOOLS; i++)
+    {
+        d_memset(&thinkerpools[i], 0, sizeof(thinkerpool_t));
+        thinkerpools[i].size = (thinkerpoolsizes[i] + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    }
+}
+
+//
+// P_AllocateThinker
+// Allocates a zeroed thinker of the given class.
+// The caller initialises it and adds it with P_AddThinker.
+//
+void *P_AllocateThinker(thinkerpool_e type)
+{
+    thinkerpool_t *pool;
+    thinker_t *thinker;
+
+    pool = &thinkerpools[type];
+
+    if (nothinkerpools)
+    {
+        thinker = Z_Malloc(pool->size, PU_LEVEL, NULL);
+    }
+    else if (pool->freelist != NULL)
+    {
+        thinker = pool->freelist;
+        pool->freelist = thinker->next;
+        pool->recycled++;
+    }
+    else
+    {
+        if (pool->slabfree == 0)
+        {
+            pool->slab = Z_Malloc(pool->size * THINKERSLABSIZE, PU_LEVEL, NULL);
+            pool->slabfree = THINKERSLABSIZE;
+            pool->numslabs++;
+        }
+
+        thinker = (thinker_t *)pool->slab;
+        pool->slab += pool->size;
+        pool->slabfree--;
+    }
+
+    // Cleared here, so callers cannot wipe the pool pointer by
+    // clearing the object themselves.
+    d_memset(thinker, 0, pool->size);
+    thinker->pool = pool;
+
+    pool->allocs++;
+    pool->live++;
+    if (pool->live > pool->peak)
+        pool->peak = pool->live;
+
+    return thinker;
+}
+
+//
+// P_FreeThinker
+// Returns a thinker to the pool it came from.
+//
+void P_FreeThinker(thinker_t *thinker)
+{
+    thinkerpool_t *pool;
+
+    pool = thinker->pool;
+
+    if (pool < thinkerpools || pool >= thinkerpools + NUMTHINKERPOOLS)
+        I_Error("P_FreeThinker: thinker not allocated from a pool");
+
+    pool->live--;
+
+    if (nothinkerpools)
+    {
+        Z_Free(thinker);
+        return;
+    }
+
+    thinker->next = pool->freelist;
+    pool->freelist = thinker;
+}
+
+//
+// P_PrintThinkerStats
+//
+void P_PrintThinkerStats(void)
+{
+    int i;
+
+    d_printf("thinker pools:\n");
+
+    for (i = 0; i < NUMTHINKERPOOLS; i++)
+    {
+        thinkerpool_t *pool = &thinkerpools[i];
+
+        if (pool->allocs == 0)
+            continue;
+
+        d_printf("  %-12s size %4i  slabs %4i  allocs %7i  recycled %7i  live %6i  peak %6i\n",
+                 thinkerpoolnames[i], pool->size, pool->numslabs,
+                 pool->allocs, pool->recycled, pool->live, pool->peak);
+    }
+
+    if (thinkertics > 0)
+    {
+        d_printf("  %i tics: P_Ticker %i us/tic, P_RunThinkers %i us/tic\n",
+                 thinkertics, (int)(tickertime / thinkertics),
+                 (int)(thinkertime / thinkertics));
+    }
+}
+
 //
 // P_InitThinkers
 //
@@ -66,40 +259,168 @@ void P_RemoveThinker(thinker_t *thinker)
     thinker->function.acv = (actionf_v)(-1);
 }
 
-//
-// P_AllocateThinker
-// Allocates memory and adds a new thinker at the end of the list.
-//
-void P_AllocateThinker(thinker_t *thinker)
-{
-}
 
 //
 // P_RunThinkers
 //
 void P_RunThinkers(doom_data_t *doom)
 {
-    thinker_t *currentthinker;
+    thinker_t *currentthinker, *nextthinker;
 
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
     {
         if (currentthinker->function.acv == (actionf_v)(-1))
         {
-            // time to remove it
+            // time to remove it; the pool reuses the
+            // next pointer, so fetch it first
+            nextthinker = currentthinker->next;
             currentthinker->next->prev = currentthinker->prev;
             currentthinker->prev->next = currentthinker->next;
-            Z_Free(currentthinker);
-        }
-        else
-        {
-            if (currentthinker->function.acp1)
-                currentthinker->function.acp1(doom, currentthinker);
+            P_FreeThinker(currentthinker);
+            currentthinker = nextthinker;
+            continue;
         }
+
+        if (currentthinker->function.acp1)
+            currentthinker->function.acp1(doom, currentthinker);
+
         currentthinker = currentthinker->next;
     }
 }
 
+//
+// P_HashGameState
+// Hashes of the parts of the play simulation that a desync would
+// change, kept apart so a mismatch says where to look: the play
+// random number generator and the players, the sector heights and
+// lights, and every map object.  M_Random is left out: wipes draw
+// from it, so it depends on which frames were drawn.
+//
+static unsigned int MobjHash(mobj_t *mo)
+{
+    int fields[16];
+
+    fields[0] = mo->type;
+    fields[1] = mo->x;
+    fields[2] = mo->y;
+    fields[3] = mo->z;
+    fields[4] = mo->momx;
+    fields[5] = mo->momy;
+    fields[6] = mo->momz;
+    fields[7] = mo->angle;
+    fields[8] = mo->state - states;
+    fields[9] = mo->tics;
+    fields[10] = mo->health;
+    fields[11] = mo->flags;
+    fields[12] = mo->movedir;
+    fields[13] = mo->movecount;
+    fields[14] = mo->reactiontime;
+    fields[15] = mo->threshold;
+
+    return M_HashWords(M_HASH_INIT, fields, arrlen(fields));
+}
+
+void P_HashGameState(doom_data_t *doom, gamestatehash_t *hash,
+                     unsigned int *mobjhashes, int maxmobjs)
+{
+    int fields[12 + NUMAMMO];
+    unsigned int h, mobjhash;
+    thinker_t *th;
+    player_t *player;
+    sector_t *sector;
+    int i, j, n;
+
+    fields[0] = doom->gamestate;
+    fields[1] = prndindex;
+    h = M_HashWords(M_HASH_INIT, fields, 2);
+
+    for (i = 0; i < MAXPLAYERS; i++)
+    {
+        if (!doom->playeringame[i])
+            continue;
+
+        player = &doom->players[i];
+        fields[0] = player->playerstate;
+        fields[1] = player->health;
+        fields[2] = player->armorpoints;
+        fields[3] = player->armortype;
+        fields[4] = player->viewz;
+        fields[5] = player->readyweapon;
+        fields[6] = player->pendingweapon;
+        fields[7] = player->killcount;
+        fields[8] = player->itemcount;
+        fields[9] = player->secretcount;
+        fields[10] = player->mo != NULL ? player->mo->x : 0;
+        fields[11] = player->mo != NULL ? player->mo->y : 0;
+
+        for (j = 0; j < NUMAMMO; j++)
+            fields[12 + j] = player->ammo[j];
+
+        h = M_HashWords(h, fields, arrlen(fields));
+    }
+
+    hash->misc = h;
+    hash->sectors = M_HASH_INIT;
+    hash->mobjs = M_HASH_INIT;
+    hash->nummobjs = 0;
+
+    if (doom->gamestate != GS_LEVEL)
+        return;
+
+    h = M_HASH_INIT;
+
+    for (i = 0, sector = sectors; i < numsectors; i++, sector++)
+    {
+        fields[0] = sector->floorheight;
+        fields[1] = sector->ceilingheight;
+        fields[2] = sector->lightlevel;
+        h = M_HashWords(h, fields, 3);
+    }
+
+    hash->sectors = h;
+
+    h = M_HASH_INIT;
+    n = 0;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+            continue;
+
+        mobjhash = MobjHash((mobj_t *)th);
+        h = M_HashWords(h, (int *) &mobjhash, 1);
+
+        if (mobjhashes != NULL && n < maxmobjs)
+            mobjhashes[n] = mobjhash;
+
+        n++;
+    }
+
+    hash->mobjs = h;
+    hash->nummobjs = n;
+}
+
+//
+// P_GameStateHash
+// The parts above and the tic they are for, in one number.  Used
+// to compare demo playback between builds.
+//
+unsigned int P_GameStateHash(doom_data_t *doom)
+{
+    gamestatehash_t hash;
+    int parts[4];
+
+    P_HashGameState(doom, &hash, NULL, 0);
+
+    parts[0] = doom->gametic;
+    parts[1] = hash.misc;
+    parts[2] = hash.sectors;
+    parts[3] = hash.mobjs;
+
+    return M_HashWords(M_HASH_INIT, parts, arrlen(parts));
+}
+
 //
 // P_Ticker
 //
@@ -107,6 +428,7 @@ void P_RunThinkers(doom_data_t *doom)
 void P_Ticker(doom_data_t *doom)
 {
     int i;
+    uint64_t tickstart, thinkstart;
 
     // run the tic
     if (doom->paused)
@@ -118,14 +440,29 @@ void P_Ticker(doom_data_t *doom)
         return;
     }
 
+    tickstart = doom->timingdemo ? I_GetTimeUS() : 0;
+
+    P_InvalidateSightCache();
+
     for (i = 0; i < MAXPLAYERS; i++)
         if (doom->playeringame[i])
             P_PlayerThink(doom, &doom->players[i]);
 
+    thinkstart = doom->timingdemo ? I_GetTimeUS() : 0;
     P_RunThinkers(doom);
+
+    if (doom->timingdemo)
+        thinkertime += I_GetTimeUS() - thinkstart;
+
     P_UpdateSpecials(doom);
     P_RespawnSpecials(doom);
 
+    if (doom->timingdemo)
+    {
+        tickertime += I_GetTimeUS() - tickstart;
+        thinkertics++;
+    }
+
     // for par times
     leveltime++;
 }
@@ -21,6 +21,8 @@
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_thread.h"
+#include "i_timer.h"
 #include "z_zone.h"
 
 #include "w_wad.h"
@@ -34,6 +36,7 @@
 #include "r_sky.h"
 
 #include "r_data.h"
+#include "r_texcache.h"
 
 //
 // Graphics.
@@ -200,12 +203,13 @@ void R_DrawColumnInCache(column_t *patch,
 }
 
 //
-// R_GenerateComposite
-// Using the texture definition,
-//  the composite texture is created from the patches,
-//  and each column is cached.
+// R_DrawComposite
+// Using the texture definition, the composite texture is
+// created from the patches, and each column is cached.
+// realpatches holds the locked patches of the texture; this
+// does not touch the zone, so it can run on a worker thread.
 //
-void R_GenerateComposite(struct doom_data_t_* doom, int texnum)
+void R_DrawComposite(int texnum, patch_t **realpatches)
 {
     byte *block;
     texture_t *texture;
@@ -220,10 +224,7 @@ void R_GenerateComposite(struct doom_data_t_* doom, int texnum)
     unsigned short *colofs;
 
     texture = textures[texnum];
-
-    block = Z_Malloc(texturecompositesize[texnum],
-                     PU_STATIC,
-                     &texturecomposite[texnum]);
+    block = texturecomposite[texnum];
 
     collump = texturecolumnlump[texnum];
     colofs = texturecolumnofs[texnum];
@@ -235,7 +236,7 @@ void R_GenerateComposite(struct doom_data_t_* doom, int texnum)
          i < texture->patchcount;
          i++, patch++)
     {
-        realpatch = W_CacheLumpNum(doom, patch->patch, PU_CACHE);
+        realpatch = realpatches[i];
         x1 = patch->originx;
         x2 = x1 + SHORT(realpatch->width);
 
@@ -260,10 +261,223 @@ void R_GenerateComposite(struct doom_data_t_* doom, int texnum)
                                 texture->height);
         }
     }
+}
+
+static void R_LockCompositePatches(struct doom_data_t_* doom, int texnum,
+                                   patch_t **realpatches)
+{
+    texture_t *texture = textures[texnum];
+    int i;
+
+    for (i = 0; i < texture->patchcount; i++)
+        realpatches[i] = W_CacheLumpNum(doom, texture->patches[i].patch, PU_STATIC);
+}
+
+static void R_UnlockCompositePatches(struct doom_data_t_* doom, int texnum)
+{
+    texture_t *texture = textures[texnum];
+    int i;
+
+    for (i = 0; i < texture->patchcount; i++)
+        W_ReleaseLumpNum(doom, texture->patches[i].patch);
+}
+
+//
+// R_ReserveComposite
+// If texnum needs a composite that is not built yet, allocates it
+// in the texture cache and locks its patches into realpatches,
+// adding their size to *lockedbytes.  The caller must then call
+// R_DrawComposite and R_ReleaseComposite.  Returns the number of
+// patches locked, 0 if there is nothing to build, or -1 if the
+// texture cache is full of composites used since the last frame.
+//
+int R_ReserveComposite(struct doom_data_t_* doom, int texnum,
+                       patch_t **realpatches, int *lockedbytes)
+{
+    texture_t *texture = textures[texnum];
+    int i;
+
+    if (texturecompositesize[texnum] == 0)
+        return 0;
+
+    if (texturecomposite[texnum])
+    {
+        // Kept from an earlier level.
+        R_TouchTextureCache(texturecomposite[texnum]);
+        return 0;
+    }
+
+    if (!R_TextureCacheAlloc(texturecompositesize[texnum],
+                             &texturecomposite[texnum], false))
+        return -1;
+
+    R_LockCompositePatches(doom, texnum, realpatches);
+
+    for (i = 0; i < texture->patchcount; i++)
+        *lockedbytes += doom->lumpinfo[texture->patches[i].patch].size;
+
+    return texture->patchcount;
+}
+
+void R_ReleaseComposite(struct doom_data_t_* doom, int texnum)
+{
+    R_UnlockCompositePatches(doom, texnum);
+}
+
+int R_TexturePatchCount(int texnum)
+{
+    return textures[texnum]->patchcount;
+}
+
+//
+// R_CacheTexturePatches
+// Loads the patches of a texture into the zone cache.
+// Returns the number of bytes they take.
+//
+int R_CacheTexturePatches(struct doom_data_t_* doom, int texnum)
+{
+    texture_t *texture = textures[texnum];
+    int lump;
+    int size;
+    int i;
+
+    size = 0;
+
+    for (i = 0; i < texture->patchcount; i++)
+    {
+        lump = texture->patches[i].patch;
+        size += doom->lumpinfo[lump].size;
+        W_CacheLumpNum(doom, lump, PU_CACHE);
+    }
+
+    return size;
+}
+
+//
+// R_GenerateComposite
+// Builds a composite on demand, in the middle of a frame.
+// Composites live in the texture cache rather than the zone,
+// so they survive level changes.
+//
+void R_GenerateComposite(struct doom_data_t_* doom, int texnum)
+{
+    patch_t **realpatches;
+
+    R_TextureCacheAlloc(texturecompositesize[texnum],
+                        &texturecomposite[texnum], true);
+
+    realpatches = Z_Malloc(textures[texnum]->patchcount * sizeof(*realpatches),
+                           PU_STATIC, NULL);
+
+    R_LockCompositePatches(doom, texnum, realpatches);
+    R_DrawComposite(texnum, realpatches);
+    R_UnlockCompositePatches(doom, texnum);
+
+    Z_Free(realpatches);
+}
+
+//
+// R_PrecacheComposites
+// Builds every missing composite that is marked in texturepresent,
+// spread over the worker threads.  Patches are locked in batches
+// so a large PWAD cannot fill the zone.
+//
+#define COMPOSITEBATCHBYTES (1024 * 1024)
+
+typedef struct
+{
+    int numtextures;
+    int *texnums;
+    patch_t ***realpatches;     // [numtextures], each into patchbuffer
+    patch_t **patchbuffer;
+} compositebatch_t;
+
+static void R_DrawCompositeJob(void *data, int index)
+{
+    compositebatch_t *batch = data;
+
+    R_DrawComposite(batch->texnums[index], batch->realpatches[index]);
+}
+
+static void R_RunCompositeBatch(struct doom_data_t_* doom,
+                                compositebatch_t *batch)
+{
+    int i;
+
+    I_ParallelFor(batch->numtextures, R_DrawCompositeJob, batch);
+
+    for (i = 0; i < batch->numtextures; i++)
+        R_ReleaseComposite(doom, batch->texnums[i]);
+
+    batch->numtextures = 0;
+}
+
+static int R_PrecacheComposites(struct doom_data_t_* doom, char *texturepresent)
+{
+    compositebatch_t batch;
+    patch_t **nextpatch;
+    int totalpatches;
+    int batchbytes;
+    int locked;
+    int built;
+    int i;
+
+    // New frame, so composites left over from the previous level
+    // are evicted before any built here.
+    R_TextureCacheFrame();
+
+    totalpatches = 0;
+    for (i = 0; i < numtextures; i++)
+    {
+        if (texturepresent[i])
+            totalpatches += textures[i]->patchcount;
+    }
+
+    batch.texnums = Z_Malloc(numtextures * sizeof(*batch.texnums), PU_STATIC, NULL);
+    batch.realpatches = Z_Malloc(numtextures * sizeof(*batch.realpatches), PU_STATIC, NULL);
+    batch.patchbuffer = Z_Malloc((totalpatches + 1) * sizeof(*batch.patchbuffer), PU_STATIC, NULL);
+    batch.numtextures = 0;
+
+    nextpatch = batch.patchbuffer;
+    batchbytes = 0;
+    built = 0;
+
+    for (i = 0; i < numtextures; i++)
+    {
+        if (!texturepresent[i])
+            continue;
+
+        locked = R_ReserveComposite(doom, i, nextpatch, &batchbytes);
+
+        // Stop when the budget is full of this level's textures;
+        // the rest are built on demand.
+        if (locked < 0)
+            break;
+
+        if (locked == 0)
+            continue;
+
+        batch.texnums[batch.numtextures] = i;
+        batch.realpatches[batch.numtextures] = nextpatch;
+        ++batch.numtextures;
+        nextpatch += locked;
+        ++built;
+
+        if (batchbytes >= COMPOSITEBATCHBYTES)
+        {
+            R_RunCompositeBatch(doom, &batch);
+            nextpatch = batch.patchbuffer;
+            batchbytes = 0;
+        }
+    }
+
+    R_RunCompositeBatch(doom, &batch);
+
+    Z_Free(batch.patchbuffer);
+    Z_Free(batch.realpatches);
+    Z_Free(batch.texnums);
 
-    // Now that the texture has been built in column cache,
-    //  it is purgable from zone memory.
-    Z_ChangeTag(block, PU_CACHE);
+    return built;
 }
 
 //
@@ -372,9 +586,32 @@ R_GetColumn(struct doom_data_t_* doom,
     if (!texturecomposite[tex])
         R_GenerateComposite(doom, tex);
 
+    R_TouchTextureCache(texturecomposite[tex]);
+
     return texturecomposite[tex] + ofs;
 }
 
+//
+// R_ColumnCached
+// True if R_GetColumn can return this column without allocating,
+//  and so without purging or evicting columns it returned earlier.
+//
+boolean R_ColumnCached(struct doom_data_t_* doom, int tex, int col)
+{
+    int lump;
+
+    col &= texturewidthmask[tex];
+    lump = texturecolumnlump[tex][col];
+
+    if (lump > 0)
+    {
+        return doom->lumpinfo[lump].wad_file->mapped != NULL
+            || doom->lumpinfo[lump].cache != NULL;
+    }
+
+    return texturecomposite[tex] != NULL;
+}
+
 static void GenerateTextureHashTable(void)
 {
     texture_t **rover;
@@ -583,6 +820,8 @@ void R_InitTextures(struct doom_data_t_* doom)
 
     // Precalculate whatever possible.
 
+    R_InitTextureCache(doom);
+
     for (i = 0; i < numtextures; i++)
         R_GenerateLookup(doom, i);
 
@@ -760,8 +999,9 @@ void R_PrecacheLevel(doom_data_t* doom)
     int j;
     int k;
     int lump;
+    int built;
+    uint64_t starttime;
 
-    texture_t *texture;
     thinker_t *th;
     spriteframe_t *sf;
 
@@ -817,14 +1057,18 @@ void R_PrecacheLevel(doom_data_t* doom)
         if (!texturepresent[i])
             continue;
 
-        texture = textures[i];
+        texturememory += R_CacheTexturePatches(doom, i);
+    }
 
-        for (j = 0; j < texture->patchcount; j++)
-        {
-            lump = texture->patches[j].patch;
-            texturememory += doom->lumpinfo[lump].size;
-            W_CacheLumpNum(doom, lump, PU_CACHE);
-        }
+    // Build multi-patch composites now rather than mid-frame.
+    starttime = I_GetTimeUS();
+    built = R_PrecacheComposites(doom, texturepresent);
+
+    if (doom->devparm)
+    {
+        d_printf("R_PrecacheLevel: %i composites in %i us on %i threads\n",
+                 built, (int) (I_GetTimeUS() - starttime),
+                 I_NumWorkerThreads());
     }
 
     Z_Free(texturepresent);
@@ -32,6 +32,13 @@ R_GetColumn
   int		tex,
   int		col );
 
+// True if R_GetColumn would not need to allocate for this column.
+boolean
+R_ColumnCached
+( struct doom_data_t_* doom,
+  int		tex,
+  int		col );
+
 struct doom_data_t_;
 
 
@@ -40,6 +47,15 @@ void R_InitData (struct doom_data_t_* doom);
 void R_PrecacheLevel (struct doom_data_t_* doom);
 
 
+// Level prefetch support, see g_prefetch.c.
+int R_ReserveComposite (struct doom_data_t_* doom, int texnum,
+                        patch_t **realpatches, int *lockedbytes);
+void R_DrawComposite (int texnum, patch_t **realpatches);
+void R_ReleaseComposite (struct doom_data_t_* doom, int texnum);
+int R_TexturePatchCount (int texnum);
+int R_CacheTexturePatches (struct doom_data_t_* doom, int texnum);
+
+
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
 // lookup by name. For animation?
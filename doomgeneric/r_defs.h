@@ -370,6 +370,9 @@ typedef struct vissprite_s
     lighttable_t*	colormap;
    
     int			mobjflags;
+
+    // NULL for the player's weapon
+    mobj_t*		mobj;
     
 } vissprite_t;
 
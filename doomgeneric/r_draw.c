@@ -26,9 +26,15 @@
 #include "i_system.h"
 #include "z_zone.h"
 #include "w_wad.h"
+#include "m_argv.h"
 
 #include "r_local.h"
 
+#ifdef R_SPAN_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 // Needs access to LFB (guess what).
 #include "v_video.h"
 
@@ -138,6 +144,109 @@ void R_DrawColumn(void)
     } while (count--);
 }
 
+//
+// R_DrawWallColumns
+// Draws a run of up to MAXWALLBATCH adjacent wall columns that share a
+//  colormap.  The rows every column covers are drawn across the whole
+//  run, so each row's writes land in one cache line; the ragged ends
+//  above and below are drawn a column at a time.  Every column keeps
+//  its own frac and step, so the result matches R_DrawColumn.
+//
+void R_DrawWallColumns(wallcolumn_t *columns, int count, int x,
+                       lighttable_t *colormap)
+{
+    fixed_t frac[MAXWALLBATCH];
+    byte *dest;
+    int top, bottom;
+    int i, y, last;
+
+#ifdef RANGECHECK
+    if (count < 1 || count > MAXWALLBATCH || x < 0 || x + count > SCREENWIDTH)
+        I_Error("R_DrawWallColumns: %i columns at %i", count, x);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (columns[i].yl < 0 || columns[i].yh >= SCREENHEIGHT)
+            I_Error("R_DrawWallColumns: %i to %i at %i",
+                    columns[i].yl, columns[i].yh, x + i);
+    }
+#endif
+
+    top = columns[0].yl;
+    bottom = columns[0].yh;
+
+    for (i = 1; i < count; ++i)
+    {
+        if (columns[i].yl > top)
+            top = columns[i].yl;
+        if (columns[i].yh < bottom)
+            bottom = columns[i].yh;
+    }
+
+    // Tops, down to the first shared row.
+    for (i = 0; i < count; ++i)
+    {
+        frac[i] = columns[i].texturemid + (columns[i].yl - centery) * columns[i].iscale;
+
+        last = top <= bottom ? top - 1 : columns[i].yh;
+        dest = ylookup[columns[i].yl] + columnofs[x + i];
+
+        for (y = columns[i].yl; y <= last; ++y)
+        {
+            *dest = colormap[columns[i].source[(frac[i] >> FRACBITS) & 127]];
+            dest += SCREENWIDTH;
+            frac[i] += columns[i].iscale;
+        }
+    }
+
+    if (top > bottom)
+        return;
+
+    // Shared rows, across the run.
+    dest = ylookup[top] + columnofs[x];
+
+    if (count == 4)
+    {
+        for (y = top; y <= bottom; ++y)
+        {
+            dest[0] = colormap[columns[0].source[(frac[0] >> FRACBITS) & 127]];
+            dest[1] = colormap[columns[1].source[(frac[1] >> FRACBITS) & 127]];
+            dest[2] = colormap[columns[2].source[(frac[2] >> FRACBITS) & 127]];
+            dest[3] = colormap[columns[3].source[(frac[3] >> FRACBITS) & 127]];
+            frac[0] += columns[0].iscale;
+            frac[1] += columns[1].iscale;
+            frac[2] += columns[2].iscale;
+            frac[3] += columns[3].iscale;
+            dest += SCREENWIDTH;
+        }
+    }
+    else
+    {
+        for (y = top; y <= bottom; ++y)
+        {
+            for (i = 0; i < count; ++i)
+            {
+                dest[i] = colormap[columns[i].source[(frac[i] >> FRACBITS) & 127]];
+                frac[i] += columns[i].iscale;
+            }
+            dest += SCREENWIDTH;
+        }
+    }
+
+    // Bottoms, below the last shared row.
+    for (i = 0; i < count; ++i)
+    {
+        dest = ylookup[bottom + 1] + columnofs[x + i];
+
+        for (y = bottom + 1; y <= columns[i].yh; ++y)
+        {
+            *dest = colormap[columns[i].source[(frac[i] >> FRACBITS) & 127]];
+            dest += SCREENWIDTH;
+            frac[i] += columns[i].iscale;
+        }
+    }
+}
+
 // UNUSED.
 // Loop unrolled.
 #if 0
@@ -598,6 +707,239 @@ void R_DrawSpan(void)
     } while (count--);
 }
 
+#ifdef R_SPAN_SIMD
+
+//
+// Vector span drawers.
+//
+// Lane i of the position vector holds position + i * step, which is
+// exactly what i scalar additions of step give modulo 2^32, carry from
+// the y half into the x half included, so the output is byte-identical
+// to R_DrawSpan.  Spans shorter than one vector and the remainder of
+// longer ones are finished by the scalar loop.
+//
+
+static void R_DrawSpanTail(byte *dest, unsigned int position,
+                           unsigned int step, int count)
+{
+    unsigned int spot;
+
+    while (count-- > 0)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+        *dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+    }
+}
+
+void R_DrawSpanSSE2(void)
+{
+    unsigned int position, step;
+    unsigned int spots[8];
+    byte *dest;
+    byte *source;
+    lighttable_t *colormap;
+    int count;
+    int i;
+    uint64_t pixels;
+    __m128i pos0, pos1, step8, ymask;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH || (unsigned)ds_y > SCREENHEIGHT)
+    {
+        I_Error("R_DrawSpan: %i to %i at %i",
+                ds_x1, ds_x2, ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+    source = ds_source;
+    colormap = ds_colormap;
+
+    pos0 = _mm_setr_epi32(position, position + step,
+                          position + step * 2, position + step * 3);
+    pos1 = _mm_add_epi32(pos0, _mm_set1_epi32(step * 4));
+    step8 = _mm_set1_epi32(step * 8);
+    ymask = _mm_set1_epi32(0x0fc0);
+
+    // SSE2 has no gather, so the spots are computed eight at a time in
+    // vectors and the texel and light lookups done from a spill.
+
+    while (count >= 8)
+    {
+        _mm_storeu_si128((__m128i *) &spots[0],
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pos0, 4), ymask),
+                                      _mm_srli_epi32(pos0, 26)));
+        _mm_storeu_si128((__m128i *) &spots[4],
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pos1, 4), ymask),
+                                      _mm_srli_epi32(pos1, 26)));
+
+        pixels = 0;
+
+        for (i = 0; i < 8; ++i)
+        {
+            pixels |= (uint64_t) colormap[source[spots[i]]] << (i * 8);
+        }
+
+        _mm_storel_epi64((__m128i *) dest, _mm_cvtsi64_si128((long long) pixels));
+
+        pos0 = _mm_add_epi32(pos0, step8);
+        pos1 = _mm_add_epi32(pos1, step8);
+        dest += 8;
+        count -= 8;
+    }
+
+    R_DrawSpanTail(dest, (unsigned int) _mm_cvtsi128_si32(pos0), step, count);
+}
+
+//
+// Gathers one byte per lane from table[index].  The gather loads the
+// aligned dword containing each byte and shifts it down; an aligned
+// dword never crosses a page, so reading up to three bytes either side
+// of the table cannot fault.
+//
+__attribute__((target("avx2")))
+static inline __m256i R_GatherBytes(const byte *table, __m256i index)
+{
+    const int *base;
+    __m256i offset, three;
+
+    base = (const int *) ((uintptr_t) table & ~(uintptr_t) 3);
+    offset = _mm256_add_epi32(index, _mm256_set1_epi32((int) ((uintptr_t) table & 3)));
+    three = _mm256_set1_epi32(3);
+
+    return _mm256_and_si256(
+        _mm256_srlv_epi32(_mm256_i32gather_epi32(base, _mm256_andnot_si256(three, offset), 1),
+                          _mm256_slli_epi32(_mm256_and_si256(offset, three), 3)),
+        _mm256_set1_epi32(0xff));
+}
+
+__attribute__((target("avx2")))
+void R_DrawSpanAVX2(void)
+{
+    unsigned int position, step;
+    byte *dest;
+    int count;
+    __m256i pos, step8, ymask, spot, pixels, pack;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH || (unsigned)ds_y > SCREENHEIGHT)
+    {
+        I_Error("R_DrawSpan: %i to %i at %i",
+                ds_x1, ds_x2, ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000) | ((ds_yfrac >> 6) & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000) | ((ds_ystep >> 6) & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    pos = _mm256_add_epi32(_mm256_set1_epi32(position),
+                           _mm256_mullo_epi32(_mm256_set1_epi32(step),
+                                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    step8 = _mm256_set1_epi32(step * 8);
+    ymask = _mm256_set1_epi32(0x0fc0);
+
+    // Low byte of each dword to the bottom of its 128-bit half, then
+    // both halves together.
+    pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    while (count >= 8)
+    {
+        spot = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pos, 4), ymask),
+                               _mm256_srli_epi32(pos, 26));
+
+        pixels = R_GatherBytes(ds_colormap, R_GatherBytes(ds_source, spot));
+        pixels = _mm256_shuffle_epi8(pixels, pack);
+        pixels = _mm256_permutevar8x32_epi32(pixels, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+
+        _mm_storel_epi64((__m128i *) dest, _mm256_castsi256_si128(pixels));
+
+        pos = _mm256_add_epi32(pos, step8);
+        dest += 8;
+        count -= 8;
+    }
+
+    R_DrawSpanTail(dest, (unsigned int) _mm256_cvtsi256_si32(pos), step, count);
+}
+
+//
+// Checks CPUID for AVX2, and XCR0 for the OS (or firmware) saving
+// the YMM registers; without the latter AVX instructions fault.
+//
+boolean R_HaveAVX2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int xcr0, xcr0high;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+    {
+        return false;
+    }
+
+    __cpuid(1, eax, ebx, ecx, edx);
+
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+    {
+        return false;
+    }
+
+    __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0high) : "c"(0));
+
+    if ((xcr0 & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    return (ebx & bit_AVX2) != 0;
+}
+
+#endif // R_SPAN_SIMD
+
+//
+// R_InitSpanDrawer
+// Picks the full detail span drawer for this CPU.  -nosimd keeps the
+// scalar one.
+//
+void (*spandrawer)(void) = R_DrawSpan;
+
+void R_InitSpanDrawer(struct doom_data_t_ *doom)
+{
+    const char *name = "scalar";
+
+    spandrawer = R_DrawSpan;
+
+#ifdef R_SPAN_SIMD
+    if (!M_CheckParm(doom, "-nosimd"))
+    {
+        if (R_HaveAVX2())
+        {
+            spandrawer = R_DrawSpanAVX2;
+            name = "AVX2";
+        }
+        else
+        {
+            spandrawer = R_DrawSpanSSE2;
+            name = "SSE2";
+        }
+    }
+#endif
+
+    if (doom->devparm)
+    {
+        d_printf("R_InitSpanDrawer: %s spans\n", name);
+    }
+}
+
 // UNUSED.
 // Loop unrolled by 4.
 #if 0
@@ -40,6 +40,23 @@ extern byte*		dc_source;
 void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
 
+// A wall column queued for R_DrawWallColumns.
+typedef struct
+{
+    byte*	source;
+    int		yl;
+    int		yh;
+    fixed_t	texturemid;
+    fixed_t	iscale;
+} wallcolumn_t;
+
+#define MAXWALLBATCH	4
+
+// Draws count adjacent wall columns from screen column x, all
+//  lit by colormap; the same pixels as R_DrawColumn per column.
+void	R_DrawWallColumns (wallcolumn_t* columns, int count, int x,
+			   lighttable_t* colormap);
+
 // The Spectre/Invisibility effect.
 void 	R_DrawFuzzColumn (void);
 void 	R_DrawFuzzColumnLow (void);
@@ -80,6 +97,20 @@ void 	R_DrawSpan (void);
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
 
+// Vector versions of R_DrawSpan, byte-identical to it.
+#if defined(__x86_64__) || defined(_M_X64)
+#define R_SPAN_SIMD
+void	R_DrawSpanSSE2 (void);
+void	R_DrawSpanAVX2 (void);
+boolean	R_HaveAVX2 (void);
+#endif
+
+// Full detail span drawer picked by R_InitSpanDrawer.
+extern void	(*spandrawer) (void);
+
+struct doom_data_t_;
+void	R_InitSpanDrawer (struct doom_data_t_* doom);
+
 
 void
 R_InitBuffer
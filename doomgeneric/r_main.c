@@ -23,11 +23,13 @@
 #include "doomdef.h"
 #include "d_loop.h"
 
+#include "i_timer.h"
 #include "m_bbox.h"
 #include "m_menu.h"
 
 #include "r_local.h"
 #include "r_sky.h"
+#include "r_texcache.h"
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -610,7 +612,7 @@ void R_ExecuteSetViewSize(void)
         colfunc = basecolfunc = R_DrawColumn;
         fuzzcolfunc = R_DrawFuzzColumn;
         transcolfunc = R_DrawTranslatedColumn;
-        spanfunc = R_DrawSpan;
+        spanfunc = spandrawer;
     }
     else
     {
@@ -679,6 +681,8 @@ void R_Init(struct doom_data_t_* doom)
     R_InitTables();
     // viewwidth / viewheight / detailLevel are set by the defaults
     d_printf(".");
+    R_InitSpanDrawer(doom);
+    R_InitWallBatching(doom);
 
     R_SetViewSize(screenblocks, detailLevel);
     R_InitPlanes();
@@ -761,19 +765,25 @@ void R_SetupFrame(player_t *player)
 //
 void R_RenderPlayerView(struct doom_data_t_ *doom, player_t *player)
 {
+    uint64_t bsptime;
+
     R_SetupFrame(player);
+    R_TextureCacheFrame();
 
     // Clear buffers.
     R_ClearClipSegs();
     R_ClearDrawSegs();
     R_ClearPlanes();
     R_ClearSprites();
+    R_ObserveView();
 
     // check for new console commands.
     NetUpdate(doom);
 
     // The head node is the last node output.
+    bsptime = I_GetTimeUS();
     R_RenderBSPNode(doom, numnodes - 1);
+    R_WallTimingFrame(I_GetTimeUS() - bsptime);
 
     // Check for new console commands.
     NetUpdate(doom);
@@ -0,0 +1,184 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Depth and object label buffers.
+//	Depth is the distance along the view direction in map units, as
+//	the planes and the light tables reckon it.  Walls and sprites
+//	have it as a scale, from which it is worked out once a column.
+//
+
+#include "dlibc.h"
+
+#include "doomdef.h"
+#include "i_video.h"
+#include "r_local.h"
+#include "r_observe.h"
+
+#define FARDEPTH 0xffff
+
+boolean observing;
+byte obslabel;
+
+static uint16_t *obsdepth;
+static byte *obslabels;
+static dg_object_t *obsobjects;
+static int numobsobjects;
+static int numobsviews;
+
+void R_SetObservation(uint16_t *depth, byte *labels, dg_object_t *objects)
+{
+    obsdepth = depth;
+    obslabels = labels;
+    obsobjects = objects;
+    numobsobjects = 0;
+}
+
+//
+// R_ObserveView
+// The view is redrawn in full, but clear it anyway so nothing from
+//  an earlier, larger view is left at its edges.
+//
+void R_ObserveView(void)
+{
+    int ofs;
+    int x, y;
+
+    observing = obsdepth != NULL || obslabels != NULL;
+    obslabel = 0;
+    numobsobjects = 0;
+
+    if (!observing)
+        return;
+
+    numobsviews++;
+
+    for (y = 0; y < viewheight; y++)
+    {
+        ofs = (viewwindowy + y) * SCREENWIDTH + viewwindowx;
+
+        if (obsdepth)
+        {
+            for (x = 0; x < scaledviewwidth; x++)
+                obsdepth[ofs + x] = FARDEPTH;
+        }
+
+        if (obslabels)
+            d_memset(obslabels + ofs, 0, scaledviewwidth);
+    }
+}
+
+int R_ObservedViews(void)
+{
+    return numobsviews;
+}
+
+int R_ObservedObjects(void)
+{
+    return numobsobjects;
+}
+
+void R_ObserveSprite(mobj_t *thing)
+{
+    dg_object_t *object;
+
+    if (obsobjects == NULL || numobsobjects == DG_OBS_MAXOBJECTS)
+    {
+        obslabel = 0;
+        return;
+    }
+
+    object = &obsobjects[numobsobjects++];
+    object->type = thing->type;
+    object->x = thing->x;
+    object->y = thing->y;
+    object->z = thing->z;
+    object->angle = thing->angle;
+    object->health = thing->health;
+    object->flags = thing->flags;
+
+    obslabel = numobsobjects;
+}
+
+static uint16_t ScaleDepth(fixed_t scale)
+{
+    fixed_t distance;
+
+    if (scale <= 0)
+        return FARDEPTH;
+
+    // Scales are at full detail; centerxfrac is not.
+
+    distance = FixedDiv(centerxfrac << detailshift, scale) >> FRACBITS;
+
+    return distance < FARDEPTH ? distance : FARDEPTH - 1;
+}
+
+void R_ObserveColumn(int x, int yl, int yh, fixed_t scale)
+{
+    uint16_t depth;
+    int ofs, count;
+    int y;
+
+    if (yl > yh)
+        return;
+
+    ofs = (viewwindowy + yl) * SCREENWIDTH + viewwindowx + (x << detailshift);
+    count = yh - yl + 1;
+
+    if (obsdepth)
+    {
+        depth = ScaleDepth(scale);
+
+        for (y = 0; y < count; y++)
+        {
+            obsdepth[ofs + y * SCREENWIDTH] = depth;
+
+            if (detailshift)
+                obsdepth[ofs + y * SCREENWIDTH + 1] = depth;
+        }
+    }
+
+    if (obslabels)
+    {
+        for (y = 0; y < count; y++)
+        {
+            obslabels[ofs + y * SCREENWIDTH] = obslabel;
+
+            if (detailshift)
+                obslabels[ofs + y * SCREENWIDTH + 1] = obslabel;
+        }
+    }
+}
+
+void R_ObserveSpan(int y, int x1, int x2, fixed_t distance)
+{
+    uint16_t depth;
+    int ofs, count;
+    int x;
+
+    ofs = (viewwindowy + y) * SCREENWIDTH + viewwindowx + (x1 << detailshift);
+    count = (x2 - x1 + 1) << detailshift;
+
+    // Planes are never objects, and the view was cleared to label 0.
+
+    if (obsdepth)
+    {
+        distance >>= FRACBITS;
+        depth = distance < FARDEPTH ? distance : FARDEPTH - 1;
+
+        for (x = 0; x < count; x++)
+            obsdepth[ofs + x] = depth;
+    }
+}
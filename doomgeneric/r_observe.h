@@ -0,0 +1,55 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Depth and object label buffers, written by the wall, plane and
+//	sprite drawers alongside the pixels for doomgeneric_Observe.
+//
+
+
+#ifndef __R_OBSERVE__
+#define __R_OBSERVE__
+
+#include "doomgeneric.h"
+#include "doomtype.h"
+#include "m_fixed.h"
+
+// Set at the start of each view when there is anything to write.
+extern boolean observing;
+
+// Label for what is being drawn, 0 for the world.
+extern byte obslabel;
+
+struct mobj_s;
+
+// Where to write; NULL for buffers not wanted.  Both are full
+// screens, like I_VideoBuffer.
+void R_SetObservation(uint16_t *depth, byte *labels, dg_object_t *objects);
+
+// At the start of each view.
+void R_ObserveView(void);
+
+// Views drawn so far, and the objects labelled in the last one.
+int R_ObservedViews(void);
+int R_ObservedObjects(void);
+
+// Sets obslabel for a sprite of thing about to be drawn.
+void R_ObserveSprite(struct mobj_s *thing);
+
+// A column or span as it is drawn.  A column is at scale, 0 for the
+// sky; a span at distance.
+void R_ObserveColumn(int x, int yl, int yh, fixed_t scale);
+void R_ObserveSpan(int y, int x1, int x2, fixed_t distance);
+
+#endif
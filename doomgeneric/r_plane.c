@@ -151,6 +151,9 @@ void R_MapPlane(int y,
     ds_x1 = x1;
     ds_x2 = x2;
 
+    if (observing)
+        R_ObserveSpan(y, x1, x2, distance);
+
     // high or low detail
     spanfunc();
 }
@@ -377,6 +380,9 @@ void R_DrawPlanes(struct doom_data_t_* doom)
                     dc_x = x;
                     dc_source = R_GetColumn(doom, skytexture, angle);
                     colfunc();
+
+                    if (observing)
+                        R_ObserveColumn(x, dc_yl, dc_yh, 0);
                 }
             }
             continue;
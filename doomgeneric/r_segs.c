@@ -26,6 +26,8 @@
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "m_argv.h"
+
 // OPTIMIZE: closed two sided lines as single sided
 
 // True if any of the segs textures might be visible.
@@ -78,6 +80,139 @@ lighttable_t **walllights;
 
 short *maskedtexturecol;
 
+//
+// Wall column batching.
+// Full detail wall columns are queued per tier and drawn in runs of
+//  adjacent columns with R_DrawWallColumns.  -nowallbatch draws them
+//  one at a time; -walltiming alternates the two every frame and
+//  reports the time spent in the BSP walk for each.
+//
+typedef struct
+{
+	wallcolumn_t columns[MAXWALLBATCH];
+	int count;
+	int x;
+	lighttable_t *colormap;
+} wallbatch_t;
+
+static wallbatch_t midbatch;
+static wallbatch_t topbatch;
+static wallbatch_t bottombatch;
+
+static boolean wallbatching = true;
+static boolean batchwalls;
+
+static boolean walltiming;
+static uint64_t walltime[2];
+static int wallframes[2];
+
+static void R_FlushWallBatch(wallbatch_t *batch)
+{
+	if (batch->count)
+	{
+		R_DrawWallColumns(batch->columns, batch->count, batch->x,
+						  batch->colormap);
+		batch->count = 0;
+	}
+}
+
+static void R_FlushWallBatches(void)
+{
+	R_FlushWallBatch(&midbatch);
+	R_FlushWallBatch(&topbatch);
+	R_FlushWallBatch(&bottombatch);
+}
+
+//
+// R_DrawWallColumn
+// Draws the column described by dc_*, or adds it to a batch.
+//
+static void R_DrawWallColumn(wallbatch_t *batch)
+{
+	wallcolumn_t *column;
+
+	if (observing)
+		R_ObserveColumn(dc_x, dc_yl, dc_yh, rw_scale);
+
+	if (!batchwalls)
+	{
+		colfunc();
+		return;
+	}
+
+	if (dc_yh < dc_yl)
+		return;
+
+	if (batch->count
+	 && (batch->colormap != dc_colormap || batch->x + batch->count != dc_x))
+	{
+		R_FlushWallBatch(batch);
+	}
+
+	if (!batch->count)
+	{
+		batch->x = dc_x;
+		batch->colormap = dc_colormap;
+	}
+
+	column = &batch->columns[batch->count++];
+	column->source = dc_source;
+	column->yl = dc_yl;
+	column->yh = dc_yh;
+	column->texturemid = dc_texturemid;
+	column->iscale = dc_iscale;
+
+	if (batch->count == MAXWALLBATCH)
+		R_FlushWallBatch(batch);
+}
+
+//
+// R_GetWallColumn
+// R_GetColumn, but queued columns are drawn first if it would have
+//  to allocate, as that may purge the memory they point into.
+//
+static byte *R_GetWallColumn(struct doom_data_t_* doom, int tex, int col)
+{
+	if (batchwalls && !R_ColumnCached(doom, tex, col))
+		R_FlushWallBatches();
+
+	return R_GetColumn(doom, tex, col);
+}
+
+void R_InitWallBatching(struct doom_data_t_* doom)
+{
+	wallbatching = !M_CheckParm(doom, "-nowallbatch");
+	walltiming = M_CheckParm(doom, "-walltiming") > 0;
+}
+
+//
+// R_WallTimingFrame
+// Called after the BSP walk with its duration.  Picks the wall path
+//  for the next frame when -walltiming is on.
+//
+void R_WallTimingFrame(uint64_t us)
+{
+	int mode;
+
+	if (!walltiming)
+		return;
+
+	mode = wallbatching ? 1 : 0;
+	walltime[mode] += us;
+	++wallframes[mode];
+
+	if (wallframes[0] >= 2 * TICRATE && wallframes[1] >= 2 * TICRATE)
+	{
+		d_printf("walls: per column %d us/frame, batched %d us/frame\n",
+				 (int) (walltime[0] / wallframes[0]),
+				 (int) (walltime[1] / wallframes[1]));
+		walltime[0] = walltime[1] = 0;
+		wallframes[0] = wallframes[1] = 0;
+	}
+
+	wallbatching = !wallbatching;
+}
+
 //
 // R_RenderMaskedSegRange
 //
@@ -192,6 +327,8 @@ void R_RenderSegLoop(struct doom_data_t_* doom)
 	int top;
 	int bottom;
 
+	batchwalls = wallbatching && colfunc == R_DrawColumn;
+
 	for (; rw_x < rw_stopx; rw_x++)
 	{
 		// mark floor / ceiling areas
@@ -271,8 +408,8 @@ void R_RenderSegLoop(struct doom_data_t_* doom)
 			dc_yl = yl;
 			dc_yh = yh;
 			dc_texturemid = rw_midtexturemid;
-			dc_source = R_GetColumn(doom, midtexture, texturecolumn);
-			colfunc();
+			dc_source = R_GetWallColumn(doom, midtexture, texturecolumn);
+			R_DrawWallColumn(&midbatch);
 			ceilingclip[rw_x] = viewheight;
 			floorclip[rw_x] = -1;
 		}
@@ -293,8 +430,8 @@ void R_RenderSegLoop(struct doom_data_t_* doom)
 					dc_yl = yl;
 					dc_yh = mid;
 					dc_texturemid = rw_toptexturemid;
-					dc_source = R_GetColumn(doom, toptexture, texturecolumn);
-					colfunc();
+					dc_source = R_GetWallColumn(doom, toptexture, texturecolumn);
+					R_DrawWallColumn(&topbatch);
 					ceilingclip[rw_x] = mid;
 				}
 				else
@@ -322,9 +459,9 @@ void R_RenderSegLoop(struct doom_data_t_* doom)
 					dc_yl = mid;
 					dc_yh = yh;
 					dc_texturemid = rw_bottomtexturemid;
-					dc_source = R_GetColumn(doom, bottomtexture,
-											texturecolumn);
-					colfunc();
+					dc_source = R_GetWallColumn(doom, bottomtexture,
+												texturecolumn);
+					R_DrawWallColumn(&bottombatch);
 					floorclip[rw_x] = mid;
 				}
 				else
@@ -349,6 +486,8 @@ void R_RenderSegLoop(struct doom_data_t_* doom)
 		topfrac += topstep;
 		bottomfrac += bottomstep;
 	}
+
+	R_FlushWallBatches();
 }
 
 //
@@ -30,5 +30,8 @@ R_RenderMaskedSegRange
   int		x1,
   int		x2 );
 
+void R_InitWallBatching (struct doom_data_t_* doom);
+void R_WallTimingFrame (uint64_t us);
+
 
 #endif
@@ -34,6 +34,8 @@
 //  for rendering.
 //
 
+extern int		numtextures;
+
 // needed for texture pegging
 extern fixed_t*		textureheight;
 
@@ -0,0 +1,230 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Composite texture cache.
+//	Blocks are kept in address order like the zone, with free
+//	neighbours merged.  When an allocation does not fit, the least
+//	recently used blocks are evicted until it does.
+//
+
+#include "dlibc.h"
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "r_texcache.h"
+
+// Upper limit of the -texcache budget.
+
+#define TEXCACHE_MAXSIZE (2 * 1024 * 1024)
+#define TEXCACHE_MINSIZE (128 * 1024)
+
+#define TEXCACHE_ALIGN 16
+
+static byte texcachemem[TEXCACHE_MAXSIZE] __attribute__((aligned(TEXCACHE_ALIGN)));
+
+static texcacheblock_t *texcachehead;
+static int texcachesize;
+
+unsigned int texturecacheclock;
+
+static int texcacheused;
+static int texcachepeak;
+static int texcacheallocs;
+static int texcacheevictions;
+
+static int BlockSize(texcacheblock_t *block)
+{
+    if (block->next != NULL)
+    {
+        return (byte *) block->next - (byte *) block;
+    }
+
+    return texcachemem + texcachesize - (byte *) block;
+}
+
+void R_InitTextureCache(doom_data_t *doom)
+{
+    int p;
+
+    texcachesize = TEXCACHE_MAXSIZE;
+
+    //!
+    // @arg <kib>
+    //
+    // Memory budget for composite textures, in KiB (default and
+    // maximum 2048).
+    //
+
+    p = M_CheckParmWithArgs(doom, "-texcache", 1);
+
+    if (p > 0)
+    {
+        texcachesize = d_atoi(doom->myargv[p + 1]) * 1024;
+
+        if (texcachesize < TEXCACHE_MINSIZE)
+            texcachesize = TEXCACHE_MINSIZE;
+        if (texcachesize > TEXCACHE_MAXSIZE)
+            texcachesize = TEXCACHE_MAXSIZE;
+    }
+
+    texcachehead = (texcacheblock_t *) texcachemem;
+    d_memset(texcachehead, 0, sizeof(*texcachehead));
+}
+
+// Free a block and merge it with free neighbours.
+
+static void FreeBlock(texcacheblock_t *block)
+{
+    texcacheblock_t *other;
+
+    texcacheused -= block->size;
+    *block->user = NULL;
+    block->user = NULL;
+    block->size = 0;
+
+    other = block->next;
+
+    if (other != NULL && other->size == 0)
+    {
+        block->next = other->next;
+        if (block->next != NULL)
+            block->next->prev = block;
+    }
+
+    other = block->prev;
+
+    if (other != NULL && other->size == 0)
+    {
+        other->next = block->next;
+        if (other->next != NULL)
+            other->next->prev = other;
+    }
+}
+
+static texcacheblock_t *FindFreeBlock(int size)
+{
+    texcacheblock_t *block;
+
+    for (block = texcachehead; block != NULL; block = block->next)
+    {
+        if (block->size == 0 && BlockSize(block) >= size)
+        {
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+// Evict the least recently used block.  Blocks used in the current
+// frame are only considered if evictcurrent is set.
+
+static boolean EvictBlock(boolean evictcurrent)
+{
+    texcacheblock_t *block;
+    texcacheblock_t *oldest = NULL;
+
+    for (block = texcachehead; block != NULL; block = block->next)
+    {
+        if (block->size == 0)
+            continue;
+        if (!evictcurrent && block->lastused == texturecacheclock)
+            continue;
+        if (oldest == NULL
+         || texturecacheclock - block->lastused
+          > texturecacheclock - oldest->lastused)
+        {
+            oldest = block;
+        }
+    }
+
+    if (oldest == NULL)
+    {
+        return false;
+    }
+
+    FreeBlock(oldest);
+    ++texcacheevictions;
+
+    return true;
+}
+
+void *R_TextureCacheAlloc(int size, byte **user, boolean evictcurrent)
+{
+    texcacheblock_t *block;
+    texcacheblock_t *rest;
+    int space;
+
+    size = (size + sizeof(texcacheblock_t) + TEXCACHE_ALIGN - 1)
+         & ~(TEXCACHE_ALIGN - 1);
+
+    if (size > texcachesize)
+    {
+        I_Error("R_TextureCacheAlloc: %i bytes does not fit in the "
+                "texture cache", size);
+    }
+
+    while ((block = FindFreeBlock(size)) == NULL)
+    {
+        if (!EvictBlock(false) && !(evictcurrent && EvictBlock(true)))
+        {
+            return NULL;
+        }
+    }
+
+    // Split off the remainder if it is big enough to be useful.
+
+    space = BlockSize(block);
+
+    if (space - size > (int) sizeof(texcacheblock_t) + TEXCACHE_ALIGN)
+    {
+        rest = (texcacheblock_t *) ((byte *) block + size);
+        rest->size = 0;
+        rest->user = NULL;
+        rest->prev = block;
+        rest->next = block->next;
+        if (rest->next != NULL)
+            rest->next->prev = rest;
+        block->next = rest;
+        space = size;
+    }
+
+    block->size = space;
+    block->user = user;
+    block->lastused = texturecacheclock;
+
+    texcacheused += space;
+    if (texcacheused > texcachepeak)
+        texcachepeak = texcacheused;
+    ++texcacheallocs;
+
+    *user = (byte *) (block + 1);
+
+    return block + 1;
+}
+
+void R_TextureCacheFrame(void)
+{
+    ++texturecacheclock;
+}
+
+void R_PrintTextureCacheStats(void)
+{
+    d_printf("texture cache: %i composites built, %i evicted, "
+             "%i/%i KiB used, %i KiB peak\n",
+             texcacheallocs, texcacheevictions,
+             texcacheused / 1024, texcachesize / 1024, texcachepeak / 1024);
+}
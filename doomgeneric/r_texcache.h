@@ -0,0 +1,56 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Composite texture cache.
+//	A fixed memory budget outside the zone, so composites survive
+//	level changes and are only thrown out least recently used first.
+//
+
+
+#ifndef __R_TEXCACHE__
+#define __R_TEXCACHE__
+
+#include "doomtype.h"
+
+typedef struct texcacheblock_s
+{
+    int size;                   // including the header, 0 if free
+    unsigned int lastused;      // texturecacheclock when last drawn
+    byte **user;                // cleared when the block is evicted
+    struct texcacheblock_s *prev;
+    struct texcacheblock_s *next;
+} texcacheblock_t;
+
+// Advanced once per rendered frame.
+extern unsigned int texturecacheclock;
+
+// Mark a composite as used this frame.
+#define R_TouchTextureCache(ptr) \
+    (((texcacheblock_t *) (ptr) - 1)->lastused = texturecacheclock)
+
+struct doom_data_t_;
+
+void R_InitTextureCache(struct doom_data_t_ *doom);
+
+// Allocate a composite and point *user at it.  Blocks not used this
+// frame are evicted first.  If that is not enough, blocks used this
+// frame are evicted too when evictcurrent is set; otherwise NULL is
+// returned.
+void *R_TextureCacheAlloc(int size, byte **user, boolean evictcurrent);
+
+void R_TextureCacheFrame(void);
+void R_PrintTextureCacheStats(void);
+
+#endif
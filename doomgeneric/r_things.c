@@ -150,9 +150,22 @@ void R_InstallSpriteLump(int lump,
 //  letter/number appended.
 // The rotation character can be 0 to signify no rotations.
 //
+// Slot for the 4-character prefix of a lump name key in a table of
+// size entries (a power of two).
+static unsigned int SpritePrefixSlot(uint64_t key, unsigned int size)
+{
+    return W_LumpKeyHash(key & 0xffffffff) & (size - 1);
+}
+
 void R_InitSpriteDefs(doom_data_t *doom, char **namelist)
 {
     char **check;
+    int *prefixhead;
+    int *prefixnext;
+    uint64_t prefix;
+    unsigned int hashsize;
+    unsigned int slot;
+    int numlumps;
     int i;
     int l;
     int frame;
@@ -176,9 +189,34 @@ void R_InitSpriteDefs(doom_data_t *doom, char **namelist)
     start = firstspritelump - 1;
     end = lastspritelump + 1;
 
-    // scan all the lump names for each of the names,
+    // Group the sprite lumps by their first 4 characters in one pass:
+    //  an open-addressed table from prefix to the first lump with it,
+    //  and a chain through the rest in directory order.
+    numlumps = end - start - 1;
+
+    for (hashsize = 16; hashsize < numlumps * 2; hashsize <<= 1);
+
+    prefixhead = Z_Malloc(hashsize * sizeof(*prefixhead), PU_STATIC, NULL);
+    prefixnext = Z_Malloc((numlumps + 1) * sizeof(*prefixnext), PU_STATIC, NULL);
+    d_memset(prefixhead, 0xff, hashsize * sizeof(*prefixhead));
+
+    for (l = end - 1; l > start; l--)
+    {
+        slot = SpritePrefixSlot(doom->lumpinfo[l].key, hashsize);
+
+        while (prefixhead[slot] >= 0
+            && (doom->lumpinfo[prefixhead[slot]].key & 0xffffffff)
+                != (doom->lumpinfo[l].key & 0xffffffff))
+        {
+            slot = (slot + 1) & (hashsize - 1);
+        }
+
+        prefixnext[l - start] = prefixhead[slot];
+        prefixhead[slot] = l;
+    }
+
+    // For each of the names, walk its lumps,
     //  noting the highest frame letter.
-    // Just compare 4 characters as ints
     for (i = 0; i < numsprites; i++)
     {
         spritename = DEH_String(namelist[i]);
@@ -186,28 +224,33 @@ void R_InitSpriteDefs(doom_data_t *doom, char **namelist)
 
         maxframe = -1;
 
-        // scan the lumps,
-        //  filling in the frames for whatever is found
-        for (l = start + 1; l < end; l++)
+        prefix = W_LumpNameKey(spritename) & 0xffffffff;
+        slot = SpritePrefixSlot(prefix, hashsize);
+
+        while (prefixhead[slot] >= 0
+            && (doom->lumpinfo[prefixhead[slot]].key & 0xffffffff) != prefix)
+        {
+            slot = (slot + 1) & (hashsize - 1);
+        }
+
+        // filling in the frames for whatever is found
+        for (l = prefixhead[slot]; l >= 0; l = prefixnext[l - start])
         {
-            if (!d_strnicmp(doom->lumpinfo[l].name, spritename, 4))
+            frame = doom->lumpinfo[l].name[4] - 'A';
+            rotation = doom->lumpinfo[l].name[5] - '0';
+
+            if (doom->modifiedgame)
+                patched = W_GetNumForName(doom, doom->lumpinfo[l].name);
+            else
+                patched = l;
+
+            R_InstallSpriteLump(patched, frame, rotation, false);
+
+            if (doom->lumpinfo[l].name[6])
             {
-                frame = doom->lumpinfo[l].name[4] - 'A';
-                rotation = doom->lumpinfo[l].name[5] - '0';
-
-                if (doom->modifiedgame)
-                    patched = W_GetNumForName(doom, doom->lumpinfo[l].name);
-                else
-                    patched = l;
-
-                R_InstallSpriteLump(patched, frame, rotation, false);
-
-                if (doom->lumpinfo[l].name[6])
-                {
-                    frame = doom->lumpinfo[l].name[6] - 'A';
-                    rotation = doom->lumpinfo[l].name[7] - '0';
-                    R_InstallSpriteLump(l, frame, rotation, true);
-                }
+                frame = doom->lumpinfo[l].name[6] - 'A';
+                rotation = doom->lumpinfo[l].name[7] - '0';
+                R_InstallSpriteLump(l, frame, rotation, true);
             }
         }
 
@@ -252,6 +295,9 @@ void R_InitSpriteDefs(doom_data_t *doom, char **namelist)
             Z_Malloc(maxframe * sizeof(spriteframe_t), PU_STATIC, NULL);
         d_memcpy(sprites[i].spriteframes, sprtemp, maxframe * sizeof(spriteframe_t));
     }
+
+    Z_Free(prefixnext);
+    Z_Free(prefixhead);
 }
 
 //
@@ -341,6 +387,10 @@ void R_DrawMaskedColumn(column_t *column)
             dc_texturemid = basetexturemid - (column->topdelta << FRACBITS);
             // dc_source = (byte *)column + 3 - column->topdelta;
 
+            // The fuzz drawers move dc_yl and dc_yh.
+            if (observing)
+                R_ObserveColumn(dc_x, dc_yl, dc_yh, spryscale);
+
             // Drawn by either R_DrawColumn
             //  or (SHADOW) R_DrawFuzzColumn.
             colfunc();
@@ -387,6 +437,9 @@ void R_DrawVisSprite(struct doom_data_t_* doom,
     spryscale = vis->scale;
     sprtopscreen = centeryfrac - FixedMul(dc_texturemid, spryscale);
 
+    if (observing)
+        R_ObserveSprite(vis->mobj);
+
     for (dc_x = vis->x1; dc_x <= vis->x2; dc_x++, frac += vis->xiscale)
     {
         texturecolumn = frac >> FRACBITS;
@@ -400,6 +453,7 @@ void R_DrawVisSprite(struct doom_data_t_* doom,
     }
 
     colfunc = basecolfunc;
+    obslabel = 0;
 }
 
 //
@@ -506,6 +560,7 @@ void R_ProjectSprite(mobj_t *thing)
 
     // store information in a vissprite
     vis = R_NewVisSprite();
+    vis->mobj = thing;
     vis->mobjflags = thing->flags;
     vis->scale = xscale << detailshift;
     vis->gx = thing->x;
@@ -645,6 +700,7 @@ void R_DrawPSprite(struct doom_data_t_* doom, pspdef_t *psp)
 
     // store information in a vissprite
     vis = &avis;
+    vis->mobj = NULL;
     vis->mobjflags = 0;
     vis->texturemid = (BASEYCENTER << FRACBITS) + FRACUNIT / 2 - (psp->sy - spritetopoffset[lump]);
     vis->x1 = x1 < 0 ? 0 : x1;
@@ -916,6 +972,9 @@ void R_DrawMasked(struct doom_data_t_* doom)
 
     // draw the psprites on top of everything
     //  but does not draw on side views
+    //  (the observation buffers show the world without them)
+    observing = false;
+
     if (!viewangleoffset)
         R_DrawPlayerSprites(doom);
 }
@@ -33,8 +33,28 @@
 #include "i_swap.h"
 #include "sha1.h"
 
+#ifdef SHA1_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*sha1_transform_t)(sha1_context_t *hd, const byte *data, size_t nblocks);
+
+static void TransformScalar(sha1_context_t *hd, const byte *data, size_t nblocks);
+
+// Block transform in use, set by SHA1_SetImpl; the first SHA1_Init
+// picks the best one if nothing has.
+
+static sha1_transform_t transform = NULL;
+static sha1_impl_t transformimpl = SHA1_SCALAR;
+
 void SHA1_Init(sha1_context_t *hd)
 {
+    if (transform == NULL)
+    {
+        SHA1_SetImpl(SHA1_BestImpl());
+    }
+
     hd->h0 = 0x67452301;
     hd->h1 = 0xefcdab89;
     hd->h2 = 0x98badcfe;
@@ -47,7 +67,7 @@ void SHA1_Init(sha1_context_t *hd)
 /****************
  * Transform the message X which consists of 16 32-bit-words
  */
-static void Transform(sha1_context_t *hd, byte *data)
+static void Transform(sha1_context_t *hd, const byte *data)
 {
     uint32_t a, b, c, d, e, tm;
     uint32_t x[16];
@@ -183,6 +203,298 @@ static void Transform(sha1_context_t *hd, byte *data)
     hd->h4 += e;
 }
 
+static void TransformScalar(sha1_context_t *hd, const byte *data, size_t nblocks)
+{
+    for (; nblocks > 0; --nblocks, data += 64)
+    {
+        Transform(hd, data);
+    }
+}
+
+#ifdef SHA1_SIMD
+
+/*
+ * SSSE3: the message schedule four words at a time, with the round
+ * constants added, then the rounds as above from the result.
+ *
+ * W[t..t+3] = rol1(W[t-3..t] ^ W[t-8..t-5] ^ W[t-14..t-11] ^ W[t-16..t-13])
+ * needs W[t] in its top lane before it exists, so that lane is done
+ * with zero in its place and fixed up after: rol1(x ^ W[t]) is
+ * rol1(x) ^ rol1(W[t]).
+ */
+__attribute__((target("ssse3")))
+static void TransformSSSE3(sha1_context_t *hd, const byte *data, size_t nblocks)
+{
+    uint32_t a, b, c, d, e;
+    uint32_t wk[80];
+    __m128i w[20], x, fix;
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const uint32_t k[4] = {K1, K2, K3, K4};
+    int i;
+
+    for (; nblocks > 0; --nblocks, data += 64)
+    {
+        for (i = 0; i < 4; ++i)
+        {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), bswap);
+        }
+
+        for (i = 4; i < 20; ++i)
+        {
+            x = _mm_xor_si128(_mm_xor_si128(_mm_srli_si128(w[i - 1], 4), w[i - 2]),
+                              _mm_xor_si128(_mm_alignr_epi8(w[i - 3], w[i - 4], 8), w[i - 4]));
+            x = _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+            fix = _mm_slli_si128(x, 12);
+            w[i] = _mm_xor_si128(x, _mm_or_si128(_mm_slli_epi32(fix, 1), _mm_srli_epi32(fix, 31)));
+        }
+
+        for (i = 0; i < 20; ++i)
+        {
+            _mm_storeu_si128((__m128i *)&wk[i * 4], _mm_add_epi32(w[i], _mm_set1_epi32(k[i / 5])));
+        }
+
+        a = hd->h0;
+        b = hd->h1;
+        c = hd->h2;
+        d = hd->h3;
+        e = hd->h4;
+
+#define RK(a, b, c, d, e, f, i)              \
+    do                                       \
+    {                                        \
+        e += rol(a, 5) + f(b, c, d) + wk[i]; \
+        b = rol(b, 30);                      \
+    } while (0)
+#define RK5(f, i)                  \
+    RK(a, b, c, d, e, f, i);       \
+    RK(e, a, b, c, d, f, i + 1);   \
+    RK(d, e, a, b, c, f, i + 2);   \
+    RK(c, d, e, a, b, f, i + 3);   \
+    RK(b, c, d, e, a, f, i + 4)
+
+        RK5(F1, 0);  RK5(F1, 5);  RK5(F1, 10); RK5(F1, 15);
+        RK5(F2, 20); RK5(F2, 25); RK5(F2, 30); RK5(F2, 35);
+        RK5(F3, 40); RK5(F3, 45); RK5(F3, 50); RK5(F3, 55);
+        RK5(F4, 60); RK5(F4, 65); RK5(F4, 70); RK5(F4, 75);
+
+#undef RK5
+#undef RK
+
+        hd->h0 += a;
+        hd->h1 += b;
+        hd->h2 += c;
+        hd->h3 += d;
+        hd->h4 += e;
+    }
+}
+
+/*
+ * SHA extensions: four rounds an instruction.  ABCD holds a in its
+ * top lane down to d; E holds e in its top lane, and each group's
+ * message words are added to it on the way into the next group.
+ * Message words for group g + 1 to g + 3 are built up from group g's
+ * as the rounds go.
+ */
+
+#define SHA_ROUNDS(f, e, enext, m)          \
+    e = _mm_sha1nexte_epu32(e, m);          \
+    enext = abcd;                           \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f)
+
+#define SHA_SCHEDULE(m, m1, m2, m3)         \
+    m1 = _mm_sha1msg2_epu32(m1, m);         \
+    m2 = _mm_xor_si128(m2, m);              \
+    m3 = _mm_sha1msg1_epu32(m3, m)
+
+__attribute__((target("sha,ssse3")))
+static void TransformSHANI(sha1_context_t *hd, const byte *data, size_t nblocks)
+{
+    __m128i abcd, abcdsave, e0, e0save, e1;
+    __m128i m0, m1, m2, m3;
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    uint32_t out[4];
+
+    abcd = _mm_set_epi32(hd->h0, hd->h1, hd->h2, hd->h3);
+    e0 = _mm_set_epi32(hd->h4, 0, 0, 0);
+
+    for (; nblocks > 0; --nblocks, data += 64)
+    {
+        abcdsave = abcd;
+        e0save = e0;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), bswap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), bswap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), bswap);
+
+        // 0-15
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        SHA_ROUNDS(0, e1, e0, m1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        SHA_ROUNDS(0, e0, e1, m2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+        SHA_ROUNDS(0, e1, e0, m3);
+        SHA_SCHEDULE(m3, m0, m1, m2);
+
+        // 16-31
+        SHA_ROUNDS(0, e0, e1, m0);
+        SHA_SCHEDULE(m0, m1, m2, m3);
+        SHA_ROUNDS(1, e1, e0, m1);
+        SHA_SCHEDULE(m1, m2, m3, m0);
+        SHA_ROUNDS(1, e0, e1, m2);
+        SHA_SCHEDULE(m2, m3, m0, m1);
+        SHA_ROUNDS(1, e1, e0, m3);
+        SHA_SCHEDULE(m3, m0, m1, m2);
+
+        // 32-47
+        SHA_ROUNDS(1, e0, e1, m0);
+        SHA_SCHEDULE(m0, m1, m2, m3);
+        SHA_ROUNDS(1, e1, e0, m1);
+        SHA_SCHEDULE(m1, m2, m3, m0);
+        SHA_ROUNDS(2, e0, e1, m2);
+        SHA_SCHEDULE(m2, m3, m0, m1);
+        SHA_ROUNDS(2, e1, e0, m3);
+        SHA_SCHEDULE(m3, m0, m1, m2);
+
+        // 48-63
+        SHA_ROUNDS(2, e0, e1, m0);
+        SHA_SCHEDULE(m0, m1, m2, m3);
+        SHA_ROUNDS(2, e1, e0, m1);
+        SHA_SCHEDULE(m1, m2, m3, m0);
+        SHA_ROUNDS(2, e0, e1, m2);
+        SHA_SCHEDULE(m2, m3, m0, m1);
+        SHA_ROUNDS(3, e1, e0, m3);
+        SHA_SCHEDULE(m3, m0, m1, m2);
+
+        // 64-79, finishing the last words.
+        SHA_ROUNDS(3, e0, e1, m0);
+        SHA_SCHEDULE(m0, m1, m2, m3);
+        SHA_ROUNDS(3, e1, e0, m1);
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        m3 = _mm_xor_si128(m3, m1);
+        SHA_ROUNDS(3, e0, e1, m2);
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        SHA_ROUNDS(3, e1, e0, m3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0save);
+        abcd = _mm_add_epi32(abcd, abcdsave);
+    }
+
+    _mm_storeu_si128((__m128i *)out, abcd);
+    hd->h0 = out[3];
+    hd->h1 = out[2];
+    hd->h2 = out[1];
+    hd->h3 = out[0];
+    _mm_storeu_si128((__m128i *)out, e0);
+    hd->h4 = out[3];
+}
+
+#undef SHA_SCHEDULE
+#undef SHA_ROUNDS
+
+#endif // SHA1_SIMD
+
+boolean SHA1_HaveImpl(sha1_impl_t impl)
+{
+#ifdef SHA1_SIMD
+    unsigned int eax, ebx, ecx, edx;
+#endif
+
+    if (impl == SHA1_SCALAR)
+    {
+        return true;
+    }
+
+#ifdef SHA1_SIMD
+    __cpuid(1, eax, ebx, ecx, edx);
+
+    if (!(ecx & bit_SSSE3))
+    {
+        return false;
+    }
+
+    if (impl == SHA1_SSSE3)
+    {
+        return true;
+    }
+
+    if (impl == SHA1_SHANI && __get_cpuid_max(0, NULL) >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        return (ebx & bit_SHA) != 0;
+    }
+#endif
+
+    return false;
+}
+
+sha1_impl_t SHA1_BestImpl(void)
+{
+    if (SHA1_HaveImpl(SHA1_SHANI))
+    {
+        return SHA1_SHANI;
+    }
+    else if (SHA1_HaveImpl(SHA1_SSSE3))
+    {
+        return SHA1_SSSE3;
+    }
+
+    return SHA1_SCALAR;
+}
+
+boolean SHA1_SetImpl(sha1_impl_t impl)
+{
+    if (!SHA1_HaveImpl(impl))
+    {
+        return false;
+    }
+
+    switch (impl)
+    {
+#ifdef SHA1_SIMD
+    case SHA1_SHANI:
+        transform = TransformSHANI;
+        break;
+    case SHA1_SSSE3:
+        transform = TransformSSSE3;
+        break;
+#endif
+    default:
+        transform = TransformScalar;
+        break;
+    }
+
+    transformimpl = impl;
+
+    return true;
+}
+
+sha1_impl_t SHA1_GetImpl(void)
+{
+    if (transform == NULL)
+    {
+        SHA1_SetImpl(SHA1_BestImpl());
+    }
+
+    return transformimpl;
+}
+
+const char *SHA1_ImplName(sha1_impl_t impl)
+{
+    switch (impl)
+    {
+    case SHA1_SHANI:
+        return "SHA-NI";
+    case SHA1_SSSE3:
+        return "SSSE3";
+    default:
+        return "scalar";
+    }
+}
+
 /* Update the message digest with the contents
  * of INBUF with length INLEN.
  */
@@ -191,7 +503,7 @@ void SHA1_Update(sha1_context_t *hd, byte *inbuf, size_t inlen)
     if (hd->count == 64)
     {
         /* flush the buffer */
-        Transform(hd, hd->buf);
+        transform(hd, hd->buf, 1);
         hd->count = 0;
         hd->nblocks++;
     }
@@ -206,13 +518,13 @@ void SHA1_Update(sha1_context_t *hd, byte *inbuf, size_t inlen)
             return;
     }
 
-    while (inlen >= 64)
+    if (inlen >= 64)
     {
-        Transform(hd, inbuf);
+        transform(hd, inbuf, inlen / 64);
         hd->count = 0;
-        hd->nblocks++;
-        inlen -= 64;
-        inbuf += 64;
+        hd->nblocks += inlen / 64;
+        inbuf += inlen & ~(size_t)63;
+        inlen &= 63;
     }
     for (; inlen && hd->count < 64; inlen--)
         hd->buf[hd->count++] = *inbuf++;
@@ -273,7 +585,7 @@ void SHA1_Final(sha1_digest_t digest, sha1_context_t *hd)
     hd->buf[61] = lsb >> 16;
     hd->buf[62] = lsb >> 8;
     hd->buf[63] = lsb;
-    Transform(hd, hd->buf);
+    transform(hd, hd->buf, 1);
 
     p = hd->buf;
 #ifdef SYS_BIG_ENDIAN
@@ -31,6 +31,29 @@ struct sha1_context_s {
     int count;
 };
 
+// Block transforms, all giving the same digests.  The first
+// SHA1_Init picks the best this CPU has.
+typedef enum
+{
+    SHA1_SCALAR,
+    SHA1_SSSE3,
+    SHA1_SHANI,
+    NUM_SHA1_IMPLS
+} sha1_impl_t;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SHA1_SIMD
+#endif
+
+boolean SHA1_HaveImpl(sha1_impl_t impl);
+sha1_impl_t SHA1_BestImpl(void);
+const char *SHA1_ImplName(sha1_impl_t impl);
+
+// Use impl from now on.  Returns false, changing nothing, if this
+// CPU does not have it.
+boolean SHA1_SetImpl(sha1_impl_t impl);
+sha1_impl_t SHA1_GetImpl(void);
+
 void SHA1_Init(sha1_context_t *context);
 void SHA1_Update(sha1_context_t *context, byte *buf, size_t len);
 void SHA1_Final(sha1_digest_t digest, sha1_context_t *context);
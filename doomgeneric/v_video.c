@@ -98,6 +98,296 @@ void V_SetPatchClipCallback(doom_data_t* doom, vpatchclipfunc_t func)
     doom->patchclip_callback = func;
 }
 
+//
+// Decoded patches.
+//
+// The first time a patch from a lump is drawn, its columns of posts
+// are turned into rows of opaque runs, so it can be drawn a row at a
+// time with one copy per run.  Decoded patches are PU_CACHE blocks,
+// one per lump, so they outlive the lump being purged and are thrown
+// out like any other cached data when memory runs short.
+//
+
+typedef struct
+{
+    short x;        // column the run starts in
+    short length;
+    int ofs;        // of its pixels, from the start of the pixels
+} vrun_t;
+
+typedef struct
+{
+    short width;
+    short height;   // rows the posts reach, at least the patch height
+    int numruns;
+
+    // Followed by int firstrun[height + 1], the index of the first run
+    // in each row, vrun_t runs[numruns] and then the run pixels.
+} vpatch_t;
+
+#define VPATCH_FIRSTRUN(vp) ((int *) ((vp) + 1))
+#define VPATCH_RUNS(vp) ((vrun_t *) (VPATCH_FIRSTRUN(vp) + (vp)->height + 1))
+#define VPATCH_PIXELS(vp) ((byte *) (VPATCH_RUNS(vp) + (vp)->numruns))
+
+// Patches whose rows average shorter runs than this are quicker to
+// draw by columns, and are left alone.
+
+#define VPATCH_MINRUN 3
+
+// The column drawers draw every post in full, even past the patch
+// height, so a decoded patch has as many rows as its posts reach: at
+// most a top delta of 254 and a length of 255.
+
+#define VPATCH_MAXROWS (254 + 255)
+
+static vpatch_t **vpatches;
+static unsigned int numvpatches;
+
+// The lump a patch was cached from, found through the owner of its
+// zone block, or -1 if it is not a cached lump.
+
+static int PatchLump(doom_data_t *doom, patch_t *patch, int *tag)
+{
+    void **user;
+    uintptr_t offset;
+    unsigned int lump;
+
+    user = Z_GetUser(patch, tag);
+
+    if (user == NULL || doom->lumpinfo == NULL)
+    {
+        return -1;
+    }
+
+    offset = (uintptr_t) user - (uintptr_t) &doom->lumpinfo[0].cache;
+    lump = offset / sizeof(lumpinfo_t);
+
+    if (offset % sizeof(lumpinfo_t) != 0 || lump >= doom->numlumps
+     || doom->lumpinfo[lump].cache != patch)
+    {
+        return -1;
+    }
+
+    return lump;
+}
+
+static vpatch_t *DecodePatch(patch_t *patch, vpatch_t **user)
+{
+    static byte pixels[SCREENWIDTH * VPATCH_MAXROWS];
+    static byte opaque[SCREENWIDTH * VPATCH_MAXROWS];
+    column_t *column;
+    vpatch_t *vp;
+    vrun_t *run;
+    byte *dest;
+    int *firstrun;
+    int w, h;
+    int x, y, i;
+    int numruns, numpixels;
+
+    w = SHORT(patch->width);
+    h = SHORT(patch->height);
+
+    if (w <= 0 || h <= 0 || w > SCREENWIDTH || h > SCREENHEIGHT)
+    {
+        return NULL;
+    }
+
+    // Rows down to the end of the lowest post.
+
+    for (x = 0; x < w; x++)
+    {
+        column = (column_t *)((byte *)patch + LONG(patch->columnofs[x]));
+
+        while (column->topdelta != 0xff)
+        {
+            if (column->topdelta + column->length > h)
+                h = column->topdelta + column->length;
+
+            column = (column_t *)((byte *)column + column->length + 4);
+        }
+    }
+
+    d_memset(opaque, 0, w * h);
+
+    for (x = 0; x < w; x++)
+    {
+        column = (column_t *)((byte *)patch + LONG(patch->columnofs[x]));
+
+        while (column->topdelta != 0xff)
+        {
+            for (i = 0; i < column->length; i++)
+            {
+                y = column->topdelta + i;
+                pixels[y * w + x] = ((byte *) column)[3 + i];
+                opaque[y * w + x] = 1;
+            }
+
+            column = (column_t *)((byte *)column + column->length + 4);
+        }
+    }
+
+    numruns = 0;
+    numpixels = 0;
+
+    for (i = 0; i < w * h; i++)
+    {
+        if (opaque[i])
+        {
+            numpixels++;
+
+            if (i % w == 0 || !opaque[i - 1])
+                numruns++;
+        }
+    }
+
+    // A patch left in columns is remembered with numruns -1, so it is
+    // not looked at again.
+
+    if (numpixels < numruns * VPATCH_MINRUN)
+    {
+        vp = Z_Malloc(sizeof(vpatch_t), PU_CACHE, user);
+        vp->width = w;
+        vp->height = h;
+        vp->numruns = -1;
+        return vp;
+    }
+
+    vp = Z_Malloc(sizeof(vpatch_t) + (h + 1) * sizeof(int)
+                + numruns * sizeof(vrun_t) + numpixels, PU_CACHE, user);
+    vp->width = w;
+    vp->height = h;
+    vp->numruns = numruns;
+
+    firstrun = VPATCH_FIRSTRUN(vp);
+    run = VPATCH_RUNS(vp);
+    dest = VPATCH_PIXELS(vp);
+
+    for (y = 0; y < h; y++)
+    {
+        firstrun[y] = run - VPATCH_RUNS(vp);
+
+        for (x = 0; x < w; x++)
+        {
+            if (!opaque[y * w + x])
+                continue;
+
+            run->x = x;
+            run->ofs = dest - VPATCH_PIXELS(vp);
+
+            while (x < w && opaque[y * w + x])
+            {
+                *dest++ = pixels[y * w + x];
+                x++;
+            }
+
+            run->length = dest - VPATCH_PIXELS(vp) - run->ofs;
+            run++;
+        }
+    }
+
+    firstrun[h] = numruns;
+
+    return vp;
+}
+
+// The decoded form of a patch, or NULL if it is not from a lump or
+// is best drawn by columns.
+
+static vpatch_t *V_DecodedPatch(doom_data_t *doom, patch_t *patch)
+{
+    unsigned int i;
+    int lump, tag;
+
+    lump = PatchLump(doom, patch, &tag);
+
+    if (lump < 0)
+    {
+        return NULL;
+    }
+
+    if (numvpatches != doom->numlumps || vpatches[lump] == NULL)
+    {
+        // The caller may only hold the patch at PU_CACHE; keep it
+        // from being purged by the allocations below.
+
+        if (tag >= PU_PURGELEVEL)
+        {
+            Z_ChangeTag(patch, PU_STATIC);
+        }
+
+        if (numvpatches != doom->numlumps)
+        {
+            for (i = 0; i < numvpatches; ++i)
+            {
+                if (vpatches[i] != NULL)
+                    Z_Free(vpatches[i]);
+            }
+
+            if (vpatches != NULL)
+                Z_Free(vpatches);
+
+            vpatches = Z_Malloc(doom->numlumps * sizeof(*vpatches), PU_STATIC, NULL);
+            d_memset(vpatches, 0, doom->numlumps * sizeof(*vpatches));
+            numvpatches = doom->numlumps;
+        }
+
+        DecodePatch(patch, &vpatches[lump]);
+
+        if (tag >= PU_PURGELEVEL)
+        {
+            Z_ChangeTag(patch, tag);
+        }
+    }
+
+    if (vpatches[lump] != NULL && vpatches[lump]->numruns < 0)
+    {
+        return NULL;
+    }
+
+    return vpatches[lump];
+}
+
+static void DrawRuns(byte *desttop, vpatch_t *vp, boolean flipped)
+{
+    int *firstrun = VPATCH_FIRSTRUN(vp);
+    vrun_t *runs = VPATCH_RUNS(vp);
+    byte *pixels = VPATCH_PIXELS(vp);
+    byte *source;
+    byte *dest;
+    int y, r, count;
+
+    for (y = 0; y < vp->height; y++, desttop += SCREENWIDTH)
+    {
+        for (r = firstrun[y]; r < firstrun[y + 1]; r++)
+        {
+            source = pixels + runs[r].ofs;
+            count = runs[r].length;
+
+            if (flipped)
+            {
+                dest = desttop + vp->width - 1 - runs[r].x;
+
+                for (; count > 0; count--)
+                    *dest-- = *source++;
+            }
+            else if (count >= 16)
+            {
+                d_memcpy(desttop + runs[r].x, source, count);
+            }
+            else
+            {
+                // Font and menu graphics are mostly short runs, not
+                // worth a call each.
+
+                dest = desttop + runs[r].x;
+
+                for (; count > 0; count--)
+                    *dest++ = *source++;
+            }
+        }
+    }
+}
+
 //
 // V_DrawPatch
 // Masks a column based masked pic to the screen.
@@ -111,6 +401,7 @@ void V_DrawPatch(doom_data_t* doom, int x, int y, patch_t *patch)
     byte *desttop;
     byte *dest;
     byte *source;
+    vpatch_t *vp;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -135,6 +426,14 @@ void V_DrawPatch(doom_data_t* doom, int x, int y, patch_t *patch)
     col = 0;
     desttop = doom->dest_screen + y * SCREENWIDTH + x;
 
+    vp = V_DecodedPatch(doom, patch);
+
+    if (vp != NULL)
+    {
+        DrawRuns(desttop, vp, false);
+        return;
+    }
+
     w = SHORT(patch->width);
 
     for (; col < w; x++, col++, desttop++)
@@ -172,6 +471,7 @@ void V_DrawPatchFlipped(doom_data_t* doom, int x, int y, patch_t *patch)
     byte *desttop;
     byte *dest;
     byte *source;
+    vpatch_t *vp;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -196,6 +496,14 @@ void V_DrawPatchFlipped(doom_data_t* doom, int x, int y, patch_t *patch)
     col = 0;
     desttop = doom->dest_screen + y * SCREENWIDTH + x;
 
+    vp = V_DecodedPatch(doom, patch);
+
+    if (vp != NULL)
+    {
+        DrawRuns(desttop, vp, true);
+        return;
+    }
+
     w = SHORT(patch->width);
 
     for (; col < w; x++, col++, desttop++)
@@ -547,6 +855,65 @@ void V_Init(struct doom_data_t_* doom)
     // now handled in the upper layers.
 }
 
+//
+// V_BeginLayer
+// Layers are whole screens kept between frames, for backgrounds that
+// take several draws to build but rarely change.
+//
+
+boolean V_BeginLayer(doom_data_t* doom, vlayer_t *layer, unsigned int key)
+{
+    boolean redraw;
+
+    redraw = layer->pixels == NULL || layer->key != key;
+
+    if (layer->pixels == NULL)
+    {
+        Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, &layer->pixels);
+    }
+    else
+    {
+        // Hold on to it while it is being drawn into.
+
+        Z_ChangeTag(layer->pixels, PU_STATIC);
+    }
+
+    layer->key = key;
+    layer->screen = doom->dest_screen;
+
+    if (redraw)
+    {
+        doom->dest_screen = layer->pixels;
+    }
+
+    return redraw;
+}
+
+//
+// V_EndLayer
+//
+
+void V_EndLayer(doom_data_t* doom, vlayer_t *layer)
+{
+    doom->dest_screen = layer->screen;
+    d_memcpy(doom->dest_screen, layer->pixels, SCREENWIDTH * SCREENHEIGHT);
+    V_MarkRect(doom, 0, 0, SCREENWIDTH, SCREENHEIGHT);
+
+    Z_ChangeTag(layer->pixels, PU_CACHE);
+}
+
+//
+// V_FreeLayer
+//
+
+void V_FreeLayer(vlayer_t *layer)
+{
+    if (layer->pixels != NULL)
+    {
+        Z_Free(layer->pixels);
+    }
+}
+
 // Set the buffer that the code draws to.
 
 void V_UseBuffer(doom_data_t* doom, byte *buffer)
@@ -74,6 +74,24 @@ void V_DrawBox(struct doom_data_t_* doom, int x, int y, int w, int h, int c);
 
 void V_DrawRawScreen(struct doom_data_t_* doom, byte *raw);
 
+// A whole screen kept between frames.  V_BeginLayer returns true
+// when its contents must be drawn again, because it is new, was
+// purged or key has changed, and sends drawing to it until
+// V_EndLayer, which copies it to the screen.
+
+typedef struct
+{
+    byte *pixels;
+    unsigned int key;
+    byte *screen;
+} vlayer_t;
+
+boolean V_BeginLayer(struct doom_data_t_* doom, vlayer_t *layer, unsigned int key);
+void V_EndLayer(struct doom_data_t_* doom, vlayer_t *layer);
+
+// Drops a layer's contents, for when what it shows is about to go.
+void V_FreeLayer(vlayer_t *layer);
+
 // Temporarily switch to using a different buffer to draw graphics, etc.
 
 void V_UseBuffer(struct doom_data_t_* doom, byte *buffer);
@@ -13,13 +13,19 @@
 // GNU General Public License for more details.
 //
 // DESCRIPTION:
-//       Generate a checksum of the WAD directory.
+//       Generate a checksum of the WAD directory, or of everything
+//       in the WADs.
 //
 
+#include "dlibc.h"
+
 #include "doomdef.h"
+#include "i_system.h"
+#include "i_timer.h"
 #include "z_zone.h"
 #include "m_misc.h"
 #include "sha1.h"
+#include "w_file.h"
 #include "w_checksum.h"
 #include "w_wad.h"
 
@@ -85,3 +91,79 @@ void W_Checksum(struct doom_data_t_* doom, sha1_digest_t digest)
 
     SHA1_Final(digest, &sha1_context);
 }
+
+// Lump data is read through this much at a time unless the file is
+// mapped.
+#define CONTENTCHUNK 65536
+
+static void ContentsAddLump(sha1_context_t *sha1_context, lumpinfo_t *lump,
+                            byte *chunk)
+{
+    char buf[9];
+    unsigned int pos, length;
+
+    M_StringCopy(buf, lump->name, sizeof(buf));
+    SHA1_UpdateString(sha1_context, buf);
+    SHA1_UpdateInt32(sha1_context, lump->size);
+
+    if (lump->wad_file->mapped != NULL)
+    {
+        SHA1_Update(sha1_context, lump->wad_file->mapped + lump->position,
+                    lump->size);
+        return;
+    }
+
+    for (pos = 0; pos < (unsigned int) lump->size; pos += length)
+    {
+        length = lump->size - pos;
+
+        if (length > CONTENTCHUNK)
+        {
+            length = CONTENTCHUNK;
+        }
+
+        if (W_Read(lump->wad_file, lump->position + pos, chunk, length) < length)
+        {
+            I_Error("W_ChecksumContents: couldn't read lump %.8s", lump->name);
+        }
+
+        SHA1_Update(sha1_context, chunk, length);
+    }
+}
+
+void W_ChecksumContents(struct doom_data_t_* doom, sha1_digest_t digest)
+{
+    sha1_context_t sha1_context;
+    byte *chunk;
+    uint64_t start, bytes;
+    unsigned int i;
+    int us;
+
+    start = I_GetTimeUS();
+    bytes = 0;
+
+    SHA1_Init(&sha1_context);
+    chunk = Z_Malloc(CONTENTCHUNK, PU_STATIC, NULL);
+
+    // The name, size and data of every lump, in directory order, but
+    // not where in which file it is.
+
+    for (i = 0; i < doom->numlumps; ++i)
+    {
+        ContentsAddLump(&sha1_context, &doom->lumpinfo[i], chunk);
+        bytes += doom->lumpinfo[i].size;
+    }
+
+    Z_Free(chunk);
+    SHA1_Final(digest, &sha1_context);
+
+    if (doom->devparm)
+    {
+        us = I_GetTimeUS() - start;
+
+        d_printf("W_ChecksumContents: %u KB in %d us (%s, %d MB/s)\n",
+                 (unsigned int)(bytes >> 10), us,
+                 SHA1_ImplName(SHA1_GetImpl()),
+                 us > 0 ? (int)(bytes / us) : 0);
+    }
+}
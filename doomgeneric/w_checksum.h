@@ -24,5 +24,10 @@
 struct doom_data_t_;
 extern void W_Checksum(struct doom_data_t_* doom, sha1_digest_t digest);
 
+// Checksum of every lump's name, size and data.  Two sets of WADs
+// with the same directory but different data differ here; the same
+// lumps at other places in the files do not.
+extern void W_ChecksumContents(struct doom_data_t_* doom, sha1_digest_t digest);
+
 #endif /* #ifndef W_CHECKSUM_H */
 
@@ -26,6 +26,10 @@
 
 extern const wad_file_class_t stdc_wad_file;
 
+#ifdef EMBED_PACKED_WAD
+extern const wad_file_class_t packed_wad_file;
+#endif
+
 /*
 #ifdef _WIN32
 extern wad_file_class_t win32_wad_file;
@@ -46,6 +50,17 @@ wad_file_t *W_OpenFile(struct doom_data_t_* doom, const char *path)
     wad_file_t *result;
     int i;
 
+#ifdef EMBED_PACKED_WAD
+    // The embedded IWAD, if that is what is asked for.
+
+    result = packed_wad_file.OpenFile(path);
+
+    if (result != NULL)
+    {
+        return result;
+    }
+#endif
+
     //!
     // Use the OS's virtual memory subsystem to map WAD files
     // directly into memory.
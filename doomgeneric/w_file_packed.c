@@ -0,0 +1,188 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions for the embedded IWAD, packed by tools/wadpack.
+//
+//	The file is split at every lump boundary and each piece is
+//	compressed on its own, so a read only decompresses the lumps it
+//	touches.  W_CacheLumpNum keeps what it reads, so a lump is
+//	decompressed when it is first used rather than at startup.
+//
+
+#include "dlibc.h"
+
+#ifdef EMBED_PACKED_WAD
+
+#include "i_system.h"
+#include "m_lz4.h"
+#include "w_file.h"
+#include "z_zone.h"
+
+// Defines doom1_wad_len, the unpacked size, and doom1_wad_chunks[],
+// one { offset, length, packed offset, packed length } per piece in
+// file order, with the data in doom1_wad_packed[].  A piece whose
+// packed length equals its length is stored as is.
+
+#include "doom1wad_packed.h"
+
+#define NUMCHUNKS (sizeof(doom1_wad_chunks) / sizeof(doom1_wad_chunks[0]))
+
+static wad_file_t *W_Packed_OpenFile(const char *path);
+static void W_Packed_CloseFile(wad_file_t *wad);
+static size_t W_Packed_Read(wad_file_t *wad, unsigned int offset,
+                            void *buffer, size_t buffer_len);
+
+const wad_file_class_t packed_wad_file =
+{
+    W_Packed_OpenFile,
+    W_Packed_CloseFile,
+    W_Packed_Read,
+};
+
+static wad_file_t *W_Packed_OpenFile(const char *path)
+{
+    wad_file_t *result;
+
+    if (d_strcmp(path, "doom1.wad") != 0)
+    {
+        return NULL;
+    }
+
+    result = Z_Malloc(sizeof(wad_file_t), PU_STATIC, 0);
+    result->file_class = &packed_wad_file;
+    result->mapped = NULL;
+    result->length = doom1_wad_len;
+
+    return result;
+}
+
+static void W_Packed_CloseFile(wad_file_t *wad)
+{
+    Z_Free(wad);
+}
+
+// Finds the piece holding offset.
+
+static int FindChunk(unsigned int offset)
+{
+    int low, high, mid;
+
+    low = 0;
+    high = NUMCHUNKS - 1;
+
+    while (low < high)
+    {
+        mid = (low + high + 1) / 2;
+
+        if (doom1_wad_chunks[mid][0] <= offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+static boolean UnpackChunk(int chunk, byte *dest)
+{
+    const unsigned int *c = doom1_wad_chunks[chunk];
+
+    if (c[3] == c[1])
+    {
+        d_memcpy(dest, doom1_wad_packed + c[2], c[1]);
+        return true;
+    }
+
+    return M_LZ4Decompress(doom1_wad_packed + c[2], c[3], dest, c[1]) == c[1];
+}
+
+// Read data from the specified position in the file into the
+// provided buffer.  Returns the number of bytes read.
+
+static size_t W_Packed_Read(wad_file_t *wad, unsigned int offset,
+                            void *buffer, size_t buffer_len)
+{
+    const unsigned int *c;
+    byte *dest = buffer;
+    byte *scratch;
+    size_t result;
+    unsigned int skip, count;
+    int chunk;
+
+    if (offset >= wad->length)
+    {
+        return 0;
+    }
+
+    if (buffer_len > wad->length - offset)
+    {
+        buffer_len = wad->length - offset;
+    }
+
+    result = 0;
+    chunk = FindChunk(offset);
+
+    while (result < buffer_len)
+    {
+        c = doom1_wad_chunks[chunk];
+        skip = offset + result - c[0];
+        count = c[1] - skip;
+
+        if (count > buffer_len - result)
+        {
+            count = buffer_len - result;
+        }
+
+        // Whole lumps, which is nearly every read, go straight into
+        // the caller's buffer.
+
+        if (skip == 0 && count == c[1])
+        {
+            if (!UnpackChunk(chunk, dest + result))
+            {
+                break;
+            }
+        }
+        else
+        {
+            scratch = Z_Malloc(c[1], PU_STATIC, 0);
+
+            if (!UnpackChunk(chunk, scratch))
+            {
+                Z_Free(scratch);
+                break;
+            }
+
+            d_memcpy(dest + result, scratch + skip, count);
+            Z_Free(scratch);
+        }
+
+        result += count;
+        ++chunk;
+    }
+
+    if (result < buffer_len)
+    {
+        I_Error("W_Packed_Read: corrupt data at offset %u", offset + result);
+    }
+
+    return result;
+}
+
+#endif
@@ -62,6 +62,39 @@ unsigned int W_LumpNameHash(const char *s)
     return result;
 }
 
+uint64_t W_LumpNameKey(const char *name)
+{
+    uint64_t key = 0;
+    unsigned int i;
+
+    for (i = 0; i < 8 && name[i] != '\0'; ++i)
+    {
+        key |= (uint64_t)(byte)d_toupper((int)name[i]) << (i * 8);
+    }
+
+    return key;
+}
+
+// Hash of a lump name key.  Names in a directory often differ only in
+// their last characters, the top bytes of the key, so every bit is
+// mixed down (the splitmix64 finalizer).
+
+unsigned int W_LumpKeyHash(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+
+    return (unsigned int)key;
+}
+
+static unsigned int LumpKeySlot(doom_data_t *doom, uint64_t key)
+{
+    return W_LumpKeyHash(key) & doom->lumphashmask;
+}
+
 // Increase the size of the lumpinfo[] array to the specified size.
 static void ExtendLumpInfo(doom_data_t* doom, int newnumlumps)
 {
@@ -88,14 +121,6 @@ static void ExtendLumpInfo(doom_data_t* doom, int newnumlumps)
         {
             Z_ChangeUser(newlumpinfo[i].cache, &newlumpinfo[i].cache);
         }
-
-        // We shouldn't be generating a hash table until after all WADs have
-        // been loaded, but just in case...
-        if (doom->lumpinfo[i].next != NULL)
-        {
-            int nextlumpnum = doom->lumpinfo[i].next - doom->lumpinfo;
-            newlumpinfo[i].next = &newlumpinfo[nextlumpnum];
-        }
     }
 
     // All done.
@@ -202,7 +227,9 @@ wad_file_t *W_AddFile(doom_data_t* doom, const char *filename)
         lump_p->position = LONG(filerover->filepos);
         lump_p->size = LONG(filerover->size);
         lump_p->cache = NULL;
+        lump_p->loaded = false;
         d_strncpy(lump_p->name, filerover->name, 8);
+        lump_p->key = W_LumpNameKey(lump_p->name);
 
         ++lump_p;
         ++filerover;
@@ -234,24 +261,25 @@ int W_NumLumps(doom_data_t* doom)
 
 int W_CheckNumForName(doom_data_t* doom, const char *name)
 {
-    lumpinfo_t *lump_p;
+    uint64_t key;
+    unsigned int slot;
     int i;
 
+    key = W_LumpNameKey(name);
+
     // Do we have a hash table yet?
 
     if (doom->lumphash != NULL)
     {
-        int hash;
-
         // We do! Excellent.
 
-        hash = W_LumpNameHash(name) % doom->numlumps;
-
-        for (lump_p = doom->lumphash[hash]; lump_p != NULL; lump_p = lump_p->next)
+        for (slot = LumpKeySlot(doom, key);
+             doom->lumphash[slot] >= 0;
+             slot = (slot + 1) & doom->lumphashmask)
         {
-            if (!d_strnicmp(lump_p->name, name, 8))
+            if (doom->lumpinfo[doom->lumphash[slot]].key == key)
             {
-                return lump_p - doom->lumpinfo;
+                return doom->lumphash[slot];
             }
         }
     }
@@ -263,7 +291,7 @@ int W_CheckNumForName(doom_data_t* doom, const char *name)
 
         for (i = doom->numlumps - 1; i >= 0; --i)
         {
-            if (!d_strnicmp(doom->lumpinfo[i].name, name, 8))
+            if (doom->lumpinfo[i].key == key)
             {
                 return i;
             }
@@ -383,8 +411,14 @@ void *W_CacheLumpNum(doom_data_t* doom, int lumpnum, int tag)
     {
         // Not yet loaded, so load it now
 
+        if (lump->loaded)
+        {
+            Z_CountReread(lump->size);
+        }
+
         lump->cache = Z_Malloc(W_LumpLength(doom, lumpnum), tag, &lump->cache);
         W_ReadLump(doom, lumpnum, lump->cache);
+        lump->loaded = true;
         result = lump->cache;
     }
 
@@ -440,30 +474,41 @@ void W_ReleaseLumpName(doom_data_t* doom, const char *name)
 void W_GenerateHashTable(doom_data_t* doom)
 {
     unsigned int i;
+    unsigned int size;
+    unsigned int slot;
 
     // Free the old hash table, if there is one
 
     if (doom->lumphash != NULL)
     {
         Z_Free(doom->lumphash);
+        doom->lumphash = NULL;
     }
 
-    // Generate hash table
+    // Generate hash table, at most half full so probe runs stay short
     if (doom->numlumps > 0)
     {
-        doom->lumphash = Z_Malloc(sizeof(lumpinfo_t *) * doom->numlumps, PU_STATIC, NULL);
-        d_memset(doom->lumphash, 0, sizeof(lumpinfo_t *) * doom->numlumps);
+        for (size = 16; size < doom->numlumps * 2; size <<= 1);
+
+        doom->lumphash = Z_Malloc(sizeof(int) * size, PU_STATIC, NULL);
+        doom->lumphashmask = size - 1;
+        d_memset(doom->lumphash, 0xff, sizeof(int) * size);
 
         for (i = 0; i < doom->numlumps; ++i)
         {
-            unsigned int hash;
-
-            hash = W_LumpNameHash(doom->lumpinfo[i].name) % doom->numlumps;
-
-            // Hook into the hash table
+            for (slot = LumpKeySlot(doom, doom->lumpinfo[i].key);
+                 doom->lumphash[slot] >= 0;
+                 slot = (slot + 1) & doom->lumphashmask)
+            {
+                // Later lumps replace earlier ones of the same name,
+                // so patch lump files take precedence.
+                if (doom->lumpinfo[doom->lumphash[slot]].key == doom->lumpinfo[i].key)
+                {
+                    break;
+                }
+            }
 
-            doom->lumpinfo[i].next = doom->lumphash[hash];
-            doom->lumphash[hash] = &doom->lumpinfo[i];
+            doom->lumphash[slot] = i;
         }
     }
 
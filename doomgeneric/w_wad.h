@@ -44,9 +44,12 @@ struct lumpinfo_s
     int		size;
     void       *cache;
 
-    // Used for hash table lookups
+    // The name uppercased and packed into an integer, for lookups.
+    uint64_t	key;
 
-    lumpinfo_t *next;
+    // Set once the lump has been read into the zone, so reading it
+    // again means it was purged.
+    boolean	loaded;
 };
 
 struct doom_data_t_;
@@ -66,6 +69,12 @@ void    W_GenerateHashTable(struct doom_data_t_* doom);
 
 extern unsigned int W_LumpNameHash(const char *s);
 
+// Packs up to 8 characters of a lump name, uppercased, into an integer
+// with the first character in the low byte.  Names compare equal in
+// the way d_strnicmp(a, b, 8) does iff their keys are equal.
+uint64_t W_LumpNameKey(const char *name);
+unsigned int W_LumpKeyHash(uint64_t key);
+
 void    W_ReleaseLumpNum(struct doom_data_t_* doom, int lump);
 void    W_ReleaseLumpName(struct doom_data_t_* doom, const char *name);
 
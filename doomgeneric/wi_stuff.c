@@ -500,6 +500,35 @@ void WI_drawAnimatedBack(doom_data_t *doom)
     }
 }
 
+// The background and its animations, kept in a layer and only drawn
+// again when an animation moves on to its next frame.
+
+static vlayer_t backlayer;
+
+static void WI_drawBackground(doom_data_t *doom)
+{
+    unsigned int key;
+    int i;
+
+    key = (unsigned int) (size_t) doom->background;
+
+    if (doom->gamemode != commercial && doom->wbs->epsd <= 2)
+    {
+        for (i = 0; i < NUMANIMS[doom->wbs->epsd]; i++)
+        {
+            key = key * 31 + anims[doom->wbs->epsd][i].ctr + 1;
+        }
+    }
+
+    if (V_BeginLayer(doom, &backlayer, key))
+    {
+        WI_slamBackground(doom);
+        WI_drawAnimatedBack(doom);
+    }
+
+    V_EndLayer(doom, &backlayer);
+}
+
 //
 // Draws a number.
 // If digits > 0, then use that many digits minimum,
@@ -667,10 +696,8 @@ void WI_drawShowNextLoc(doom_data_t *doom)
     int i;
     int last;
 
-    WI_slamBackground(doom);
-
     // draw animated background
-    WI_drawAnimatedBack(doom);
+    WI_drawBackground(doom);
 
     if (doom->gamemode != commercial)
     {
@@ -859,10 +886,8 @@ void WI_drawDeathmatchStats(doom_data_t *doom)
     int y;
     int w;
 
-    WI_slamBackground(doom);
-
     // draw animated background
-    WI_drawAnimatedBack(doom);
+    WI_drawBackground(doom);
     WI_drawLF(doom);
 
     // draw stat titles (top line)
@@ -1120,10 +1145,8 @@ void WI_drawNetgameStats(doom_data_t *doom)
     int y;
     int pwidth = SHORT(doom->percent->width);
 
-    WI_slamBackground(doom);
-
     // draw animated background
-    WI_drawAnimatedBack(doom);
+    WI_drawBackground(doom);
 
     WI_drawLF(doom);
 
@@ -1294,10 +1317,8 @@ void WI_drawStats(doom_data_t *doom)
 
     lh = (3 * SHORT(doom->num[0]->height)) / 2;
 
-    WI_slamBackground(doom);
-
     // draw animated background
-    WI_drawAnimatedBack(doom);
+    WI_drawBackground(doom);
 
     WI_drawLF(doom);
 
@@ -1644,6 +1665,7 @@ void WI_Start(doom_data_t *doom, wbstartstruct_t *wbstartstruct)
 {
     WI_initVariables(doom, wbstartstruct);
     WI_loadData(doom);
+    V_FreeLayer(&backlayer);
 
     if (doom->deathmatch)
         WI_initDeathmatchStats(doom);
@@ -20,6 +20,7 @@
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomtype.h"
+#include "m_argv.h"
 
 //
 // ZONE MEMORY ALLOCATION
@@ -38,9 +39,10 @@
 typedef struct memblock_s
 {
     int size; // including the header and possibly tiny fragments
+    int tag;  // PU_FREE if this is free
+    int id;   // should be ZONEID
+    int site; // index in zonesites, 0 if not tracked
     void **user;
-    int tag; // PU_FREE if this is free
-    int id;  // should be ZONEID
     struct memblock_s *next;
     struct memblock_s *prev;
 } memblock_t;
@@ -59,6 +61,57 @@ typedef struct
 
 memzone_t *mainzone;
 
+//
+// Statistics.  Everything but the largest free block is kept exact as
+// blocks change; that is only found again, by a walk of the heap, once
+// an allocation has been cut from the block that held the record.
+//
+
+static zone_stats_t zonestats;
+static boolean largestfree_stale;
+
+// Allocations by call site, a small open-addressed hash table keyed
+// by file and line.  Entry 0 stands for anything not tracked.
+
+#define MAXSITES 512
+
+static zone_site_t zonesites[MAXSITES];
+static boolean zonesites_enabled;
+
+static int FindSite(const char *file, int line)
+{
+    unsigned int hash;
+    int i, n;
+
+    hash = (unsigned int) ((size_t) file >> 2) * 31 + line;
+
+    for (n = 0; n < MAXSITES; ++n)
+    {
+        i = (hash + n) & (MAXSITES - 1);
+
+        if (i == 0)
+        {
+            continue;
+        }
+
+        if (zonesites[i].file == NULL)
+        {
+            zonesites[i].file = file;
+            zonesites[i].line = line;
+            return i;
+        }
+
+        if (zonesites[i].file == file && zonesites[i].line == line)
+        {
+            return i;
+        }
+    }
+
+    // Full; count it with the untracked blocks.
+
+    return 0;
+}
+
 //
 // Z_ClearZone
 //
@@ -109,6 +162,20 @@ void Z_Init(struct doom_data_t_* doom)
     block->tag = PU_FREE;
 
     block->size = mainzone->size - sizeof(memzone_t);
+
+    d_memset(&zonestats, 0, sizeof(zonestats));
+    zonestats.size = mainzone->size;
+    zonestats.tagbytes[PU_FREE] = block->size;
+    zonestats.tagblocks[PU_FREE] = 1;
+    zonestats.largestfree = block->size;
+    largestfree_stale = false;
+
+    //!
+    // Count the blocks each Z_Malloc call allocates, for Z_GetSites.
+    //
+
+    d_memset(zonesites, 0, sizeof(zonesites));
+    zonesites_enabled = M_CheckParm(doom, "-zonesites") > 0;
 }
 
 //
@@ -130,16 +197,29 @@ void Z_Free(void *ptr)
         *block->user = 0;
     }
 
+    if (block->site != 0)
+    {
+        zonesites[block->site].blocks--;
+        zonesites[block->site].bytes -= block->size;
+    }
+
+    zonestats.tagbytes[block->tag] -= block->size;
+    zonestats.tagblocks[block->tag]--;
+    zonestats.tagbytes[PU_FREE] += block->size;
+    zonestats.tagblocks[PU_FREE]++;
+
     // mark as free
     block->tag = PU_FREE;
     block->user = NULL;
     block->id = 0;
+    block->site = 0;
 
     other = block->prev;
 
     if (other->tag == PU_FREE)
     {
         // merge with previous free block
+        zonestats.tagblocks[PU_FREE]--;
         other->size += block->size;
         other->next = block->next;
         other->next->prev = other;
@@ -154,6 +234,7 @@ void Z_Free(void *ptr)
     if (other->tag == PU_FREE)
     {
         // merge the next free block onto the end
+        zonestats.tagblocks[PU_FREE]--;
         block->size += other->size;
         block->next = other->next;
         block->next->prev = block;
@@ -161,6 +242,9 @@ void Z_Free(void *ptr)
         if (other == mainzone->rover)
             mainzone->rover = block;
     }
+
+    if (block->size > zonestats.largestfree)
+        zonestats.largestfree = block->size;
 }
 
 //
@@ -170,9 +254,11 @@ void Z_Free(void *ptr)
 #define MINFRAGMENT 64
 
 void *
-Z_Malloc(int size,
-         int tag,
-         void *user)
+Z_Malloc2(int size,
+          int tag,
+          void *user,
+          const char *file,
+          int line)
 {
     int extra;
     memblock_t *start;
@@ -221,6 +307,9 @@ Z_Malloc(int size,
             {
                 // free the rover block (adding the size to base)
 
+                zonestats.purges++;
+                zonestats.purgedbytes += rover->size;
+
                 // the rover can be the base block
                 base = base->prev;
                 Z_Free((byte *)rover + sizeof(memblock_t));
@@ -236,6 +325,9 @@ Z_Malloc(int size,
     } while (base->tag != PU_FREE || base->size < size);
 
     // found a block big enough
+    if (base->size >= zonestats.largestfree)
+        largestfree_stale = true;
+
     extra = base->size - size;
 
     if (extra > MINFRAGMENT)
@@ -252,6 +344,8 @@ Z_Malloc(int size,
 
         base->next = newblock;
         base->size = size;
+
+        zonestats.tagblocks[PU_FREE]++;
     }
 
     if (user == NULL && tag >= PU_PURGELEVEL)
@@ -260,6 +354,25 @@ Z_Malloc(int size,
     base->user = user;
     base->tag = tag;
 
+    zonestats.tagbytes[PU_FREE] -= base->size;
+    zonestats.tagblocks[PU_FREE]--;
+    zonestats.tagbytes[tag] += base->size;
+    zonestats.tagblocks[tag]++;
+
+    base->site = zonesites_enabled ? FindSite(file, line) : 0;
+
+    if (base->site != 0)
+    {
+        zone_site_t *site = &zonesites[base->site];
+
+        site->blocks++;
+        site->allocs++;
+        site->bytes += base->size;
+
+        if (site->bytes > site->peakbytes)
+            site->peakbytes = site->bytes;
+    }
+
     result = (void *)((byte *)base + sizeof(memblock_t));
 
     if (base->user)
@@ -413,9 +526,39 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line)
                 "for purgable blocks",
                 file, line);
 
+    zonestats.tagbytes[block->tag] -= block->size;
+    zonestats.tagblocks[block->tag]--;
+    zonestats.tagbytes[tag] += block->size;
+    zonestats.tagblocks[tag]++;
+
     block->tag = tag;
 }
 
+//
+// Z_GetUser
+// Safe on any pointer: only blocks that lie in the zone and carry
+// a ZONEID are looked at.
+//
+void **Z_GetUser(void *ptr, int *tag)
+{
+    memblock_t *block;
+    byte *start;
+
+    start = (byte *)mainzone + sizeof(memzone_t) + sizeof(memblock_t);
+
+    if ((byte *)ptr < start || (byte *)ptr >= (byte *)mainzone + mainzone->size)
+        return NULL;
+
+    block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID || block->tag == PU_FREE)
+        return NULL;
+
+    *tag = block->tag;
+
+    return block->user;
+}
+
 void Z_ChangeUser(void *ptr, void **user)
 {
     memblock_t *block;
@@ -456,3 +599,73 @@ unsigned int Z_ZoneSize(void)
 {
     return mainzone->size;
 }
+
+//
+// Z_GetStats
+//
+void Z_GetStats(zone_stats_t *stats)
+{
+    memblock_t *block;
+
+    if (largestfree_stale)
+    {
+        zonestats.largestfree = 0;
+
+        for (block = mainzone->blocklist.next;
+             block != &mainzone->blocklist;
+             block = block->next)
+        {
+            if (block->tag == PU_FREE && block->size > zonestats.largestfree)
+                zonestats.largestfree = block->size;
+        }
+
+        largestfree_stale = false;
+    }
+
+    *stats = zonestats;
+}
+
+//
+// Z_GetSites
+// Fills sites with up to maxsites call sites, most live bytes first,
+// and returns how many there are.  Empty without -zonesites.
+//
+int Z_GetSites(zone_site_t *sites, int maxsites)
+{
+    int count;
+    int i, j;
+
+    count = 0;
+
+    for (i = 1; i < MAXSITES; ++i)
+    {
+        if (zonesites[i].file == NULL)
+            continue;
+
+        for (j = count; j > 0 && sites[j - 1].bytes < zonesites[i].bytes; --j)
+        {
+            if (j < maxsites)
+                sites[j] = sites[j - 1];
+        }
+
+        if (j < maxsites)
+        {
+            sites[j] = zonesites[i];
+
+            if (count < maxsites)
+                ++count;
+        }
+    }
+
+    return count;
+}
+
+//
+// Z_CountReread
+// Called by the WAD code when it reads a lump it had cached before.
+//
+void Z_CountReread(int size)
+{
+    zonestats.rereads++;
+    zonestats.rereadbytes += size;
+}
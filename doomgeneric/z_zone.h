@@ -49,10 +49,38 @@ enum
     PU_NUM_TAGS
 };
 
+// Heap usage, kept up to date as blocks are allocated, freed and
+// retagged.  Sizes include the block headers.
+
+typedef struct
+{
+    int size;                       // the whole zone
+    int tagbytes[PU_NUM_TAGS];      // bytes in blocks of each tag
+    int tagblocks[PU_NUM_TAGS];     // blocks of each tag
+    int largestfree;                // largest PU_FREE block
+
+    int purges;                     // purgable blocks thrown out
+    int purgedbytes;
+    int rereads;                    // lumps read again after a purge
+    int rereadbytes;
+} zone_stats_t;
+
+// One place Z_Malloc is called from, tracked with -zonesites.
+
+typedef struct
+{
+    const char *file;
+    int line;
+    int blocks;                     // live blocks allocated here
+    int bytes;                      // and their size
+    int peakbytes;
+    int allocs;                     // allocations over the whole run
+} zone_site_t;
+
 struct doom_data_t_;
 
 void	Z_Init (struct doom_data_t_* doom);
-void*	Z_Malloc (int size, int tag, void *ptr);
+void*	Z_Malloc2 (int size, int tag, void *ptr, const char *file, int line);
 void    Z_Free (void *ptr);
 void    Z_FreeTags (int lowtag, int hightag);
 void    Z_DumpHeap (int lowtag, int hightag);
@@ -60,13 +88,23 @@ void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
 void    Z_ChangeTag2 (void *ptr, int tag, char *file, int line);
 void    Z_ChangeUser(void *ptr, void **user);
+
+// The owner of the zone block starting at ptr, with its tag, or
+// NULL if ptr is not the start of one.
+void**  Z_GetUser (void *ptr, int *tag);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
+void    Z_GetStats (zone_stats_t *stats);
+int     Z_GetSites (zone_site_t *sites, int maxsites);
+void    Z_CountReread (int size);
 
 //
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.
 //
+#define Z_Malloc(s,t,p)                                        \
+    Z_Malloc2((s), (t), (p), __FILE__, __LINE__)
+
 #define Z_ChangeTag(p,t)                                       \
     Z_ChangeTag2((p), (t), __FILE__, __LINE__)
 
@@ -7,6 +7,7 @@
 #include "efi.h"
 #include "doomgeneric.h"
 #include "doomkeys.h"
+#include "i_system.h"
 #include "dlibc.h"
 #include "x86.h"
 
@@ -16,6 +17,8 @@ static size_t WIDTH;
 static size_t HEIGHT;
 static uint8_t keyStateMap[258];
 static uint8_t mouse_detected = 0;
+static EFI_HANDLE image_handle;
+static bool first_frame = true;
 doom_data_t doom;
 
 void doomgeneric_Res(uint32_t *width, uint32_t *height)
@@ -29,6 +32,11 @@ uint32_t DG_GetTicksMs()
 	return clock_msec();
 }
 
+uint64_t DG_GetTicksUs()
+{
+	return clock_usec();
+}
+
 static void AddKey(int pressed, unsigned int key)
 {
 	event_t event;
@@ -158,12 +166,36 @@ static void ReadMouse()
 	pressDoomKey(state.RightButton, 257);
 }
 
+#define LOG_PATH ((CHAR16 *)u"\\efidoom.log")
+
+// The log is saved after the first frame, and again on the way out
+// or after an error, so the last thing printed is on disk.
+static void SaveLogNow(void)
+{
+	FlushConsole();
+	SaveLog(image_handle, LOG_PATH);
+}
+
+static void SaveLogAtExit(doom_data_t *doom)
+{
+	SaveLogNow();
+}
+
 void DG_DrawFrame()
 {
 	ResetPressedKeys();
 	ReadKeys();
 	ReadMouse();
 	pGraphics->Blt(pGraphics, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)doom.DG_ScreenBuffer, EfiBltBufferToVideo, 0, 0, 0, 0, WIDTH, HEIGHT, 0);
+	FlushConsole();
+
+	if (first_frame)
+	{
+		// The TSC clock starts in calibrate_cpu, first thing in efi_main.
+		first_frame = false;
+		d_printf("Boot to first frame: %u msec\n", (uint32_t)clock_msec());
+		SaveLogNow();
+	}
 }
 
 EFI_STATUS efi_main(
@@ -172,7 +204,11 @@ EFI_STATUS efi_main(
 	EFI_STATUS status;
 	EFI_BOOT_SERVICES *BS = system_table->BootServices;
 	Init(system_table);
+	image_handle = handle;
+	I_AtError(SaveLogNow);
+	I_AtExit(SaveLogAtExit, true);
 	calibrate_cpu();
+	d_printf("Reset to efi_main: %u msec\n", (uint32_t)clock_msec_before_start());
 
 	status = system_table->ConOut->ClearScreen(system_table->ConOut);
 	if (status != 0)
@@ -7,37 +7,152 @@ void Init(EFI_SYSTEM_TABLE *pSystemTable)
     g_pSystemTable = pSystemTable;
 }
 
-#define BUFFER_SIZE 128
-static uint16_t BUFFER[BUFFER_SIZE];
-static uint32_t index = 0;
+//
+// Console output.  Characters collect in a UCS-2 line buffer that goes
+// to ConOut once per line, or when it fills, as every OutputString
+// call is slow.  Everything printed is also kept in a ring buffer that
+// SaveLog writes to the boot volume.
+//
+#define CONSOLE_BUFFER_SIZE 256
+static CHAR16 console_buffer[CONSOLE_BUFFER_SIZE];
+static UINTN console_length = 0;
 
-void _put(int c)
+#define LOG_SIZE (64 * 1024)
+static char log_ring[LOG_SIZE];
+static uint64_t log_written = 0;
+
+void FlushConsole(void)
 {
-    uint16_t BUFFER[2];
-    BUFFER[0] = c;
-    BUFFER[1] = '\0';
-    g_pSystemTable->ConOut->OutputString(g_pSystemTable->ConOut, BUFFER);
+    if (console_length == 0)
+    {
+        return;
+    }
+
+    console_buffer[console_length] = 0;
+    g_pSystemTable->ConOut->OutputString(g_pSystemTable->ConOut, console_buffer);
+    console_length = 0;
 }
 
 int d_putchar(int c)
 {
+    log_ring[log_written++ % LOG_SIZE] = (char)c;
+
+    // Leave room for "\r\n" and the terminator.
+    if (console_length + 3 > CONSOLE_BUFFER_SIZE)
+    {
+        FlushConsole();
+    }
+
     if (c == '\n')
     {
-        _put('\r');
-        _put('\n');
+        console_buffer[console_length++] = '\r';
+        console_buffer[console_length++] = '\n';
+        FlushConsole();
     }
     else
     {
-        _put(c);
+        console_buffer[console_length++] = (CHAR16)(unsigned char)c;
     }
+
     return 1;
 }
 
 void Print(uint16_t *str)
 {
+    FlushConsole();
     g_pSystemTable->ConOut->OutputString(g_pSystemTable->ConOut, str);
 }
 
+static EFI_STATUS WriteAll(EFI_FILE_HANDLE file, char *data, UINTN size)
+{
+    EFI_STATUS Status;
+    UINTN written;
+
+    while (size > 0)
+    {
+        written = size;
+        Status = file->Write(file, &written, data);
+        if (EFI_ERROR(Status))
+        {
+            return Status;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return EFI_SUCCESS;
+}
+
+//
+// Writes the log ring, oldest first, to path on the volume the image
+// was loaded from (normally the ESP), replacing any earlier log.
+//
+EFI_STATUS SaveLog(EFI_HANDLE image, CHAR16 *path)
+{
+    EFI_BOOT_SERVICES *BS = g_pSystemTable->BootServices;
+    EFI_GUID LoadedImageGuid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
+    EFI_GUID FileSystemGuid = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID;
+    EFI_LOADED_IMAGE *LoadedImage;
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem;
+    EFI_FILE_HANDLE Root, File;
+    EFI_STATUS Status;
+    UINTN start;
+
+    FlushConsole();
+
+    Status = BS->HandleProtocol(image, &LoadedImageGuid, (VOID **)&LoadedImage);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    Status = BS->HandleProtocol(LoadedImage->DeviceHandle, &FileSystemGuid, (VOID **)&FileSystem);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    Status = FileSystem->OpenVolume(FileSystem, &Root);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    // Opening with create does not truncate, so delete any old log.
+    if (!EFI_ERROR(Root->Open(Root, &File, path, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0)))
+    {
+        File->Delete(File);
+    }
+
+    Status = Root->Open(Root, &File, path,
+                        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    if (EFI_ERROR(Status))
+    {
+        Root->Close(Root);
+        return Status;
+    }
+
+    if (log_written > LOG_SIZE)
+    {
+        start = log_written % LOG_SIZE;
+        Status = WriteAll(File, log_ring + start, LOG_SIZE - start);
+        if (!EFI_ERROR(Status))
+        {
+            Status = WriteAll(File, log_ring, start);
+        }
+    }
+    else
+    {
+        Status = WriteAll(File, log_ring, (UINTN)log_written);
+    }
+
+    File->Flush(File);
+    File->Close(File);
+    Root->Close(Root);
+
+    return Status;
+}
+
 EFI_STATUS LibLocateProtocol(
     IN EFI_BOOT_SERVICES *BS,
     IN EFI_GUID *ProtocolGuid,
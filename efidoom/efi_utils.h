@@ -14,6 +14,13 @@ void* AllocatePool(size_t size);
 void FreePool(void* ptr);
 void Print(uint16_t* str);
 
+// d_putchar is line buffered; this pushes out a partial line.
+void FlushConsole(void);
+
+// Writes everything printed so far (the last 64 KiB) to a file on the
+// volume the image was loaded from.
+EFI_STATUS SaveLog(EFI_HANDLE image, CHAR16* path);
+
 EFI_STATUS
 LibLocateHandle (
     IN EFI_BOOT_SERVICES* BS,
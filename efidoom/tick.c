@@ -22,6 +22,10 @@ EFI_STATUS efi_main(
 	calibrate_cpu();
 	uint64_t start = clock_msec();
 
+	// The RTC next to each tick shows how far the calibration drifts.
+	EFI_TIME time;
+	uint32_t rtc_start = 0;
+
 	for (size_t i = 0;; ++i)
 	{
 		uint64_t now;
@@ -29,7 +33,13 @@ EFI_STATUS efi_main(
 		while ((now = clock_msec()) - start < 1000 * i)
 			;
 
-		d_printf("Tick %u\n", i);
+		system_table->RuntimeServices->GetTime(&time, NULL);
+		uint32_t rtc = time.Hour * 3600 + time.Minute * 60 + time.Second;
+
+		if (i == 0)
+			rtc_start = rtc;
+
+		d_printf("Tick %u, RTC %u\n", i, rtc - rtc_start);
 	}
 
 	return 0;
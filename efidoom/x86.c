@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include "x86.h"
 #include "dlibc.h"
+#include "efi_utils.h"
 
 #define printf d_printf
 #define u8 uint8_t
@@ -56,6 +57,8 @@ BUILDIO(l, , u32)
 static bool cpu_calibrated = false;
 static uint32_t cpu_calibrated_mul = 1;
 static uint32_t cpu_calibrated_shift = 1;
+static uint32_t cpu_calibrated_us_mul = 1;
+static uint32_t cpu_calibrated_us_shift = 1;
 static uint64_t cpu_base = 1;
 
 uint64_t rdtsc()
@@ -200,11 +203,97 @@ static int comp(const void *lhs, const void *rhs)
 	return (*(uint64_t *)lhs < *(uint64_t *)rhs) ? -1 : 1;
 }
 
-void calibrate_cpu()
+static void cpuid(u32 leaf, u32 *eax, u32 *ebx, u32 *ecx, u32 *edx)
+{
+	__asm__ volatile("cpuid"
+					 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+					 : "a"(leaf), "c"(0));
+}
+
+// Anything outside this is a broken source rather than a real TSC.
+#define MIN_TSC_KHZ 100000
+#define MAX_TSC_KHZ 10000000
+
+// Assumed when no source gives a rate at all.
+#define DEFAULT_TSC_KHZ 2000000
+
+static bool plausible_khz(u64 khz)
+{
+	return khz >= MIN_TSC_KHZ && khz <= MAX_TSC_KHZ;
+}
+
+// VMware, and KVM with the matching option, report the TSC rate they
+// give the guest in leaf 0x40000010.
+static u32 tsc_khz_from_hypervisor()
+{
+	u32 eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+
+	if (!(ecx & (1u << 31)))
+		return 0;
+
+	cpuid(0x40000000, &eax, &ebx, &ecx, &edx);
+
+	if (eax < 0x40000010)
+		return 0;
+
+	cpuid(0x40000010, &eax, &ebx, &ecx, &edx);
+	return eax;
+}
+
+// Leaf 0x15 gives the TSC as a ratio of the crystal clock, with the
+// crystal rate in ECX where the CPU knows it.  Failing that, leaf 0x16
+// has the base frequency, which the TSC runs at.
+static u32 tsc_khz_from_cpuid()
+{
+	u32 max, eax, ebx, ecx, edx;
+
+	cpuid(0, &max, &ebx, &ecx, &edx);
+
+	if (max >= 0x15)
+	{
+		cpuid(0x15, &eax, &ebx, &ecx, &edx);
+
+		if (eax != 0 && ebx != 0 && ecx != 0)
+			return (u64)ecx * ebx / eax / 1000;
+	}
+
+	if (max >= 0x16)
+	{
+		cpuid(0x16, &eax, &ebx, &ecx, &edx);
+		return (eax & 0xffff) * 1000;
+	}
+
+	return 0;
+}
+
+// One short busy wait in the firmware's Stall, which OVMF and real
+// firmware time with the ACPI PM timer or the HPET.
+#define STALL_USEC 10000
+
+static u32 tsc_khz_from_stall()
+{
+	EFI_BOOT_SERVICES *BS;
+	uint64_t start;
+
+	if (g_pSystemTable == NULL)
+		return 0;
+
+	BS = g_pSystemTable->BootServices;
+	start = rdtsc();
+
+	if (BS->Stall(STALL_USEC) != EFI_SUCCESS)
+		return 0;
+
+	return (rdtsc() - start) * 1000 / STALL_USEC;
+}
+
+// Only where the legacy PIT is emulated: the median of several runs.
+static u32 tsc_khz_from_pit()
 {
 #define N 11
 #define iterations 100
-	cpu_base = rdtsc();
 	uint64_t values[N];
 	for (size_t i = 0; i < N; ++i)
 	{
@@ -212,24 +301,64 @@ void calibrate_cpu()
 	}
 
 	d_qsort(values, N, sizeof(uint64_t), comp);
-	d_printf("Calibration results: [");
+	return values[N / 2];
+#undef N
+#undef iterations
+}
 
-	for (size_t i = 0; i < N; ++i)
+typedef struct
+{
+	const char *name;
+	u32 (*khz)();
+} tsc_source_t;
+
+static const tsc_source_t tsc_sources[] = {
+	{"hypervisor", tsc_khz_from_hypervisor},
+	{"CPUID", tsc_khz_from_cpuid},
+	{"UEFI Stall", tsc_khz_from_stall},
+	{"PIT", tsc_khz_from_pit},
+};
+
+void calibrate_cpu()
+{
+	const char *name = NULL;
+	u32 khz = 0;
+
+	cpu_base = rdtsc();
+
+	for (size_t i = 0; i < sizeof(tsc_sources) / sizeof(tsc_sources[0]); ++i)
+	{
+		name = tsc_sources[i].name;
+		khz = tsc_sources[i].khz();
+
+		if (plausible_khz(khz))
+			break;
+	}
+
+	// A rate of 0 would divide by zero in clocks_calc_mult_shift, and
+	// a wild one runs the game at the wrong speed.
+	if (!plausible_khz(khz))
 	{
-		if (i == 0)
-		{
-			d_printf("%u", values[i]);
-		}
+		u32 measured = khz;
+
+		if (khz == 0)
+			khz = DEFAULT_TSC_KHZ;
+		else if (khz < MIN_TSC_KHZ)
+			khz = MIN_TSC_KHZ;
 		else
-		{
-			d_printf(", %u", values[i]);
-		}
+			khz = MAX_TSC_KHZ;
+
+		d_printf("Warning: no source gave a plausible TSC clock (%s said %u kHz), "
+				 "assuming %u kHz; timing will be off\n",
+				 name, measured, khz);
+		name = "fallback";
 	}
 
-	d_printf("]\n");
+	clocks_calc_mult_shift(&cpu_calibrated_mul, &cpu_calibrated_shift, khz, 1, 0);
+	clocks_calc_mult_shift(&cpu_calibrated_us_mul, &cpu_calibrated_us_shift, khz, 1000, 0);
 
-	clocks_calc_mult_shift(&cpu_calibrated_mul, &cpu_calibrated_shift, values[N / 2], 1, 0);
-	d_printf("TSC clock is %u kHz Calibration was done in %u msec\n", values[N / 2], (uint32_t)clock_msec());
+	d_printf("TSC clock is %u kHz from %s, calibration took %u usec\n",
+			 khz, name, (uint32_t)clock_usec());
 }
 
 uint64_t clock_msec()
@@ -237,3 +366,16 @@ uint64_t clock_msec()
 	uint64_t cycles = rdtsc() - cpu_base;
 	return mul_u64_u32_shr(cycles, cpu_calibrated_mul, cpu_calibrated_shift);
 }
+
+uint64_t clock_usec()
+{
+	uint64_t cycles = rdtsc() - cpu_base;
+	return mul_u64_u32_shr(cycles, cpu_calibrated_us_mul, cpu_calibrated_us_shift);
+}
+
+// The TSC counts from reset, so its value when calibrate_cpu started
+// is the time the firmware took, loading this image included.
+uint64_t clock_msec_before_start()
+{
+	return mul_u64_u32_shr(cpu_base, cpu_calibrated_mul, cpu_calibrated_shift);
+}
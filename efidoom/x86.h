@@ -5,3 +5,5 @@
 void calibrate_cpu();
 uint64_t rdtsc();
 uint64_t clock_msec();
+uint64_t clock_usec();
+uint64_t clock_msec_before_start();
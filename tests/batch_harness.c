@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "d_loop.h"
+#include "doomdef.h"
+#include "doomgeneric.h"
+#include "i_video.h"
+#include "s_sound.h"
+#include "z_zone.h"
+
+#include "batch_harness.h"
+
+static int tics_run;
+
+static void ProcessEvents(doom_data_t *doom)
+{
+}
+
+static void BuildTiccmd(doom_data_t *doom, ticcmd_t *cmd, int maketic)
+{
+}
+
+static void RunTic(doom_data_t *doom, ticcmd_t *cmds, boolean *ingame)
+{
+    ++tics_run;
+}
+
+static void RunMenu(void)
+{
+}
+
+static loop_interface_t harness_interface =
+{
+    ProcessEvents,
+    BuildTiccmd,
+    RunTic,
+    RunMenu,
+};
+
+void BatchHarness_Run(int tics, int drawevery, int calls, int requestat,
+                      batchresult_t *result)
+{
+    static char *argv[] = { "batch_harness", NULL };
+    static doom_data_t doom;
+    int i;
+
+    doomdata_init(&doom);
+    doom.myargc = 1;
+    doom.myargv = argv;
+    Z_Init(&doom);
+    D_RegisterLoopCallbacks(&doom, &harness_interface);
+
+    // A frame that is due still counts, but there is no screen to
+    // draw it on or sound to update.
+    screenvisible = false;
+    snd_channels = 0;
+
+    doomgeneric_SetBatch(&doom, tics, drawevery);
+    tics_run = 0;
+
+    for (i = 0; i < calls; ++i)
+    {
+        if (i == requestat)
+        {
+            doomgeneric_RequestFrame(&doom);
+        }
+
+        doomgeneric_Tick(&doom);
+    }
+
+    result->tics = tics_run;
+    result->gametic = doom.gametic;
+    result->frames = doom.batchframes;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Driving doomgeneric_Tick with batching, but with a loop that only
+// counts tics, so it runs without an IWAD.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    int tics;       // tics run, counted in the loop's RunTic
+    int gametic;    // gametic at the end
+    int frames;     // calls that drew (and updated sound)
+} batchresult_t;
+
+// Calls doomgeneric_Tick calls times after doomgeneric_SetBatch(tics,
+// drawevery), with doomgeneric_RequestFrame before the call numbered
+// requestat (counting from 0), if that is not -1.
+void BatchHarness_Run(int tics, int drawevery, int calls, int requestat,
+                      batchresult_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,32 @@
+#include "gtest/gtest.h"
+#include "batch_harness.h"
+
+// Each call runs the batch of tics; frames come every drawevery
+// calls, or only when asked for with drawevery 0.
+TEST(Batch, TicsAndFrames)
+{
+    batchresult_t result;
+
+    BatchHarness_Run(1, 1, 10, -1, &result);
+    EXPECT_EQ(result.tics, 10);
+    EXPECT_EQ(result.gametic, 10);
+    EXPECT_EQ(result.frames, 10);
+
+    BatchHarness_Run(35, 0, 10, -1, &result);
+    EXPECT_EQ(result.tics, 350);
+    EXPECT_EQ(result.gametic, 350);
+    EXPECT_EQ(result.frames, 0);
+
+    BatchHarness_Run(4, 3, 9, -1, &result);
+    EXPECT_EQ(result.tics, 36);
+    EXPECT_EQ(result.frames, 3);
+
+    BatchHarness_Run(35, 0, 10, 4, &result);
+    EXPECT_EQ(result.tics, 350);
+    EXPECT_EQ(result.frames, 1);
+
+    // Out-of-range settings fall back to one tic, drawn on request.
+    BatchHarness_Run(0, -2, 5, -1, &result);
+    EXPECT_EQ(result.tics, 5);
+    EXPECT_EQ(result.frames, 0);
+}
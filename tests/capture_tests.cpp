@@ -0,0 +1,222 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// The engine headers do not build as C++, so declare what is needed.
+extern "C"
+{
+int M_EncodeCaptureFrame(const unsigned char *prev, const unsigned char *frame, int length,
+                         unsigned char *dest);
+int M_DecodeCaptureFrame(const unsigned char *src, int srclength, unsigned char *frame,
+                         int length);
+typedef int (*capturewrite_t)(void *data, uint64_t offset, const unsigned char *buf, int length);
+int M_StartCapture(capturewrite_t write, void *data, int width, int height);
+void M_CaptureFrame(int tic, const unsigned char *frame, const unsigned char *palette);
+void M_StopCapture(void);
+
+void ZoneHarness_Init(int argc, char **argv);
+}
+
+static const int width = 320, height = 200;
+
+// Something like a game frame: a flat floor and ceiling, walls that
+// move with the tic, a status bar that does not, and a little noise.
+
+static std::vector<unsigned char> GameFrame(int tic)
+{
+    std::vector<unsigned char> frame(width * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char c;
+
+            if (y >= 168)
+                c = (unsigned char)(x / 32 + 200);
+            else if (y < 40)
+                c = 5;
+            else if (y >= 128)
+                c = 100;
+            else
+                c = (unsigned char)((x + tic * 3) / 8 % 16 + 64);
+
+            frame[y * width + x] = c;
+        }
+    }
+
+    for (int i = 0; i < 50; ++i)
+        frame[(tic * 7919 + i * 104729) % (width * 168)] = (unsigned char)(tic + i);
+
+    return frame;
+}
+
+static std::vector<unsigned char> Encode(const std::vector<unsigned char> *prev,
+                                         const std::vector<unsigned char> &frame)
+{
+    std::vector<unsigned char> payload(frame.size() * 2 + 16);
+    int length = M_EncodeCaptureFrame(prev ? prev->data() : NULL, frame.data(), (int)frame.size(),
+                                      payload.data());
+    EXPECT_GT(length, 0);
+    payload.resize(length);
+    return payload;
+}
+
+static void RoundTrip(const std::vector<unsigned char> *prev, const std::vector<unsigned char> &frame)
+{
+    std::vector<unsigned char> payload = Encode(prev, frame);
+    std::vector<unsigned char> decoded = prev ? *prev : std::vector<unsigned char>(frame.size());
+
+    ASSERT_TRUE(M_DecodeCaptureFrame(payload.data(), (int)payload.size(), decoded.data(),
+                                     (int)decoded.size()));
+    EXPECT_EQ(frame, decoded);
+}
+
+TEST(Capture, RoundTrip)
+{
+    std::vector<unsigned char> a = GameFrame(0), b = GameFrame(1);
+
+    RoundTrip(NULL, a);
+    RoundTrip(&a, b);
+    RoundTrip(&a, a);
+
+    // Key frames pack the flats; deltas cost little more than what
+    // changed.
+    std::vector<unsigned char> c = a;
+    for (int y = 100; y < 116; ++y)
+        for (int x = 150; x < 166; ++x)
+            c[y * width + x] = (unsigned char)(x * y);
+    RoundTrip(&a, c);
+
+    EXPECT_LT(Encode(NULL, a).size(), a.size() / 4);
+    EXPECT_LT(Encode(&a, b).size(), Encode(NULL, b).size());
+    EXPECT_LT(Encode(&a, c).size(), 16u * (16 + 4));
+    EXPECT_LT(Encode(&a, a).size(), 8u);
+
+    // Random frames do not pack, but still come back within the bound.
+    std::srand(1);
+    for (auto &p : b)
+        p = (unsigned char)std::rand();
+    RoundTrip(&a, b);
+    RoundTrip(NULL, b);
+    EXPECT_LE(Encode(&a, b).size(), b.size() * 2 + 16);
+}
+
+TEST(Capture, RejectsBadData)
+{
+    std::vector<unsigned char> a = GameFrame(0), b = GameFrame(1);
+    std::vector<unsigned char> payload = Encode(&a, b);
+    std::vector<unsigned char> decoded = a;
+
+    // Cut short, too long for the frame, or too short to fill it.
+    for (size_t cut = 1; cut < payload.size(); cut += payload.size() / 17 + 1)
+    {
+        decoded = a;
+        EXPECT_FALSE(M_DecodeCaptureFrame(payload.data(), (int)cut, decoded.data(), (int)decoded.size()));
+    }
+    EXPECT_FALSE(M_DecodeCaptureFrame(payload.data(), (int)payload.size(), decoded.data(),
+                                      (int)decoded.size() - 1));
+    EXPECT_FALSE(M_DecodeCaptureFrame(payload.data(), (int)payload.size(), decoded.data(), 0));
+
+    const unsigned char overlong[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0x01};
+    EXPECT_FALSE(M_DecodeCaptureFrame(overlong, sizeof(overlong), decoded.data(), (int)decoded.size()));
+}
+
+static unsigned int ReadLong(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long ReadLongLong(const unsigned char *p)
+{
+    return ReadLong(p) | ((unsigned long long)ReadLong(p + 4) << 32);
+}
+
+// Decodes frame number n of a capture, starting from the key frame
+// before it as a reader seeking through the index would.
+static void ReadFrame(const std::vector<unsigned char> &file, int n, std::vector<unsigned char> &frame,
+                      std::vector<unsigned char> &palette, int &tic)
+{
+    unsigned long long indexoffset = ReadLongLong(&file[16]);
+    int keyinterval = ReadLong(&file[24]);
+
+    for (int i = n - n % keyinterval; i <= n; ++i)
+    {
+        size_t pos = ReadLongLong(&file[indexoffset + i * 8]);
+        ASSERT_LT(pos + 12, indexoffset);
+
+        tic = ReadLong(&file[pos]);
+        unsigned int flags = ReadLong(&file[pos + 4]), length = ReadLong(&file[pos + 8]);
+        pos += 12;
+
+        ASSERT_EQ(i % keyinterval == 0, (flags & 1) != 0);
+
+        if (flags & 2)
+        {
+            palette.assign(file.begin() + pos, file.begin() + pos + 768);
+            pos += 768;
+        }
+        if (flags & 1)
+            frame.assign(width * height, 0);
+
+        ASSERT_LE(pos + length, indexoffset);
+        ASSERT_TRUE(M_DecodeCaptureFrame(&file[pos], length, frame.data(), (int)frame.size()));
+    }
+}
+
+static int WriteToVector(void *data, uint64_t offset, const unsigned char *buf, int length)
+{
+    std::vector<unsigned char> &file = *static_cast<std::vector<unsigned char> *>(data);
+
+    if (file.size() < offset + length)
+        file.resize(offset + length);
+    std::memcpy(&file[offset], buf, length);
+    return 1;
+}
+
+TEST(Capture, WritesSeekableFile)
+{
+    static char name[] = "capture_tests";
+    char *argv[] = {name, NULL};
+    std::vector<unsigned char> file;
+    std::vector<unsigned char> palette(768), otherpalette(768);
+    const int numframes = 150;
+
+    for (int i = 0; i < 768; ++i)
+    {
+        palette[i] = (unsigned char)i;
+        otherpalette[i] = (unsigned char)(255 - i);
+    }
+
+    ZoneHarness_Init(1, argv);
+
+    ASSERT_TRUE(M_StartCapture(WriteToVector, &file, width, height));
+    for (int i = 0; i < numframes; ++i)
+        M_CaptureFrame(i * 2, GameFrame(i).data(), i >= 70 && i < 75 ? otherpalette.data() : palette.data());
+    M_StopCapture();
+
+    ASSERT_GE(file.size(), 32u);
+    EXPECT_EQ(std::memcmp(&file[0], "DCAP", 4), 0);
+    EXPECT_EQ(file[8] | (file[9] << 8), width);
+    EXPECT_EQ(file[10] | (file[11] << 8), height);
+    ASSERT_EQ(ReadLong(&file[12]), (unsigned int)numframes);
+    ASSERT_EQ(ReadLongLong(&file[16]) + numframes * 8, file.size());
+
+    // Much smaller than the raw frames, even with every wall moving.
+    EXPECT_LT(file.size(), (size_t)numframes * width * height / 5);
+
+    std::vector<unsigned char> frame, framepalette;
+    int tic;
+
+    for (int i : {0, 1, 63, 64, 70, 74, 75, 127, 128, numframes - 1})
+    {
+        SCOPED_TRACE(i);
+        ReadFrame(file, i, frame, framepalette, tic);
+        EXPECT_EQ(tic, i * 2);
+        EXPECT_TRUE(frame == GameFrame(i));
+        EXPECT_TRUE(framepalette == (i >= 70 && i < 75 ? otherpalette : palette));
+    }
+}
@@ -0,0 +1,199 @@
+#include "gtest/gtest.h"
+#include "demo_trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+// The engine headers do not build as C++, so declare what is needed.
+extern "C"
+{
+int G_EncodeCompactDemo(const unsigned char *in, int length, unsigned char *out, int outsize);
+int G_DecodeCompactDemo(const unsigned char *in, int length, unsigned char *out, int outsize);
+}
+
+// About ten minutes of game time; the three shareware demos and the
+// pages in between take well under that.
+static const int MAX_TICS = 35 * 60 * 10;
+
+// Batched runs, drawing now and then or never, play the demos out
+// exactly as a run that draws every tic.  Each run is in a child
+// process, so this comes before Doom1Demos starts the engine here.
+TEST(DemoRegression, BatchedMatchesEveryTic)
+{
+    if (!DemoTrace_HaveIwad())
+    {
+        GTEST_SKIP() << "doom1.wad is not embedded in this build";
+    }
+
+    const char *everytic = "demotrace_everytic.txt";
+    const char *batched = "demotrace_batched.txt";
+    char report[1024];
+
+    ASSERT_TRUE(DemoTrace_RunBatched(MAX_TICS, 1, 1, everytic));
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(DemoTrace_RunBatched(MAX_TICS, 35, 0, batched));
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_TRUE(DemoTrace_CompareTics(everytic, batched, report, sizeof(report)))
+        << report;
+
+    ASSERT_TRUE(DemoTrace_RunBatched(MAX_TICS, 4, 3, batched));
+    EXPECT_TRUE(DemoTrace_CompareTics(everytic, batched, report, sizeof(report)))
+        << report;
+
+    std::printf("batched, never drawing: %.0f ms for the title loop\n",
+                std::chrono::duration<double, std::milli>(end - start).count());
+
+    std::remove(everytic);
+    std::remove(batched);
+}
+
+// Checked against the golden trace when there is one.  doom1.wad
+// cannot be kept in the repository, so neither can a trace of it;
+// without one, a reference run of this build with the fast paths
+// turned off is traced first and this run is checked against that.
+// Set DEMO_TRACE_UPDATE=1 to write the golden trace after a change
+// that is meant to alter the simulation or the rendering.
+
+TEST(DemoRegression, Doom1Demos)
+{
+    if (!DemoTrace_HaveIwad())
+    {
+        GTEST_SKIP() << "doom1.wad is not embedded in this build";
+    }
+
+    bool update = std::getenv("DEMO_TRACE_UPDATE") != nullptr;
+    const char *reference = DEMO_GOLDEN_TRACE;
+
+    // Before this process starts the engine, as the reference run
+    // is a fork of it.
+    if (!update && !std::ifstream(DEMO_GOLDEN_TRACE).good())
+    {
+        reference = "demotrace_reference.txt";
+        ASSERT_TRUE(DemoTrace_RunReference(MAX_TICS, reference))
+            << "reference run did not finish";
+    }
+
+    ASSERT_GE(DemoTrace_Run(MAX_TICS), 0) << "demos did not finish";
+
+    if (update)
+    {
+        ASSERT_TRUE(DemoTrace_Write(DEMO_GOLDEN_TRACE));
+        GTEST_SKIP() << "wrote " << DEMO_GOLDEN_TRACE;
+    }
+
+    char report[1024];
+    EXPECT_TRUE(DemoTrace_Compare(reference, report, sizeof(report)))
+        << "against " << reference << ": " << report;
+
+    if (reference != DEMO_GOLDEN_TRACE)
+    {
+        std::remove(reference);
+    }
+}
+
+// A made-up recording that plays like a person at a keyboard: keys
+// held for a while, turning in bursts, firing now and then.
+static std::vector<unsigned char> SyntheticDemo(int tics, int players, bool longtics)
+{
+    std::vector<unsigned char> demo = {
+        (unsigned char)(longtics ? 111 : 109), 2, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0,
+    };
+    unsigned int seed = 12345;
+    struct { int forward, side, turn, buttons, hold; } held[4] = {};
+
+    for (int i = 0; i < players; ++i)
+    {
+        demo[9 + i] = 1;
+    }
+
+    for (int tic = 0; tic < tics; ++tic)
+    {
+        for (int i = 0; i < players; ++i)
+        {
+            if (held[i].hold-- <= 0)
+            {
+                seed = seed * 1103515245 + 12345;
+                held[i].forward = (int)(seed >> 16) % 3 * 25 - 25;
+                held[i].side = (seed >> 20) % 4 == 0 ? 24 : 0;
+                held[i].turn = (seed >> 22) % 3 == 0 ? 640 : 0;
+                held[i].buttons = (seed >> 24) % 5 == 0 ? 1 : 0;
+                held[i].hold = 5 + (seed >> 8) % 60;
+            }
+
+            int turn = held[i].turn ? held[i].turn + tic % 7 * 16 : 0;
+
+            demo.push_back((unsigned char)held[i].forward);
+            demo.push_back((unsigned char)held[i].side);
+            if (longtics)
+            {
+                demo.push_back(turn & 0xff);
+            }
+            demo.push_back((turn >> 8) & 0xff);
+            demo.push_back(held[i].buttons);
+        }
+    }
+
+    demo.push_back(0x80);
+
+    return demo;
+}
+
+static void RoundTrip(int players, bool longtics)
+{
+    // One hour of play.
+    std::vector<unsigned char> demo = SyntheticDemo(35 * 60 * 60, players, longtics);
+    int length = (int)demo.size();
+
+    int compactlength = G_EncodeCompactDemo(demo.data(), length, nullptr, 0);
+    ASSERT_GT(compactlength, 0);
+
+    std::vector<unsigned char> compact(compactlength);
+    std::vector<unsigned char> decoded(length);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(G_EncodeCompactDemo(demo.data(), length, compact.data(), compactlength), compactlength);
+    auto encoded = std::chrono::steady_clock::now();
+    ASSERT_EQ(G_DecodeCompactDemo(compact.data(), compactlength, decoded.data(), length), length);
+    auto end = std::chrono::steady_clock::now();
+
+    EXPECT_EQ(demo, decoded);
+    EXPECT_LT(compactlength, length);
+
+    std::printf("%d player%s%s: %d -> %d bytes (%.1f%%), encode %.2f ms, decode %.2f ms\n",
+                players, players > 1 ? "s" : "", longtics ? ", longtics" : "",
+                length, compactlength, 100.0 * compactlength / length,
+                std::chrono::duration<double, std::milli>(encoded - start).count(),
+                std::chrono::duration<double, std::milli>(end - encoded).count());
+}
+
+TEST(DemoCodec, RoundTrip)
+{
+    RoundTrip(1, false);
+    RoundTrip(1, true);
+    RoundTrip(4, false);
+}
+
+TEST(DemoCodec, KeepsTail)
+{
+    std::vector<unsigned char> demo = SyntheticDemo(100, 2, false);
+
+    // A tic cut short, the marker and trailing junk all survive.
+    demo.pop_back();
+    demo.insert(demo.end(), {10, 0, 0, 0, 0x80, 'x', 'y'});
+
+    int length = (int)demo.size();
+    std::vector<unsigned char> compact(G_EncodeCompactDemo(demo.data(), length, nullptr, 0));
+    ASSERT_EQ(G_EncodeCompactDemo(demo.data(), length, compact.data(), (int)compact.size()), (int)compact.size());
+
+    std::vector<unsigned char> decoded(length);
+    ASSERT_EQ(G_DecodeCompactDemo(compact.data(), (int)compact.size(), decoded.data(), length), length);
+    EXPECT_EQ(demo, decoded);
+
+    // Truncated compact data is rejected rather than read past.
+    EXPECT_EQ(G_DecodeCompactDemo(compact.data(), 20, nullptr, 0), -1);
+}
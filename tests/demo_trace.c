@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "doomdef.h"
+#include "doomgeneric.h"
+#include "i_video.h"
+#include "m_misc.h"
+#include "p_local.h"
+
+#include "demo_trace.h"
+
+extern unsigned int doom1_wad_len;
+
+typedef struct
+{
+    char kind;          // 'T' for a tic, 'F' for a frame
+    int index;          // gametic or frame number
+    int demo;           // demosequence at the time
+    unsigned int hash;
+} tracerecord_t;
+
+static doom_data_t doom;
+
+static tracerecord_t *records;
+static int numrecords;
+static int maxrecords;
+static int numframes;
+
+static void AddRecord(char kind, int index, unsigned int hash)
+{
+    if (numrecords == maxrecords)
+    {
+        maxrecords = maxrecords ? maxrecords * 2 : 4096;
+        records = realloc(records, maxrecords * sizeof(*records));
+    }
+
+    records[numrecords].kind = kind;
+    records[numrecords].index = index;
+    records[numrecords].demo = doom.demosequence;
+    records[numrecords].hash = hash;
+    ++numrecords;
+}
+
+void doomgeneric_Res(uint32_t *width, uint32_t *height)
+{
+    *width = 800;
+    *height = 600;
+}
+
+void DG_Init() {}
+
+void DG_DrawFrame()
+{
+    AddRecord('F', numframes++,
+              M_HashBytes(M_HASH_INIT, I_VideoBuffer, SCREENWIDTH * SCREENHEIGHT));
+}
+
+int DG_GetKey(int *pressed, unsigned char *key)
+{
+    return 0;
+}
+
+int DemoTrace_HaveIwad(void)
+{
+    return doom1_wad_len > 12;
+}
+
+static int RunTitleLoop(int argc, char **argv, int maxtics)
+{
+    int lastgametic;
+    int seenlast;
+    int tics;
+
+    doomdata_init(&doom);
+    doomgeneric_Create(&doom, argc, argv);
+
+    lastgametic = doom.gametic;
+    seenlast = 0;
+
+    // The title loop plays demo1, demo2 and demo3 between the title,
+    // credit and help screens, then wraps round to the title.
+
+    for (tics = 0; tics < maxtics && !doom.should_quit; ++tics)
+    {
+        doomgeneric_Tick(&doom);
+
+        if (doom.gametic != lastgametic)
+        {
+            lastgametic = doom.gametic;
+            AddRecord('T', doom.gametic, P_GameStateHash(&doom));
+        }
+
+        if (doom.demosequence == 5)
+        {
+            seenlast = 1;
+        }
+        else if (seenlast)
+        {
+            return tics;
+        }
+    }
+
+    return -1;
+}
+
+int DemoTrace_Run(int maxtics)
+{
+    static char *argv[] = { "doomgeneric_demotests", NULL };
+
+    return RunTitleLoop(1, argv, maxtics);
+}
+
+int DemoTrace_RunReference(int maxtics, const char *path)
+{
+    // The plain C drawers, one wall column at a time, no level
+    // prefetching, thinkers in their own zone blocks and every sight
+    // check traversed.
+    static char *argv[] =
+    {
+        "doomgeneric_demotests", "-nosimd", "-nowallbatch", "-noprefetch",
+        "-nothinkerpools", "-nosightcache", NULL
+    };
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+
+    if (pid < 0)
+    {
+        return 0;
+    }
+
+    if (pid == 0)
+    {
+        numrecords = 0;
+        numframes = 0;
+
+        if (RunTitleLoop(arrlen(argv) - 1, argv, maxtics) < 0)
+        {
+            _exit(1);
+        }
+
+        fflush(stdout);
+        _exit(DemoTrace_Write(path) ? 0 : 1);
+    }
+
+    waitpid(pid, &status, 0);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int DemoTrace_RunBatched(int maxtics, int tics, int drawevery, const char *path)
+{
+    static char *argv[] = { "doomgeneric_demotests", NULL };
+    int seenlast;
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+
+    if (pid < 0)
+    {
+        return 0;
+    }
+
+    if (pid == 0)
+    {
+        doomdata_init(&doom);
+        doomgeneric_Create(&doom, 1, argv);
+        doomgeneric_SetBatch(&doom, tics, drawevery);
+
+        numrecords = 0;
+        seenlast = 0;
+
+        while (doom.gametic < maxtics && !doom.should_quit)
+        {
+            doomgeneric_Tick(&doom);
+            AddRecord('T', doom.gametic, P_GameStateHash(&doom));
+
+            if (doom.demosequence == 5)
+            {
+                seenlast = 1;
+            }
+            else if (seenlast)
+            {
+                fflush(stdout);
+                _exit(DemoTrace_Write(path) ? 0 : 1);
+            }
+        }
+
+        _exit(1);
+    }
+
+    waitpid(pid, &status, 0);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int DemoTrace_Write(const char *path)
+{
+    FILE *file;
+    int i;
+
+    file = fopen(path, "w");
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    fprintf(file, "# doomgeneric demo trace v1: kind index demo hash\n");
+
+    for (i = 0; i < numrecords; ++i)
+    {
+        fprintf(file, "%c %d %d %08x\n", records[i].kind, records[i].index,
+                records[i].demo, records[i].hash);
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+// Find the first record of the given kind that differs.
+
+static void CompareKind(char kind, tracerecord_t *golden, int numgolden,
+                        char *report, size_t report_len)
+{
+    const char *name = kind == 'T' ? "tic" : "frame";
+    size_t used = strlen(report);
+    int g, r;
+
+    for (g = 0, r = 0;; ++g, ++r)
+    {
+        while (g < numgolden && golden[g].kind != kind)
+            ++g;
+        while (r < numrecords && records[r].kind != kind)
+            ++r;
+
+        if (g == numgolden || r == numrecords)
+        {
+            if (g != numgolden || r != numrecords)
+            {
+                snprintf(report + used, report_len - used,
+                         "%s count differs: trace ends early in %s\n",
+                         name, g == numgolden ? "golden" : "this run");
+            }
+            return;
+        }
+
+        if (golden[g].index != records[r].index
+         || golden[g].hash != records[r].hash)
+        {
+            snprintf(report + used, report_len - used,
+                     "first divergent %s: %d (demo sequence %d), "
+                     "expected %08x, got %08x\n",
+                     name, records[r].index, records[r].demo,
+                     golden[g].hash, records[r].hash);
+            return;
+        }
+    }
+}
+
+static tracerecord_t *ReadTrace(const char *path, int *count)
+{
+    tracerecord_t *golden;
+    int numgolden;
+    int maxgolden;
+    char line[128];
+    FILE *file;
+
+    file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    golden = NULL;
+    numgolden = maxgolden = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        tracerecord_t rec;
+
+        if (line[0] == '#')
+            continue;
+
+        if (sscanf(line, "%c %d %d %x", &rec.kind, &rec.index,
+                   &rec.demo, &rec.hash) != 4)
+            continue;
+
+        if (numgolden == maxgolden)
+        {
+            maxgolden = maxgolden ? maxgolden * 2 : 4096;
+            golden = realloc(golden, maxgolden * sizeof(*golden));
+        }
+
+        golden[numgolden++] = rec;
+    }
+
+    fclose(file);
+
+    *count = numgolden;
+
+    return golden != NULL ? golden : calloc(1, sizeof(*golden));
+}
+
+int DemoTrace_Compare(const char *path, char *report, size_t report_len)
+{
+    tracerecord_t *golden;
+    int numgolden;
+
+    report[0] = '\0';
+    golden = ReadTrace(path, &numgolden);
+
+    if (golden == NULL)
+    {
+        snprintf(report, report_len, "cannot open %s\n", path);
+        return 0;
+    }
+
+    CompareKind('T', golden, numgolden, report, report_len);
+    CompareKind('F', golden, numgolden, report, report_len);
+
+    free(golden);
+
+    return report[0] == '\0';
+}
+
+int DemoTrace_CompareTics(const char *path, const char *sampled,
+                          char *report, size_t report_len)
+{
+    tracerecord_t *all, *some;
+    int numall, numsome;
+    int a, s;
+
+    report[0] = '\0';
+    all = ReadTrace(path, &numall);
+    some = ReadTrace(sampled, &numsome);
+
+    if (all == NULL || some == NULL)
+    {
+        snprintf(report, report_len, "cannot open %s\n",
+                 all == NULL ? path : sampled);
+        free(all);
+        free(some);
+        return 0;
+    }
+
+    for (a = 0, s = 0; s < numsome; ++s)
+    {
+        while (a < numall && (all[a].kind != 'T' || all[a].index < some[s].index))
+            ++a;
+
+        // The sampled run may stop a little later.
+
+        if (a == numall)
+        {
+            break;
+        }
+
+        if (all[a].index != some[s].index)
+        {
+            snprintf(report, report_len, "tic %d is not in %s\n",
+                     some[s].index, path);
+            break;
+        }
+
+        if (all[a].hash != some[s].hash)
+        {
+            snprintf(report, report_len,
+                     "first divergent tic: %d (demo sequence %d), "
+                     "expected %08x, got %08x\n",
+                     some[s].index, some[s].demo, all[a].hash, some[s].hash);
+            break;
+        }
+    }
+
+    free(all);
+    free(some);
+
+    return report[0] == '\0';
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Headless playback of the demos in the embedded IWAD, recording a
+// game state hash per tic and a hash of I_VideoBuffer per frame.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+// False if the build embeds a placeholder instead of doom1.wad.
+int DemoTrace_HaveIwad(void);
+
+// Run the title loop until the last demo has finished.  Can only be
+// called once per process.  Returns the number of tics run, or -1 if
+// maxtics ran out first.
+int DemoTrace_Run(int maxtics);
+
+// Run the title loop in a child process with every optional fast
+// path turned off (-nosimd -nowallbatch -noprefetch -nothinkerpools
+// -nosightcache), and write its trace to path.  Returns 1 if the
+// demos finished.
+int DemoTrace_RunReference(int maxtics, const char *path);
+
+// Run the title loop in a child process, tics tics to a call and
+// drawing every drawevery calls, and write a trace of the state after
+// each call to path.  Returns 1 if the demos finished.
+int DemoTrace_RunBatched(int maxtics, int tics, int drawevery, const char *path);
+
+int DemoTrace_Write(const char *path);
+
+// Compare against a trace written by DemoTrace_Write.  Returns 1 if
+// they match; otherwise describes the first divergent tic and frame
+// in report.
+int DemoTrace_Compare(const char *path, char *report, size_t report_len);
+
+// Check every tic in the trace sampled has the same state as in the
+// trace at path, up to where that ends.
+int DemoTrace_CompareTics(const char *path, const char *sampled,
+                          char *report, size_t report_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,215 @@
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// The engine headers do not build as C++ (boolean is an enum with
+// false/true members), so declare what is needed here.
+extern "C"
+{
+typedef unsigned char byte;
+typedef int fixed_t;
+
+#define FRACUNIT (1 << 16)
+#define SCREENWIDTH 320
+#define SCREENHEIGHT 200
+
+extern byte *I_VideoBuffer;
+extern int scaledviewwidth;
+extern int viewheight;
+
+extern int ds_y;
+extern int ds_x1;
+extern int ds_x2;
+extern byte *ds_colormap;
+extern fixed_t ds_xfrac;
+extern fixed_t ds_yfrac;
+extern fixed_t ds_xstep;
+extern fixed_t ds_ystep;
+extern byte *ds_source;
+
+extern int centery;
+extern int dc_x;
+extern int dc_yl;
+extern int dc_yh;
+extern fixed_t dc_iscale;
+extern fixed_t dc_texturemid;
+extern byte *dc_source;
+extern byte *dc_colormap;
+
+typedef struct
+{
+    byte *source;
+    int yl;
+    int yh;
+    fixed_t texturemid;
+    fixed_t iscale;
+} wallcolumn_t;
+
+void R_DrawColumn(void);
+void R_DrawWallColumns(wallcolumn_t *columns, int count, int x, byte *colormap);
+
+void R_InitBuffer(int width, int height);
+void R_DrawSpan(void);
+void R_DrawSpanSSE2(void);
+void R_DrawSpanAVX2(void);
+int R_HaveAVX2(void);
+}
+
+// Matches the R_SPAN_SIMD condition in r_draw.h.
+#if defined(__x86_64__) || defined(_M_X64)
+
+typedef void (*spandrawer_t)(void);
+
+// Draws the same random spans with R_DrawSpan and with the given
+// drawer and expects identical framebuffers.
+static void CompareSpans(spandrawer_t drawer)
+{
+    static byte flatstore[64 * 64 + 4];
+    static byte colormapstore[256 + 4];
+    static byte expected[SCREENWIDTH * SCREENHEIGHT];
+    static byte actual[SCREENWIDTH * SCREENHEIGHT];
+    byte *savedbuffer;
+    int i;
+
+    // Put both tables at an odd address to exercise the gather
+    // alignment handling.
+    for (i = 0; i < (int) sizeof(flatstore); ++i)
+    {
+        flatstore[i] = (byte) std::rand();
+    }
+    for (i = 0; i < (int) sizeof(colormapstore); ++i)
+    {
+        colormapstore[i] = (byte) std::rand();
+    }
+
+    savedbuffer = I_VideoBuffer;
+
+    for (i = 0; i < 2000; ++i)
+    {
+        int x1 = std::rand() % SCREENWIDTH;
+        int x2 = x1 + std::rand() % (SCREENWIDTH - x1);
+
+        ds_y = std::rand() % SCREENHEIGHT;
+        ds_xfrac = std::rand() * 65599;
+        ds_yfrac = std::rand() * 65599;
+        ds_xstep = (std::rand() % (8 * FRACUNIT)) - 4 * FRACUNIT;
+        ds_ystep = (std::rand() % (8 * FRACUNIT)) - 4 * FRACUNIT;
+        ds_source = flatstore + 1 + (i & 3);
+        ds_colormap = colormapstore + 1 + ((i >> 2) & 3);
+
+        std::memset(expected, 0, sizeof(expected));
+        std::memset(actual, 0, sizeof(actual));
+
+        I_VideoBuffer = expected;
+        R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+        ds_x1 = x1;
+        ds_x2 = x2;
+        R_DrawSpan();
+
+        I_VideoBuffer = actual;
+        R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+        ds_x1 = x1;
+        ds_x2 = x2;
+        drawer();
+
+        ASSERT_EQ(std::memcmp(expected, actual, sizeof(expected)), 0)
+            << "span " << x1 << "-" << x2 << " at " << ds_y;
+    }
+
+    I_VideoBuffer = savedbuffer;
+    R_InitBuffer(scaledviewwidth, viewheight);
+}
+
+TEST(SpanDrawer, SSE2MatchesScalar)
+{
+    CompareSpans(R_DrawSpanSSE2);
+}
+
+TEST(SpanDrawer, AVX2MatchesScalar)
+{
+    if (!R_HaveAVX2())
+    {
+        GTEST_SKIP() << "no AVX2 on this CPU";
+    }
+
+    CompareSpans(R_DrawSpanAVX2);
+}
+
+#endif
+
+// Draws random runs of wall columns with R_DrawColumn one at a time
+// and with R_DrawWallColumns, and expects identical framebuffers.
+TEST(WallColumns, MatchPerColumn)
+{
+    static byte texture[4][128];
+    static byte colormap[256];
+    static byte expected[SCREENWIDTH * SCREENHEIGHT];
+    static byte actual[SCREENWIDTH * SCREENHEIGHT];
+    wallcolumn_t columns[4];
+    byte *savedbuffer;
+    int savedcentery;
+    int i, j;
+
+    for (i = 0; i < (int) sizeof(texture); ++i)
+    {
+        texture[i / 128][i % 128] = (byte) std::rand();
+    }
+    for (i = 0; i < 256; ++i)
+    {
+        colormap[i] = (byte) std::rand();
+    }
+
+    savedbuffer = I_VideoBuffer;
+    savedcentery = centery;
+    centery = SCREENHEIGHT / 2;
+
+    for (i = 0; i < 2000; ++i)
+    {
+        int count = 1 + std::rand() % 4;
+        int x = std::rand() % (SCREENWIDTH - count + 1);
+
+        for (j = 0; j < count; ++j)
+        {
+            // Mostly overlapping, sometimes disjoint.
+            columns[j].yl = std::rand() % SCREENHEIGHT;
+            columns[j].yh = columns[j].yl + std::rand() % (SCREENHEIGHT - columns[j].yl);
+            if (i & 1)
+            {
+                columns[j].yl /= 4;
+                columns[j].yh = SCREENHEIGHT - 1 - columns[j].yl;
+            }
+            columns[j].source = texture[j];
+            columns[j].texturemid = std::rand() * 65599;
+            columns[j].iscale = 1 + std::rand() % (4 * FRACUNIT);
+        }
+
+        std::memset(expected, 0, sizeof(expected));
+        std::memset(actual, 0, sizeof(actual));
+
+        I_VideoBuffer = expected;
+        R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+        dc_colormap = colormap;
+        for (j = 0; j < count; ++j)
+        {
+            dc_x = x + j;
+            dc_yl = columns[j].yl;
+            dc_yh = columns[j].yh;
+            dc_source = columns[j].source;
+            dc_texturemid = columns[j].texturemid;
+            dc_iscale = columns[j].iscale;
+            R_DrawColumn();
+        }
+
+        I_VideoBuffer = actual;
+        R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+        R_DrawWallColumns(columns, count, x, colormap);
+
+        ASSERT_EQ(std::memcmp(expected, actual, sizeof(expected)), 0)
+            << count << " columns at " << x;
+    }
+
+    I_VideoBuffer = savedbuffer;
+    centery = savedcentery;
+    R_InitBuffer(scaledviewwidth, viewheight);
+}
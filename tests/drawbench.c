@@ -0,0 +1,653 @@
+//
+// Microbenchmark for the column and span drawers in r_draw.c.
+//
+// With the IWAD embedded the drawers are fed real wall texture columns,
+// a real flat and the real COLORMAP lump; otherwise synthetic data of
+// the same shape is used.  Each drawer is swept over column heights or
+// span lengths and texture steps, and one CSV line is printed per case
+// with the nanoseconds and TSC cycles spent per pixel written.
+//
+// Then whole menu and intermission frames are drawn from synthetic
+// patches, once with the column drawer, once from decoded patches and,
+// for the intermission, once more with its background in a layer.
+//
+// usage: doomgeneric_drawbench [-pixels N] [-texture NAME] [-flat NAME]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+#include "doomdef.h"
+#include "doomgeneric.h"
+#include "i_video.h"
+#include "patch_harness.h"
+#include "r_data.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "r_state.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+extern unsigned int doom1_wad_len;
+
+// Columns are 128 texels high, spans sample a 64x64 flat.  The
+// translated drawers do not wrap (sprite columns are drawn exactly), so
+// each column is repeated out far enough for the largest step.
+#define BENCH_COLUMNS 64
+#define BENCH_COLUMNHEIGHT 128
+#define BENCH_COLUMNSOURCE 512
+#define BENCH_FLATSIZE (64 * 64)
+
+typedef void (*drawfunc_t)(void);
+
+typedef struct
+{
+    const char *name;
+    drawfunc_t func;
+    boolean low;
+} benchdrawer_t;
+
+static const benchdrawer_t columndrawers[] =
+{
+    { "R_DrawColumn", R_DrawColumn, false },
+    { "R_DrawColumnLow", R_DrawColumnLow, true },
+    { "R_DrawFuzzColumn", R_DrawFuzzColumn, false },
+    { "R_DrawFuzzColumnLow", R_DrawFuzzColumnLow, true },
+    { "R_DrawTranslatedColumn", R_DrawTranslatedColumn, false },
+    { "R_DrawTranslatedColumnLow", R_DrawTranslatedColumnLow, true },
+};
+
+static const benchdrawer_t spandrawers[] =
+{
+    { "R_DrawSpan", R_DrawSpan, false },
+    { "R_DrawSpanLow", R_DrawSpanLow, true },
+#ifdef R_SPAN_SIMD
+    { "R_DrawSpanSSE2", R_DrawSpanSSE2, false },
+    { "R_DrawSpanAVX2", R_DrawSpanAVX2, false },
+#endif
+};
+
+static const int columnheights[] = { 16, 64, 128, SCREENHEIGHT - 2 };
+static const int spanlengths[] = { 16, 64, 160, SCREENWIDTH };
+
+// Texture steps: magnified, 1:1 and minified.
+static const fixed_t steps[] = { FRACUNIT / 4, FRACUNIT, FRACUNIT * 5 / 2 };
+
+static doom_data_t doom;
+
+static byte benchcolumns[BENCH_COLUMNS][BENCH_COLUMNSOURCE];
+static byte benchflat[BENCH_FLATSIZE];
+static byte benchtranslation[256];
+static lighttable_t *benchcolormap;
+
+static long long pixelsper = 4000000;
+
+// Frames drawn per UI case.
+#define BENCH_FRAMES 2000
+
+void doomgeneric_Res(uint32_t *width, uint32_t *height)
+{
+    *width = 800;
+    *height = 600;
+}
+
+void DG_Init() {}
+
+void DG_DrawFrame() {}
+
+int DG_GetKey(int *pressed, unsigned char *key)
+{
+    return 0;
+}
+
+static unsigned long long NowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned long long NowCycles(void)
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void SyntheticData(void)
+{
+    static char *argv[] = { "doomgeneric_drawbench", NULL };
+    int i, j;
+
+    for (i = 0; i < BENCH_COLUMNS; ++i)
+    {
+        for (j = 0; j < BENCH_COLUMNSOURCE; ++j)
+        {
+            benchcolumns[i][j] = (byte) (i * 7 + j * 3 + ((i ^ j) & 15));
+        }
+    }
+
+    for (i = 0; i < BENCH_FLATSIZE; ++i)
+    {
+        benchflat[i] = (byte) (i * 5 + (i >> 6) * 11);
+    }
+
+    // A light table that is not the identity, so lookups cannot fold.
+
+    colormaps = malloc((NUMCOLORMAPS + 2) * 256);
+
+    for (i = 0; i < NUMCOLORMAPS + 2; ++i)
+    {
+        for (j = 0; j < 256; ++j)
+        {
+            colormaps[i * 256 + j] = (lighttable_t) ((j * (32 - i / 2)) >> 5);
+        }
+    }
+
+    I_VideoBuffer = calloc(SCREENWIDTH, SCREENHEIGHT);
+
+    // The UI frames need a zone for their patches.
+
+    doomdata_init(&doom);
+    doom.myargc = 1;
+    doom.myargv = argv;
+    Z_Init(&doom);
+}
+
+static boolean WadData(const char *texname, const char *flatname)
+{
+    static char *argv[] = { "doomgeneric_drawbench", NULL };
+    byte *flat;
+    int texnum;
+    int height;
+    int i, j;
+
+    doomdata_init(&doom);
+    doomgeneric_Create(&doom, 1, argv);
+
+    texnum = R_CheckTextureNumForName((char *) texname);
+
+    if (texnum < 0)
+    {
+        fprintf(stderr, "drawbench: no texture %s\n", texname);
+        return false;
+    }
+
+    // Texture columns wrap on their own height; repeat them out to fill
+    // the source buffer.
+
+    height = textureheight[texnum] >> FRACBITS;
+
+    if (height <= 0 || height > BENCH_COLUMNHEIGHT)
+    {
+        height = BENCH_COLUMNHEIGHT;
+    }
+
+    for (i = 0; i < BENCH_COLUMNS; ++i)
+    {
+        byte *source = R_GetColumn(&doom, texnum, i);
+
+        for (j = 0; j < BENCH_COLUMNSOURCE; ++j)
+        {
+            benchcolumns[i][j] = source[j % height];
+        }
+    }
+
+    if (W_CheckNumForName(&doom, (char *) flatname) < 0)
+    {
+        fprintf(stderr, "drawbench: no flat %s\n", flatname);
+        return false;
+    }
+
+    flat = W_CacheLumpNum(&doom, firstflat + R_FlatNumForName(&doom, (char *) flatname),
+                          PU_STATIC);
+    memcpy(benchflat, flat, BENCH_FLATSIZE);
+
+    return true;
+}
+
+static void SetupView(void)
+{
+    int i;
+
+    // Full-screen view, as with screenblocks 11.
+
+    viewwidth = SCREENWIDTH;
+    viewheight = SCREENHEIGHT;
+    centery = viewheight / 2;
+    centeryfrac = centery << FRACBITS;
+    R_InitBuffer(viewwidth, viewheight);
+
+    // A mid-distance light level, and a translation that remaps the
+    // green ramp like the player colours do.
+
+    benchcolormap = colormaps + 8 * 256;
+
+    for (i = 0; i < 256; ++i)
+    {
+        benchtranslation[i] = (i >= 0x70 && i <= 0x7f) ? (byte) (0x60 + (i & 0xf))
+                                                        : (byte) i;
+    }
+}
+
+static void Report(const char *kind, const char *name, int size, fixed_t step,
+                   long long pixels, unsigned long long ns,
+                   unsigned long long cycles)
+{
+    printf("%s,%s,%d,%d,%lld,%.4f,%.3f\n", kind, name, size, step, pixels,
+           (double) ns / pixels, (double) cycles / pixels);
+}
+
+static void BenchColumn(const benchdrawer_t *drawer, int height, fixed_t step)
+{
+    unsigned long long startns, startcycles;
+    long long pixels;
+    int columns;
+    int x;
+
+    columns = drawer->low ? viewwidth / 2 : viewwidth;
+
+    dc_colormap = benchcolormap;
+    dc_translation = benchtranslation;
+    dc_iscale = step;
+
+    // The fuzz drawers clamp to [1, viewheight - 2].
+
+    dc_yl = (viewheight - height) / 2;
+    if (dc_yl < 1)
+    {
+        dc_yl = 1;
+    }
+    dc_yh = dc_yl + height - 1;
+    if (dc_yh > viewheight - 2)
+    {
+        dc_yh = viewheight - 2;
+    }
+
+    // Start every column at texel 0, as R_DrawMaskedColumn would.
+
+    dc_texturemid = (centery - dc_yl) * step;
+
+    pixels = 0;
+    x = 0;
+    startns = NowNs();
+    startcycles = NowCycles();
+
+    while (pixels < pixelsper)
+    {
+        dc_x = x;
+        dc_source = benchcolumns[x & (BENCH_COLUMNS - 1)];
+        drawer->func();
+
+        // The fuzz drawers may have moved dc_yl/dc_yh.  Low detail
+        // writes every texel twice; count screen pixels.
+        pixels += (dc_yh - dc_yl + 1) << drawer->low;
+
+        if (++x == columns)
+        {
+            x = 0;
+        }
+    }
+
+    Report("column", drawer->name, height, step, pixels, NowNs() - startns,
+           NowCycles() - startcycles);
+}
+
+//
+// Runs of four adjacent wall columns through R_DrawWallColumns, to set
+// against the R_DrawColumn lines.  Neighbouring columns get slightly
+// different heights and steps, as on an angled wall.
+//
+static void BenchWallColumns(int height, fixed_t step)
+{
+    unsigned long long startns, startcycles;
+    wallcolumn_t columns[MAXWALLBATCH];
+    long long pixels;
+    int x, i;
+
+    for (i = 0; i < MAXWALLBATCH; ++i)
+    {
+        columns[i].yl = (viewheight - height) / 2 + (i & 1);
+        columns[i].yh = columns[i].yl + height - 1 - (i & 1) * 2;
+        if (columns[i].yh < columns[i].yl)
+        {
+            columns[i].yh = columns[i].yl;
+        }
+        columns[i].iscale = step + i * 64;
+        columns[i].texturemid = (centery - columns[i].yl) * columns[i].iscale;
+    }
+
+    pixels = 0;
+    x = 0;
+    startns = NowNs();
+    startcycles = NowCycles();
+
+    while (pixels < pixelsper)
+    {
+        for (i = 0; i < MAXWALLBATCH; ++i)
+        {
+            columns[i].source = benchcolumns[(x + i) & (BENCH_COLUMNS - 1)];
+            pixels += columns[i].yh - columns[i].yl + 1;
+        }
+
+        R_DrawWallColumns(columns, MAXWALLBATCH, x, benchcolormap);
+
+        x += MAXWALLBATCH;
+        if (x + MAXWALLBATCH > viewwidth)
+        {
+            x = 0;
+        }
+    }
+
+    Report("column", "R_DrawWallColumns", height, step, pixels, NowNs() - startns,
+           NowCycles() - startcycles);
+}
+
+static void BenchSpan(const benchdrawer_t *drawer, int length, fixed_t step)
+{
+    unsigned long long startns, startcycles;
+    long long pixels;
+    int x2;
+    int y;
+
+    // Low detail spans are given in half-width coordinates.
+
+    x2 = (length >> drawer->low) - 1;
+
+    ds_colormap = benchcolormap;
+    ds_source = benchflat;
+
+    // Walk the flat diagonally, as an angled floor would.
+
+    ds_xstep = step;
+    ds_ystep = step / 3;
+
+    pixels = 0;
+    y = 0;
+    startns = NowNs();
+    startcycles = NowCycles();
+
+    while (pixels < pixelsper)
+    {
+        // The low detail drawer doubles ds_x1/ds_x2 in place.
+        ds_x1 = 0;
+        ds_x2 = x2;
+        ds_y = y;
+        ds_xfrac = y << (FRACBITS - 1);
+        ds_yfrac = y << FRACBITS;
+        drawer->func();
+
+        pixels += length;
+
+        if (++y == viewheight)
+        {
+            y = 0;
+        }
+    }
+
+    Report("span", drawer->name, length, step, pixels, NowNs() - startns,
+           NowCycles() - startcycles);
+}
+
+//
+// Menu and intermission frames.
+//
+
+enum
+{
+    UI_TITLE,
+    UI_ITEM,
+    UI_SKULL,
+    UI_GLYPH,
+    UI_BACKGROUND,
+    UI_ANIM,
+    UI_NUMBER,
+    NUMUIPATCHES
+};
+
+static const struct
+{
+    int width, height, holes;
+} uishapes[NUMUIPATCHES] =
+{
+    { 118, 83, 1 },     // M_DOOM
+    { 150, 16, 1 },     // M_NGAME and friends
+    { 20, 19, 1 },      // M_SKULL1
+    { 8, 7, 1 },        // STCFN font
+    { 320, 200, 0 },    // WIMAP0
+    { 32, 24, 1 },      // WIA animations
+    { 12, 15, 1 },      // WINUM
+};
+
+static patch_t *uipatches[NUMUIPATCHES];
+
+// The main menu over a live screen: the title, six items, the skull
+// and a line of text.
+
+static void DrawMenuFrame(void)
+{
+    int i;
+
+    V_DrawPatch(&doom, 94, 2, uipatches[UI_TITLE]);
+
+    for (i = 0; i < 6; ++i)
+    {
+        V_DrawPatch(&doom, 97, 64 + i * 16, uipatches[UI_ITEM]);
+    }
+
+    V_DrawPatch(&doom, 65, 64, uipatches[UI_SKULL]);
+
+    for (i = 0; i < 40; ++i)
+    {
+        V_DrawPatch(&doom, i * 8, 190, uipatches[UI_GLYPH]);
+    }
+}
+
+static void DrawIntermissionBack(void)
+{
+    int i;
+
+    V_DrawPatch(&doom, 0, 0, uipatches[UI_BACKGROUND]);
+
+    for (i = 0; i < 10; ++i)
+    {
+        V_DrawPatch(&doom, 16 + i * 29, 40 + (i % 3) * 40, uipatches[UI_ANIM]);
+    }
+}
+
+// The stats screen: the map and its animations, then the counts.
+
+static void DrawIntermissionFrame(vlayer_t *layer)
+{
+    int i;
+
+    if (layer == NULL)
+    {
+        DrawIntermissionBack();
+    }
+    else
+    {
+        if (V_BeginLayer(&doom, layer, 0))
+        {
+            DrawIntermissionBack();
+        }
+
+        V_EndLayer(&doom, layer);
+    }
+
+    for (i = 0; i < 12; ++i)
+    {
+        V_DrawPatch(&doom, 200 + (i % 4) * 14, 50 + (i / 4) * 24,
+                    uipatches[UI_NUMBER]);
+    }
+}
+
+static void BenchFrame(const char *name, int decoded, vlayer_t *layer,
+                       void (*draw)(vlayer_t *layer))
+{
+    unsigned long long startns, startcycles;
+    lumpinfo_t *lumpinfo = doom.lumpinfo;
+    unsigned int numlumps = doom.numlumps;
+    int i;
+
+    // Without lumps behind them the patches are drawn a column at a
+    // time; with them, from their decoded rows.
+
+    PatchHarness_SetLumps(&doom, uipatches, decoded ? NUMUIPATCHES : 0);
+    V_UseBuffer(&doom, I_VideoBuffer);
+
+    // One untimed frame to decode the patches and fill the layer.
+
+    draw(layer);
+
+    startns = NowNs();
+    startcycles = NowCycles();
+
+    for (i = 0; i < BENCH_FRAMES; ++i)
+    {
+        draw(layer);
+    }
+
+    Report("frame", name, decoded + (layer != NULL), 0, BENCH_FRAMES,
+           NowNs() - startns, NowCycles() - startcycles);
+
+    doom.lumpinfo = lumpinfo;
+    doom.numlumps = numlumps;
+}
+
+static void DrawMenu(vlayer_t *layer)
+{
+    DrawMenuFrame();
+}
+
+static void BenchFrames(void)
+{
+    vlayer_t layer;
+    int i;
+
+    for (i = 0; i < NUMUIPATCHES; ++i)
+    {
+        uipatches[i] = PatchHarness_Make(uishapes[i].width, uishapes[i].height,
+                                         uishapes[i].holes);
+    }
+
+    memset(&layer, 0, sizeof(layer));
+
+    BenchFrame("menu", 0, NULL, DrawMenu);
+    BenchFrame("menu", 1, NULL, DrawMenu);
+    BenchFrame("intermission", 0, NULL, DrawIntermissionFrame);
+    BenchFrame("intermission", 1, NULL, DrawIntermissionFrame);
+    BenchFrame("intermission", 1, &layer, DrawIntermissionFrame);
+
+    V_FreeLayer(&layer);
+}
+
+int main(int argc, char **argv)
+{
+    const char *texname = "STARTAN3";
+    const char *flatname = "FLOOR4_8";
+    boolean fromwad;
+    int d, s, i;
+
+    for (i = 1; i < argc - 1; i += 2)
+    {
+        if (!strcmp(argv[i], "-pixels"))
+        {
+            pixelsper = atoll(argv[i + 1]);
+        }
+        else if (!strcmp(argv[i], "-texture"))
+        {
+            texname = argv[i + 1];
+        }
+        else if (!strcmp(argv[i], "-flat"))
+        {
+            flatname = argv[i + 1];
+        }
+    }
+
+    if (pixelsper <= 0)
+    {
+        pixelsper = 4000000;
+    }
+
+    fromwad = doom1_wad_len > 12 && WadData(texname, flatname);
+
+    if (!fromwad)
+    {
+        if (doom1_wad_len > 12)
+        {
+            return 1;
+        }
+
+        SyntheticData();
+    }
+
+    SetupView();
+
+    printf("# data=%s texture=%s flat=%s pixels=%lld tsc=%s\n",
+           fromwad ? "wad" : "synthetic", fromwad ? texname : "-",
+           fromwad ? flatname : "-", pixelsper,
+#ifdef HAVE_RDTSC
+           "yes"
+#else
+           "no"
+#endif
+           );
+    printf("kind,drawer,size,step,pixels,ns_per_pixel,cycles_per_pixel\n");
+
+    for (d = 0; d < arrlen(columndrawers); ++d)
+    {
+        for (i = 0; i < arrlen(columnheights); ++i)
+        {
+            for (s = 0; s < arrlen(steps); ++s)
+            {
+                BenchColumn(&columndrawers[d], columnheights[i], steps[s]);
+            }
+        }
+    }
+
+    for (i = 0; i < arrlen(columnheights); ++i)
+    {
+        for (s = 0; s < arrlen(steps); ++s)
+        {
+            BenchWallColumns(columnheights[i], steps[s]);
+        }
+    }
+
+    for (d = 0; d < arrlen(spandrawers); ++d)
+    {
+#ifdef R_SPAN_SIMD
+        if (spandrawers[d].func == R_DrawSpanAVX2 && !R_HaveAVX2())
+        {
+            continue;
+        }
+#endif
+
+        for (i = 0; i < arrlen(spanlengths); ++i)
+        {
+            for (s = 0; s < arrlen(steps); ++s)
+            {
+                BenchSpan(&spandrawers[d], spanlengths[i], steps[s]);
+            }
+        }
+    }
+
+    // For frames, size is 0 for the column drawer, 1 for decoded
+    // patches and 2 with a layer too; the times are per frame.
+
+    BenchFrames();
+
+    return 0;
+}
@@ -1,3 +1,14 @@
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 int d_putchar(int c) { return putchar(c); }
+
+uint64_t DG_GetTicksUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <vector>
+
+// The engine headers do not build as C++, so declare what is needed.
+extern "C"
+{
+int M_LZ4Compress(const unsigned char *src, int length, unsigned char *dest, int destlength);
+int M_LZ4Decompress(const unsigned char *src, int length, unsigned char *dest, int destlength);
+}
+
+static std::vector<unsigned char> Pack(const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> packed(data.size() + data.size() / 255 + 16);
+    int length = M_LZ4Compress(data.data(), (int)data.size(), packed.data(), (int)packed.size());
+    EXPECT_GT(length, 0);
+    packed.resize(length);
+    return packed;
+}
+
+static void RoundTrip(const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> packed = Pack(data);
+    std::vector<unsigned char> unpacked(data.size());
+
+    ASSERT_EQ(M_LZ4Decompress(packed.data(), (int)packed.size(), unpacked.data(), (int)unpacked.size()),
+              (int)data.size());
+    EXPECT_EQ(data, unpacked);
+}
+
+TEST(LZ4, RoundTrip)
+{
+    std::vector<unsigned char> data;
+
+    RoundTrip(data);
+    RoundTrip({1, 2, 3});
+
+    // Runs, which decode with a match overlapping its own output.
+    data.assign(100000, 0xaa);
+    RoundTrip(data);
+    EXPECT_LT(Pack(data).size(), data.size() / 100);
+
+    // Something patch-like: repeated rows with a few changes.
+    data.clear();
+    for (int i = 0; i < 64 * 1024; ++i)
+        data.push_back((i % 320) < 200 ? (unsigned char)(i % 7 + (i / 4096)) : 0);
+    RoundTrip(data);
+    EXPECT_LT(Pack(data).size(), data.size() / 4);
+
+    // Random data does not compress, but still comes back.
+    std::srand(1);
+    data.resize(70000);
+    for (auto &b : data)
+        b = (unsigned char)std::rand();
+    RoundTrip(data);
+}
+
+TEST(LZ4, RejectsBadData)
+{
+    std::vector<unsigned char> data(5000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (unsigned char)(i / 10);
+
+    std::vector<unsigned char> packed = Pack(data);
+    std::vector<unsigned char> unpacked(data.size());
+
+    // Too small an output, a truncated input and an offset before
+    // the start are refused without writing out of bounds.
+    EXPECT_EQ(M_LZ4Decompress(packed.data(), (int)packed.size(), unpacked.data(), 100), -1);
+    EXPECT_EQ(M_LZ4Decompress(packed.data(), (int)packed.size() / 2, unpacked.data(), (int)unpacked.size()), -1);
+
+    const unsigned char badoffset[] = {0x14, 'a', 0x10, 0x00, 0x00};
+    EXPECT_EQ(M_LZ4Decompress(badoffset, sizeof(badoffset), unpacked.data(), (int)unpacked.size()), -1);
+}
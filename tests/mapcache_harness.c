@@ -0,0 +1,298 @@
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomdata.h"
+#include "p_local.h"
+#include "r_state.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "mapcache_harness.h"
+
+// Two sectors side by side, split by a two-sided line:
+//
+//   3-----2-----5
+//   |  0  |  1  |
+//   0-----1-----4
+
+static vertex_t mapvertexes[6];
+static sector_t mapsectors[2];
+static side_t mapsides[5];
+static line_t maplines[4];
+static subsector_t mapsubsectors[2];
+static node_t mapnodes[1];
+static seg_t mapsegs[5];
+static line_t *maplinebuffer[5];
+
+// One block holding every line, then the reject matrix.
+static short mapblockmap[] = { 0, 0, 1, 1, 5, 0, 0, 1, 2, 3, -1 };
+static byte mapreject[1] = { 0x06 };
+
+static byte wadbytes[64];
+static wad_file_t wadfile;
+static lumpinfo_t lumps[ML_BLOCKMAP + 1];
+
+static void InitLumps(doom_data_t *doom)
+{
+    static const char *names[] =
+    {
+        "E1M1", "THINGS", "LINEDEFS", "SIDEDEFS", "VERTEXES", "SEGS",
+        "SSECTORS", "NODES", "SECTORS", "REJECT", "BLOCKMAP",
+    };
+    int i;
+
+    memset(lumps, 0, sizeof(lumps));
+    memcpy(wadbytes, mapblockmap, sizeof(mapblockmap));
+    wadfile.mapped = wadbytes;
+    wadfile.length = sizeof(wadbytes);
+
+    for (i = 0; i <= ML_BLOCKMAP; ++i)
+    {
+        strncpy(lumps[i].name, names[i], sizeof(lumps[i].name));
+        lumps[i].wad_file = &wadfile;
+    }
+
+    lumps[ML_REJECT].size = sizeof(mapreject);
+    lumps[ML_BLOCKMAP].size = sizeof(mapblockmap);
+
+    doom->lumpinfo = lumps;
+    doom->numlumps = ML_BLOCKMAP + 1;
+}
+
+static void SetSide(side_t *side, int sector)
+{
+    side->sector = &mapsectors[sector];
+    side->textureoffset = sector * FRACUNIT;
+}
+
+static void SetLine(line_t *line, int v1, int v2, int front, int back)
+{
+    line->v1 = &mapvertexes[v1];
+    line->v2 = &mapvertexes[v2];
+    line->dx = line->v2->x - line->v1->x;
+    line->dy = line->v2->y - line->v1->y;
+    line->frontsector = &mapsectors[front];
+    line->backsector = back >= 0 ? &mapsectors[back] : NULL;
+    line->flags = back >= 0 ? ML_TWOSIDED : ML_BLOCKING;
+}
+
+static void SetSeg(seg_t *seg, int line, int side, int front, int back)
+{
+    seg->v1 = maplines[line].v1;
+    seg->v2 = maplines[line].v2;
+    seg->linedef = &maplines[line];
+    seg->sidedef = &mapsides[side];
+    seg->frontsector = &mapsectors[front];
+    seg->backsector = back >= 0 ? &mapsectors[back] : NULL;
+}
+
+static void InitLevel(void)
+{
+    static const int coords[6][2] =
+    {
+        { 0, 0 }, { 64, 0 }, { 64, 64 }, { 0, 64 }, { 128, 0 }, { 128, 64 },
+    };
+    int i;
+
+    memset(mapvertexes, 0, sizeof(mapvertexes));
+    memset(mapsectors, 0, sizeof(mapsectors));
+    memset(mapsides, 0, sizeof(mapsides));
+    memset(maplines, 0, sizeof(maplines));
+    memset(mapsubsectors, 0, sizeof(mapsubsectors));
+    memset(mapnodes, 0, sizeof(mapnodes));
+    memset(mapsegs, 0, sizeof(mapsegs));
+
+    for (i = 0; i < 6; ++i)
+    {
+        mapvertexes[i].x = coords[i][0] * FRACUNIT;
+        mapvertexes[i].y = coords[i][1] * FRACUNIT;
+    }
+
+    for (i = 0; i < 2; ++i)
+    {
+        mapsectors[i].floorheight = i * 8 * FRACUNIT;
+        mapsectors[i].ceilingheight = 128 * FRACUNIT;
+        mapsectors[i].lightlevel = 160 + i * 32;
+    }
+
+    SetSide(&mapsides[0], 0);
+    SetSide(&mapsides[1], 0);
+    SetSide(&mapsides[2], 1);
+    SetSide(&mapsides[3], 1);
+    SetSide(&mapsides[4], 1);
+
+    SetLine(&maplines[0], 0, 1, 0, -1);
+    SetLine(&maplines[1], 1, 2, 0, 1);
+    SetLine(&maplines[2], 1, 4, 1, -1);
+    SetLine(&maplines[3], 4, 5, 1, -1);
+
+    SetSeg(&mapsegs[0], 0, 0, 0, -1);
+    SetSeg(&mapsegs[1], 1, 1, 0, 1);
+    SetSeg(&mapsegs[2], 1, 2, 1, 0);
+    SetSeg(&mapsegs[3], 2, 3, 1, -1);
+    SetSeg(&mapsegs[4], 3, 4, 1, -1);
+
+    mapsubsectors[0].sector = &mapsectors[0];
+    mapsubsectors[0].numlines = 2;
+    mapsubsectors[1].sector = &mapsectors[1];
+    mapsubsectors[1].firstline = 2;
+    mapsubsectors[1].numlines = 3;
+
+    mapnodes[0].x = 64 * FRACUNIT;
+    mapnodes[0].dy = 64 * FRACUNIT;
+    mapnodes[0].children[0] = 1 | NF_SUBSECTOR;
+    mapnodes[0].children[1] = 0 | NF_SUBSECTOR;
+
+    // As P_GroupLines would leave them: each sector's lines, one
+    // after another.
+
+    maplinebuffer[0] = &maplines[0];
+    maplinebuffer[1] = &maplines[1];
+    maplinebuffer[2] = &maplines[1];
+    maplinebuffer[3] = &maplines[2];
+    maplinebuffer[4] = &maplines[3];
+    mapsectors[0].lines = &maplinebuffer[0];
+    mapsectors[0].linecount = 2;
+    mapsectors[1].lines = &maplinebuffer[2];
+    mapsectors[1].linecount = 3;
+
+    vertexes = mapvertexes;
+    numvertexes = arrlen(mapvertexes);
+    sectors = mapsectors;
+    numsectors = arrlen(mapsectors);
+    sides = mapsides;
+    numsides = arrlen(mapsides);
+    lines = maplines;
+    numlines = arrlen(maplines);
+    subsectors = mapsubsectors;
+    numsubsectors = arrlen(mapsubsectors);
+    nodes = mapnodes;
+    numnodes = arrlen(mapnodes);
+    segs = mapsegs;
+    numsegs = arrlen(mapsegs);
+    totallines = arrlen(maplinebuffer);
+    blockmaplump = mapblockmap;
+    rejectmatrix = mapreject;
+}
+
+// Index of a pointer into an array, or -1 for NULL, so the loaded
+// level can be compared with the one that was cached.
+
+#define INDEX(ptr, base) ((ptr) == NULL ? -1 : (int) ((ptr) - (base)))
+
+static int Mismatches(void)
+{
+    line_t **linebuffer;
+    int n, i;
+
+    n = (numvertexes != arrlen(mapvertexes)) + (numsectors != arrlen(mapsectors))
+      + (numsides != arrlen(mapsides)) + (numlines != arrlen(maplines))
+      + (numsubsectors != arrlen(mapsubsectors)) + (numnodes != arrlen(mapnodes))
+      + (numsegs != arrlen(mapsegs)) + (totallines != arrlen(maplinebuffer));
+
+    if (n > 0 || vertexes == mapvertexes)
+    {
+        return n + 1;
+    }
+
+    linebuffer = sectors[0].lines;
+
+    n += memcmp(vertexes, mapvertexes, sizeof(mapvertexes)) != 0;
+    n += memcmp(nodes, mapnodes, sizeof(mapnodes)) != 0;
+    n += memcmp(blockmaplump, mapblockmap, sizeof(mapblockmap)) != 0;
+    n += memcmp(rejectmatrix, mapreject, sizeof(mapreject)) != 0;
+    n += bmapwidth != 1 || bmapheight != 1 || blockmap != blockmaplump + 4;
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        n += sectors[i].floorheight != mapsectors[i].floorheight;
+        n += sectors[i].lightlevel != mapsectors[i].lightlevel;
+        n += sectors[i].linecount != mapsectors[i].linecount;
+        n += INDEX(sectors[i].lines, linebuffer)
+          != INDEX(mapsectors[i].lines, maplinebuffer);
+    }
+
+    for (i = 0; i < numsides; ++i)
+    {
+        n += sides[i].textureoffset != mapsides[i].textureoffset;
+        n += INDEX(sides[i].sector, sectors)
+          != INDEX(mapsides[i].sector, mapsectors);
+    }
+
+    for (i = 0; i < numlines; ++i)
+    {
+        n += lines[i].flags != maplines[i].flags;
+        n += INDEX(lines[i].v1, vertexes) != INDEX(maplines[i].v1, mapvertexes);
+        n += INDEX(lines[i].v2, vertexes) != INDEX(maplines[i].v2, mapvertexes);
+        n += INDEX(lines[i].frontsector, sectors)
+          != INDEX(maplines[i].frontsector, mapsectors);
+        n += INDEX(lines[i].backsector, sectors)
+          != INDEX(maplines[i].backsector, mapsectors);
+    }
+
+    for (i = 0; i < numsubsectors; ++i)
+    {
+        n += subsectors[i].firstline != mapsubsectors[i].firstline;
+        n += INDEX(subsectors[i].sector, sectors)
+          != INDEX(mapsubsectors[i].sector, mapsectors);
+    }
+
+    for (i = 0; i < numsegs; ++i)
+    {
+        n += INDEX(segs[i].v1, vertexes) != INDEX(mapsegs[i].v1, mapvertexes);
+        n += INDEX(segs[i].v2, vertexes) != INDEX(mapsegs[i].v2, mapvertexes);
+        n += INDEX(segs[i].sidedef, sides) != INDEX(mapsegs[i].sidedef, mapsides);
+        n += INDEX(segs[i].linedef, lines) != INDEX(mapsegs[i].linedef, maplines);
+        n += INDEX(segs[i].frontsector, sectors)
+          != INDEX(mapsegs[i].frontsector, mapsectors);
+        n += INDEX(segs[i].backsector, sectors)
+          != INDEX(mapsegs[i].backsector, mapsectors);
+    }
+
+    for (i = 0; i < totallines; ++i)
+    {
+        n += INDEX(linebuffer[i], lines) != INDEX(maplinebuffer[i], maplines);
+    }
+
+    return n;
+}
+
+int MapCacheHarness_RoundTrip(int loads)
+{
+    static char *argv[] = { "mapcache_harness", NULL };
+    static doom_data_t doom;
+    int mismatches;
+    int i;
+
+    doomdata_init(&doom);
+    doom.myargc = 1;
+    doom.myargv = argv;
+    doom.savegamedir = "";
+    Z_Init(&doom);
+
+    InitLumps(&doom);
+    InitLevel();
+
+    // There are no writable files here, as in the embedded build,
+    // so the zone copy is all there is to load from.
+
+    P_SaveMapCache(&doom, "E1M1", 0);
+
+    mismatches = 0;
+
+    for (i = 0; i < loads; ++i)
+    {
+        // As P_SetupLevel does before loading a level.
+        Z_FreeTags(PU_LEVEL, PU_PURGELEVEL - 1);
+        InitLevel();
+
+        if (!P_LoadMapCache(&doom, "E1M1", 0))
+        {
+            return -1;
+        }
+
+        mismatches += Mismatches();
+    }
+
+    return mismatches;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Caching a small hand-built level and loading it back, for the
+// map cache tests.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Caches the level, then loads it from the cache loads times, as
+// restarting it would.  Returns the number of fields that did not
+// come back as they were, or -1 if a load did not use the cache.
+int MapCacheHarness_RoundTrip(int loads);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+#include "gtest/gtest.h"
+#include "mapcache_harness.h"
+
+// A level cached with -mapcache comes back from the zone copy with
+// every pointer relocated, again and again, with no cache file.
+TEST(MapCache, RoundTrip)
+{
+    EXPECT_EQ(MapCacheHarness_RoundTrip(3), 0);
+}
@@ -0,0 +1,295 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "d_loop.h"
+#include "doomdef.h"
+#include "i_timer.h"
+#include "net_client.h"
+#include "net_server.h"
+#include "net_udp.h"
+#include "z_zone.h"
+
+#include "net_harness.h"
+
+// Longest a node may take over the whole game.
+#define NODE_DEADLINE_MS 20000
+
+enum
+{
+    NODE_OK,
+    NODE_NO_CONNECTION,
+    NODE_WRONG_PLAYERS,
+    NODE_TIMED_OUT,
+    NODE_BAD_TICCMD,
+    NODE_CRASHED,
+};
+
+static const char *node_errors[] =
+{
+    "ok",
+    "could not connect",
+    "wrong number of players",
+    "timed out",
+    "wrong ticcmd",
+    "crashed",
+};
+
+static int num_players;
+static int num_nodes;
+static int bad_tics;
+
+// Each player's ticcmds are a fixed function of the player and tic,
+// changing often enough to exercise every field of the diffs.
+
+static void ExpectedTiccmd(ticcmd_t *cmd, int player, int tic)
+{
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->forwardmove = (tic / 3 + player * 11) % 50;
+    cmd->sidemove = -player;
+    cmd->angleturn = (short) (tic * 97 * (player + 1)) & 0xff00;
+    cmd->buttons = tic % 7 == 0 ? BT_ATTACK : 0;
+    cmd->consistancy = tic & 0xff;
+    cmd->chatchar = tic % 50 == 0 ? 'a' + player : 0;
+}
+
+static void ProcessEvents(doom_data_t *doom)
+{
+}
+
+static void BuildTiccmd(doom_data_t *doom, ticcmd_t *cmd, int maketic)
+{
+    ExpectedTiccmd(cmd, doom->localplayer, maketic);
+}
+
+static void RunTic(doom_data_t *doom, ticcmd_t *cmds, boolean *ingame)
+{
+    ticcmd_t expected;
+    int p;
+
+    for (p = 0; p < num_players; ++p)
+    {
+        ExpectedTiccmd(&expected, p, doom->gametic);
+
+        if (!ingame[p] || memcmp(&cmds[p], &expected, sizeof(expected)) != 0)
+        {
+            ++bad_tics;
+        }
+    }
+}
+
+static void RunMenu(void)
+{
+}
+
+static loop_interface_t harness_interface =
+{
+    ProcessEvents,
+    BuildTiccmd,
+    RunTic,
+    RunMenu,
+};
+
+static int RunNode(int node, int drone, int batch, int tics, int port,
+                   int readyfd, int lingerfd)
+{
+    char portarg[16], nodesarg[16], batcharg[16], addrarg[32];
+    char *argv[16];
+    int argc;
+    doom_data_t *doom;
+    net_connect_data_t connect_data;
+    net_gamesettings_t settings;
+    char buffer[1];
+    int start;
+
+    snprintf(portarg, sizeof(portarg), "%d", port);
+    snprintf(nodesarg, sizeof(nodesarg), "%d", num_nodes);
+    snprintf(batcharg, sizeof(batcharg), "%d", batch);
+    snprintf(addrarg, sizeof(addrarg), "localhost:%d", port);
+
+    argc = 0;
+    argv[argc++] = "net_harness";
+    argv[argc++] = "-mb";
+    argv[argc++] = "2";
+    argv[argc++] = "-port";
+    argv[argc++] = portarg;
+    argv[argc++] = "-netbatch";
+    argv[argc++] = batcharg;
+
+    if (node == 0)
+    {
+        argv[argc++] = "-server";
+        argv[argc++] = "-nodes";
+        argv[argc++] = nodesarg;
+    }
+    else
+    {
+        argv[argc++] = "-connect";
+        argv[argc++] = addrarg;
+    }
+
+    if (drone)
+    {
+        argv[argc++] = "-drone";
+    }
+
+    argv[argc] = NULL;
+
+    doom = calloc(1, sizeof(*doom));
+    doomdata_init(doom);
+    doom->myargc = argc;
+    doom->myargv = argv;
+    Z_Init(doom);
+
+    // The server binds its port before D_InitNetGame, which keeps the
+    // socket, and closes the ready pipe to let the others connect.
+
+    if (node == 0)
+    {
+        net_udp_port = port;
+
+        if (!net_udp_module.InitServer())
+        {
+            return NODE_NO_CONNECTION;
+        }
+
+        close(readyfd);
+    }
+    else
+    {
+        while (read(readyfd, buffer, 1) > 0)
+        {
+        }
+
+        close(readyfd);
+    }
+
+    memset(&connect_data, 0, sizeof(connect_data));
+    connect_data.max_players = MAXPLAYERS;
+
+    if (!D_InitNetGame(doom, &connect_data))
+    {
+        return NODE_NO_CONNECTION;
+    }
+
+    D_RegisterLoopCallbacks(doom, &harness_interface);
+
+    memset(&settings, 0, sizeof(settings));
+    settings.skill = 2;
+    settings.episode = 1;
+    settings.map = 1;
+    D_StartNetGame(doom, &settings, NULL);
+
+    if (settings.num_players != num_players)
+    {
+        return NODE_WRONG_PLAYERS;
+    }
+
+    start = I_GetTimeMS();
+
+    while (doom->gametic < tics)
+    {
+        if (I_GetTimeMS() - start > NODE_DEADLINE_MS)
+        {
+            return NODE_TIMED_OUT;
+        }
+
+        TryRunTics(doom);
+    }
+
+    // The server relays for everyone, so it stays up until the
+    // others have finished.
+
+    if (node == 0)
+    {
+        while (read(lingerfd, buffer, 1) != 0
+            && I_GetTimeMS() - start < NODE_DEADLINE_MS)
+        {
+            NetUpdate(doom);
+            I_Sleep(1);
+        }
+    }
+
+    D_QuitNetGame(doom);
+
+    return bad_tics > 0 ? NODE_BAD_TICCMD : NODE_OK;
+}
+
+const char *NetHarness_Run(int players, int drones, int batch, int tics)
+{
+    static char report[128];
+    pid_t pids[MAXPLAYERS + 4];
+    int readypipe[2];
+    int lingerpipe[2];
+    int nodes, port;
+    int status, result;
+    int i;
+
+    num_players = players;
+    num_nodes = nodes = players + drones;
+    port = 20000 + getpid() % 20000;
+
+    if (pipe(readypipe) != 0 || pipe(lingerpipe) != 0)
+    {
+        return "pipe failed";
+    }
+
+    fflush(stdout);
+
+    for (i = 0; i < nodes; ++i)
+    {
+        pids[i] = fork();
+
+        if (pids[i] == 0)
+        {
+            close(lingerpipe[1]);
+            fcntl(lingerpipe[0], F_SETFL, O_NONBLOCK);
+
+            // Only the server holds the ready pipe open for writing.
+
+            if (i > 0)
+            {
+                close(readypipe[1]);
+            }
+
+            result = RunNode(i, i >= players, batch, tics, port,
+                             i > 0 ? readypipe[0] : readypipe[1],
+                             lingerpipe[0]);
+            fflush(stdout);
+            _exit(result);
+        }
+    }
+
+    close(readypipe[0]);
+    close(readypipe[1]);
+    close(lingerpipe[0]);
+    report[0] = '\0';
+
+    for (i = nodes - 1; i >= 0; --i)
+    {
+        if (i == 0)
+        {
+            close(lingerpipe[1]);
+        }
+
+        waitpid(pids[i], &status, 0);
+
+        result = WIFEXITED(status) ? WEXITSTATUS(status) : NODE_CRASHED;
+
+        if (result > NODE_CRASHED)
+        {
+            result = NODE_CRASHED;
+        }
+
+        if (result != NODE_OK && report[0] == '\0')
+        {
+            snprintf(report, sizeof(report), "node %d: %s", i,
+                     node_errors[result]);
+        }
+    }
+
+    return report[0] != '\0' ? report : NULL;
+}
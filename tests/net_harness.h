@@ -0,0 +1,18 @@
+#pragma once
+
+// Network games between several copies of the engine, each in its
+// own process, talking over loopback UDP.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Run a game of players players and drones drones for tics tics,
+// sending ticcmds batch tics at a time.  Every node checks each tic
+// carries every player's ticcmd as that player built it.  Returns
+// NULL on success, otherwise a description of the first failure.
+const char *NetHarness_Run(int players, int drones, int batch, int tics);
+
+#ifdef __cplusplus
+}
+#endif
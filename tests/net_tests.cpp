@@ -0,0 +1,18 @@
+#include "gtest/gtest.h"
+#include "net_harness.h"
+
+// A few seconds of game time; the nodes run as fast as the ticcmds
+// come back, so this takes well under a second.
+static const int NET_TICS = 35 * 5;
+
+TEST(NetGame, ThreePlayers)
+{
+    const char *failure = NetHarness_Run(3, 0, 1, NET_TICS);
+    EXPECT_EQ(failure, nullptr) << failure;
+}
+
+TEST(NetGame, BatchedWithDrone)
+{
+    const char *failure = NetHarness_Run(2, 1, 3, NET_TICS);
+    EXPECT_EQ(failure, nullptr) << failure;
+}
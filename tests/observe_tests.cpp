@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include "doomgeneric.h"
+}
+
+// The engine headers do not build as C++, so declare what is needed.
+extern "C"
+{
+typedef unsigned char byte;
+typedef int fixed_t;
+
+#define FRACUNIT (1 << 16)
+
+extern int viewwindowx;
+extern int viewwindowy;
+extern int scaledviewwidth;
+extern int viewheight;
+extern int detailshift;
+extern fixed_t centerxfrac;
+extern byte obslabel;
+
+void R_SetObservation(uint16_t *depth, byte *labels, dg_object_t *objects);
+void R_ObserveView(void);
+int R_ObservedViews(void);
+void R_ObserveColumn(int x, int yl, int yh, fixed_t scale);
+void R_ObserveSpan(int y, int x1, int x2, fixed_t distance);
+}
+
+static const int WIDTH = 320;
+static const int HEIGHT = 200;
+
+TEST(Observation, RegionLayout)
+{
+    std::vector<uint64_t> memory(doomgeneric_ObservationSize(DG_OBS_DEPTH | DG_OBS_LABELS) / 8 + 1);
+    dg_observation_t *obs = reinterpret_cast<dg_observation_t *>(memory.data());
+    uint8_t *base = reinterpret_cast<uint8_t *>(obs);
+
+    obs->width = WIDTH;
+    obs->height = HEIGHT;
+
+    obs->flags = DG_OBS_DEPTH | DG_OBS_LABELS;
+    EXPECT_EQ(DG_OBS_SCREEN(obs) - base, (long) sizeof(dg_observation_t));
+    EXPECT_EQ((uint8_t *) DG_OBS_DEPTHBUFFER(obs) - DG_OBS_SCREEN(obs), WIDTH * HEIGHT);
+    EXPECT_EQ(DG_OBS_LABELBUFFER(obs) - (uint8_t *) DG_OBS_DEPTHBUFFER(obs), WIDTH * HEIGHT * 2);
+    EXPECT_EQ(DG_OBS_LABELBUFFER(obs) + WIDTH * HEIGHT - base,
+              (long) doomgeneric_ObservationSize(obs->flags));
+
+    obs->flags = DG_OBS_LABELS;
+    EXPECT_EQ(DG_OBS_LABELBUFFER(obs) + WIDTH * HEIGHT - base,
+              (long) doomgeneric_ObservationSize(obs->flags));
+}
+
+// A small view window in low detail: each column covers two screen
+// pixels, and nothing outside the window is touched.
+TEST(Observation, ColumnsAndSpans)
+{
+    std::vector<uint16_t> depth(WIDTH * HEIGHT, 7);
+    std::vector<byte> labels(WIDTH * HEIGHT, 7);
+
+    viewwindowx = 32;
+    viewwindowy = 10;
+    scaledviewwidth = 256;
+    viewheight = 128;
+    detailshift = 1;
+    centerxfrac = (scaledviewwidth >> detailshift) / 2 * FRACUNIT;
+
+    R_SetObservation(depth.data(), labels.data(), nullptr);
+    int views = R_ObservedViews();
+    R_ObserveView();
+    EXPECT_EQ(R_ObservedViews(), views + 1);
+
+    // Scales are at full detail: 128 / scale units away.
+    obslabel = 3;
+    R_ObserveColumn(5, 20, 29, 2 * FRACUNIT);
+    obslabel = 0;
+    R_ObserveColumn(6, 0, 9, 0);
+    R_ObserveSpan(100, 10, 19, 300 * FRACUNIT);
+
+    R_SetObservation(nullptr, nullptr, nullptr);
+
+    for (int y = 0; y < HEIGHT; ++y)
+    {
+        for (int x = 0; x < WIDTH; ++x)
+        {
+            int vx = x - viewwindowx, vy = y - viewwindowy;
+            uint16_t wantdepth = 7;
+            byte wantlabel = 7;
+
+            if (vx >= 0 && vx < scaledviewwidth && vy >= 0 && vy < viewheight)
+            {
+                wantdepth = 0xffff;
+                wantlabel = 0;
+
+                if (vx / 2 == 5 && vy >= 20 && vy <= 29)
+                {
+                    wantdepth = 64;
+                    wantlabel = 3;
+                }
+                else if (vy == 100 && vx / 2 >= 10 && vx / 2 <= 19)
+                {
+                    wantdepth = 300;
+                }
+            }
+
+            ASSERT_EQ(depth[y * WIDTH + x], wantdepth) << x << "," << y;
+            ASSERT_EQ(labels[y * WIDTH + x], wantlabel) << x << "," << y;
+        }
+    }
+}
+
+// A copy is good only if no tick started or finished while it was
+// being made.
+TEST(Observation, ReadRetry)
+{
+    dg_observation_t obs = {};
+
+    obs.sequence = 4;
+    uint32_t sequence = doomgeneric_ObservationReadBegin(&obs);
+    EXPECT_EQ(sequence, 4u);
+    EXPECT_FALSE(doomgeneric_ObservationReadRetry(&obs, sequence));
+
+    obs.sequence = 5;
+    EXPECT_TRUE(doomgeneric_ObservationReadRetry(&obs, sequence));
+    obs.sequence = 6;
+    EXPECT_TRUE(doomgeneric_ObservationReadRetry(&obs, sequence));
+}
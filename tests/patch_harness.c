@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "i_swap.h"
+#include "i_video.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "patch_harness.h"
+
+#define MAXLUMPS 64
+
+static lumpinfo_t lumps[MAXLUMPS];
+
+// The posts reach overhang rows past the height in the header, which
+// the column drawer draws anyway.
+
+static patch_t *MakePatch(int width, int height, int holes, int overhang)
+{
+    patch_t *patch;
+    byte *p;
+    int size, rows;
+    int x, y, g, len, i;
+
+    rows = height + overhang;
+
+    // Worst case, one post per two rows.
+    size = 8 + width * 4 + width * (rows / 2 + 1) * 4 + width * rows + width;
+    patch = Z_Malloc(size, PU_STATIC, NULL);
+
+    patch->width = SHORT(width);
+    patch->height = SHORT(height);
+    patch->leftoffset = 0;
+    patch->topoffset = 0;
+
+    p = (byte *) &patch->columnofs[width];
+
+    for (x = 0; x < width; ++x)
+    {
+        patch->columnofs[x] = LONG(p - (byte *) patch);
+
+        // Columns come in groups of six alike, as in the strokes of
+        // a letter, so rows have runs to find.
+
+        g = x / 6;
+        y = holes ? g % 3 : 0;
+
+        while (y < rows)
+        {
+            len = holes ? 1 + (g * 7 + y) % 5 : rows - y;
+            if (y + len > rows)
+            {
+                len = rows - y;
+            }
+
+            *p++ = y;
+            *p++ = len;
+            *p++ = 0;
+            for (i = 0; i < len; ++i)
+            {
+                *p++ = (byte) (x * 13 + (y + i) * 7);
+            }
+            *p++ = 0;
+
+            y += len + (holes ? 1 + (g + y) % 4 : 0);
+        }
+
+        *p++ = 0xff;
+    }
+
+    return patch;
+}
+
+patch_t *PatchHarness_Make(int width, int height, int holes)
+{
+    return MakePatch(width, height, holes, 0);
+}
+
+void PatchHarness_SetLumps(doom_data_t *doom, patch_t **patches, int count)
+{
+    int i;
+
+    memset(lumps, 0, sizeof(lumps));
+
+    // Owned by the lump, as W_CacheLumpNum leaves a cached lump.
+    for (i = 0; i < count && i < MAXLUMPS; ++i)
+    {
+        Z_ChangeUser(patches[i], &lumps[i].cache);
+    }
+
+    doom->lumpinfo = lumps;
+    doom->numlumps = i;
+}
+
+static const struct
+{
+    int width, height, holes, overhang;
+} shapes[] =
+{
+    { 8, 7, 1, 0 },         // font
+    { 150, 16, 1, 0 },      // menu item
+    { 118, 83, 1, 0 },      // title
+    { 320, 200, 0, 0 },     // background
+    { 320, 200, 1, 0 },
+    { 24, 10, 1, 6 },       // posts past the patch height
+    { 64, 32, 0, 9 },
+};
+
+int PatchHarness_Mismatches(int flipped)
+{
+    static char *argv[] = { "patch_harness", NULL };
+    static doom_data_t doom;
+    static byte columns[SCREENWIDTH * SCREENHEIGHT];
+    static byte rows[SCREENWIDTH * SCREENHEIGHT];
+    patch_t *patches[arrlen(shapes)];
+    int i, x, y;
+    int mismatches;
+
+    doomdata_init(&doom);
+    doom.myargc = 1;
+    doom.myargv = argv;
+    Z_Init(&doom);
+
+    for (i = 0; i < arrlen(shapes); ++i)
+    {
+        patches[i] = MakePatch(shapes[i].width, shapes[i].height,
+                               shapes[i].holes, shapes[i].overhang);
+    }
+
+    mismatches = 0;
+
+    for (i = 0; i < arrlen(shapes); ++i)
+    {
+        for (x = 0; x + shapes[i].width <= SCREENWIDTH; x += 37)
+        {
+            for (y = 0; y + shapes[i].height + shapes[i].overhang <= SCREENHEIGHT; y += 23)
+            {
+                memset(columns, 0, sizeof(columns));
+                memset(rows, 0, sizeof(rows));
+
+                PatchHarness_SetLumps(&doom, NULL, 0);
+                V_UseBuffer(&doom, columns);
+                if (flipped)
+                    V_DrawPatchFlipped(&doom, x, y, patches[i]);
+                else
+                    V_DrawPatch(&doom, x, y, patches[i]);
+
+                PatchHarness_SetLumps(&doom, patches, arrlen(shapes));
+                V_UseBuffer(&doom, rows);
+                if (flipped)
+                    V_DrawPatchFlipped(&doom, x, y, patches[i]);
+                else
+                    V_DrawPatch(&doom, x, y, patches[i]);
+
+                for (int j = 0; j < SCREENWIDTH * SCREENHEIGHT; ++j)
+                {
+                    mismatches += columns[j] != rows[j];
+                }
+            }
+        }
+    }
+
+    return mismatches;
+}
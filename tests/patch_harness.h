@@ -0,0 +1,29 @@
+#pragma once
+
+// Synthetic patches for the patch drawer tests and benchmark.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct patch_s;
+struct doom_data_t_;
+
+// Builds a width x height patch in the zone, laid out as in a WAD.
+// With holes, every column has gaps of varying length, like a font
+// or menu graphic; without, it is solid, like a background.
+struct patch_s *PatchHarness_Make(int width, int height, int holes);
+
+// Makes doom's lump directory hold just these patches, as if each
+// were a cached lump, so the drawers take their decoded path.
+void PatchHarness_SetLumps(struct doom_data_t_ *doom, struct patch_s **patches,
+                           int count);
+
+// Draws patches of several shapes, some with posts past their height,
+// at several places with the column drawer and again decoded, and
+// returns how many screen bytes differ.
+int PatchHarness_Mismatches(int flipped);
+
+#ifdef __cplusplus
+}
+#endif
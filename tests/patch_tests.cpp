@@ -0,0 +1,12 @@
+#include "gtest/gtest.h"
+#include "patch_harness.h"
+
+TEST(PatchDrawer, RowsMatchColumns)
+{
+    EXPECT_EQ(PatchHarness_Mismatches(0), 0);
+}
+
+TEST(PatchDrawer, FlippedRowsMatchColumns)
+{
+    EXPECT_EQ(PatchHarness_Mismatches(1), 0);
+}
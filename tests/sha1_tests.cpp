@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The engine headers do not build as C++, so declare what is needed.
+extern "C"
+{
+struct sha1_context_t
+{
+    unsigned int h0, h1, h2, h3, h4;
+    unsigned int nblocks;
+    unsigned char buf[64];
+    int count;
+};
+
+enum sha1_impl_t
+{
+    SHA1_SCALAR,
+    SHA1_SSSE3,
+    SHA1_SHANI,
+    NUM_SHA1_IMPLS
+};
+
+int SHA1_HaveImpl(sha1_impl_t impl);
+sha1_impl_t SHA1_BestImpl(void);
+const char *SHA1_ImplName(sha1_impl_t impl);
+int SHA1_SetImpl(sha1_impl_t impl);
+void SHA1_Init(sha1_context_t *context);
+void SHA1_Update(sha1_context_t *context, unsigned char *buf, size_t len);
+void SHA1_Final(unsigned char digest[20], sha1_context_t *context);
+}
+
+static std::string Digest(const unsigned char *data, size_t length, size_t piece = 0)
+{
+    sha1_context_t context;
+    unsigned char digest[20];
+    char hex[41];
+
+    SHA1_Init(&context);
+
+    // In uneven pieces, to go through the partial block buffer.
+    if (piece == 0)
+        piece = length;
+    for (size_t pos = 0; pos < length; pos += piece)
+        SHA1_Update(&context, const_cast<unsigned char *>(data + pos), std::min(piece, length - pos));
+
+    SHA1_Final(digest, &context);
+
+    for (int i = 0; i < 20; ++i)
+        std::snprintf(hex + i * 2, 3, "%02x", digest[i]);
+
+    return hex;
+}
+
+static std::string Digest(const char *s)
+{
+    return Digest(reinterpret_cast<const unsigned char *>(s), std::strlen(s));
+}
+
+// Every transform gives the known digests, and the same as the
+// scalar one for any length and split.
+TEST(SHA1, ImplsMatch)
+{
+    std::vector<unsigned char> data(100000);
+
+    std::srand(1);
+    for (auto &b : data)
+        b = (unsigned char)std::rand();
+
+    for (int impl = 0; impl < NUM_SHA1_IMPLS; ++impl)
+    {
+        SCOPED_TRACE(SHA1_ImplName((sha1_impl_t)impl));
+
+        if (!SHA1_SetImpl((sha1_impl_t)impl))
+        {
+            std::printf("%s: not on this CPU\n", SHA1_ImplName((sha1_impl_t)impl));
+            continue;
+        }
+
+        EXPECT_EQ(Digest(""), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+        EXPECT_EQ(Digest("abc"), "a9993e364706816aba3e25717850c26c9cd0d89d");
+        EXPECT_EQ(Digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+                  "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+
+        std::vector<std::string> digests;
+        for (size_t length : {1, 55, 56, 63, 64, 65, 127, 128, 1000, 65536, 100000})
+        {
+            digests.push_back(Digest(data.data(), length));
+            digests.push_back(Digest(data.data(), length, 37));
+        }
+
+        SHA1_SetImpl(SHA1_SCALAR);
+        size_t i = 0;
+        for (size_t length : {1, 55, 56, 63, 64, 65, 127, 128, 1000, 65536, 100000})
+        {
+            EXPECT_EQ(digests[i++], Digest(data.data(), length)) << length << " bytes";
+            EXPECT_EQ(digests[i++], Digest(data.data(), length)) << length << " bytes in pieces";
+        }
+    }
+
+    SHA1_SetImpl(SHA1_BestImpl());
+}
+
+TEST(SHA1, Throughput)
+{
+    // About the size of doom1.wad.
+    std::vector<unsigned char> data(4 << 20, 0x5a);
+
+    for (int impl = 0; impl < NUM_SHA1_IMPLS; ++impl)
+    {
+        if (!SHA1_SetImpl((sha1_impl_t)impl))
+            continue;
+
+        Digest(data.data(), data.size());
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 4; ++i)
+            Digest(data.data(), data.size());
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::printf("%s: %.0f MB/s\n", SHA1_ImplName((sha1_impl_t)impl),
+                    4.0 * data.size() / (1 << 20) / seconds);
+    }
+
+    SHA1_SetImpl(SHA1_BestImpl());
+}
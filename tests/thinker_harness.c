@@ -0,0 +1,145 @@
+#include <string.h>
+
+#include "doomdef.h"
+#include "i_timer.h"
+#include "info.h"
+#include "p_local.h"
+#include "r_state.h"
+#include "s_sound.h"
+#include "z_zone.h"
+
+#include "thinker_harness.h"
+
+static void InitMap(doom_data_t *doom, int pools)
+{
+    static char *argv[] = { "thinker_harness", "-nothinkerpools", NULL };
+    static sector_t sector;
+    static subsector_t subsector;
+
+    doomdata_init(doom);
+    doom->myargc = pools ? 1 : 2;
+    doom->myargv = argv;
+    Z_Init(doom);
+
+    // One sector and no nodes, so every point is in it; no blockmap,
+    // so everything is off it.
+
+    memset(&sector, 0, sizeof(sector));
+    sector.ceilingheight = 128 * FRACUNIT;
+    memset(&subsector, 0, sizeof(subsector));
+    subsector.sector = &sector;
+
+    sectors = &sector;
+    numsectors = 1;
+    subsectors = &subsector;
+    numsubsectors = 1;
+    numnodes = 0;
+    bmapwidth = bmapheight = 0;
+
+    // Sound is not started, so there are no channels to stop.
+    snd_channels = 0;
+
+    P_InitThinkerPools(doom);
+    P_InitThinkers();
+}
+
+// Health bonuses: animated, but with no action functions, so they
+// think without needing players or a real map.
+
+static mobj_t *Spawn(doom_data_t *doom, int i)
+{
+    return P_SpawnMobj(doom, (i % 64) << (FRACBITS + 4), (i / 64) << (FRACBITS + 4),
+                       ONFLOORZ, MT_MISC2);
+}
+
+static int CheckList(int *inorder)
+{
+    thinker_t *th;
+    mobj_t *last;
+    int n;
+
+    last = NULL;
+    n = 0;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+            continue;
+
+        // Spawn order is kept in the spawn tic's spawnpoint.
+        if (last != NULL && ((mobj_t *)th)->spawnpoint.options < last->spawnpoint.options)
+            *inorder = 0;
+
+        last = (mobj_t *)th;
+        ++n;
+    }
+
+    return n;
+}
+
+void ThinkerHarness_Stress(int count, int tics, int pools, thinkerstress_t *result)
+{
+    static doom_data_t doom;
+    static unsigned int mobjhashes[8192];
+    gamestatehash_t hash;
+    thinker_t *th, *next;
+    uint64_t start;
+    mobj_t *mo;
+    int i, n, t;
+
+    InitMap(&doom, pools);
+    doom.gamestate = GS_LEVEL;
+    memset(result, 0, sizeof(*result));
+    result->inorder = 1;
+
+    start = I_GetTimeUS();
+
+    for (i = 0; i < count; ++i)
+    {
+        Spawn(&doom, i)->spawnpoint.options = 0;
+    }
+
+    result->spawnus = I_GetTimeUS() - start;
+
+    for (t = 1; t <= tics; ++t)
+    {
+        // Remove every third object, as in a fight, and spawn as many
+        // to take their place; the pools recycle the removed ones.
+
+        n = 0;
+
+        for (th = thinkercap.next; th != &thinkercap; th = next)
+        {
+            next = th->next;
+
+            if (th->function.acp1 == (actionf_p1)P_MobjThinker && n++ % 3 == t % 3)
+            {
+                P_RemoveMobj((mobj_t *)th);
+            }
+        }
+
+        start = I_GetTimeUS();
+
+        for (i = 0; i < (n + 2 - t % 3) / 3; ++i)
+        {
+            mo = Spawn(&doom, i);
+            mo->spawnpoint.options = t;
+        }
+
+        result->spawnus += I_GetTimeUS() - start;
+
+        start = I_GetTimeUS();
+        P_RunThinkers(&doom);
+        result->thinkus += I_GetTimeUS() - start;
+
+        start = I_GetTimeUS();
+        P_HashGameState(&doom, &hash, mobjhashes, arrlen(mobjhashes));
+        result->hashus += I_GetTimeUS() - start;
+
+        CheckList(&result->inorder);
+    }
+
+    result->live = CheckList(&result->inorder);
+    result->hash = hash.mobjs;
+    result->tics = tics;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Spawning, thinking and removing map objects on a one-sector map,
+// for the thinker pool tests and stress benchmark.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    int live;           // objects on the thinker list at the end
+    int inorder;        // 1 if the list kept spawn order throughout
+    long long spawnus;  // time spent spawning
+    long long thinkus;  // time spent in P_RunThinkers
+    long long hashus;   // time spent in P_HashGameState, with every
+                        // object's hash kept, as -syncobjects does
+    unsigned int hash;  // P_HashGameState's objects hash at the end
+    int tics;
+} thinkerstress_t;
+
+// Spawns count objects, runs tics tics of thinkers, removing every
+// third object and spawning a replacement each tic.  Without pools,
+// runs with -nothinkerpools.
+void ThinkerHarness_Stress(int count, int tics, int pools, thinkerstress_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,44 @@
+#include "gtest/gtest.h"
+#include "thinker_harness.h"
+
+#include <cstdio>
+
+// Spawning and removing objects goes through the pools without
+// losing any, and the thinker list stays in spawn order.
+TEST(ThinkerPools, SpawnAndRemove)
+{
+    thinkerstress_t result;
+
+    ThinkerHarness_Stress(10, 5, 1, &result);
+    EXPECT_EQ(result.live, 10);
+    EXPECT_TRUE(result.inorder);
+}
+
+// -nothinkerpools, which the demo reference run uses, gives the same
+// objects in the same order.
+TEST(ThinkerPools, MatchesZoneBlocks)
+{
+    thinkerstress_t pooled, zone;
+
+    ThinkerHarness_Stress(500, 35, 1, &pooled);
+    ThinkerHarness_Stress(500, 35, 0, &zone);
+    EXPECT_EQ(zone.live, pooled.live);
+    EXPECT_TRUE(zone.inorder);
+    EXPECT_EQ(zone.hash, pooled.hash);
+}
+
+// Thousands of objects, a third replaced every tic.
+TEST(ThinkerPools, Stress)
+{
+    thinkerstress_t result;
+
+    ThinkerHarness_Stress(4000, 350, 1, &result);
+    EXPECT_EQ(result.live, 4000);
+    EXPECT_TRUE(result.inorder);
+
+    std::printf("4000 objects, %d tics: P_RunThinkers %lld us/tic, spawning %lld ns/object, "
+                "P_HashGameState %lld us/tic\n",
+                result.tics, result.thinkus / result.tics,
+                result.spawnus * 1000 / (4000 + result.tics * 4000 / 3),
+                result.hashus / result.tics);
+}
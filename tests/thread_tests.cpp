@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C"
+{
+#include "i_thread.h"
+}
+
+static void Count(void *data, int index)
+{
+    static_cast<std::atomic<int> *>(data)[index]++;
+}
+
+static bool EveryIndexOnce(int count, int calls)
+{
+    std::vector<std::atomic<int>> counts(count);
+
+    for (int call = 0; call < calls; ++call)
+        I_ParallelFor(count, Count, counts.data());
+
+    for (auto &c : counts)
+        if (c != calls)
+            return false;
+
+    return true;
+}
+
+// The same workers take every job, however big or small.
+TEST(ParallelFor, EveryIndexOnce)
+{
+    EXPECT_TRUE(EveryIndexOnce(1, 10));
+    EXPECT_TRUE(EveryIndexOnce(3, 100));
+    EXPECT_TRUE(EveryIndexOnce(1000, 100));
+    I_ParallelFor(0, Count, nullptr);
+}
+
+// A child forked once the workers are running has none of them, and
+// must start its own rather than wait for them.
+TEST(ParallelFor, AfterFork)
+{
+    ASSERT_TRUE(EveryIndexOnce(64, 1));
+
+    std::fflush(stdout);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+        _exit(EveryIndexOnce(64, 10) ? 0 : 1);
+
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void Nothing(void *data, int index)
+{
+}
+
+// What a call costs beyond the work, as for the texture composites
+// of a level with little to build.
+TEST(ParallelFor, CallOverhead)
+{
+    const int calls = 2000;
+
+    I_ParallelFor(64, Nothing, nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i)
+        I_ParallelFor(64, Nothing, nullptr);
+    auto end = std::chrono::steady_clock::now();
+
+    std::printf("%d threads: %.1f us per call\n", I_NumWorkerThreads(),
+                std::chrono::duration<double, std::micro>(end - start).count() / calls);
+}
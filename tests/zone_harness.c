@@ -0,0 +1,15 @@
+#include "doomdef.h"
+#include "z_zone.h"
+
+// doom_data_t does not build as C++, so the zone tests start a fresh
+// zone through here.  Each call leaks the last one, which is fine for
+// a test run.
+
+void ZoneHarness_Init(int argc, char **argv)
+{
+    static doom_data_t doom;
+
+    doom.myargc = argc;
+    doom.myargv = argv;
+    Z_Init(&doom);
+}
@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+extern "C"
+{
+#include "z_zone.h"
+
+void ZoneHarness_Init(int argc, char **argv);
+}
+
+static void InitZone(bool sites)
+{
+    static char name[] = "zone_tests", zonesites[] = "-zonesites";
+    char *argv[] = {name, zonesites, NULL};
+
+    ZoneHarness_Init(sites ? 2 : 1, argv);
+}
+
+static int UsedBytes(const zone_stats_t &stats)
+{
+    int total = 0;
+
+    for (int tag = 0; tag < PU_NUM_TAGS; ++tag)
+    {
+        total += stats.tagbytes[tag];
+    }
+
+    return total;
+}
+
+TEST(Zone, StatsFollowTags)
+{
+    zone_stats_t before, stats;
+    void *cached = NULL;
+
+    InitZone(false);
+    Z_GetStats(&before);
+    EXPECT_EQ(before.tagblocks[PU_FREE], 1);
+    EXPECT_EQ(before.largestfree, before.tagbytes[PU_FREE]);
+
+    void *a = Z_Malloc2(1000, PU_STATIC, NULL, "a", 1);
+    void *b = Z_Malloc2(3000, PU_LEVEL, NULL, "b", 1);
+    Z_Malloc2(500, PU_CACHE, &cached, "c", 1);
+
+    Z_GetStats(&stats);
+    EXPECT_EQ(UsedBytes(stats), UsedBytes(before));
+    EXPECT_EQ(stats.tagblocks[PU_STATIC], 1);
+    EXPECT_GE(stats.tagbytes[PU_STATIC], 1000);
+    EXPECT_GE(stats.tagbytes[PU_LEVEL], 3000);
+    EXPECT_EQ(stats.largestfree, stats.tagbytes[PU_FREE]);
+
+    Z_ChangeTag2(b, PU_STATIC, (char *)"b", 2);
+    Z_GetStats(&stats);
+    EXPECT_EQ(stats.tagblocks[PU_STATIC], 2);
+    EXPECT_EQ(stats.tagbytes[PU_LEVEL], 0);
+
+    // Freeing the first block leaves a hole before the others.
+
+    Z_Free(a);
+    Z_GetStats(&stats);
+    EXPECT_EQ(UsedBytes(stats), UsedBytes(before));
+    EXPECT_EQ(stats.tagblocks[PU_STATIC], 1);
+    EXPECT_EQ(stats.tagblocks[PU_FREE], 2);
+    EXPECT_LT(stats.largestfree, stats.tagbytes[PU_FREE]);
+
+    Z_FreeTags(PU_STATIC, PU_CACHE);
+    Z_GetStats(&stats);
+    EXPECT_EQ(stats.tagblocks[PU_FREE], 1);
+    EXPECT_EQ(stats.tagbytes[PU_FREE], before.tagbytes[PU_FREE]);
+    EXPECT_EQ(stats.largestfree, before.largestfree);
+    EXPECT_EQ(cached, nullptr);
+}
+
+TEST(Zone, CountsPurges)
+{
+    const int size = 1024 * 1024;
+    void *users[16] = {};
+    zone_stats_t stats;
+
+    InitZone(false);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        Z_Malloc2(size, PU_CACHE, &users[i], "cache", 1);
+    }
+
+    Z_GetStats(&stats);
+    EXPECT_GT(stats.purges, 0);
+    EXPECT_GE(stats.purgedbytes, stats.purges * size);
+    EXPECT_EQ(stats.tagblocks[PU_CACHE], 16 - stats.purges);
+    EXPECT_EQ(users[0], nullptr);
+    EXPECT_NE(users[15], nullptr);
+}
+
+TEST(Zone, TracksSites)
+{
+    zone_site_t sites[4];
+
+    InitZone(true);
+
+    void *a = Z_Malloc2(100, PU_STATIC, NULL, "small.c", 10);
+    Z_Malloc2(100, PU_STATIC, NULL, "small.c", 10);
+    Z_Malloc2(5000, PU_STATIC, NULL, "big.c", 20);
+
+    ASSERT_EQ(Z_GetSites(sites, 4), 2);
+    EXPECT_STREQ(sites[0].file, "big.c");
+    EXPECT_EQ(sites[0].line, 20);
+    EXPECT_EQ(sites[1].blocks, 2);
+    EXPECT_EQ(sites[1].allocs, 2);
+
+    Z_Free(a);
+    ASSERT_EQ(Z_GetSites(sites, 1), 1);
+    EXPECT_STREQ(sites[0].file, "big.c");
+
+    ASSERT_EQ(Z_GetSites(sites, 4), 2);
+    EXPECT_EQ(sites[1].blocks, 1);
+    EXPECT_EQ(sites[1].allocs, 2);
+    EXPECT_EQ(sites[1].peakbytes, 2 * sites[1].bytes);
+}
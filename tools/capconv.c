@@ -0,0 +1,436 @@
+//
+// capconv: turns a capture written with -capture (see
+// doomgeneric/m_capture.h) into one PNG per frame, or into a single
+// file of raw 24 bit RGB frames for a video encoder, e.g.
+//
+//   capconv -raw game.cap game.rgb
+//   ffmpeg -f rawvideo -pix_fmt rgb24 -s 320x200 -r 35 -i game.rgb game.mp4
+//
+// usage: capconv [-raw] [-first n] [-count n] <capture> <output>
+//
+// PNGs are written as <output>00000.png and so on, numbered by frame.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "m_capture.h"
+
+typedef struct
+{
+    FILE *file;
+    int width, height;
+    unsigned int numframes;
+    unsigned int keyinterval;
+    unsigned long long indexoffset;
+} capture_t;
+
+static unsigned int ReadLong(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned long long ReadLongLong(const unsigned char *p)
+{
+    return ReadLong(p) | ((unsigned long long) ReadLong(p + 4) << 32);
+}
+
+static int OpenCapture(capture_t *cap, const char *path)
+{
+    unsigned char header[CAPTURE_HEADERSIZE];
+
+    cap->file = fopen(path, "rb");
+
+    if (cap->file == NULL
+     || fread(header, sizeof(header), 1, cap->file) != 1
+     || memcmp(header, "DCAP", 4) != 0
+     || ReadLong(header + 4) != CAPTURE_VERSION)
+    {
+        return 0;
+    }
+
+    cap->width = header[8] | (header[9] << 8);
+    cap->height = header[10] | (header[11] << 8);
+    cap->numframes = ReadLong(header + 12);
+    cap->indexoffset = ReadLongLong(header + 16);
+    cap->keyinterval = ReadLong(header + 24);
+
+    return cap->width > 0 && cap->height > 0 && cap->keyinterval > 0;
+}
+
+// Moves to the key frame at or before first and returns its number.
+// A capture that was never stopped has no index and is read from
+// the start.
+
+static unsigned int SeekKeyFrame(capture_t *cap, unsigned int first)
+{
+    unsigned char entry[8];
+    unsigned int key;
+
+    if (cap->indexoffset == 0)
+    {
+        return 0;
+    }
+
+    if (first >= cap->numframes)
+    {
+        first = cap->numframes > 0 ? cap->numframes - 1 : 0;
+    }
+
+    key = first - first % cap->keyinterval;
+
+    if (fseek(cap->file, cap->indexoffset + key * 8ULL, SEEK_SET) != 0
+     || fread(entry, sizeof(entry), 1, cap->file) != 1
+     || fseek(cap->file, ReadLongLong(entry), SEEK_SET) != 0)
+    {
+        fseek(cap->file, CAPTURE_HEADERSIZE, SEEK_SET);
+        return 0;
+    }
+
+    return key;
+}
+
+// Reads the next record into frame and palette.  Returns 0 at the
+// end of the frames, -1 if the record is damaged.
+
+static int ReadFrame(capture_t *cap, unsigned char **payload,
+                     unsigned int *payloadsize, unsigned char *frame,
+                     unsigned char *palette)
+{
+    unsigned char record[CAPTURE_RECORDSIZE];
+    unsigned int flags, length;
+    long pos;
+
+    pos = ftell(cap->file);
+
+    if (cap->indexoffset != 0 && (unsigned long long) pos >= cap->indexoffset)
+    {
+        return 0;
+    }
+
+    if (fread(record, sizeof(record), 1, cap->file) != 1)
+    {
+        return 0;
+    }
+
+    flags = ReadLong(record + 4);
+    length = ReadLong(record + 8);
+
+    if ((flags & CAPTURE_PALETTE) != 0
+     && fread(palette, 768, 1, cap->file) != 1)
+    {
+        return -1;
+    }
+
+    if (length > *payloadsize)
+    {
+        *payloadsize = length;
+        *payload = realloc(*payload, length);
+    }
+
+    if (fread(*payload, 1, length, cap->file) != length)
+    {
+        return -1;
+    }
+
+    if ((flags & CAPTURE_KEY) != 0)
+    {
+        memset(frame, 0, cap->width * cap->height);
+    }
+
+    if (!M_DecodeCaptureFrame(*payload, length, frame, cap->width * cap->height))
+    {
+        return -1;
+    }
+
+    return 1;
+}
+
+//
+// PNG output, as an indexed image in stored (uncompressed) deflate
+// blocks, which needs nothing but a CRC and an Adler sum.
+//
+
+static unsigned int crctable[256];
+
+static void MakeCRCTable(void)
+{
+    unsigned int c;
+    int n, k;
+
+    for (n = 0; n < 256; ++n)
+    {
+        c = n;
+
+        for (k = 0; k < 8; ++k)
+        {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+
+        crctable[n] = c;
+    }
+}
+
+static unsigned int CRC(unsigned int crc, const unsigned char *data, size_t length)
+{
+    while (length-- > 0)
+    {
+        crc = crctable[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static void PutBigLong(unsigned char *dest, unsigned int value)
+{
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+}
+
+static void WriteChunk(FILE *out, const char *type, const unsigned char *data,
+                       unsigned int length)
+{
+    unsigned char buf[4];
+    unsigned int crc;
+
+    PutBigLong(buf, length);
+    fwrite(buf, 4, 1, out);
+    fwrite(type, 4, 1, out);
+
+    if (length > 0)
+    {
+        fwrite(data, 1, length, out);
+    }
+
+    crc = CRC(0xffffffff, (const unsigned char *) type, 4);
+    crc = CRC(crc, data, length) ^ 0xffffffff;
+    PutBigLong(buf, crc);
+    fwrite(buf, 4, 1, out);
+}
+
+static int WritePNG(const char *path, const unsigned char *frame,
+                    const unsigned char *palette, int width, int height)
+{
+    static const unsigned char signature[8] =
+        { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char ihdr[13];
+    unsigned char *raw, *data, *p;
+    unsigned int rawlength, a, b, block, i;
+    FILE *out;
+    int y;
+
+    // Each row is a filter byte (none) and the pixels.
+
+    rawlength = (width + 1) * height;
+    raw = malloc(rawlength);
+
+    for (y = 0; y < height; ++y)
+    {
+        raw[y * (width + 1)] = 0;
+        memcpy(raw + y * (width + 1) + 1, frame + y * width, width);
+    }
+
+    data = malloc(rawlength + (rawlength / 65535 + 1) * 5 + 6);
+    p = data;
+    *p++ = 0x78;
+    *p++ = 0x01;
+
+    for (i = 0; i == 0 || i < rawlength; i += block)
+    {
+        block = rawlength - i < 65535 ? rawlength - i : 65535;
+        *p++ = i + block == rawlength;
+        *p++ = block;
+        *p++ = block >> 8;
+        *p++ = ~block;
+        *p++ = ~block >> 8;
+        memcpy(p, raw + i, block);
+        p += block;
+    }
+
+    a = 1;
+    b = 0;
+
+    for (i = 0; i < rawlength; ++i)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    PutBigLong(p, (b << 16) | a);
+    p += 4;
+
+    out = fopen(path, "wb");
+
+    if (out == NULL)
+    {
+        free(raw);
+        free(data);
+        return 0;
+    }
+
+    PutBigLong(ihdr, width);
+    PutBigLong(ihdr + 4, height);
+    ihdr[8] = 8;    // bit depth
+    ihdr[9] = 3;    // indexed colour
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // adaptive filtering
+    ihdr[12] = 0;   // not interlaced
+
+    fwrite(signature, sizeof(signature), 1, out);
+    WriteChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    WriteChunk(out, "PLTE", palette, 768);
+    WriteChunk(out, "IDAT", data, p - data);
+    WriteChunk(out, "IEND", NULL, 0);
+
+    free(raw);
+    free(data);
+
+    return fclose(out) == 0;
+}
+
+static int WriteRGB(FILE *out, const unsigned char *frame,
+                    const unsigned char *palette, int length)
+{
+    unsigned char row[3 * 1024];
+    int i, n;
+
+    while (length > 0)
+    {
+        n = length < 1024 ? length : 1024;
+
+        for (i = 0; i < n; ++i)
+        {
+            memcpy(row + i * 3, palette + frame[i] * 3, 3);
+        }
+
+        if (fwrite(row, 3, n, out) != (size_t) n)
+        {
+            return 0;
+        }
+
+        frame += n;
+        length -= n;
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    capture_t cap;
+    unsigned char *frame, *payload;
+    unsigned char palette[768];
+    unsigned int payloadsize, first, count, framenum, written;
+    char path[1024];
+    FILE *rawout;
+    int raw, result;
+    int i;
+
+    raw = 0;
+    first = 0;
+    count = ~0u;
+
+    for (i = 1; i < argc - 2; ++i)
+    {
+        if (strcmp(argv[i], "-raw") == 0)
+        {
+            raw = 1;
+        }
+        else if (strcmp(argv[i], "-first") == 0 && i + 1 < argc - 2)
+        {
+            first = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-count") == 0 && i + 1 < argc - 2)
+        {
+            count = atoi(argv[++i]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i != argc - 2)
+    {
+        fprintf(stderr, "usage: %s [-raw] [-first n] [-count n] <capture> <output>\n", argv[0]);
+        return 1;
+    }
+
+    if (!OpenCapture(&cap, argv[i]))
+    {
+        fprintf(stderr, "%s: %s is not a capture\n", argv[0], argv[i]);
+        return 1;
+    }
+
+    rawout = NULL;
+
+    if (raw)
+    {
+        rawout = fopen(argv[i + 1], "wb");
+
+        if (rawout == NULL)
+        {
+            fprintf(stderr, "%s: could not open %s\n", argv[0], argv[i + 1]);
+            return 1;
+        }
+    }
+
+    MakeCRCTable();
+
+    frame = calloc(cap.width, cap.height);
+    payload = NULL;
+    payloadsize = 0;
+    memset(palette, 0, sizeof(palette));
+    written = 0;
+    result = 0;
+
+    framenum = SeekKeyFrame(&cap, first);
+
+    while (written < count && (result = ReadFrame(&cap, &payload, &payloadsize,
+                                                  frame, palette)) > 0)
+    {
+        if (framenum++ < first)
+        {
+            continue;
+        }
+
+        if (raw)
+        {
+            result = WriteRGB(rawout, frame, palette, cap.width * cap.height);
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "%s%05u.png", argv[i + 1], framenum - 1);
+            result = WritePNG(path, frame, palette, cap.width, cap.height);
+        }
+
+        if (!result)
+        {
+            fprintf(stderr, "%s: could not write frame %u\n", argv[0], framenum - 1);
+            return 1;
+        }
+
+        ++written;
+    }
+
+    if (result < 0)
+    {
+        fprintf(stderr, "%s: frame %u is damaged\n", argv[0], framenum);
+    }
+
+    if (rawout != NULL && fclose(rawout) != 0)
+    {
+        fprintf(stderr, "%s: could not write %s\n", argv[0], argv[i + 1]);
+        return 1;
+    }
+
+    printf("%u of %u frames, %dx%d\n", written, cap.numframes, cap.width, cap.height);
+
+    free(frame);
+    free(payload);
+
+    return result < 0;
+}
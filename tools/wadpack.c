@@ -0,0 +1,233 @@
+//
+// wadpack: writes a WAD file out as doom1wad_packed.h, for building
+// with -DPACKED_WAD=ON.  Every lump (and the header, directory and
+// any gaps) is compressed on its own so the game can unpack lumps
+// one at a time; see doomgeneric/w_file_packed.c.
+//
+// usage: wadpack doom1.wad doomgeneric/doom1wad_packed.h
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "m_lz4.h"
+
+static unsigned int ReadLong(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static int CompareUInt(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static unsigned char *ReadFile(const char *path, long *length)
+{
+    unsigned char *data;
+    FILE *file;
+
+    file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = malloc(*length > 0 ? *length : 1);
+
+    if (fread(data, 1, *length, file) != (size_t) *length)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char *wad, *packed, *check;
+    unsigned int *bounds, (*chunks)[4];
+    unsigned int numlumps, infotableofs, pos, size;
+    int numbounds, numchunks, numstored;
+    long length, packedlength;
+    clock_t start;
+    double unpacktime;
+    FILE *out;
+    int i, n;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <wad> <output.h>\n", argv[0]);
+        return 1;
+    }
+
+    wad = ReadFile(argv[1], &length);
+
+    if (wad == NULL || length < 12
+     || (memcmp(wad, "IWAD", 4) != 0 && memcmp(wad, "PWAD", 4) != 0))
+    {
+        fprintf(stderr, "%s: not a WAD file\n", argv[1]);
+        return 1;
+    }
+
+    numlumps = ReadLong(wad + 4);
+    infotableofs = ReadLong(wad + 8);
+
+    if (infotableofs > length || numlumps > (length - infotableofs) / 16)
+    {
+        fprintf(stderr, "%s: bad lump directory\n", argv[1]);
+        return 1;
+    }
+
+    // Split the file at the start and end of every lump, the header
+    // and the directory.
+
+    bounds = malloc((numlumps * 2 + 5) * sizeof(*bounds));
+    numbounds = 0;
+    bounds[numbounds++] = 0;
+    bounds[numbounds++] = 12;
+    bounds[numbounds++] = infotableofs;
+    bounds[numbounds++] = infotableofs + numlumps * 16;
+    bounds[numbounds++] = length;
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        pos = ReadLong(wad + infotableofs + i * 16);
+        size = ReadLong(wad + infotableofs + i * 16 + 4);
+
+        if (pos > length || size > length - pos)
+        {
+            fprintf(stderr, "%s: lump %d is past the end\n", argv[1], i);
+            return 1;
+        }
+
+        bounds[numbounds++] = pos;
+        bounds[numbounds++] = pos + size;
+    }
+
+    qsort(bounds, numbounds, sizeof(*bounds), CompareUInt);
+
+    for (i = 1, n = 1; i < numbounds; ++i)
+    {
+        if (bounds[i] != bounds[n - 1])
+        {
+            bounds[n++] = bounds[i];
+        }
+    }
+
+    numbounds = n;
+
+    // Compress each piece, keeping it as is if that is no smaller.
+
+    chunks = malloc(numbounds * sizeof(*chunks));
+    packed = malloc(M_LZ4_BOUND(length) + numbounds * 16);
+    packedlength = 0;
+    numchunks = 0;
+    numstored = 0;
+
+    for (i = 0; i + 1 < numbounds; ++i)
+    {
+        pos = bounds[i];
+        size = bounds[i + 1] - pos;
+        n = M_LZ4Compress(wad + pos, size, packed + packedlength,
+                          M_LZ4_BOUND(size));
+
+        if (n <= 0 || n >= size)
+        {
+            memcpy(packed + packedlength, wad + pos, size);
+            n = size;
+            ++numstored;
+        }
+
+        chunks[numchunks][0] = pos;
+        chunks[numchunks][1] = size;
+        chunks[numchunks][2] = packedlength;
+        chunks[numchunks][3] = n;
+        ++numchunks;
+
+        packedlength += n;
+    }
+
+    // Check it all comes back, and time how long that takes.
+
+    check = malloc(length > 0 ? length : 1);
+    start = clock();
+
+    for (i = 0; i < numchunks; ++i)
+    {
+        if (chunks[i][3] == chunks[i][1])
+        {
+            memcpy(check + chunks[i][0], packed + chunks[i][2], chunks[i][1]);
+        }
+        else if (M_LZ4Decompress(packed + chunks[i][2], chunks[i][3],
+                                 check + chunks[i][0], chunks[i][1])
+                 != chunks[i][1])
+        {
+            fprintf(stderr, "piece %d does not unpack\n", i);
+            return 1;
+        }
+    }
+
+    unpacktime = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    if (memcmp(check, wad, length) != 0)
+    {
+        fprintf(stderr, "unpacked data differs\n");
+        return 1;
+    }
+
+    out = fopen(argv[2], "w");
+
+    if (out == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by wadpack from %s; do not edit.\n\n", argv[1]);
+    fprintf(out, "unsigned int doom1_wad_len = %ld;\n\n", length);
+    fprintf(out, "static const unsigned int doom1_wad_chunks[][4] = {\n");
+
+    for (i = 0; i < numchunks; ++i)
+    {
+        fprintf(out, "  { %u, %u, %u, %u },\n",
+                chunks[i][0], chunks[i][1], chunks[i][2], chunks[i][3]);
+    }
+
+    fprintf(out, "};\n\nstatic const unsigned char doom1_wad_packed[] = {");
+
+    for (i = 0; i < packedlength; ++i)
+    {
+        fprintf(out, "%s0x%02x,", i % 12 == 0 ? "\n  " : " ", packed[i]);
+    }
+
+    fprintf(out, "\n};\n");
+    fclose(out);
+
+    printf("%s: %ld bytes, %u lumps -> %ld bytes (%.1f%%) in %d pieces, "
+           "%d stored; unpacks in %.1f ms\n",
+           argv[1], length, numlumps, packedlength,
+           length > 0 ? 100.0 * packedlength / length : 0.0,
+           numchunks, numstored, unpacktime * 1000);
+
+    free(check);
+    free(packed);
+    free(chunks);
+    free(bounds);
+    free(wad);
+
+    return 0;
+}